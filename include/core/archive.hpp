@@ -0,0 +1,108 @@
+#ifndef CHRONICLE_ARCHIVE_HPP
+#define CHRONICLE_ARCHIVE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr uint64_t CHRONICLE_ARCHIVE_SEGMENT_SIZE = 256ull * 1024 * 1024;   // Segments roll over past this
+inline constexpr int CHRONICLE_ARCHIVE_COMPRESSION_LEVEL = 6;
+inline constexpr int64_t CHRONICLE_ARCHIVE_MIN_TIME = std::numeric_limits<int64_t>::min();
+inline constexpr int64_t CHRONICLE_ARCHIVE_MAX_TIME = std::numeric_limits<int64_t>::max();
+
+/* ---------- Data Structures ---------- */
+
+struct archiveEntry {
+    std::string device;
+    std::string hash;
+    int64_t taken_at = 0;   // Unix milliseconds
+    uint32_t size = 0;      // Blob bytes
+    uint32_t segment = 0;
+    uint64_t offset = 0;
+};
+
+/*
+
+    # archive.hpp
+    Append-only on-disk store of snapshot history, readable without a database.
+
+    A directory of segment files (segment-NNNNNN.chra), each a sequence of records:
+    32 byte header (magic, crc32, flags, sizes, takenAt), device name, hash and the blob,
+    deflated when that saves space. A snapshot whose hash matches the previous record of
+    the same device is stored as a reference to that record instead of a second copy.
+
+    Every segment has an index file (segment-NNNNNN.idx) listing its records by device
+    and time. Opening the archive reads only the indexes, records past the indexed part
+    of a segment (an unclean shutdown) are scanned, and a torn record at the tail is cut
+    off when the archive is opened for writing.
+
+    Segments are mapped read only, blobs stored uncompressed are handed out as views into
+    the mapping and compressed ones are inflated straight from it.
+
+    Records of a device are appended in time order, append() ignores a snapshot that is
+    not newer than the last one archived for the device so exports can simply be rerun.
+
+*/
+
+class SnapshotArchive {
+  public:
+    explicit SnapshotArchive(const std::string& directory, bool writable = false);
+    ~SnapshotArchive();
+    SnapshotArchive(const SnapshotArchive&) = delete;
+    SnapshotArchive& operator=(const SnapshotArchive&) = delete;
+
+    bool append(const std::string& device, const std::string& hash, int64_t takenAt, std::string_view blob);
+    void flush();
+
+    std::vector<std::string> devices() const;
+    int64_t latest(const std::string& device) const;   // 0 when the device has no records
+    size_t size() const;
+
+    std::vector<archiveEntry> entries(const std::string& device,
+                                      int64_t from = CHRONICLE_ARCHIVE_MIN_TIME,
+                                      int64_t to = CHRONICLE_ARCHIVE_MAX_TIME) const;
+    std::string read(const archiveEntry& entry) const;
+
+    // Visits the records of one device (every device when empty) in time order, the view is only valid during the call
+    void scan(const std::string& device, int64_t from, int64_t to,
+              const std::function<void(const archiveEntry&, std::string_view)>& visit) const;
+
+  private:
+    struct location {
+      uint32_t segment;
+      uint32_t size;
+      int64_t taken_at;
+      uint64_t offset;
+    };
+
+    struct segmentFile {
+      std::string path;
+      uint64_t size = 0;        // Bytes of valid records
+      uint64_t indexed = 0;     // Bytes covered by the index file
+      void* map = nullptr;
+      size_t mapped = 0;
+    };
+
+    void openSegment(uint32_t id, bool recover);
+    void mapSegment(segmentFile& segment, size_t length);
+    void startSegment();
+    void writeIndex(uint32_t id);
+    std::string_view payload(uint32_t segment, uint64_t offset, std::string& scratch) const;
+    archiveEntry describe(const std::string& device, const location& at) const;
+
+    std::string directory_;
+    bool writable_;
+    int activeFd_ = -1;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<segmentFile> segments_;
+    std::map<std::string, std::vector<location>> devices_;
+    size_t count_ = 0;
+};
+
+#endif // CHRONICLE_ARCHIVE_HPP
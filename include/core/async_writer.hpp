@@ -0,0 +1,105 @@
+#ifndef CHRONICLE_ASYNC_WRITER_HPP
+#define CHRONICLE_ASYNC_WRITER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <bsoncxx/document/value.hpp>
+
+class MongoDB;
+
+inline constexpr size_t CHRONICLE_WRITER_DEFAULT_QUEUE_CAPACITY = 10000;     // Documents
+inline constexpr size_t CHRONICLE_WRITER_DEFAULT_BATCH_SIZE = 500;           // Documents per insert_many
+inline constexpr size_t CHRONICLE_WRITER_DEFAULT_BATCH_BYTES = 8 * 1024 * 1024;
+inline constexpr int CHRONICLE_WRITER_DEFAULT_LINGER_MS = 50;                // Wait for a batch to fill
+inline constexpr int CHRONICLE_WRITER_MAX_ATTEMPTS = 3;
+
+/* ---------- Data Structures ---------- */
+
+struct writerOptions {
+    size_t queue_capacity = CHRONICLE_WRITER_DEFAULT_QUEUE_CAPACITY;
+    size_t batch_size = CHRONICLE_WRITER_DEFAULT_BATCH_SIZE;
+    size_t batch_bytes = CHRONICLE_WRITER_DEFAULT_BATCH_BYTES;
+    int linger_ms = CHRONICLE_WRITER_DEFAULT_LINGER_MS;
+};
+
+struct writerStats {
+    uint64_t queued = 0;        // Documents waiting right now
+    uint64_t written = 0;
+    uint64_t failed = 0;        // Given up on after CHRONICLE_WRITER_MAX_ATTEMPTS
+    uint64_t batches = 0;
+    uint64_t rejected = 0;      // tryInsert calls that found the queue full
+    std::string last_error;
+};
+
+/*
+
+    # async_writer.hpp
+    Background writer that takes inserts off the caller's thread.
+
+    Documents are queued and a single thread writes them with one insert_many per collection,
+    once a batch reaches batch_size documents or batch_bytes, or linger_ms after its first
+    document arrived. The writer has its own connection, a mongocxx client is not thread safe.
+
+    The queue is bounded: insert() blocks while it is full (back-pressure on a producer that
+    outruns the database), tryInsert() never blocks and returns false instead.
+
+    A failed batch is retried, documents that still fail are counted in stats() and reported
+    by the next flush(). Only the documents the server refused are sent again. Documents
+    without an _id get one before the first attempt, so a retry never stores a second copy:
+    an _id conflict on a retry is the copy an earlier attempt stored and counts as written.
+    Any other duplicate key is a failure, retrying it cannot help. close() (and the
+    destructor) drains the queue before stopping.
+
+*/
+
+class AsyncWriter {
+  public:
+    explicit AsyncWriter(const writerOptions& options = writerOptions());
+    ~AsyncWriter();
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void insert(const std::string& collection, bsoncxx::document::value document);
+    bool tryInsert(const std::string& collection, bsoncxx::document::value document);
+
+    // Waits until everything queued so far is written, throws if any of it failed since the last flush
+    void flush();
+    void close();
+
+    writerStats stats() const;
+
+  private:
+    struct pending {
+      std::string collection;
+      bsoncxx::document::value document;
+    };
+
+    void enqueue(std::unique_lock<std::mutex>& lock, const std::string& collection, bsoncxx::document::value&& document);
+    void run();
+
+    writerOptions options_;
+    std::unique_ptr<MongoDB> db_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;        // Writer thread waits for documents
+    std::condition_variable space_;       // Producers wait for room in the queue
+    std::condition_variable done_;        // flush() waits for its documents
+    std::deque<pending> queue_;
+    size_t queuedBytes_ = 0;
+    uint64_t enqueued_ = 0;
+    uint64_t completed_ = 0;              // Written or failed
+    uint64_t flushTarget_ = 0;
+    uint64_t unreportedFailures_ = 0;
+    bool stopping_ = false;
+    writerStats stats_;
+
+    std::thread thread_;
+};
+
+#endif // CHRONICLE_ASYNC_WRITER_HPP
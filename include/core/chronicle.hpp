@@ -4,8 +4,85 @@
 #include <string>
 #include "core/config.hpp"
 #include "core/device_factory.hpp"
+#include "core/fleet_run.hpp"
+#include "core/reachability.hpp"
+#include "core/result.hpp"
 
-// Device operations
-std::vector<std::string> getConfig(connectionInfo ci, std::vector<OperationMap> getConfig);
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS = 16;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS = 64;
+
+/* ---------- Data Structures ---------- */
+
+struct configCheck {
+    bool probed = false;              // False when the plugin declares no change probe
+    bool changed = true;              // False when the probe matched and the full download was skipped
+    std::string probe;                // Probe output of this run
+    std::vector<std::string> config;  // Empty unless changed
+};
+
+// Outcome of one device in a batch, failures are collected instead of raised
+struct configResult {
+    std::string device;
+    bool ok = false;
+    int code = 0;
+    std::string message;
+    std::string details;
+    std::string hash;                   // Snapshot stored by backupRun, the config itself is not kept
+    std::vector<std::string> config;
+};
+
+// Devices that gave the same (normalized) output
+struct fanoutGroup {
+    std::string hash;
+    std::vector<std::string> output;    // Every command's output in order, stored once for the whole group
+    size_t count = 0;
+    std::vector<std::string> devices;
+};
+
+struct fanoutResult {
+    size_t devices = 0;
+    size_t succeeded = 0;
+    std::vector<fanoutGroup> groups;        // Largest group first
+    std::vector<configResult> failures;
+};
+
+// Device operations, the try variants report failures through the Result instead of throwing
+// A bare command list answers the pager prompts given, a plugin's deviceOperations carry their own
+Result<std::vector<std::string>> tryGetConfig(const connectionInfo& ci, const std::vector<OperationMap>& getConfig,
+                                              const std::vector<std::string>& pagerPrompts = {});
+Result<std::vector<std::string>> tryGetConfig(const connectionInfo& ci, const deviceOperations& ops);
+std::vector<std::string> getConfig(connectionInfo ci, std::vector<OperationMap> getConfig, const std::vector<std::string>& pagerPrompts = {});
+std::vector<std::string> getConfig(connectionInfo ci, const deviceOperations& ops);
+configCheck getConfigIfChanged(connectionInfo ci, const deviceOperations& ops);
+std::vector<configResult> getConfigBatch(const std::vector<connectionInfo>& devices, const deviceOperations& ops,
+                                         int workers = CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS);
+
+// getConfigBatch checkpointed in a fleet run, every device's snapshot is stored under the run as it
+// comes in and devices are leased ahead of the workers, results come in the order devices finished.
+// Devices the run has done already are skipped and have no result
+std::vector<configResult> backupRun(FleetRun& run, const std::vector<connectionInfo>& devices, const deviceOperations& ops,
+                                    int workers = CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS);
+
+// Ad hoc commands across a device set, the outputs of all commands are joined in order and grouped
+// by their hash. pagerPrompts are answered
+// in shell mode, the commands page on devices whose terminal length was not set
+fanoutResult fanOut(const std::vector<connectionInfo>& devices, const std::vector<OperationMap>& operations,
+                    const std::vector<NormalizeRule>& normalize = {}, int channelMode = CHRONICLE_CHANNEL_MODE_SHELL,
+                    int workers = CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS, const std::vector<std::string>& pagerPrompts = {});
+fanoutResult fanOutByName(const std::vector<std::string>& nicknames, const std::vector<OperationMap>& operations,
+                          const std::vector<NormalizeRule>& normalize = {}, int channelMode = CHRONICLE_CHANNEL_MODE_SHELL,
+                          int workers = CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS, const std::vector<std::string>& pagerPrompts = {});
+
+// Offline replay of a recorded shell session, see transcript.hpp
+std::vector<std::string> replayConfig(const std::string& transcriptPath, std::vector<OperationMap> getConfig, bool realtime = false,
+                                      const std::vector<std::string>& pagerPrompts = {});
+std::vector<std::string> replayConfig(const std::string& transcriptPath, const deviceOperations& ops, bool realtime = false);
+
+// Inventory operations
+std::vector<reachabilityResult> sweepReachability(int timeoutMs = CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT,
+                                                  int maxInFlight = CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT);
+std::vector<reachabilityResult> sweepReachability(const std::vector<connectionInfo>& devices,
+                                                  int timeoutMs = CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT,
+                                                  int maxInFlight = CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT);
 
 #endif // CHRONICLE_H
\ No newline at end of file
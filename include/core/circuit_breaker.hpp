@@ -0,0 +1,109 @@
+#ifndef CHRONICLE_CIRCUIT_BREAKER_HPP
+#define CHRONICLE_CIRCUIT_BREAKER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/error_handler.hpp"
+#include "core/result.hpp"
+
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_BREAKER_THRESHOLD    = 3;        // Consecutive failures before opening
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_BREAKER_COOLDOWN     = 60000;    // ms, doubled on every failed probe
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_BREAKER_MAX_COOLDOWN = 3600000;  // ms
+
+/* ---------- Circuit States ---------- */
+
+inline constexpr int CHRONICLE_CIRCUIT_CLOSED    = 0;   // Calls go through
+inline constexpr int CHRONICLE_CIRCUIT_OPEN      = 1;   // Calls fail immediately until the cooldown ends
+inline constexpr int CHRONICLE_CIRCUIT_HALF_OPEN = 2;   // A single probe call is in flight
+
+/* ---------- Data Structures ---------- */
+
+struct retryPolicy {
+    int max_attempts;
+    int base_delay_ms;
+    int max_delay_ms;
+};
+
+struct deviceHealth {
+    int state = CHRONICLE_CIRCUIT_CLOSED;
+    int consecutive_failures = 0;
+    int last_error = 0;
+    int cooldown_ms = CHRONICLE_CONFIG_DEFAULT_BREAKER_COOLDOWN;
+    int64_t open_until_ms = 0;      // Steady clock, only meaningful while open
+};
+
+/*
+
+    # circuit_breaker.hpp
+    Per-device failure tracking shared by every worker in the process.
+
+    A device whose connections keep failing is opened and short-circuited until its cooldown ends,
+    then a single half-open probe decides whether it closes again or stays open for longer.
+    Only transport level errors count, a failing command still proves the device is alive.
+
+*/
+
+retryPolicy getRetryPolicy(int error_code);
+bool isDeviceFailure(int error_code);
+int getBackoffDelay(const retryPolicy& policy, int attempt);
+
+class CircuitBreaker {
+    public:
+        static CircuitBreaker& instance();
+
+        bool allowRequest(const std::string& device);
+        void recordSuccess(const std::string& device);
+        void recordFailure(const std::string& device, int error_code);
+        deviceHealth getHealth(const std::string& device);
+        void reset(const std::string& device);
+
+    private:
+        CircuitBreaker() = default;
+        std::mutex mutex_;
+        std::unordered_map<std::string, deviceHealth> devices_;
+};
+
+/*
+    Runs func, which returns a Result, against a device under the circuit breaker. Failures
+    are retried with exponential backoff and full jitter according to the policy of their
+    error code and handed back without an exception being thrown.
+*/
+template <typename Func>
+auto withDeviceRetryResult(const std::string& device, Func&& func) -> decltype(func()) {
+    CircuitBreaker& breaker = CircuitBreaker::instance();
+
+    for (int attempt = 1; ; ++attempt) {
+        if (!breaker.allowRequest(device)) {
+            return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_CIRCUIT_OPEN, device);
+        }
+
+        try {
+            auto result = func();
+            if (result.ok() || !isDeviceFailure(result.error().code())) {
+                breaker.recordSuccess(device);
+                return result;
+            }
+
+            const int code = result.error().code();
+            breaker.recordFailure(device, code);
+
+            retryPolicy policy = getRetryPolicy(code);
+            if (attempt >= policy.max_attempts || breaker.getHealth(device).state != CHRONICLE_CIRCUIT_CLOSED) {
+                return result;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(getBackoffDelay(policy, attempt)));
+        } catch (...) {
+            breaker.recordSuccess(device);
+            throw;
+        }
+    }
+}
+
+#endif // CHRONICLE_CIRCUIT_BREAKER_HPP
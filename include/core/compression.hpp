@@ -0,0 +1,86 @@
+#ifndef CHRONICLE_COMPRESSION_HPP
+#define CHRONICLE_COMPRESSION_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+struct ZSTD_DCtx_s;
+
+inline constexpr int CHRONICLE_COMPRESSION_LEVEL = 9;                          // Configs are written once and read many times
+inline constexpr size_t CHRONICLE_DICTIONARY_CAPACITY = 112 * 1024;
+inline constexpr size_t CHRONICLE_DICTIONARY_MIN_SAMPLES = 8;
+inline constexpr size_t CHRONICLE_DICTIONARY_MAX_SAMPLES = 2000;
+inline constexpr auto CHRONICLE_CODEC_ZSTD = "zstd";
+
+/* ---------- Data Structures ---------- */
+
+struct compressionBenchmark {
+    std::string codec;          // "none", "zstd" or "zstd+dict"
+    size_t raw_bytes = 0;
+    size_t stored_bytes = 0;
+    double ratio = 1.0;
+    double compress_mb_s = 0;
+    double decompress_mb_s = 0;
+};
+
+/*
+
+    # compression.hpp
+    zstd compression of stored configuration blobs.
+
+    Configurations of one vendor share most of their text (section names, defaults, banners),
+    so a dictionary trained on a vendor's existing snapshots lets even a small blob or delta
+    compress well. Dictionaries are immutable and versioned, a blob records the id of the
+    dictionary it was written with and old versions stay readable.
+
+    BlobDecompressor inflates a blob chunk by chunk as the chunks arrive from the database,
+    the compressed blob is never held in memory as a whole.
+
+    benchmarkCompression measures ratio and throughput of no compression, plain zstd and zstd
+    with a dictionary trained on the given samples.
+
+*/
+
+class CompressionDictionary {
+  public:
+    CompressionDictionary(std::string id, std::string bytes, int level = CHRONICLE_COMPRESSION_LEVEL);
+    ~CompressionDictionary();
+    CompressionDictionary(const CompressionDictionary&) = delete;
+    CompressionDictionary& operator=(const CompressionDictionary&) = delete;
+
+    const std::string& id() const { return id_; }
+    const std::string& bytes() const { return bytes_; }
+    const ZSTD_CDict_s* compressor() const { return cdict_; }
+    const ZSTD_DDict_s* decompressor() const { return ddict_; }
+
+  private:
+    std::string id_;
+    std::string bytes_;
+    ZSTD_CDict_s* cdict_ = nullptr;
+    ZSTD_DDict_s* ddict_ = nullptr;
+};
+
+class BlobDecompressor {
+  public:
+    explicit BlobDecompressor(const CompressionDictionary* dictionary = nullptr);
+    ~BlobDecompressor();
+    BlobDecompressor(const BlobDecompressor&) = delete;
+    BlobDecompressor& operator=(const BlobDecompressor&) = delete;
+
+    void feed(std::string_view input, std::string& output);
+    void finish() const;    // Throws when the input ended inside a frame
+
+  private:
+    ZSTD_DCtx_s* dctx_ = nullptr;
+    bool complete_ = true;
+};
+
+std::string trainDictionary(const std::vector<std::string>& samples, size_t capacity = CHRONICLE_DICTIONARY_CAPACITY);
+std::string compressBlob(std::string_view data, const CompressionDictionary* dictionary = nullptr, int level = CHRONICLE_COMPRESSION_LEVEL);
+std::string decompressBlob(std::string_view data, const CompressionDictionary* dictionary = nullptr);
+std::vector<compressionBenchmark> benchmarkCompression(const std::vector<std::string>& samples, int level = CHRONICLE_COMPRESSION_LEVEL);
+
+#endif // CHRONICLE_COMPRESSION_HPP
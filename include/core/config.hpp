@@ -1,7 +1,9 @@
 #ifndef CHRONICLE_CONFIG_H
 #define CHRONICLE_CONFIG_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 inline constexpr auto CHRONICLE_CONFIG_DEFAULT_KEX_METHODS =
     "curve25519-sha256@libssh.org,ecdh-sha2-nistp384,ecdh-sha2-nistp256,diffie-hellman-group14-sha256";
@@ -12,6 +14,13 @@ inline constexpr const char* CHRONICLE_CONFIG_DEFAULT_USER = "chronicle-runner";
 inline constexpr int CHRONICLE_CONFIG_DEFAULT_VERBOSITY = 0;
 inline constexpr int CHRONICLE_CONFIG_DEFAULT_SSH_IDLE_TIMEOUT = 1000;
 inline constexpr int CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT = 10000;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SSH_CONNECT_TIMEOUT = 3000;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SSH_HANDSHAKE_TIMEOUT = 5000;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SSH_AUTH_TIMEOUT = 5000;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_COMPRESSION_LEVEL = 6;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_READ_BUFFER = 16384;
+inline constexpr int CHRONICLE_CONFIG_MIN_READ_BUFFER = 4096;
+inline constexpr int CHRONICLE_CONFIG_MAX_READ_BUFFER = 1048576;
 
 struct connectionInfo {
 
@@ -20,6 +29,7 @@ struct connectionInfo {
 
     std::string kex_methods = CHRONICLE_CONFIG_DEFAULT_KEX_METHODS;
     std::string hostkey_algorithms = CHRONICLE_CONFIG_DEFAULT_HOSTKEYS;
+    std::string nickname;
     std::string vendorName;
     int vendor;
     std::string deviceName;
@@ -29,14 +39,30 @@ struct connectionInfo {
     std::string host;
     int port = CHRONICLE_CONFIG_DEFAULT_PORT;
     int verbosity = CHRONICLE_CONFIG_DEFAULT_VERBOSITY;
+    bool reachable = true;      // False when the last reachability sweep could not reach the device
+    int64_t reachable_checked_at = 0;   // Unix seconds of that sweep, 0 if never swept
+
+    // Transport tuning
+    bool compression = false;
+    int compression_level = CHRONICLE_CONFIG_DEFAULT_COMPRESSION_LEVEL;
+    int read_buffer_size = CHRONICLE_CONFIG_DEFAULT_READ_BUFFER;
+    int last_output_size = 0;   // Bytes of the last getConfig output, used to pre-size buffers
+
+    // Change detection, state of the last full download
+    std::string change_probe;           // Probe output seen at the last full download
+    int64_t change_probe_full_at = 0;   // Unix seconds of the last full download, 0 if never
 };
 
 struct chronicleSettings {
     int ssh_idle_timeout = CHRONICLE_CONFIG_DEFAULT_SSH_IDLE_TIMEOUT;
     int ssh_total_timeout = CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT;
+    int ssh_connect_timeout = CHRONICLE_CONFIG_DEFAULT_SSH_CONNECT_TIMEOUT;
+    int ssh_handshake_timeout = CHRONICLE_CONFIG_DEFAULT_SSH_HANDSHAKE_TIMEOUT;
+    int ssh_auth_timeout = CHRONICLE_CONFIG_DEFAULT_SSH_AUTH_TIMEOUT;
 };
 
 
 connectionInfo getConnectionInfo(const std::string& deviceNickname);
+std::vector<connectionInfo> getAllConnectionInfo();
 chronicleSettings getChronicleSettings();
 #endif // CHRONICLE_CONFIG_H
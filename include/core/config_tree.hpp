@@ -0,0 +1,62 @@
+#ifndef CHRONICLE_CONFIG_TREE_HPP
+#define CHRONICLE_CONFIG_TREE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* ---------- Data Structures ---------- */
+
+struct configNode {
+    std::string_view text;              // Trimmed line, Junos "{" and ";" removed, points into the tree buffer
+    uint32_t line = 0;                  // 0 based source line, the root has none
+    uint32_t depth = 0;                 // 0 for the root, 1 for top level lines
+    configNode* parent = nullptr;
+    configNode* first_child = nullptr;
+    configNode* last_child = nullptr;
+    configNode* next_sibling = nullptr;
+};
+
+/*
+
+    # config_tree.hpp
+    Parses IOS style (indentation) or Junos style (braces) configuration output into a tree.
+    Braces are used only when the lines ending in "{" and the "}" lines balance.
+
+    The text is copied once into a single buffer and every node lives in one block allocated
+    up front, nodes only hold string_views into the buffer so parsing never allocates per line.
+
+    Path queries are '/' separated glob segments ('*' and '?'). A segment matches whole words from
+    the start of a line, so the segment "interface *" followed by "ip address" finds every
+    "ip address ..." line inside an interface block. A "**" segment matches any number of levels.
+
+*/
+
+class ConfigTree {
+  public:
+    explicit ConfigTree(std::string_view text);
+    explicit ConfigTree(const std::vector<std::string>& lines);
+
+    const configNode* root() const { return &nodes_[0]; }
+    size_t size() const { return count_ - 1; }
+    bool braces() const { return braces_; }
+
+    std::vector<const configNode*> query(std::string_view path) const;
+    static std::vector<const configNode*> query(const configNode* from, std::string_view path);
+
+  private:
+    void parse();
+
+    std::unique_ptr<char[]> buffer_;
+    size_t length_ = 0;
+    std::unique_ptr<configNode[]> nodes_;
+    size_t count_ = 0;
+    bool braces_ = false;
+};
+
+std::vector<const configNode*> childrenOf(const configNode* node);
+std::string nodePath(const configNode* node);
+
+#endif // CHRONICLE_CONFIG_TREE_HPP
@@ -18,6 +18,25 @@ inline constexpr int LINUX_TEST        = 80;
 inline constexpr int JUNIPER_ID        = 2;
 inline constexpr int VSRX              = 1;
 
+/* ---------- Channel Modes ---------- */
+
+// Interactive shell on a pty, commands share one channel (default)
+inline constexpr int CHRONICLE_CHANNEL_MODE_SHELL = 0;
+// Non-interactive exec, every command runs on its own channel
+inline constexpr int CHRONICLE_CHANNEL_MODE_EXEC  = 1;
+
+// Longest time a change probe may skip the full download (seconds)
+inline constexpr int CHRONICLE_DEVICE_DEFAULT_PROBE_MAX_AGE = 7 * 24 * 3600;
+
+/* ---------- Normalize Rules ---------- */
+
+// Drop lines that start with the pattern (leading whitespace ignored)
+inline constexpr int CHRONICLE_NORMALIZE_DROP_PREFIX = 0;
+// Drop lines the pattern (ECMAScript regex) matches anywhere
+inline constexpr int CHRONICLE_NORMALIZE_DROP_MATCH  = 1;
+// Replace every regex match with the replacement ($1 etc. allowed)
+inline constexpr int CHRONICLE_NORMALIZE_REPLACE     = 2;
+
 /* ---------- Data Structures ---------- */
 
 struct OperationMap {
@@ -25,13 +44,27 @@ struct OperationMap {
   int skip_head;
   int skip_tail;
   std::string err_msg;
+  int cache_ttl = 0;        // Seconds fanOut may serve the output from the output cache, 0 never
+};
+
+struct NormalizeRule {
+  int kind;
+  std::string pattern;
+  std::string replacement;
 };
 
 struct deviceOperations {
   std::vector<OperationMap> getConfig;
+  std::vector<OperationMap> changeProbe;    // Cheap commands whose joined output changes whenever the config does
+  std::vector<NormalizeRule> normalize;     // Applied to the getConfig output, in order
+  std::vector<std::string> pager_prompts;   // Regexes of the pager's "more" line, answered with a space while reading
+  int channel_mode = CHRONICLE_CHANNEL_MODE_SHELL;
+  int probe_max_age = CHRONICLE_DEVICE_DEFAULT_PROBE_MAX_AGE;
 
   void pushCommand(std::vector<OperationMap>& operation, const std::string& command,
                    int skip_head, int skip_tail, const std::string& err_msg);
+  void pushNormalizeRule(int kind, const std::string& pattern, const std::string& replacement = "");
+  void pushPagerPrompt(const std::string& pattern);
 };
 
 /* ---------- Required Plugin Exports ---------- */
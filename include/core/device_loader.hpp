@@ -0,0 +1,36 @@
+#ifndef CHRONICLE_DEVICE_LOADER_HPP
+#define CHRONICLE_DEVICE_LOADER_HPP
+
+#include "core/device_factory.hpp"
+
+#include <memory>
+#include <string>
+
+inline constexpr auto CHRONICLE_DEVICE_PLUGIN_EXTENSION = ".cld";
+
+/*
+
+    # device_loader.hpp
+    Loading of device plugins (.cld shared objects built by chronicle_device in CMakeLists.txt).
+
+    A DeviceHandle keeps the plugin loaded for as long as its deviceOperations are in use,
+    both go away with the last reference.
+
+    devicePluginPath: <directory>/<vendor>/<device>.cld, the layout the build installs plugins in.
+
+*/
+
+struct DeviceHandle {
+    void* handle;
+    deviceOperations* ops;
+
+    DeviceHandle(void* h, deviceOperations* o) : handle(h), ops(o) {}
+    ~DeviceHandle();
+    DeviceHandle(const DeviceHandle&) = delete;
+    DeviceHandle& operator=(const DeviceHandle&) = delete;
+};
+
+std::shared_ptr<DeviceHandle> loadDeviceOps(const std::string& so_path, int device_id, int vendor_id);
+std::string devicePluginPath(const std::string& directory, const std::string& vendorName, const std::string& deviceName);
+
+#endif // CHRONICLE_DEVICE_LOADER_HPP
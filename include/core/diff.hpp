@@ -0,0 +1,64 @@
+#ifndef CHRONICLE_DIFF_HPP
+#define CHRONICLE_DIFF_HPP
+
+#include <string>
+#include <vector>
+
+inline constexpr int CHRONICLE_DIFF_DEFAULT_CONTEXT = 3;
+
+/* ---------- Edit Kinds ---------- */
+
+inline constexpr int CHRONICLE_DIFF_EQUAL  = 0;
+inline constexpr int CHRONICLE_DIFF_DELETE = 1;
+inline constexpr int CHRONICLE_DIFF_INSERT = 2;
+
+/* ---------- Data Structures ---------- */
+
+// A run of lines, old_start/new_start are 0 based, an insert has no old lines and a delete no new ones
+struct diffOp {
+    int kind;
+    size_t old_start;
+    size_t new_start;
+    size_t length;
+};
+
+struct diffSummary {
+    bool identical = true;
+    int added = 0;
+    int removed = 0;
+    int hunks = 0;
+    std::vector<std::string> sections;     // Top level blocks (e.g. "interface Gi1") that contain a change
+};
+
+struct diffBenchmark {
+    size_t lines = 0;                      // Of the old version
+    double edit_rate = 0;                  // Share of lines changed, removed or added after
+    size_t edits = 0;                      // Non equal runs diffLines found
+    double diff_ms = 0;                    // diffLines, best of the rounds
+    double unified_ms = 0;                 // Hierarchical unifiedDiff, best of the rounds
+    double lines_per_s = 0;                // Old and new lines through diffLines per second
+};
+
+/*
+
+    # diff.hpp
+    Line diff between two configuration snapshots.
+
+    Lines are interned by hash first, the comparison itself runs on integers using Myers' O(ND)
+    algorithm in linear space. Hierarchical mode follows indentation (IOS blocks, Junos braces)
+    and labels every hunk with the chain of blocks it sits in.
+
+    benchmarkDiff times diffLines and unifiedDiff on synthetic configurations (synthetic.hpp)
+    of every size against every edit rate, Myers' cost grows with the number of edits.
+
+*/
+
+std::vector<diffOp> diffLines(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines);
+std::string unifiedDiff(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines,
+                        const std::string& old_label = "old", const std::string& new_label = "new",
+                        int context = CHRONICLE_DIFF_DEFAULT_CONTEXT, bool hierarchical = false);
+diffSummary summarizeDiff(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines);
+std::vector<diffBenchmark> benchmarkDiff(const std::vector<size_t>& sizes = {1000, 10000, 100000},
+                                         const std::vector<double>& editRates = {0.001, 0.01, 0.1}, int rounds = 3);
+
+#endif // CHRONICLE_DIFF_HPP
@@ -13,6 +13,8 @@
     1XX:            Internal core error. (within C++)
     2XX:            SSH error.
     3xx:            Device factory error.
+    4xx:            Local storage error. (fleet index, snapshot archive)
+    5xx:            Compression error.
     1xxxx:          MongoDB error.
     15xxx:          ChronicleDB error.
 
@@ -21,6 +23,7 @@
 // Core internal errors
 inline constexpr int CHRONICLE_ERROR_UNKNOWN_CORE_ERROR       = 100;
 inline constexpr int CHRONICLE_ERROR_ASSERTION_FAILED         = 101;
+inline constexpr int CHRONICLE_ERROR_TRACE_EXPORT_FAILED      = 102;
 
 // SSH errors
 inline constexpr int CHRONICLE_ERROR_SSH_UNKNOWN              = 200;
@@ -28,12 +31,40 @@ inline constexpr int CHRONICLE_ERROR_SSH_CLOSED_REMOTE        = 201;
 inline constexpr int CHRONICLE_ERROR_SSH_SESSION_FAILED       = 202;
 inline constexpr int CHRONICLE_ERROR_SSH_CONNECTION_FAILED    = 203;
 inline constexpr int CHRONICLE_ERROR_SSH_COMMAND_FAILED       = 204;
+inline constexpr int CHRONICLE_ERROR_SSH_HOST_UNREACHABLE     = 205;
+inline constexpr int CHRONICLE_ERROR_SSH_CIRCUIT_OPEN         = 206;
+inline constexpr int CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED    = 207;
+inline constexpr int CHRONICLE_ERROR_SSH_REPLAY_MISMATCH      = 208;
+inline constexpr int CHRONICLE_ERROR_SSH_AUTH_FAILED          = 209;
+inline constexpr int CHRONICLE_ERROR_SSH_HOST_KEY_MISMATCH    = 210;
 
 // Device factory
 inline constexpr int CHRONICLE_ERROR_DEVICE_FACTORY_FAILED    = 300;
 inline constexpr int CHRONICLE_ERROR_INVALID_DEVICE_ID        = 301;
 inline constexpr int CHRONICLE_ERROR_INVALID_VENDOR_ID        = 302;
 inline constexpr int CHRONICLE_ERROR_LOAD_DEVICE_MAP_FAILED   = 303;
+inline constexpr int CHRONICLE_ERROR_INVALID_NORMALIZE_RULE   = 304;
+inline constexpr int CHRONICLE_ERROR_INVALID_PAGER_PROMPT     = 305;
+
+// Fleet index
+inline constexpr int CHRONICLE_ERROR_FLEET_INDEX_IO_FAILED    = 400;
+inline constexpr int CHRONICLE_ERROR_FLEET_INDEX_CORRUPT      = 401;
+inline constexpr int CHRONICLE_ERROR_FLEET_INDEX_BAD_PATTERN  = 402;
+
+// Snapshot archive
+inline constexpr int CHRONICLE_ERROR_ARCHIVE_IO_FAILED        = 410;
+inline constexpr int CHRONICLE_ERROR_ARCHIVE_CORRUPT          = 411;
+inline constexpr int CHRONICLE_ERROR_ARCHIVE_READ_ONLY        = 412;
+
+// Storage backends
+inline constexpr int CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED   = 420;
+inline constexpr int CHRONICLE_ERROR_STORAGE_JOURNAL_CORRUPT  = 421;
+inline constexpr int CHRONICLE_ERROR_STORAGE_UNSUPPORTED      = 422;
+
+// Compression
+inline constexpr int CHRONICLE_ERROR_COMPRESSION_FAILED       = 500;
+inline constexpr int CHRONICLE_ERROR_DECOMPRESSION_FAILED     = 501;
+inline constexpr int CHRONICLE_ERROR_DICTIONARY_FAILED        = 502;
 
 // MongoDB errors
 inline constexpr int CHRONICLE_ERROR_MONGO_UNKNOWN            = 10000;
@@ -43,12 +74,14 @@ inline constexpr int CHRONICLE_ERROR_MONGO_UPDATE_FAILED      = 10003;
 inline constexpr int CHRONICLE_ERROR_MONGO_DUPLICATE          = 10004;
 inline constexpr int CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND = 10005;
 inline constexpr int CHRONICLE_ERROR_MONGO_DELETE_DOCUMENT    = 10006;
+inline constexpr int CHRONICLE_ERROR_MONGO_WRITER_CLOSED      = 10007;
 
 // ChronicleDB logic-level errors
 inline constexpr int CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED    = 15000;
 inline constexpr int CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED = 15001;
 inline constexpr int CHRONICLE_ERROR_CHRONICLE_DB_DELETE_FAILED = 15002;
 inline constexpr int CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT   = 15003;
+inline constexpr int CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB  = 15004;
 
 std::string getErrorMsg(int internal_exit_code = CHRONICLE_ERROR_UNKNOWN_CORE_ERROR);
 
@@ -0,0 +1,107 @@
+#ifndef CHRONICLE_FLEET_INDEX_HPP
+#define CHRONICLE_FLEET_INDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+inline constexpr size_t CHRONICLE_FLEET_INDEX_DEFAULT_LIMIT = 1000;
+
+/* ---------- Data Structures ---------- */
+
+struct fleetHit {
+    std::string device;
+    std::string hash;
+    int line;           // 0 based line in the snapshot
+    std::string text;
+};
+
+/*
+
+    # fleet_index.hpp
+    Trigram index over the latest snapshot of every device.
+
+    Every document (one per device) is posted under each distinct trigram of its lines.
+    A search intersects the postings of the needle's trigrams and only scans the
+    surviving documents, regex searches do the same with the literals the pattern requires.
+
+    save() writes all live documents and their postings to one file, load() maps it read only
+    and checks every table and posting points inside it, so a fresh process answers queries
+    without reading the configurations in. update() and remove() work on top of the mapped
+    file (new documents in memory, replaced ones tombstoned) until the next save() folds them
+    in. A save() that raced an update() leaves the index in memory as it is.
+
+*/
+
+class FleetIndex {
+  public:
+    FleetIndex() = default;
+    ~FleetIndex();
+    FleetIndex(const FleetIndex&) = delete;
+    FleetIndex& operator=(const FleetIndex&) = delete;
+
+    void load(const std::string& path);
+    void save(const std::string& path);
+
+    void update(const std::string& device, const std::string& hash, const std::vector<std::string>& lines);
+    void remove(const std::string& device);
+
+    std::string indexedHash(const std::string& device) const;
+    std::vector<std::string> devices() const;
+    size_t size() const;
+
+    // Unix milliseconds of the newest snapshot folded in, used for incremental syncs
+    int64_t lastSync() const;
+    void setLastSync(int64_t lastSync);
+
+    std::vector<fleetHit> search(const std::string& needle, size_t limit = CHRONICLE_FLEET_INDEX_DEFAULT_LIMIT) const;
+    std::vector<fleetHit> searchRegex(const std::string& pattern, size_t limit = CHRONICLE_FLEET_INDEX_DEFAULT_LIMIT) const;
+
+  private:
+    struct document {
+      std::string device;
+      std::string hash;
+      std::string_view text;                // Into the mapping or into owned
+      std::unique_ptr<std::string> owned;   // Documents added since the last load
+      bool live = true;
+    };
+
+    // A checked mapping of an index file, not yet in use
+    struct mappedFile {
+      void* map = nullptr;
+      size_t size = 0;
+      std::vector<document> docs;
+      std::unordered_map<std::string, uint32_t> byDevice;
+      int64_t lastSync = 0;
+      uint32_t docCount = 0;
+      uint32_t trigramCount = 0;
+      const unsigned char* trigramTable = nullptr;
+    };
+
+    static mappedFile mapFile(const std::string& path);
+    void install(mappedFile&& file);
+    std::vector<uint32_t> candidates(const std::vector<std::string>& literals) const;
+    std::vector<uint32_t> postings(uint32_t trigram) const;
+    void unmap();
+
+    mutable std::shared_mutex mutex_;
+    std::vector<document> docs_;
+    std::unordered_map<std::string, uint32_t> byDevice_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> memoryPostings_;
+    int64_t lastSync_ = 0;
+    uint64_t generation_ = 0;             // Bumped by every change, save() only maps its file over an unchanged index
+
+    // Mapped file
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    uint32_t mappedDocs_ = 0;
+    uint32_t mappedTrigrams_ = 0;
+    const unsigned char* trigramTable_ = nullptr;
+    const unsigned char* postingArea_ = nullptr;
+};
+
+#endif // CHRONICLE_FLEET_INDEX_HPP
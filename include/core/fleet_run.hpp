@@ -0,0 +1,107 @@
+#ifndef CHRONICLE_FLEET_RUN_HPP
+#define CHRONICLE_FLEET_RUN_HPP
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+inline constexpr auto CHRONICLE_RUN_PENDING = "pending";
+inline constexpr auto CHRONICLE_RUN_INFLIGHT = "inflight";
+inline constexpr auto CHRONICLE_RUN_DONE = "done";
+inline constexpr auto CHRONICLE_RUN_FAILED = "failed";
+
+inline constexpr auto CHRONICLE_RUN_STATUS_RUNNING = "running";
+inline constexpr auto CHRONICLE_RUN_STATUS_FINISHED = "finished";     // Nothing pending or in flight, failures may remain
+
+inline constexpr int CHRONICLE_RUN_DEFAULT_LEASE = 900;               // Seconds a device stays claimed without a renewal
+inline constexpr size_t CHRONICLE_RUN_FLUSH_BATCH = 200;              // Devices leased ahead of the workers, one write each time
+inline constexpr int CHRONICLE_RUN_FLUSH_INTERVAL_MS = 2000;
+
+struct runProgress {
+    std::string id;
+    std::string kind;
+    std::string status;
+    size_t devices = 0;
+    size_t pending = 0;
+    size_t inflight = 0;
+    size_t done = 0;
+    size_t failed = 0;
+};
+
+/*
+    # fleet_run.hpp
+    Checkpointed state of a run over a device set, so a crashed run picks up where it stopped.
+
+    A run is a document in runs and one document per device in rundevices, moving through
+
+        pending -> inflight -> done | failed
+
+    Transitions are kept in memory and written on flush(), the latest state of every changed
+    device in one bulk write, along with the run's counts. A device is claimed with a lease
+    that names its owner, the FleetRun object that took it. flush() renews the leases of this
+    owner once half of one has gone by, so a lease only runs out when its holder stopped, and
+    writes the owner's heartbeat (host, pid, time) into the run document.
+
+    resume() loads a run and works out what is left: pending devices, in flight ones whose
+    lease expired or whose owner is gone, failed ones when asked to retry them. An owner is
+    gone when its heartbeat is older than half its lease, or at once when it ran on this host
+    and its process no longer exists. A device with a snapshot stored under the run's id is
+    done whatever its state document says, a crash between storing the snapshot and the next
+    flush does not make it download again.
+
+    The state methods are thread safe. flush() writes to the database and belongs on the
+    thread that owns the connection.
+*/
+class FleetRun {
+    public:
+        static std::shared_ptr<FleetRun> start(const std::vector<std::string>& devices, const std::string& kind = "backup",
+                                               int leaseSeconds = CHRONICLE_RUN_DEFAULT_LEASE);
+        static std::shared_ptr<FleetRun> resume(const std::string& runId, int leaseSeconds = CHRONICLE_RUN_DEFAULT_LEASE,
+                                                bool retryFailed = false);
+
+        const std::string& id() const { return id_; }
+        std::vector<std::string> unfinished() const;    // Devices left when the run was started or resumed, in run order
+
+        bool claim(const std::string& device);          // False for a device that is done already, it is not worked on
+        void complete(const std::string& device, const std::string& hash);
+        void fail(const std::string& device, int code, const std::string& message);
+
+        bool flushDue() const;
+        void flush();
+        runProgress progress() const;
+
+    private:
+        struct deviceState {
+            std::string state = CHRONICLE_RUN_PENDING;
+            int attempts = 0;
+            std::string owner;                          // Holder of the lease while in flight
+            std::chrono::system_clock::time_point lease_until;
+            std::string hash;
+            int code = 0;
+            std::string message;
+        };
+
+        FleetRun(std::string id, std::string kind, int leaseSeconds);
+        deviceState& stateOf(const std::string& device);
+        void markDirty(const std::string& device);
+        runProgress tally() const;
+
+        std::string id_;
+        std::string kind_;
+        std::string owner_;                             // Unique per FleetRun object, so per process
+        std::chrono::seconds lease_;
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, deviceState> devices_;
+        std::vector<std::string> unfinished_;
+        std::unordered_set<std::string> leased_;        // In flight under a lease of this process
+        std::vector<std::string> dirty_;                // Changed since the last flush, each once
+        std::unordered_set<std::string> dirty_set_;
+        std::chrono::steady_clock::time_point last_flush_;
+};
+
+#endif // CHRONICLE_FLEET_RUN_HPP
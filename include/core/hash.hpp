@@ -0,0 +1,21 @@
+#ifndef CHRONICLE_HASH_HPP
+#define CHRONICLE_HASH_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+
+    # hash.hpp
+    Non-cryptographic hashing for content addressing and line comparison.
+
+    xxh64:        XXH64 of a buffer, bit compatible with the reference implementation.
+    contentHash:  128 bit content id of a buffer as 32 hex characters (two independently seeded XXH64).
+
+*/
+
+uint64_t xxh64(std::string_view data, uint64_t seed = 0);
+std::string contentHash(std::string_view data);
+
+#endif // CHRONICLE_HASH_HPP
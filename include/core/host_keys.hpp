@@ -0,0 +1,52 @@
+#ifndef CHRONICLE_HOST_KEYS_HPP
+#define CHRONICLE_HOST_KEYS_HPP
+
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct hostKeyEntry {
+    std::string host;
+    int port;
+    std::string fingerprint;    // "SHA256:<base64>"
+};
+
+/*
+    # host_keys.hpp
+    Process wide cache of trusted host keys, backed by the hostkeys collection.
+
+    The collection is read once, after that every lookup is a single hash map probe.
+    Newly trusted keys are queued and written to the database in one batch on flush(),
+    so concurrent workers never touch known_hosts or the database per connection. Batches
+    flush when they end and the Python module once more at exit, through tryFlush(), which
+    leaves the keys queued when the database cannot take them instead of failing the batch.
+    forget() drops a key from the queue as well, it is never written afterwards.
+    Batches call ensureLoaded() on their own thread before starting workers, the first
+    lookup of a worker then never reaches the shared database client.
+*/
+class HostKeyStore {
+    public:
+        static HostKeyStore& instance();
+
+        std::optional<std::string> lookup(const std::string& host, int port);
+        void remember(const std::string& host, int port, const std::string& fingerprint);
+        void forget(const std::string& host, int port);
+        void flush();
+        bool tryFlush();    // False when the keys stay queued
+        void reload();
+        void ensureLoaded();
+
+    private:
+        HostKeyStore() = default;
+        static std::string key(const std::string& host, int port);
+
+        std::shared_mutex mutex_;
+        std::unordered_map<std::string, std::string> fingerprints_;
+        std::vector<hostKeyEntry> pending_;
+        bool loaded_ = false;
+};
+
+#endif // CHRONICLE_HOST_KEYS_HPP
@@ -0,0 +1,129 @@
+#ifndef CHRONICLE_MEMORY_STORAGE_HPP
+#define CHRONICLE_MEMORY_STORAGE_HPP
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include "core/storage.hpp"
+
+/*
+
+    # memory_storage.hpp
+    Storage backend holding every document in this process.
+
+    Lookups are a hash map probe under a shared lock, no round trip and no copy on the
+    database side. Blobs are kept whole, there is nothing to gain from delta chains and
+    chunking in memory.
+
+    With a journal path every write is appended to that file before it is applied, and
+    opening it again replays the file, the last write of a key wins:
+
+        header:  magic "CHRJRNL1", version
+        records: operation byte, collection byte, key, payload
+
+    with the key and payload written as a varint length followed by the bytes, documents
+    as their BSON. A record cut short by a crash is dropped on replay and the file is
+    truncated back to the last complete one. A journal holding writes that were superseded
+    since is rewritten with just the live documents once it is replayed.
+
+    The file holds user credentials and is created readable by its owner only. A write that
+    fails part way is cut back off the file, a record after a torn one would be lost on
+    replay; when the file cannot be cut back the store refuses any further write.
+
+*/
+
+class MemoryStorage : public StorageBackend {
+  public:
+    explicit MemoryStorage(const std::string& journalPath = "");
+    ~MemoryStorage() override;
+    MemoryStorage(const MemoryStorage&) = delete;
+    MemoryStorage& operator=(const MemoryStorage&) = delete;
+
+    std::string kind() const override { return CHRONICLE_STORAGE_MEMORY; }
+    void connect() override {}
+    bool connected() const override { return true; }
+
+    void insertDevice(const bsoncxx::document::view& device) override;
+    void updateDevice(const std::string& nickname, const bsoncxx::document::view& fields) override;
+    void updateDevices(const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) override;
+    void deleteDevice(const std::string& nickname) override;
+    std::optional<bsoncxx::document::value> findDevice(const std::string& nickname) override;
+    std::vector<bsoncxx::document::value> findDevices() override;
+
+    void insertUser(const bsoncxx::document::view& user) override;
+    void updateUser(const std::string& username, const bsoncxx::document::view& fields) override;
+    void deleteUser(const std::string& username) override;
+    std::optional<bsoncxx::document::value> findUser(const std::string& username) override;
+    std::vector<bsoncxx::document::value> findUsers() override;
+
+    void insertSettings(const bsoncxx::document::view& settings) override;
+    void updateSettings(const bsoncxx::document::view& fields) override;
+    std::optional<bsoncxx::document::value> findSettings() override;
+
+    void insertHostKeys(const std::vector<bsoncxx::document::value>& entries) override;
+    void deleteHostKey(const std::string& host, int port) override;
+    std::vector<bsoncxx::document::value> findHostKeys() override;
+
+    void insertSnapshot(const bsoncxx::document::view& entry) override;
+    std::vector<bsoncxx::document::value> findSnapshots(
+      const std::string& nickname,
+      std::optional<std::chrono::system_clock::time_point> at = std::nullopt,
+      std::optional<int> limit = std::nullopt
+    ) override;
+
+    void storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash, const std::string& vendor) override;
+    std::string getBlob(const std::string& hash) override;
+
+    void insertRun(const bsoncxx::document::view& run) override;
+    void updateRun(const std::string& runId, const bsoncxx::document::view& fields) override;
+    std::optional<bsoncxx::document::value> findRun(const std::string& runId) override;
+    std::vector<bsoncxx::document::value> findRuns(std::optional<int> limit = std::nullopt) override;
+    void updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) override;
+    std::vector<bsoncxx::document::value> findRunDevices(const std::string& runId) override;
+    std::vector<bsoncxx::document::value> findRunSnapshots(const std::string& runId) override;
+
+  private:
+    enum class collection : uint8_t { devices, users, settings, hostKeys, snapshots, blobs, runs, runDevices };
+    enum class operation : uint8_t { put, erase };
+
+    // A table keeps its documents in insertion order, listings come out as Mongo returns them
+    struct table {
+      std::unordered_map<std::string, size_t> index;
+      std::vector<std::optional<bsoncxx::document::value>> documents;   // Empty where one was deleted
+    };
+
+    table& tableOf(collection name);
+    const table& tableOf(collection name) const;
+    void put(collection name, const std::string& key, const bsoncxx::document::view& document);
+    bool erase(collection name, const std::string& key);
+    void update(collection name, const std::string& key, const bsoncxx::document::view& fields);
+    bool contains(collection name, const std::string& key) const;
+    std::optional<bsoncxx::document::value> find(collection name, const std::string& key) const;
+    std::vector<bsoncxx::document::value> all(collection name) const;
+
+    void apply(operation op, collection name, const std::string& key, std::string_view payload);
+    void journal(operation op, collection name, const std::string& key, std::string_view payload);
+    void replay();
+    void compact();
+
+    mutable std::shared_mutex mutex_;
+    table devices_;
+    table users_;
+    table settings_;
+    table host_keys_;
+    table runs_;
+    table run_devices_;     // Keyed by run id and device
+    std::unordered_map<std::string, std::vector<bsoncxx::document::value>> snapshots_;   // Oldest first per device
+    std::unordered_map<std::string, std::string> blobs_;
+
+    std::string journal_path_;
+    int journal_fd_ = -1;
+    off_t journal_size_ = 0;        // Ends on the last complete record
+    bool journal_failed_ = false;   // A torn record could not be cut off, nothing more is written
+};
+
+#endif // CHRONICLE_MEMORY_STORAGE_HPP
@@ -10,11 +10,20 @@
  *  - devices  | All devices and their information
  *  - users    | All chroniucle users
  *  - settings | Chronicle settings
+ *  - hostkeys | Trusted SSH host key fingerprints
+ *  - configs   | Configuration blobs, content addressed by hash and split into chunks
+ *              | stored as keyframes or line deltas against the previous version of the device
+ *  - snapshots | Per device snapshot entries referencing a blob hash
+ *  - dictionaries | Versioned per vendor zstd dictionaries blobs are compressed with
+ *  - outputcache | Cached command output, removed by a TTL index once expiresAt passes
+ *  - runs      | Checkpointed fleet runs
+ *  - rundevices | State of every device of a run, one document per run and device
 */
 
 #include <string>
 #include <vector>
 #include <optional>
+#include <utility>
  
 #include <mongocxx/collection.hpp>
 #include <mongocxx/client.hpp>
@@ -23,6 +32,12 @@
 #include <bsoncxx/document/view_or_value.hpp>
 #include <bsoncxx/types.hpp>
  
+// A document an unordered bulk insert refused, the others of the batch went in
+struct bulkWriteError {
+  size_t index;       // Position in the batch
+  int code;
+  std::string message;
+};
 
 class MongoDB {
   private:
@@ -35,20 +50,33 @@ class MongoDB {
     mongocxx::database db_;
   public:
     MongoDB();
+    static std::string connectionUri();
     void insertDocument(mongocxx::collection& collection, const bsoncxx::document::view_or_value& doc);
+    void insertDocuments(mongocxx::collection& collection, const std::vector<bsoncxx::document::value>& docs);
+    std::vector<bulkWriteError> insertDocumentsReport(mongocxx::collection& collection, const std::vector<bsoncxx::document::value>& docs);
     void updateDocument(mongocxx::collection& collection, bsoncxx::builder::basic::document& queryFilter, const bsoncxx::document::view_or_value& data);
+    void updateDocuments(mongocxx::collection& collection, const std::vector<std::pair<bsoncxx::document::value, bsoncxx::document::value>>& updates, bool upsert = false, bool ordered = false);
     void deleteDocument(mongocxx::collection& collection, bsoncxx::builder::basic::document& queryFilter);
-    void connect();
+    int64_t deleteDocuments(mongocxx::collection& collection, const bsoncxx::document::view_or_value& filter);
+    void connect(bool initialize = true);
+    mongocxx::collection collection(const std::string& name);
     std::vector<bsoncxx::document::value> findDocuments(
       mongocxx::collection& collection,
       const bsoncxx::document::view_or_value& filter,
       const bsoncxx::document::view_or_value& projection,
-      std::optional<int> limit = std::nullopt
+      std::optional<int> limit = std::nullopt,
+      std::optional<bsoncxx::document::view_or_value> sort = std::nullopt
     );
 
     mongocxx::collection devices_c;
     mongocxx::collection users_c;
     mongocxx::collection settings_c;
+    mongocxx::collection hostkeys_c;
+    mongocxx::collection configs_c;
+    mongocxx::collection snapshots_c;
+    mongocxx::collection dictionaries_c;
+    mongocxx::collection runs_c;
+    mongocxx::collection rundevices_c;
     bool connected = false;
 };
 #endif // CHRONICLE_MONGODB_HPP
@@ -0,0 +1,40 @@
+#ifndef CHRONICLE_NORMALIZE_HPP
+#define CHRONICLE_NORMALIZE_HPP
+
+#include "core/device_factory.hpp"
+
+#include <regex>
+#include <string>
+#include <vector>
+
+/*
+
+    # normalize.hpp
+    Removes or canonicalizes volatile lines ("Building configuration...", "ntp clock-period",
+    commit timestamps) so unchanged configurations hash the same and diffs stay quiet.
+
+    Rules come from the device plugin and are compiled once, apply() is a single in place pass.
+
+*/
+
+class Normalizer {
+  public:
+    explicit Normalizer(const std::vector<NormalizeRule>& rules);
+
+    void apply(std::vector<std::string>& lines) const;
+    bool empty() const { return rules_.empty(); }
+
+  private:
+    struct compiledRule {
+      int kind;
+      std::string pattern;
+      std::regex regex;
+      std::string replacement;
+    };
+
+    std::vector<compiledRule> rules_;
+};
+
+std::vector<std::string> normalizeLines(std::vector<std::string> lines, const std::vector<NormalizeRule>& rules);
+
+#endif // CHRONICLE_NORMALIZE_HPP
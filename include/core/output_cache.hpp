@@ -0,0 +1,101 @@
+#ifndef CHRONICLE_OUTPUT_CACHE_HPP
+#define CHRONICLE_OUTPUT_CACHE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/device_factory.hpp"
+#include "core/result.hpp"
+
+class MongoDB;
+
+inline constexpr size_t CHRONICLE_CACHE_MAX_ENTRIES = 10000;
+inline constexpr auto CHRONICLE_CACHE_COLLECTION = "outputcache";
+
+/* ---------- Data Structures ---------- */
+
+struct cacheStats {
+    uint64_t hits = 0;              // Served from memory
+    uint64_t database_hits = 0;     // Served from Mongo
+    uint64_t misses = 0;            // Went to the device
+    uint64_t coalesced = 0;         // Waited on an identical request already in flight
+    uint64_t entries = 0;
+};
+
+/*
+
+    # output_cache.hpp
+    Opt-in TTL cache of read only command output, shared by every worker in the process.
+
+    An entry is keyed by device, channel mode, pager prompts and the command sequence
+    (commands with their skip values). Only fanOut reads through it, with the cache_ttl the
+    caller set on its own OperationMaps; plugins declare no TTLs, their commands download
+    configurations, which always go to the device since their output is stored as a snapshot.
+    An entry's lifetime is the cache_ttl of the last command in the sequence, a sequence
+    ending in a command with no TTL always goes to the device.
+
+    Entries live in memory and, unless disabled, in the outputcache collection where a TTL
+    index removes them once expired, so other processes and later runs share them. Mongo is
+    reached over a connection of the cache's own, a mongocxx client is not thread safe.
+
+    Concurrent requests for the same key make a single device call, the others wait for
+    its result. Failures are handed to the waiters but never cached.
+
+    invalidate() drops the entries of a device, or only those whose sequence contains the
+    given command. A fetch running while its device is invalidated does not store its result.
+    When Mongo cannot be reached the entries are only dropped from memory, the stored ones
+    are left to expire.
+
+*/
+
+class OutputCache {
+  public:
+    using fetcher = std::function<Result<std::vector<std::string>>()>;
+
+    static OutputCache& instance();
+
+    void enable(bool useDatabase = true);
+    void disable();     // Drops the entries held in memory
+    bool enabled() const;
+
+    Result<std::vector<std::string>> fetch(const std::string& device, const std::vector<OperationMap>& operations,
+                                           int channelMode, const std::vector<std::string>& pagerPrompts,
+                                           const fetcher& fetch);
+
+    size_t invalidate(const std::string& device, const std::string& command = "");
+    void clear();
+    cacheStats stats() const;
+
+  private:
+    struct entry {
+      std::string device;
+      std::vector<std::string> commands;
+      int64_t expires_at;       // Unix milliseconds
+      std::vector<std::string> output;
+    };
+
+    OutputCache() = default;
+
+    void evict(int64_t now);
+    bool loadStored(const std::string& key, entry& found);
+    void store(const std::string& key, const entry& stored);
+
+    mutable std::mutex mutex_;
+    bool enabled_ = false;
+    bool useDatabase_ = false;
+    uint64_t generation_ = 0;       // Bumped by every invalidation
+    std::unordered_map<std::string, entry> entries_;
+    std::unordered_map<std::string, std::shared_future<Result<std::vector<std::string>>>> inflight_;
+    cacheStats stats_;
+
+    std::mutex dbMutex_;
+    std::unique_ptr<MongoDB> db_;
+};
+
+#endif // CHRONICLE_OUTPUT_CACHE_HPP
@@ -0,0 +1,38 @@
+#ifndef CHRONICLE_REACHABILITY_HPP
+#define CHRONICLE_REACHABILITY_HPP
+
+#include <string>
+#include <vector>
+#include "core/config.hpp"
+
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT = 3000;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT = 512;
+inline constexpr int CHRONICLE_CONFIG_DEFAULT_SWEEP_MAX_AGE = 3600;     // Seconds an unreachable result keeps a device from being tried
+
+struct reachabilityResult {
+    std::string nickname;
+    std::string host;
+    int port = CHRONICLE_CONFIG_DEFAULT_PORT;
+    bool reachable = false;
+    std::string banner;
+    int latency_ms = -1;
+    std::string error;
+};
+
+/*
+
+    # reachability.hpp
+    Non-blocking TCP helpers.
+
+    openTcpConnection: Connects with a hard deadline, returns a blocking fd or -1 with error filled in.
+    probeReachability: Connects to every target from a single poll() loop and reads the SSH banner,
+                       at most max_in_flight sockets are open at once.
+
+*/
+
+int openTcpConnection(const std::string& host, int port, int timeout_ms, std::string& error);
+std::vector<reachabilityResult> probeReachability(const std::vector<connectionInfo>& targets,
+                                                  int timeout_ms = CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT,
+                                                  int max_in_flight = CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT);
+
+#endif // CHRONICLE_REACHABILITY_HPP
@@ -0,0 +1,121 @@
+#ifndef CHRONICLE_RESULT_HPP
+#define CHRONICLE_RESULT_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "core/error_handler.hpp"
+
+#define CHRONICLE_ERROR(code, details) \
+    ChronicleError(code, __func__, __LINE__, __FILE__, details)
+
+// The details are built by describe, only if they are ever read
+#define CHRONICLE_ERROR_LAZY(code, describe) \
+    ChronicleError(code, __func__, __LINE__, __FILE__, std::function<std::string()>(describe))
+
+/*
+
+    # result.hpp
+    Non-throwing error path of the core.
+
+    A ChronicleError carries what THROW_CHRONICLE_EXCEPTION would, but formats nothing up
+    front: the code and the static origin (function, file, line) are stored as they are and
+    the details are either a plain string or a callable run only when someone reads them.
+    A failed device in a fleet run costs a few words instead of a formatted message and
+    a stack unwind.
+
+    Result<T> holds a value or a ChronicleError. Core paths that fail routinely (connecting,
+    authenticating, opening a channel) return one, the throwing API is a thin wrapper that
+    calls valueOrThrow() and the bindings raise only there, at the Python boundary.
+
+    ChronicleError::fromException keeps a ChronicleException thrown deeper down, raise()
+    rethrows it unchanged so no code or detail is lost on the way through.
+
+*/
+
+class ChronicleError {
+  public:
+    ChronicleError() = default;
+    ChronicleError(int code, const char* function, int line, const char* file, std::string details = {})
+      : code_(code), function_(function), file_(file), line_(line), details_(std::move(details)) {}
+    ChronicleError(int code, const char* function, int line, const char* file, std::function<std::string()> describe)
+      : code_(code), function_(function), file_(file), line_(line), describe_(std::move(describe)) {}
+
+    static ChronicleError fromException(const ChronicleException& e);
+
+    int code() const { return code_; }
+    std::string details() const;
+    std::string message() const { return getErrorMsg(code_); }
+    std::string what() const;     // Same text ChronicleException::what() would give
+    [[noreturn]] void raise() const;
+
+  private:
+    int code_ = CHRONICLE_ERROR_UNKNOWN_CORE_ERROR;
+    const char* function_ = "";
+    const char* file_ = "";
+    int line_ = -1;
+    std::string details_;
+    std::function<std::string()> describe_;
+    std::shared_ptr<const ChronicleException> origin_;
+};
+
+template <typename T>
+class Result {
+  public:
+    Result(T value) : state_(std::in_place_index<0>, std::move(value)) {}
+    Result(ChronicleError error) : state_(std::in_place_index<1>, std::move(error)) {}
+
+    bool ok() const { return state_.index() == 0; }
+    explicit operator bool() const { return ok(); }
+
+    T& value() { return std::get<0>(state_); }
+    const T& value() const { return std::get<0>(state_); }
+    const ChronicleError& error() const { return std::get<1>(state_); }
+
+    T valueOrThrow() && {
+        if (!ok()) error().raise();
+        return std::move(std::get<0>(state_));
+    }
+
+  private:
+    std::variant<T, ChronicleError> state_;
+};
+
+template <>
+class Result<void> {
+  public:
+    Result() = default;
+    Result(ChronicleError error) : error_(std::make_unique<ChronicleError>(std::move(error))) {}
+
+    bool ok() const { return error_ == nullptr; }
+    explicit operator bool() const { return ok(); }
+    const ChronicleError& error() const { return *error_; }
+
+    void valueOrThrow() && {
+        if (!ok()) error_->raise();
+    }
+
+  private:
+    std::unique_ptr<ChronicleError> error_;
+};
+
+// Runs throwing code and hands its ChronicleException back as a Result
+template <typename Func>
+auto catchResult(Func&& func) -> Result<decltype(func())> {
+    try {
+        if constexpr (std::is_void_v<decltype(func())>) {
+            func();
+            return {};
+        } else {
+            return func();
+        }
+    } catch (const ChronicleException& e) {
+        return ChronicleError::fromException(e);
+    }
+}
+
+#endif // CHRONICLE_RESULT_HPP
@@ -0,0 +1,56 @@
+#ifndef CHRONICLE_SNAPSHOT_HPP
+#define CHRONICLE_SNAPSHOT_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr size_t CHRONICLE_SNAPSHOT_CHUNK_SIZE = 4 * 1024 * 1024;   // Well below the 16MB BSON limit
+inline constexpr int CHRONICLE_SNAPSHOT_KEYFRAME_INTERVAL = 16;            // A delta chain never exceeds KEYFRAME_INTERVAL - 1 deltas
+inline constexpr int CHRONICLE_SNAPSHOT_DEFAULT_UNCHANGED_DAYS = 30;
+
+/* ---------- Data Structures ---------- */
+
+struct retentionPolicy {
+    int max_age_days = 0;                                                  // Snapshots older than this are removed, 0 keeps everything
+    int keep_unchanged_days = CHRONICLE_SNAPSHOT_DEFAULT_UNCHANGED_DAYS;   // Entries that only confirmed an unchanged config, 0 keeps them
+};
+
+struct compactionResult {
+    int snapshots_removed = 0;
+    int blobs_rewritten = 0;
+    int blobs_removed = 0;
+};
+
+struct snapshotBenchmark {
+    size_t lines = 0;                      // Of the first version
+    int versions = 0;                      // Stored for the device
+    size_t bytes = 0;                      // Joined blobs of every version
+    double store_ms = 0;                   // Mean storeSnapshot
+    double latest_ms = 0;                  // Mean getLatestSnapshot
+    double at_ms = 0;                      // Mean getSnapshotAt, halfway through the history
+    double store_mb_s = 0;
+};
+
+/*
+
+    # snapshot.hpp
+    Canonical blob form of a configuration, this is what gets hashed and stored.
+
+    joinSnapshotLines:  Lines without trailing whitespace, joined with '\n'.
+    splitSnapshotLines: Inverse of joinSnapshotLines.
+
+    History is stored as keyframes (full blobs) followed by line deltas against the previous
+    version of the device, so any version is at most KEYFRAME_INTERVAL - 1 deltas away from a full blob.
+
+    encodeSnapshotDelta: Copy/insert instructions that turn base into target.
+    applySnapshotDelta:  Rebuilds the target blob from the base blob and a delta.
+
+*/
+
+std::string joinSnapshotLines(const std::vector<std::string>& lines);
+std::vector<std::string> splitSnapshotLines(std::string_view blob);
+std::string encodeSnapshotDelta(const std::vector<std::string>& base_lines, const std::vector<std::string>& target_lines);
+std::string applySnapshotDelta(std::string_view base_blob, std::string_view delta);
+
+#endif // CHRONICLE_SNAPSHOT_HPP
@@ -1,6 +1,9 @@
 #ifndef CHRONICLE_SSH_H
 #define CHRONICLE_SSH_H
 #include "core/config.hpp"
+#include "core/result.hpp"
+#include "core/transcript.hpp"
+#include <memory>
 #include <vector>
 #include <string>
 #include <regex>
@@ -14,20 +17,73 @@
     # ssh.hpp
     This file is a spesfic wrapper for ssh inteded to serve only chronicles needs, it is not a full on wrapper.
 
+    benchmarkSshRead replays a synthetic paged session of the given size (synthetic.hpp) through
+    executeCommand, the read loop, buffer growth, terminal filter and parsing with no network,
+    once per starting read buffer size, with and without the output reserved up front.
+
 */
 
+inline constexpr size_t CHRONICLE_SSH_BENCHMARK_BYTES = 50 * 1024 * 1024;
+
+struct sshReadBenchmark {
+    int read_buffer_size = 0;              // Starting size, grown as reads fill it
+    bool reserved = false;                 // Output reserved from a known last size
+    size_t bytes = 0;                      // Read from the channel
+    size_t lines = 0;                      // Parsed out of it
+    double ms = 0;                         // Best of the rounds
+    double mb_s = 0;
+};
+
 class Ssh {
     public:
+        Ssh();
+        explicit Ssh(const chronicleSettings& settings);
+
+        void tune(const connectionInfo& ci);
+        void replay(std::shared_ptr<TranscriptReplay> transcript) { replay_ = std::move(transcript); }
+        void pagerPrompts(const std::vector<std::string>& patterns);
+
         ssh_session startSession(connectionInfo ci) const;
+        Result<ssh_session> tryStartSession(const connectionInfo& ci) const;
         void endSession(ssh_session session) const;
         std::vector<std::string> executeCommand(OperationMap opartion_map, ssh_session session, ssh_channel channel) const;
         ssh_channel startChannel(ssh_session session) const;
+        Result<ssh_channel> tryStartChannel(ssh_session session) const;
+        ssh_channel startExecChannel(ssh_session session, const std::string& command) const;
+        std::vector<std::vector<std::string>> execCommands(const std::vector<OperationMap>& operation_maps, ssh_session session) const;
         void closeChannel(ssh_channel channel) const;
         void flushBanner(ssh_session session, ssh_channel channel) const;
     private:
-        static std::string verifyKnownHost(ssh_session session);
+        chronicleSettings settings_;
+        int read_buffer_size_ = CHRONICLE_CONFIG_DEFAULT_READ_BUFFER;
+        size_t expected_output_size_ = 0;
+        std::string nickname_, vendor_name_, device_name_;
+
+        // Channel traffic goes through these so it can be recorded or replayed, exec channels
+        // pass the number execChannel() gave them
+        mutable std::unique_ptr<TranscriptWriter> recorder_;
+        mutable uint32_t exec_channels_ = 0;
+        std::shared_ptr<TranscriptReplay> replay_;
+        void startRecording() const;
+        size_t execChannel(const std::string& command) const;
+        int readChannel(ssh_channel channel, char* buffer, uint32_t size, int is_stderr, int exec_channel = -1) const;
+        int writeChannel(ssh_channel channel, const std::string& data) const;
+
+        static void growReadBuffer(std::vector<char>& buffer, int last_read);
+
+        // Pager handling, a "more" line ending the output is answered with a space and cut out
+        std::vector<std::regex> pager_prompts_;
+        size_t pagerPromptAt(const std::string& output) const;
+
+        static void setSessionTimeout(ssh_session session, int timeout_ms);
+        static std::string verifyKnownHost(ssh_session session, const connectionInfo& ci);
+        static std::vector<std::string> parseOutput(const std::string& output, const OperationMap& operation_map);
+        static bool mayBeError(const std::string& line);
         /* Should be taken from here: https://www.cisco.com/c/en/us/support/switches/catalyst-9300-series-switches/products-system-message-guides-list.html */
         static bool hasError(const std::string& line) {
+            // Nearly every line of a config is none of these, skip the regexes for them
+            if (!mayBeError(line)) return false;
+
             static const std::vector<std::regex> common_error_patterns = {
                 std::regex(R"(^%\w+-3-\w+:.*)", std::regex::icase),
                 std::regex(R"(Invalid input detected)", std::regex::icase),
@@ -47,4 +103,32 @@ class Ssh {
         }        
 };
 
+std::vector<sshReadBenchmark> benchmarkSshRead(size_t bytes = CHRONICLE_SSH_BENCHMARK_BYTES,
+                                               const std::vector<int>& readBufferSizes = {CHRONICLE_CONFIG_DEFAULT_READ_BUFFER, CHRONICLE_CONFIG_MAX_READ_BUFFER},
+                                               int rounds = 3);
+
+// Ends a session started through an Ssh on every way out of the scope, a non Chronicle exception included
+class SshSessionGuard {
+    public:
+        SshSessionGuard(const Ssh& ssh, ssh_session session) : ssh_(ssh), session_(session) {}
+        ~SshSessionGuard() { ssh_.endSession(session_); }
+        SshSessionGuard(const SshSessionGuard&) = delete;
+        SshSessionGuard& operator=(const SshSessionGuard&) = delete;
+    private:
+        const Ssh& ssh_;
+        ssh_session session_;
+};
+
+// Same for a channel, declared after the session guard so the channel is closed first
+class SshChannelGuard {
+    public:
+        SshChannelGuard(const Ssh& ssh, ssh_channel channel) : ssh_(ssh), channel_(channel) {}
+        ~SshChannelGuard() { ssh_.closeChannel(channel_); }
+        SshChannelGuard(const SshChannelGuard&) = delete;
+        SshChannelGuard& operator=(const SshChannelGuard&) = delete;
+    private:
+        const Ssh& ssh_;
+        ssh_channel channel_;
+};
+
 #endif // CHRONICLE_SSH_H
@@ -0,0 +1,108 @@
+#ifndef CHRONICLE_STORAGE_HPP
+#define CHRONICLE_STORAGE_HPP
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+
+inline constexpr auto CHRONICLE_STORAGE_MONGO = "mongo";
+inline constexpr auto CHRONICLE_STORAGE_MEMORY = "memory";
+
+/*
+
+    # storage.hpp
+    Where ChronicleDB keeps devices, users, settings, host keys, snapshots and fleet runs.
+
+    StorageBackend is the narrow set of reads and writes ChronicleDB needs, in the shape of
+    the documents it already builds, so a backend stores them as they are:
+
+        mongo    the chronicle_db collections, the default
+        memory   maps in this process, with an optional append only journal file replayed
+                 when it is opened, for runs that do not need a database server
+
+    Updates carry the fields to set with dotted paths ("ssh.host"), as a Mongo $set does,
+    and report a missing document with CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND, inserts a
+    taken key with CHRONICLE_ERROR_MONGO_DUPLICATE, whichever the backend. ChronicleDB turns
+    those into its own errors the same way for both.
+
+    The backend is chosen once at startup, before the first ChronicleDB call. Switching
+    later leaves running calls on the backend they started with. Retention compaction,
+    compression dictionaries, the fleet index sync and archives work on the Mongo
+    collections directly and throw CHRONICLE_ERROR_STORAGE_UNSUPPORTED on another backend.
+
+*/
+
+class StorageBackend {
+  public:
+    virtual ~StorageBackend() = default;
+
+    virtual std::string kind() const = 0;
+    virtual void connect() = 0;
+    virtual bool connected() const = 0;
+
+    // Devices, keyed by device.name
+    virtual void insertDevice(const bsoncxx::document::view& device) = 0;
+    virtual void updateDevice(const std::string& nickname, const bsoncxx::document::view& fields) = 0;
+    virtual void updateDevices(const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) = 0;   // Unknown devices are skipped
+    virtual void deleteDevice(const std::string& nickname) = 0;
+    virtual std::optional<bsoncxx::document::value> findDevice(const std::string& nickname) = 0;
+    virtual std::vector<bsoncxx::document::value> findDevices() = 0;
+
+    // Users, keyed by username
+    virtual void insertUser(const bsoncxx::document::view& user) = 0;
+    virtual void updateUser(const std::string& username, const bsoncxx::document::view& fields) = 0;
+    virtual void deleteUser(const std::string& username) = 0;
+    virtual std::optional<bsoncxx::document::value> findUser(const std::string& username) = 0;
+    virtual std::vector<bsoncxx::document::value> findUsers() = 0;
+
+    // Settings, a single document
+    virtual void insertSettings(const bsoncxx::document::view& settings) = 0;
+    virtual void updateSettings(const bsoncxx::document::view& fields) = 0;
+    virtual std::optional<bsoncxx::document::value> findSettings() = 0;
+
+    // Host keys, keyed by host and port. A taken key still lets the rest of the batch in
+    virtual void insertHostKeys(const std::vector<bsoncxx::document::value>& entries) = 0;
+    virtual void deleteHostKey(const std::string& host, int port) = 0;
+    virtual std::vector<bsoncxx::document::value> findHostKeys() = 0;
+
+    // Snapshot entries, newest first, at bounds takenAt from above
+    virtual void insertSnapshot(const bsoncxx::document::view& entry) = 0;
+    virtual std::vector<bsoncxx::document::value> findSnapshots(
+      const std::string& nickname,
+      std::optional<std::chrono::system_clock::time_point> at = std::nullopt,
+      std::optional<int> limit = std::nullopt
+    ) = 0;
+
+    // Configuration blobs, content addressed by hash
+    virtual void storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash, const std::string& vendor) = 0;
+    virtual std::string getBlob(const std::string& hash) = 0;
+
+    // Checkpointed fleet runs keyed by id, with one state document per device of a run
+    virtual void insertRun(const bsoncxx::document::view& run) = 0;
+    virtual void updateRun(const std::string& runId, const bsoncxx::document::view& fields) = 0;
+    virtual std::optional<bsoncxx::document::value> findRun(const std::string& runId) = 0;
+    virtual std::vector<bsoncxx::document::value> findRuns(std::optional<int> limit = std::nullopt) = 0;   // Newest first
+    virtual void updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) = 0;   // Upserts, one write
+    virtual std::vector<bsoncxx::document::value> findRunDevices(const std::string& runId) = 0;
+    virtual std::vector<bsoncxx::document::value> findRunSnapshots(const std::string& runId) = 0;   // Entries stored with the run's id
+};
+
+// The selected backend, Mongo unless another one was chosen
+std::shared_ptr<StorageBackend> storage();
+std::string storageKind();
+
+void useMongoStorage();
+void useMemoryStorage(const std::string& journalPath = "");   // Empty keeps nothing once the process exits
+std::shared_ptr<StorageBackend> swapStorage(std::shared_ptr<StorageBackend> next);   // Returns the backend it replaced
+
+// Defined next to the Mongo connection in database_handler.cpp
+std::shared_ptr<StorageBackend> makeMongoStorage();
+
+#endif // CHRONICLE_STORAGE_HPP
@@ -0,0 +1,35 @@
+#ifndef CHRONICLE_SYNTHETIC_HPP
+#define CHRONICLE_SYNTHETIC_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+
+    # synthetic.hpp
+    Generated configurations for the in-library benchmarks.
+
+    syntheticConfig builds an IOS style configuration of the given number of lines: a header,
+    interface blocks with descriptions, VLANs and ACL references, then access lists. The text
+    depends only on the seed, so two runs of a benchmark measure the same input.
+
+    syntheticEdit returns a later version of a configuration with about editRate of its lines
+    changed, removed or followed by a new one, in equal parts, scattered over the whole text.
+
+    syntheticTerminalOutput renders a configuration the way a paged pty session sends it:
+    CRLF line ends, colored keywords, a --More-- prompt every screen that is erased again
+    with backspaces and a line clear, and now and then a line redrawn over a bare \r.
+
+
+*/
+
+std::vector<std::string> syntheticConfig(size_t lines, uint32_t seed = 1);
+std::vector<std::string> syntheticEdit(const std::vector<std::string>& config, double editRate, uint32_t seed = 1);
+std::string syntheticTerminalOutput(size_t bytes, uint32_t seed = 1);
+
+double megabytesPerSecond(size_t bytes, std::chrono::steady_clock::duration elapsed);
+double millisecondsOf(std::chrono::steady_clock::duration elapsed);
+
+#endif // CHRONICLE_SYNTHETIC_HPP
@@ -0,0 +1,80 @@
+#ifndef CHRONICLE_TERMINAL_HPP
+#define CHRONICLE_TERMINAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+
+    # terminal.hpp
+    Turns what a pty sends into the text a terminal would end up showing.
+
+    Shell channels run on a pty, so device output carries ANSI escapes (colors, cursor
+    moves, line clears), backspaces and bare carriage returns that redraw a line. Left in,
+    they end up in stored configs, change hashes and show up as diffs.
+
+    TerminalFilter is a byte level state machine fed chunk by chunk as they are read, a
+    sequence split across reads is picked up where it stopped. It appends the visible text
+    to an output string in one pass over the chunk and allocates nothing of its own:
+
+        CSI (ESC [ ... final)       removed, K (erase in line), C and D (cursor right, left) applied
+        OSC, DCS, SOS, PM, APC      removed up to BEL or ESC \
+        other ESC sequences         removed
+        \b                          moves the cursor left, the next character overwrites
+        \r                          back to the line start, unless a \n follows (CRLF)
+        other controls and DEL      removed, \n and \t are kept
+
+    A line that was redrawn loses its trailing blanks when it ends, they are what is left
+    of the longer text it overwrote.
+
+    benchmarkTerminalFilter feeds synthetic paged pty output (synthetic.hpp) through a filter
+    in chunks of each size, as the read loop does, and reports the input bytes per second.
+
+*/
+
+inline constexpr size_t CHRONICLE_TERMINAL_BENCHMARK_BYTES = 32 * 1024 * 1024;
+
+struct terminalBenchmark {
+    size_t chunk_size = 0;                 // Bytes per feed call
+    size_t input_bytes = 0;
+    size_t output_bytes = 0;               // Visible text left
+    double bytes_per_s = 0;                // Input, best of the rounds
+};
+
+class TerminalFilter {
+  public:
+    explicit TerminalFilter(std::string& output);
+
+    void feed(const char* data, size_t size);
+    void feed(std::string_view data) { feed(data.data(), data.size()); }
+
+    // Cuts the output back to size, the cursor goes to the new end
+    void truncate(size_t size);
+
+  private:
+    enum class state : uint8_t { text, escape, escapeIntermediate, csi, string, stringEscape };
+
+    void put(char c);
+    void control(char c);
+    void csi(char final);
+    void carriageReturn();
+    void endLine();
+
+    std::string& out_;
+    state state_ = state::text;
+    size_t line_start_ = 0;     // Offset in out_ of the current line
+    size_t cursor_ = 0;         // Offset in out_ the next character is written at
+    bool pending_cr_ = false;   // \r seen, applied once something other than \n follows
+    bool rewound_ = false;      // The current line was written over
+    uint32_t param_ = 0;        // First numeric CSI parameter
+    bool param_done_ = false;   // Past the first parameter
+};
+
+std::string stripTerminalControl(std::string_view data);
+std::vector<terminalBenchmark> benchmarkTerminalFilter(size_t bytes = CHRONICLE_TERMINAL_BENCHMARK_BYTES,
+                                                       const std::vector<size_t>& chunkSizes = {512, 16384, 262144}, int rounds = 3);
+
+#endif // CHRONICLE_TERMINAL_HPP
@@ -0,0 +1,66 @@
+#ifndef CHRONICLE_TRACE_HPP
+#define CHRONICLE_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+inline constexpr size_t CHRONICLE_TRACE_DEFAULT_CAPACITY = 65536;   // Spans kept per thread
+inline constexpr size_t CHRONICLE_TRACE_DEVICE_LENGTH = 40;
+inline constexpr size_t CHRONICLE_TRACE_VENDOR_LENGTH = 24;
+
+/*
+
+    # trace.hpp
+    Span based tracing of fleet runs.
+
+    A TraceSpan covers one step of a run (connection lookup, plugin load, session setup,
+    a command, a storage write) from construction to destruction. Spans nest per thread,
+    a span without a device or vendor of its own inherits them from the enclosing span so
+    only the outermost span of a device has to name it.
+
+    Finished spans go into a fixed size ring of the thread that ran them, only that thread
+    writes the ring and readers copy slots under a per slot sequence number, so recording
+    takes no lock. When a ring is full the oldest spans are overwritten. Rings outlive their
+    threads, spans of finished workers are still exported.
+
+    While tracing is disabled a TraceSpan costs one relaxed atomic load.
+
+    exportChromeTrace writes the Chrome trace event format (chrome://tracing, Perfetto),
+    exportOtlpJson writes OTLP/JSON resource spans. Both return the number of spans written.
+
+*/
+
+void enableTracing(size_t capacity = CHRONICLE_TRACE_DEFAULT_CAPACITY);    // Drops spans recorded so far
+void disableTracing();
+bool tracingEnabled();
+
+size_t exportChromeTrace(const std::string& path);
+size_t exportOtlpJson(const std::string& path);
+
+class TraceSpan {
+  public:
+    explicit TraceSpan(const char* name, std::string_view device = {}, std::string_view vendor = {});
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setDevice(std::string_view device, std::string_view vendor = {});
+    void setError() { error_ = true; }
+
+  private:
+    const char* name_;      // Must be a string literal, only the pointer is stored
+    bool active_ = false;
+    bool error_ = false;
+    int exceptions_ = 0;
+    uint64_t generation_ = 0;
+    uint64_t start_ = 0;
+    uint64_t spanId_ = 0;
+    uint64_t parentId_ = 0;
+    TraceSpan* parent_ = nullptr;
+    char device_[CHRONICLE_TRACE_DEVICE_LENGTH];     // Filled only while tracing is enabled
+    char vendor_[CHRONICLE_TRACE_VENDOR_LENGTH];
+};
+
+#endif // CHRONICLE_TRACE_HPP
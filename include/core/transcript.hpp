@@ -0,0 +1,130 @@
+#ifndef CHRONICLE_TRANSCRIPT_HPP
+#define CHRONICLE_TRANSCRIPT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+inline constexpr auto CHRONICLE_TRANSCRIPT_EXTENSION = ".chrt";
+
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_STDOUT = 0;     // Bytes read from the channel
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_STDERR = 1;
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_SENT   = 2;     // Bytes written to the channel
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_EXEC        = 3;     // Exec channel opened, the bytes are its command
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_EXEC_STDOUT = 4;
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_EXEC_STDERR = 5;
+inline constexpr uint8_t CHRONICLE_TRANSCRIPT_EXEC_EXIT   = 6;     // Exit status in decimal, the channel's last event
+
+/* ---------- Data Structures ---------- */
+
+struct transcriptEvent {
+    uint8_t kind = CHRONICLE_TRANSCRIPT_STDOUT;
+    uint64_t at_us = 0;         // Microseconds since the session started
+    uint32_t channel = 0;       // Exec events only, channels are numbered in the order they opened
+    std::string data;
+};
+
+/*
+
+    # transcript.hpp
+    Recording of raw SSH channel traffic and offline replay of it.
+
+    While a transcript directory is set every session writes the bytes it reads and
+    sends, with timestamps, to <directory>/<nickname>-<unix ms>.chrt:
+
+        header:  magic "CHRTRAN1", version, start time (unix ms), nickname, vendor, device
+        events:  kind byte, microseconds since the previous event, [exec channel], length, bytes
+
+    with integers after the header written as varints, so a chunk costs a few bytes over
+    its payload. Files are readable by their owner only, the bytes sent include passwords.
+    A write that fails, a full disk say, ends the recording and not the session.
+
+    TranscriptReplay stands in for the channel of an Ssh object: reads return the recorded
+    chunks and a write must match the next recorded one. Output is handed out at the
+    recorded pace or as fast as it is read, and a read loop ends once the output recorded
+    for the current command is used up instead of waiting for the idle timeout, so a replay
+    runs executeCommand, flushBanner and the parsers deterministically. A Transcript can
+    also be put together in memory from events, for a synthetic session.
+
+    Exec sessions open a channel per command and drain them together, their events carry
+    the channel number: the command when it opened, its stdout and stderr, its exit status.
+    A replay of one hands each exec channel its own recorded output, as fast as it is read.
+
+*/
+
+void setTranscriptDirectory(const std::string& directory);   // Empty stops recording
+std::string transcriptDirectory();
+
+class TranscriptWriter {
+  public:
+    TranscriptWriter(const std::string& path, const std::string& nickname,
+                     const std::string& vendor, const std::string& device);
+    ~TranscriptWriter();
+    TranscriptWriter(const TranscriptWriter&) = delete;
+    TranscriptWriter& operator=(const TranscriptWriter&) = delete;
+
+    void record(uint8_t kind, const char* data, size_t size, uint32_t channel = 0);     // Stops recording on the first failed write
+    const std::string& path() const { return path_; }
+
+  private:
+    std::string path_;
+    FILE* file_ = nullptr;
+    std::chrono::steady_clock::time_point last_;
+};
+
+class Transcript {
+  public:
+    explicit Transcript(const std::string& path);
+    Transcript(const std::string& nickname, std::vector<transcriptEvent> events);   // Built in memory, started now
+
+    const std::string& nickname() const { return nickname_; }
+    const std::string& vendor() const { return vendor_; }
+    const std::string& device() const { return device_; }
+    int64_t startedAt() const { return started_at_; }
+    const std::vector<transcriptEvent>& events() const { return events_; }
+    bool exec() const;          // Recorded from an exec session
+
+  private:
+    std::string nickname_;
+    std::string vendor_;
+    std::string device_;
+    int64_t started_at_ = 0;
+    std::vector<transcriptEvent> events_;
+};
+
+class TranscriptReplay {
+  public:
+    explicit TranscriptReplay(Transcript transcript, bool realtime = false);
+
+    int read(char* buffer, size_t size, int is_stderr);
+    void write(const std::string& data);
+    bool drained() const;       // No output left before the next write
+
+    // Exec channels, exec() checks the command against the next one recorded and returns its id
+    size_t exec(const std::string& command);
+    int readExec(size_t channel, char* buffer, size_t size, int is_stderr);
+    bool execDone(size_t channel) const;
+    int execExitStatus(size_t channel) const;
+
+    const Transcript& transcript() const { return transcript_; }
+
+  private:
+    struct execCursor {
+      std::vector<size_t> events;   // The channel's output and exit events, in order
+      size_t next = 0;
+      size_t consumed = 0;
+    };
+
+    Transcript transcript_;
+    bool realtime_;
+    size_t next_ = 0;           // Next event
+    size_t consumed_ = 0;       // Bytes of it already read
+    uint64_t segment_at_ = 0;   // Recorded time of the last write
+    std::chrono::steady_clock::time_point segment_start_;
+    size_t next_exec_ = 0;      // Event after the last exec channel opened
+    std::vector<execCursor> exec_channels_;
+};
+
+#endif // CHRONICLE_TRANSCRIPT_HPP
@@ -1,8 +1,17 @@
 #ifndef CHRONICLE_DATABASE_HANDLER_HPP
 #define CHRONICLE_DATABASE_HANDLER_HPP
 
+#include "core/archive.hpp"
+#include "core/compression.hpp"
 #include "core/config.hpp"
+#include "core/fleet_index.hpp"
+#include "core/host_keys.hpp"
+#include "core/reachability.hpp"
+#include "core/snapshot.hpp"
+#include <chrono>
 #include <optional>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <bsoncxx/document/view_or_value.hpp>
@@ -16,6 +25,10 @@ class ChronicleDB {
       static const bsoncxx::document::view_or_value device();
       static const bsoncxx::document::view_or_value settings();
       static const bsoncxx::document::view_or_value users();
+      static const bsoncxx::document::view_or_value hostKeys();
+      static const bsoncxx::document::view_or_value snapshots();
+      static const bsoncxx::document::view_or_value runs();
+      static const bsoncxx::document::view_or_value runDevices();
     };
 
     /* Global */
@@ -24,7 +37,10 @@ class ChronicleDB {
     /* Chronicle settings */
     void updateSettings(
       std::optional<int> sshIdleTimeout = CHRONICLE_CONFIG_DEFAULT_SSH_IDLE_TIMEOUT,
-      std::optional<int> sshTotalTimeout = CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT
+      std::optional<int> sshTotalTimeout = CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT,
+      std::optional<int> sshConnectTimeout = std::nullopt,
+      std::optional<int> sshHandshakeTimeout = std::nullopt,
+      std::optional<int> sshAuthTimeout = std::nullopt
     ) const;
     std::string getSettings() const;
 
@@ -42,7 +58,12 @@ class ChronicleDB {
       const int& port = CHRONICLE_CONFIG_DEFAULT_PORT,
       const int& sshVerbosity = 0,
       const std::string& kexMethods = CHRONICLE_CONFIG_DEFAULT_KEX_METHODS,
-      const std::string& hostkeyAlgorithms = CHRONICLE_CONFIG_DEFAULT_HOSTKEYS
+      const std::string& hostkeyAlgorithms = CHRONICLE_CONFIG_DEFAULT_HOSTKEYS,
+
+      // Transport
+      const bool& compression = false,
+      const int& compressionLevel = CHRONICLE_CONFIG_DEFAULT_COMPRESSION_LEVEL,
+      const int& readBufferSize = CHRONICLE_CONFIG_DEFAULT_READ_BUFFER
     ) const;
 
     void modifyDevice(
@@ -59,7 +80,12 @@ class ChronicleDB {
       std::optional<int> port = std::nullopt,
       std::optional<int> sshVerbosity = std::nullopt,
       std::optional<std::string> kexMethods = std::nullopt,
-      std::optional<std::string> hostkeyAlgorithms = std::nullopt
+      std::optional<std::string> hostkeyAlgorithms = std::nullopt,
+
+      // Transport fields
+      std::optional<bool> compression = std::nullopt,
+      std::optional<int> compressionLevel = std::nullopt,
+      std::optional<int> readBufferSize = std::nullopt
     ) const;
 
     void deleteDevice(const std::string& deviceNickname) const;
@@ -77,10 +103,54 @@ class ChronicleDB {
     std::vector<std::string> listUsers() const;
     std::string getUser(const std::string& username) const;
 
+    // Snapshots
+    std::string storeSnapshot(const std::string& deviceNickname, const std::vector<std::string>& lines, const std::string& runId = "") const;
+    std::vector<std::string> getSnapshot(const std::string& hash) const;
+    std::vector<std::string> getLatestSnapshot(const std::string& deviceNickname) const;
+    std::vector<std::string> getSnapshotAt(const std::string& deviceNickname, std::chrono::system_clock::time_point at) const;
+    compactionResult compactHistory(const retentionPolicy& policy = retentionPolicy()) const;
+    std::vector<std::string> listSnapshots(const std::string& deviceNickname, std::optional<int> limit = std::nullopt) const;
+    int syncFleetIndex(FleetIndex& index) const;
+    int exportArchive(SnapshotArchive& archive) const;
+    int importArchive(const SnapshotArchive& archive) const;
+
+    // Compression dictionaries
+    int trainDictionary(const std::string& vendor, int maxSamples = CHRONICLE_DICTIONARY_MAX_SAMPLES) const;
+    std::vector<std::string> listDictionaries() const;
+
+    // Fleet runs
+    std::vector<std::string> listRuns(std::optional<int> limit = std::nullopt) const;
+    std::vector<std::string> listRunDevices(const std::string& runId) const;
+
+    // Reachability
+    void updateReachability(const std::vector<reachabilityResult>& results) const;
+
+    // Host keys
+    std::vector<std::string> listHostKeys() const;
+    void deleteHostKey(const std::string& host, int port) const;
+
 
     // C++ Internal methods
     bsoncxx::document::value getDeviceBson(const std::string& deviceNickname) const;
+    std::vector<bsoncxx::document::value> getDevicesBson() const;
+    void recordOutputSize(const std::string& deviceNickname, int outputSize) const;
+    void recordChangeProbe(const std::string& deviceNickname, const std::string& probe) const;
+    std::string getDeviceVendor(const std::string& deviceNickname) const;
     bsoncxx::document::value getSettingsBson() const;
+    std::vector<hostKeyEntry> getHostKeys() const;
+    void addHostKeys(const std::vector<hostKeyEntry>& entries) const;
+    void storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash = "", const std::string& vendor = "") const;
+    std::string getBlob(const std::string& hash) const;
+    void addRun(const bsoncxx::document::view& run) const;
+    void updateRun(const std::string& runId, const bsoncxx::document::view& fields) const;
+    bsoncxx::document::value getRunBson(const std::string& runId) const;
+    void updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) const;
+    std::vector<bsoncxx::document::value> getRunDevicesBson(const std::string& runId) const;
+    std::vector<bsoncxx::document::value> getRunSnapshotsBson(const std::string& runId) const;
     
 };
+
+// Times the snapshot calls on synthetic histories in a memory store of its own, the selected backend is put back after
+std::vector<snapshotBenchmark> benchmarkSnapshots(const std::vector<size_t>& sizes = {1000, 10000, 100000}, int versions = 32, double editRate = 0.01);
+
 #endif // CHRONICLE_DATABASE_HANDLER_HPP
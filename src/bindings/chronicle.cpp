@@ -1,17 +1,53 @@
 #include <pybind11/cast.h>
+#include <pybind11/chrono.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <bsoncxx/json.hpp>
+
+#include "core/archive.hpp"
+#include "core/async_writer.hpp"
 #include "core/chronicle.hpp"
+#include "core/compression.hpp"
 #include "core/config.hpp"
+#include "core/config_tree.hpp"
+#include "core/diff.hpp"
 #include "core/error_handler.hpp"
+#include "core/fleet_index.hpp"
+#include "core/fleet_run.hpp"
+#include "core/hash.hpp"
+#include "core/host_keys.hpp"
+#include "core/circuit_breaker.hpp"
 #include "core/mongodb.hpp"
+#include "core/output_cache.hpp"
+#include "core/snapshot.hpp"
+#include "core/ssh.hpp"
+#include "core/storage.hpp"
+#include "core/terminal.hpp"
+#include "core/trace.hpp"
+#include "core/transcript.hpp"
 #include "database_handler.hpp"
 
 namespace py = pybind11;
 
 extern void bind_device_loader(py::module_ &);
 
+namespace {
+// Python side node handle, keeps the tree (and the buffer its views point into) alive
+struct configNodeRef {
+  std::shared_ptr<const ConfigTree> tree;
+  const configNode *node;
+};
+
+std::vector<configNodeRef> wrapNodes(const std::shared_ptr<const ConfigTree> &tree,
+                                     const std::vector<const configNode *> &nodes) {
+  std::vector<configNodeRef> refs;
+  refs.reserve(nodes.size());
+  for (const configNode *node : nodes) refs.push_back({tree, node});
+  return refs;
+}
+} // namespace
+
 PYBIND11_MODULE(chronicle, m) {
   m.doc() = "Chronicle";
 
@@ -63,16 +99,182 @@ PYBIND11_MODULE(chronicle, m) {
       .def_readwrite("kex_methods", &connectionInfo::kex_methods)
       .def_readwrite("hostkey_algorithms", &connectionInfo::hostkey_algorithms)
       .def_readwrite("verbosity", &connectionInfo::verbosity)
+      .def_readwrite("nickname", &connectionInfo::nickname)
+      .def_readwrite("reachable", &connectionInfo::reachable)
+      .def_readwrite("reachable_checked_at", &connectionInfo::reachable_checked_at)
+      .def_readwrite("compression", &connectionInfo::compression)
+      .def_readwrite("compression_level", &connectionInfo::compression_level)
+      .def_readwrite("read_buffer_size", &connectionInfo::read_buffer_size)
+      .def_readwrite("last_output_size", &connectionInfo::last_output_size)
+      .def_readwrite("change_probe", &connectionInfo::change_probe)
+      .def_readwrite("change_probe_full_at", &connectionInfo::change_probe_full_at)
       .def("getVendorId", &connectionInfo::getVendorId)
       .def("getDeviceId", &connectionInfo::getDeviceId);
 
   py::class_<chronicleSettings>(m, "chronicleSettings")
       .def_readwrite("ssh_idle_timeout", &chronicleSettings::ssh_idle_timeout)
       .def_readwrite("ssh_total_timeout",
-                     &chronicleSettings::ssh_total_timeout);
+                     &chronicleSettings::ssh_total_timeout)
+      .def_readwrite("ssh_connect_timeout",
+                     &chronicleSettings::ssh_connect_timeout)
+      .def_readwrite("ssh_handshake_timeout",
+                     &chronicleSettings::ssh_handshake_timeout)
+      .def_readwrite("ssh_auth_timeout", &chronicleSettings::ssh_auth_timeout);
+
+  py::class_<reachabilityResult>(m, "reachabilityResult")
+      .def_readonly("nickname", &reachabilityResult::nickname)
+      .def_readonly("host", &reachabilityResult::host)
+      .def_readonly("port", &reachabilityResult::port)
+      .def_readonly("reachable", &reachabilityResult::reachable)
+      .def_readonly("banner", &reachabilityResult::banner)
+      .def_readonly("latency_ms", &reachabilityResult::latency_ms)
+      .def_readonly("error", &reachabilityResult::error);
+
+  py::class_<deviceHealth>(m, "deviceHealth")
+      .def_readonly("state", &deviceHealth::state)
+      .def_readonly("consecutive_failures", &deviceHealth::consecutive_failures)
+      .def_readonly("last_error", &deviceHealth::last_error)
+      .def_readonly("cooldown_ms", &deviceHealth::cooldown_ms);
+
+  m.attr("CIRCUIT_CLOSED") = CHRONICLE_CIRCUIT_CLOSED;
+  m.attr("CIRCUIT_OPEN") = CHRONICLE_CIRCUIT_OPEN;
+  m.attr("CIRCUIT_HALF_OPEN") = CHRONICLE_CIRCUIT_HALF_OPEN;
+
+  m.def("getDeviceHealth",
+        [](const std::string &device) { return CircuitBreaker::instance().getHealth(device); },
+        py::arg("deviceNickname"), "Returns the circuit breaker state of a device.");
+  m.def("resetDeviceHealth",
+        [](const std::string &device) { CircuitBreaker::instance().reset(device); },
+        py::arg("deviceNickname"), "Closes the circuit of a device and clears its failures.");
+
+  m.def("sweepReachability", py::overload_cast<int, int>(&sweepReachability),
+        py::arg("timeoutMs") = CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT,
+        py::arg("maxInFlight") = CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT,
+        "Probes every device in parallel and records its reachability.");
+
+  m.def("getConfig",
+        py::overload_cast<connectionInfo, std::vector<OperationMap>, const std::vector<std::string> &>(&getConfig),
+        py::arg("ConnectionInfo"), py::arg("OperationMap"), py::arg("pagerPrompts") = std::vector<std::string>{},
+        "Returns the current device configuration, answering the pager prompts (e.g. deviceOperations.pager_prompts).");
+  m.def("getConfig",
+        py::overload_cast<connectionInfo, const deviceOperations &>(&getConfig),
+        py::arg("ConnectionInfo"), py::arg("deviceOperations"),
+        "Returns the current device configuration using the plugin channel mode.");
+
+  // Transcripts
+  m.def("setTranscriptDirectory", &setTranscriptDirectory, py::arg("directory"),
+        "Records every session, shell or exec, to a transcript file in the directory, an empty string stops recording.");
+  m.def("transcriptDirectory", &transcriptDirectory);
+  m.def("replayConfig",
+        py::overload_cast<const std::string &, std::vector<OperationMap>, bool, const std::vector<std::string> &>(&replayConfig),
+        py::arg("transcript"), py::arg("OperationMap"), py::arg("realtime") = false,
+        py::arg("pagerPrompts") = std::vector<std::string>{},
+        py::call_guard<py::gil_scoped_release>(),
+        "Runs the commands against a recorded session instead of a device, at the recorded pace when realtime is set.");
+  m.def("replayConfig",
+        py::overload_cast<const std::string &, const deviceOperations &, bool>(&replayConfig),
+        py::arg("transcript"), py::arg("deviceOperations"), py::arg("realtime") = false,
+        py::call_guard<py::gil_scoped_release>(),
+        "Runs the plugin commands and normalize rules against a recorded session instead of a device.");
+
+  py::class_<retentionPolicy>(m, "retentionPolicy")
+      .def(py::init<>())
+      .def_readwrite("max_age_days", &retentionPolicy::max_age_days)
+      .def_readwrite("keep_unchanged_days", &retentionPolicy::keep_unchanged_days);
+
+  py::class_<compactionResult>(m, "compactionResult")
+      .def_readonly("snapshots_removed", &compactionResult::snapshots_removed)
+      .def_readonly("blobs_rewritten", &compactionResult::blobs_rewritten)
+      .def_readonly("blobs_removed", &compactionResult::blobs_removed);
+
+  py::class_<configCheck>(m, "configCheck")
+      .def_readonly("probed", &configCheck::probed)
+      .def_readonly("changed", &configCheck::changed)
+      .def_readonly("probe", &configCheck::probe)
+      .def_readonly("config", &configCheck::config);
+
+  py::class_<configResult>(m, "configResult")
+      .def_readonly("device", &configResult::device)
+      .def_readonly("ok", &configResult::ok)
+      .def_readonly("code", &configResult::code)
+      .def_readonly("message", &configResult::message)
+      .def_readonly("details", &configResult::details)
+      .def_readonly("hash", &configResult::hash)
+      .def_readonly("config", &configResult::config);
 
-  m.def("getConfig", &getConfig, py::arg("ConnectionInfo"),
-        py::arg("OperationMap"), "Returns the current device configuration.");
+  // The batch calls keep the GIL, their database phases share the process wide Mongo client with
+  // every other ChronicleDB call and the GIL is what serializes them. The workers run without it.
+  m.def("getConfigBatch", &getConfigBatch,
+        py::arg("devices"), py::arg("deviceOperations"),
+        py::arg("workers") = CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS,
+        "Downloads the configuration of every device in parallel, a failed device is reported in its result instead of raising.");
+
+  // Fleet runs
+  m.attr("RUN_PENDING") = CHRONICLE_RUN_PENDING;
+  m.attr("RUN_INFLIGHT") = CHRONICLE_RUN_INFLIGHT;
+  m.attr("RUN_DONE") = CHRONICLE_RUN_DONE;
+  m.attr("RUN_FAILED") = CHRONICLE_RUN_FAILED;
+
+  py::class_<runProgress>(m, "runProgress")
+      .def_readonly("id", &runProgress::id)
+      .def_readonly("kind", &runProgress::kind)
+      .def_readonly("status", &runProgress::status)
+      .def_readonly("devices", &runProgress::devices)
+      .def_readonly("pending", &runProgress::pending)
+      .def_readonly("inflight", &runProgress::inflight)
+      .def_readonly("done", &runProgress::done)
+      .def_readonly("failed", &runProgress::failed);
+
+  py::class_<FleetRun, std::shared_ptr<FleetRun>>(m, "FleetRun")
+      .def_static("start", &FleetRun::start,
+                  py::arg("devices"), py::arg("kind") = "backup",
+                  py::arg("leaseSeconds") = CHRONICLE_RUN_DEFAULT_LEASE,
+                  "Records a new run over the device nicknames, every device pending.")
+      .def_static("resume", &FleetRun::resume,
+                  py::arg("runId"), py::arg("leaseSeconds") = CHRONICLE_RUN_DEFAULT_LEASE,
+                  py::arg("retryFailed") = false,
+                  "Loads a run that stopped, devices with a snapshot stored under it count as done.")
+      .def_property_readonly("id", &FleetRun::id)
+      .def("unfinished", &FleetRun::unfinished,
+           "Devices left when the run was started or resumed: pending, expired leases and, when asked, failed ones.")
+      .def("flush", &FleetRun::flush, "Writes the state changes since the last flush in one batch.")
+      .def("progress", &FleetRun::progress);
+
+  m.def("backupRun", &backupRun,
+        py::arg("run"), py::arg("devices"), py::arg("deviceOperations"),
+        py::arg("workers") = CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS,
+        "getConfigBatch checkpointed in a run, snapshots are stored as devices finish and results carry their hash.");
+
+  py::class_<fanoutGroup>(m, "fanoutGroup")
+      .def_readonly("hash", &fanoutGroup::hash)
+      .def_readonly("output", &fanoutGroup::output)
+      .def_readonly("count", &fanoutGroup::count)
+      .def_readonly("devices", &fanoutGroup::devices);
+
+  py::class_<fanoutResult>(m, "fanoutResult")
+      .def_readonly("devices", &fanoutResult::devices)
+      .def_readonly("succeeded", &fanoutResult::succeeded)
+      .def_readonly("groups", &fanoutResult::groups)
+      .def_readonly("failures", &fanoutResult::failures);
+
+  m.def("fanOut", &fanOut,
+        py::arg("devices"), py::arg("OperationMap"),
+        py::arg("normalize") = std::vector<NormalizeRule>{},
+        py::arg("channelMode") = CHRONICLE_CHANNEL_MODE_SHELL,
+        py::arg("workers") = CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS,
+        py::arg("pagerPrompts") = std::vector<std::string>{},
+        "Runs the commands on every device in parallel and groups the devices by identical output.");
+  m.def("fanOutByName", &fanOutByName,
+        py::arg("deviceNicknames"), py::arg("OperationMap"),
+        py::arg("normalize") = std::vector<NormalizeRule>{},
+        py::arg("channelMode") = CHRONICLE_CHANNEL_MODE_SHELL,
+        py::arg("workers") = CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS,
+        py::arg("pagerPrompts") = std::vector<std::string>{},
+        "Same as fanOut for devices stored in the database, unknown nicknames are reported as failures.");
+
+  m.def("getConfigIfChanged", &getConfigIfChanged,
+        py::arg("ConnectionInfo"), py::arg("deviceOperations"),
+        "Runs the plugin change probe first and downloads the configuration only when it changed.");
 
   // ChronicleDB
   // - Devices
@@ -86,12 +288,17 @@ PYBIND11_MODULE(chronicle, m) {
            py::arg("sshVerbosity") = 0,
            py::arg("kexMethods") = CHRONICLE_CONFIG_DEFAULT_KEX_METHODS,
            py::arg("hostkeyAlgorithms") = CHRONICLE_CONFIG_DEFAULT_HOSTKEYS,
+           py::arg("compression") = false,
+           py::arg("compressionLevel") = CHRONICLE_CONFIG_DEFAULT_COMPRESSION_LEVEL,
+           py::arg("readBufferSize") = CHRONICLE_CONFIG_DEFAULT_READ_BUFFER,
            "Add a new device to the Chronicle database.")
       .def("modifyDevice", &ChronicleDB::modifyDevice,
            py::arg("deviceNickname"), py::arg("deviceName"), py::arg("vendor"),
            py::arg("user"), py::arg("password"), py::arg("host"),
            py::arg("port"), py::arg("sshVerbosity"), py::arg("kexMethods"),
-           py::arg("hostkeyAlgorithms"),
+           py::arg("hostkeyAlgorithms"), py::arg("compression") = py::none(),
+           py::arg("compressionLevel") = py::none(),
+           py::arg("readBufferSize") = py::none(),
            "Modify a device in the Chronicle database.")
       .def("deleteDevice", &ChronicleDB::deleteDevice,
            py::arg("deviceNickname"),
@@ -106,9 +313,9 @@ PYBIND11_MODULE(chronicle, m) {
            "Returns the current chronicle settings.")
       .def("updateSettings", &ChronicleDB::updateSettings,
            py::arg("sshIdleTimeout"), py::arg("sshTotalTimeout"),
-           "Updates the current chronicle settings.")
-      .def("updateSettings", &ChronicleDB::updateSettings,
-           py::arg("sshIdleTimeout"), py::arg("sshTotalTimeout"),
+           py::arg("sshConnectTimeout") = py::none(),
+           py::arg("sshHandshakeTimeout") = py::none(),
+           py::arg("sshAuthTimeout") = py::none(),
            "Updates the current chronicle settings.")
 
       // Users
@@ -125,7 +332,329 @@ PYBIND11_MODULE(chronicle, m) {
       .def("listUsers", &ChronicleDB::listUsers,
            "List all users from the Chronicle database.")
 
+      // Snapshots
+      .def("storeSnapshot", &ChronicleDB::storeSnapshot,
+           py::arg("deviceNickname"), py::arg("lines"), py::arg("runId") = "",
+           "Stores a configuration snapshot, returns its content hash.")
+      .def("getSnapshot", &ChronicleDB::getSnapshot, py::arg("hash"),
+           "Returns the configuration lines stored under a content hash.")
+      .def("getLatestSnapshot", &ChronicleDB::getLatestSnapshot,
+           py::arg("deviceNickname"),
+           "Returns the most recent configuration snapshot of a device.")
+      .def("listSnapshots", &ChronicleDB::listSnapshots,
+           py::arg("deviceNickname"), py::arg("limit") = py::none(),
+           "Lists the snapshot entries of a device, newest first.")
+      .def("getSnapshotAt", &ChronicleDB::getSnapshotAt,
+           py::arg("deviceNickname"), py::arg("at"),
+           "Returns the configuration a device had at a point in time.")
+      .def("compactHistory", &ChronicleDB::compactHistory,
+           py::arg("policy") = retentionPolicy(),
+           "Applies the retention policy and rewrites snapshot history into keyframes and delta chains.")
+      .def("syncFleetIndex", &ChronicleDB::syncFleetIndex, py::arg("index"),
+           "Folds snapshots taken since the last sync into a fleet index, returns the devices reindexed.")
+      .def("exportArchive", &ChronicleDB::exportArchive, py::arg("archive"),
+           "Appends snapshots newer than the archive's latest records, returns the number appended.")
+      .def("importArchive", &ChronicleDB::importArchive, py::arg("archive"),
+           "Imports archived snapshots newer than the database's latest ones, returns the number imported.")
+
+      // Fleet runs
+      .def("listRuns", &ChronicleDB::listRuns, py::arg("limit") = py::none(),
+           "Lists the fleet runs with their counts, newest first.")
+      .def("listRunDevices", &ChronicleDB::listRunDevices, py::arg("runId"),
+           "Lists the state of every device of a run.")
+
+      // Compression dictionaries
+      .def("trainDictionary", &ChronicleDB::trainDictionary, py::arg("vendor"),
+           py::arg("maxSamples") = static_cast<int>(CHRONICLE_DICTIONARY_MAX_SAMPLES),
+           "Trains a new dictionary version from the vendor's stored snapshots, returns the version.")
+      .def("listDictionaries", &ChronicleDB::listDictionaries,
+           "Lists the stored compression dictionaries without their data.")
+
+      // Host keys
+      .def("listHostKeys", &ChronicleDB::listHostKeys,
+           "List all trusted host keys from the Chronicle database.")
+      .def("deleteHostKey", &ChronicleDB::deleteHostKey, py::arg("host"),
+           py::arg("port") = CHRONICLE_CONFIG_DEFAULT_PORT,
+           "Forget the trusted host key of a host, the next connection pins the new key.")
+
       .def("initDB", &ChronicleDB::initDB, "Initiates the chronicle db.");
 
+  m.def("contentHash", [](const std::string &data) { return contentHash(data); },
+        py::arg("data"), "Returns the 128 bit content hash used for snapshots.");
+  m.def("stripTerminalControl", [](const std::string &data) { return stripTerminalControl(data); },
+        py::arg("data"), "Removes escape sequences and applies backspaces and carriage returns, as shell output is read.");
+
+  // Config tree
+  py::class_<configNodeRef>(m, "ConfigNode")
+      .def_property_readonly("text", [](const configNodeRef &r) { return std::string(r.node->text); })
+      .def_property_readonly("line", [](const configNodeRef &r) { return r.node->line; })
+      .def_property_readonly("depth", [](const configNodeRef &r) { return r.node->depth; })
+      .def_property_readonly("path", [](const configNodeRef &r) { return nodePath(r.node); })
+      .def("children", [](const configNodeRef &r) { return wrapNodes(r.tree, childrenOf(r.node)); })
+      .def("query",
+           [](const configNodeRef &r, const std::string &path) {
+             return wrapNodes(r.tree, ConfigTree::query(r.node, path));
+           },
+           py::arg("path"), "Runs a path query below this node.");
+
+  py::class_<ConfigTree, std::shared_ptr<ConfigTree>>(m, "ConfigTree")
+      .def(py::init<const std::vector<std::string> &>(), py::arg("lines"))
+      .def_static("fromText",
+                  [](const std::string &text) { return std::make_shared<ConfigTree>(text); },
+                  py::arg("text"), "Parses configuration text.")
+      .def_property_readonly("braces", &ConfigTree::braces)
+      .def("__len__", &ConfigTree::size)
+      .def("query",
+           [](const std::shared_ptr<ConfigTree> &tree, const std::string &path) {
+             return wrapNodes(tree, tree->query(path));
+           },
+           py::arg("path"), "Returns the nodes matching a path such as 'interface */ip address'.")
+      .def("lines",
+           [](const ConfigTree &tree, const std::string &path) {
+             std::vector<std::string> lines;
+             for (const configNode *node : tree.query(path)) lines.emplace_back(node->text);
+             return lines;
+           },
+           py::arg("path"), "Returns the text of the nodes matching a path.");
+
+  // Diff
+  py::class_<diffSummary>(m, "diffSummary")
+      .def_readonly("identical", &diffSummary::identical)
+      .def_readonly("added", &diffSummary::added)
+      .def_readonly("removed", &diffSummary::removed)
+      .def_readonly("hunks", &diffSummary::hunks)
+      .def_readonly("sections", &diffSummary::sections);
+
+  m.def("unifiedDiff", &unifiedDiff, py::arg("oldLines"), py::arg("newLines"),
+        py::arg("oldLabel") = "old", py::arg("newLabel") = "new",
+        py::arg("context") = CHRONICLE_DIFF_DEFAULT_CONTEXT,
+        py::arg("hierarchical") = false,
+        py::call_guard<py::gil_scoped_release>(),
+        "Returns a unified diff of two configurations, empty when they are identical.");
+  m.def("summarizeDiff", &summarizeDiff, py::arg("oldLines"), py::arg("newLines"),
+        py::call_guard<py::gil_scoped_release>(),
+        "Counts the changed lines and lists the top level blocks that changed.");
+
+  py::class_<diffBenchmark>(m, "diffBenchmark")
+      .def_readonly("lines", &diffBenchmark::lines)
+      .def_readonly("edit_rate", &diffBenchmark::edit_rate)
+      .def_readonly("edits", &diffBenchmark::edits)
+      .def_readonly("diff_ms", &diffBenchmark::diff_ms)
+      .def_readonly("unified_ms", &diffBenchmark::unified_ms)
+      .def_readonly("lines_per_s", &diffBenchmark::lines_per_s);
+
+  m.def("benchmarkDiff", &benchmarkDiff,
+        py::arg("sizes") = std::vector<size_t>{1000, 10000, 100000},
+        py::arg("editRates") = std::vector<double>{0.001, 0.01, 0.1},
+        py::arg("rounds") = 3,
+        py::call_guard<py::gil_scoped_release>(),
+        "Times diffLines and unifiedDiff on synthetic configurations of every size at every edit rate.");
+
+  // Fleet index
+  py::class_<fleetHit>(m, "fleetHit")
+      .def_readonly("device", &fleetHit::device)
+      .def_readonly("hash", &fleetHit::hash)
+      .def_readonly("line", &fleetHit::line)
+      .def_readonly("text", &fleetHit::text);
+
+  py::class_<FleetIndex>(m, "FleetIndex")
+      .def(py::init<>())
+      .def("load", &FleetIndex::load, py::arg("path"),
+           py::call_guard<py::gil_scoped_release>(),
+           "Maps a saved index file, replacing the current contents.")
+      .def("save", &FleetIndex::save, py::arg("path"),
+           py::call_guard<py::gil_scoped_release>(),
+           "Writes every live document to the index file and maps it.")
+      .def("update", &FleetIndex::update, py::arg("device"), py::arg("hash"), py::arg("lines"),
+           "Indexes the configuration of a device, skipped when the hash is already indexed.")
+      .def("remove", &FleetIndex::remove, py::arg("device"))
+      .def("indexedHash", &FleetIndex::indexedHash, py::arg("device"))
+      .def("devices", &FleetIndex::devices)
+      .def("__len__", &FleetIndex::size)
+      .def_property("lastSync", &FleetIndex::lastSync, &FleetIndex::setLastSync)
+      .def("search", &FleetIndex::search, py::arg("text"),
+           py::arg("limit") = CHRONICLE_FLEET_INDEX_DEFAULT_LIMIT,
+           py::call_guard<py::gil_scoped_release>(),
+           "Returns the lines of every device configuration containing the text.")
+      .def("searchRegex", &FleetIndex::searchRegex, py::arg("pattern"),
+           py::arg("limit") = CHRONICLE_FLEET_INDEX_DEFAULT_LIMIT,
+           py::call_guard<py::gil_scoped_release>(),
+           "Returns the lines of every device configuration matching an ECMAScript regex.");
+
+  // Snapshot archive
+  py::class_<archiveEntry>(m, "archiveEntry")
+      .def_readonly("device", &archiveEntry::device)
+      .def_readonly("hash", &archiveEntry::hash)
+      .def_readonly("taken_at", &archiveEntry::taken_at)
+      .def_readonly("size", &archiveEntry::size)
+      .def_readonly("segment", &archiveEntry::segment)
+      .def_readonly("offset", &archiveEntry::offset);
+
+  py::class_<SnapshotArchive>(m, "SnapshotArchive")
+      .def(py::init<const std::string &, bool>(), py::arg("directory"), py::arg("writable") = false)
+      .def("append",
+           [](SnapshotArchive &archive, const std::string &device, const std::string &hash, int64_t takenAt,
+              const std::vector<std::string> &lines) {
+             return archive.append(device, hash, takenAt, joinSnapshotLines(lines));
+           },
+           py::arg("device"), py::arg("hash"), py::arg("takenAt"), py::arg("lines"),
+           "Appends a snapshot, False when it is not newer than the device's last record.")
+      .def("flush", &SnapshotArchive::flush, "Syncs the active segment and writes the segment indexes.")
+      .def("devices", &SnapshotArchive::devices)
+      .def("latest", &SnapshotArchive::latest, py::arg("device"))
+      .def("__len__", &SnapshotArchive::size)
+      .def("entries", &SnapshotArchive::entries, py::arg("device"),
+           py::arg("start") = CHRONICLE_ARCHIVE_MIN_TIME, py::arg("end") = CHRONICLE_ARCHIVE_MAX_TIME,
+           "Lists the records of a device between two unix millisecond times, oldest first.")
+      .def("read",
+           [](const SnapshotArchive &archive, const archiveEntry &entry) {
+             return splitSnapshotLines(archive.read(entry));
+           },
+           py::arg("entry"), py::call_guard<py::gil_scoped_release>(),
+           "Returns the configuration lines of a record.");
+
+  // Compression
+  py::class_<compressionBenchmark>(m, "compressionBenchmark")
+      .def_readonly("codec", &compressionBenchmark::codec)
+      .def_readonly("raw_bytes", &compressionBenchmark::raw_bytes)
+      .def_readonly("stored_bytes", &compressionBenchmark::stored_bytes)
+      .def_readonly("ratio", &compressionBenchmark::ratio)
+      .def_readonly("compress_mb_s", &compressionBenchmark::compress_mb_s)
+      .def_readonly("decompress_mb_s", &compressionBenchmark::decompress_mb_s);
+
+  m.def("benchmarkCompression",
+        [](const std::vector<std::vector<std::string>> &configs, int level) {
+          std::vector<std::string> samples;
+          samples.reserve(configs.size());
+          for (const auto &lines : configs) samples.push_back(joinSnapshotLines(lines));
+          py::gil_scoped_release release;
+          return benchmarkCompression(samples, level);
+        },
+        py::arg("configs"), py::arg("level") = CHRONICLE_COMPRESSION_LEVEL,
+        "Compares ratio and throughput of no compression, zstd and zstd with a dictionary trained on half the configs.");
+
+  py::class_<sshReadBenchmark>(m, "sshReadBenchmark")
+      .def_readonly("read_buffer_size", &sshReadBenchmark::read_buffer_size)
+      .def_readonly("reserved", &sshReadBenchmark::reserved)
+      .def_readonly("bytes", &sshReadBenchmark::bytes)
+      .def_readonly("lines", &sshReadBenchmark::lines)
+      .def_readonly("ms", &sshReadBenchmark::ms)
+      .def_readonly("mb_s", &sshReadBenchmark::mb_s);
+
+  m.def("benchmarkSshRead", &benchmarkSshRead,
+        py::arg("bytes") = CHRONICLE_SSH_BENCHMARK_BYTES,
+        py::arg("readBufferSizes") = std::vector<int>{CHRONICLE_CONFIG_DEFAULT_READ_BUFFER, CHRONICLE_CONFIG_MAX_READ_BUFFER},
+        py::arg("rounds") = 3,
+        py::call_guard<py::gil_scoped_release>(),
+        "Replays a synthetic paged session through the shell read loop, no device or network involved.");
+
+  py::class_<terminalBenchmark>(m, "terminalBenchmark")
+      .def_readonly("chunk_size", &terminalBenchmark::chunk_size)
+      .def_readonly("input_bytes", &terminalBenchmark::input_bytes)
+      .def_readonly("output_bytes", &terminalBenchmark::output_bytes)
+      .def_readonly("bytes_per_s", &terminalBenchmark::bytes_per_s);
+
+  m.def("benchmarkTerminalFilter", &benchmarkTerminalFilter,
+        py::arg("bytes") = CHRONICLE_TERMINAL_BENCHMARK_BYTES,
+        py::arg("chunkSizes") = std::vector<size_t>{512, 16384, 262144},
+        py::arg("rounds") = 3,
+        py::call_guard<py::gil_scoped_release>(),
+        "Feeds synthetic paged pty output through a TerminalFilter in chunks of each size, reports input bytes per second.");
+
+  py::class_<snapshotBenchmark>(m, "snapshotBenchmark")
+      .def_readonly("lines", &snapshotBenchmark::lines)
+      .def_readonly("versions", &snapshotBenchmark::versions)
+      .def_readonly("bytes", &snapshotBenchmark::bytes)
+      .def_readonly("store_ms", &snapshotBenchmark::store_ms)
+      .def_readonly("latest_ms", &snapshotBenchmark::latest_ms)
+      .def_readonly("at_ms", &snapshotBenchmark::at_ms)
+      .def_readonly("store_mb_s", &snapshotBenchmark::store_mb_s);
+
+  // Keeps the GIL, no other Python thread starts a ChronicleDB call while the memory store is swapped in
+  m.def("benchmarkSnapshots", &benchmarkSnapshots,
+        py::arg("sizes") = std::vector<size_t>{1000, 10000, 100000},
+        py::arg("versions") = 32, py::arg("editRate") = 0.01,
+        "Times storeSnapshot, getLatestSnapshot and getSnapshotAt on synthetic histories against a memory store.");
+
+  // Tracing
+  m.def("enableTracing", &enableTracing, py::arg("capacity") = CHRONICLE_TRACE_DEFAULT_CAPACITY,
+        "Starts recording spans, capacity is the number of spans kept per thread. Drops spans recorded before.");
+  m.def("disableTracing", &disableTracing, "Stops recording spans, recorded spans stay exportable.");
+  m.def("tracingEnabled", &tracingEnabled);
+  m.def("exportChromeTrace", &exportChromeTrace, py::arg("path"),
+        "Writes the recorded spans as a Chrome trace file, returns the number of spans.");
+  m.def("exportOtlpJson", &exportOtlpJson, py::arg("path"),
+        "Writes the recorded spans as OTLP/JSON, returns the number of spans.");
+
+  // Output cache
+  py::class_<cacheStats>(m, "cacheStats")
+      .def_readonly("hits", &cacheStats::hits)
+      .def_readonly("database_hits", &cacheStats::database_hits)
+      .def_readonly("misses", &cacheStats::misses)
+      .def_readonly("coalesced", &cacheStats::coalesced)
+      .def_readonly("entries", &cacheStats::entries);
+
+  m.def("enableOutputCache", [](bool useDatabase) { OutputCache::instance().enable(useDatabase); },
+        py::arg("useDatabase") = true,
+        "Serves repeated fanOut commands with a cache_ttl from the cache, shared through Mongo unless useDatabase is False.");
+  m.def("disableOutputCache", []() { OutputCache::instance().disable(); });
+  m.def("invalidateOutputCache",
+        [](const std::string &device, const std::string &command) { return OutputCache::instance().invalidate(device, command); },
+        py::arg("device"), py::arg("command") = "",
+        "Drops the cached output of a device (nickname or host:port), or only of sequences containing command.");
+  m.def("clearOutputCache", []() { OutputCache::instance().clear(); });
+  m.def("outputCacheStats", []() { return OutputCache::instance().stats(); });
+
+  // Storage backend
+  m.attr("STORAGE_MONGO") = CHRONICLE_STORAGE_MONGO;
+  m.attr("STORAGE_MEMORY") = CHRONICLE_STORAGE_MEMORY;
+
+  m.def("useMongoStorage", &useMongoStorage, "Keeps devices, users, settings, host keys and snapshots in MongoDB, the default.");
+  m.def("useMemoryStorage", &useMemoryStorage, py::arg("journalPath") = "",
+        "Keeps them in this process instead, replayed from and appended to journalPath when one is given. Call before connect().");
+  m.def("storageKind", &storageKind);
+
+  // Asynchronous writer
+  py::class_<writerOptions>(m, "writerOptions")
+      .def(py::init<>())
+      .def_readwrite("queue_capacity", &writerOptions::queue_capacity)
+      .def_readwrite("batch_size", &writerOptions::batch_size)
+      .def_readwrite("batch_bytes", &writerOptions::batch_bytes)
+      .def_readwrite("linger_ms", &writerOptions::linger_ms);
+
+  py::class_<writerStats>(m, "writerStats")
+      .def_readonly("queued", &writerStats::queued)
+      .def_readonly("written", &writerStats::written)
+      .def_readonly("failed", &writerStats::failed)
+      .def_readonly("batches", &writerStats::batches)
+      .def_readonly("rejected", &writerStats::rejected)
+      .def_readonly("last_error", &writerStats::last_error);
+
+  py::class_<AsyncWriter>(m, "AsyncWriter")
+      .def(py::init<const writerOptions &>(), py::arg("options") = writerOptions())
+      .def("insert",
+           [](AsyncWriter &writer, const std::string &collection, const std::string &json) {
+             writer.insert(collection, bsoncxx::from_json(json));
+           },
+           py::arg("collection"), py::arg("json"), py::call_guard<py::gil_scoped_release>(),
+           "Queues a JSON document for insertion, blocks while the queue is full.")
+      .def("tryInsert",
+           [](AsyncWriter &writer, const std::string &collection, const std::string &json) {
+             return writer.tryInsert(collection, bsoncxx::from_json(json));
+           },
+           py::arg("collection"), py::arg("json"),
+           "Queues a JSON document for insertion, returns False instead of waiting when the queue is full.")
+      .def("flush", &AsyncWriter::flush, py::call_guard<py::gil_scoped_release>(),
+           "Waits until everything queued so far is written.")
+      .def("close", &AsyncWriter::close, py::call_guard<py::gil_scoped_release>(),
+           "Writes the remaining documents and stops the writer thread.")
+      .def("stats", &AsyncWriter::stats);
+
+  m.def("flushHostKeys", []() { HostKeyStore::instance().flush(); },
+        "Writes newly trusted host keys to the Chronicle database.");
+
+  // Single device calls leave new keys queued, they are written here unless flushed before
+  py::module_::import("atexit").attr("register")(py::cpp_function([]() { HostKeyStore::instance().tryFlush(); }));
+
   bind_device_loader(m);
 }
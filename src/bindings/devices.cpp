@@ -2,49 +2,49 @@
 #include <pybind11/functional.h>
 #include <pybind11/pybind11.h>
 #include "core/device_factory.hpp"
+#include "core/device_loader.hpp"
 #include "core/error_handler.hpp"
+#include "core/normalize.hpp"
 #include <memory>
-#include <dlfcn.h>
 
 namespace py = pybind11;
 
-struct DeviceHandle {
-    void* handle;
-    deviceOperations* ops;
-
-    DeviceHandle(void* h, deviceOperations* o) : handle(h), ops(o) {}
-    ~DeviceHandle() {
-        if (ops) delete ops;
-        if (handle) dlclose(handle);
-    }
-};
-
-std::shared_ptr<DeviceHandle> loadDeviceOps(const std::string& so_path, int device_id, int vendor_id) {
-    void* handle = dlopen(so_path.c_str(), RTLD_NOW);
-    if (!handle) THROW_CHRONICLE_EXCEPTION(303, "dlopen failed");
-
-    using CreateFunc = deviceOperations* (*)(int, int);
-    auto create_fn = (CreateFunc)dlsym(handle, "createDeviceOperations");
-    if (!create_fn) THROW_CHRONICLE_EXCEPTION(303, "dlsym failed");
-
-    auto* ops = create_fn(device_id, vendor_id);
-    if (!ops) THROW_CHRONICLE_EXCEPTION(303, "Device did not return valid operations");
-
-    return std::make_shared<DeviceHandle>(handle, ops);
-}
-
 void bind_device_loader(py::module_& m) {
     py::class_<OperationMap>(m, "OperationMap")
         .def_readwrite("command", &OperationMap::command)
         .def_readwrite("skip_head", &OperationMap::skip_head)
         .def_readwrite("skip_tail", &OperationMap::skip_tail)
-        .def_readwrite("err_msg", &OperationMap::err_msg);
+        .def_readwrite("err_msg", &OperationMap::err_msg)
+        .def_readwrite("cache_ttl", &OperationMap::cache_ttl);
+
+    py::class_<NormalizeRule>(m, "NormalizeRule")
+        .def(py::init<>())
+        .def_readwrite("kind", &NormalizeRule::kind)
+        .def_readwrite("pattern", &NormalizeRule::pattern)
+        .def_readwrite("replacement", &NormalizeRule::replacement);
 
     py::class_<deviceOperations>(m, "deviceOperations")
-        .def_readwrite("getConfig", &deviceOperations::getConfig);
+        .def_readwrite("getConfig", &deviceOperations::getConfig)
+        .def_readwrite("changeProbe", &deviceOperations::changeProbe)
+        .def_readwrite("probe_max_age", &deviceOperations::probe_max_age)
+        .def_readwrite("normalize", &deviceOperations::normalize)
+        .def_readwrite("pager_prompts", &deviceOperations::pager_prompts)
+        .def_readwrite("channel_mode", &deviceOperations::channel_mode);
+
+    m.attr("CHANNEL_MODE_SHELL") = CHRONICLE_CHANNEL_MODE_SHELL;
+    m.attr("CHANNEL_MODE_EXEC") = CHRONICLE_CHANNEL_MODE_EXEC;
+
+    m.attr("NORMALIZE_DROP_PREFIX") = CHRONICLE_NORMALIZE_DROP_PREFIX;
+    m.attr("NORMALIZE_DROP_MATCH") = CHRONICLE_NORMALIZE_DROP_MATCH;
+    m.attr("NORMALIZE_REPLACE") = CHRONICLE_NORMALIZE_REPLACE;
+
+    m.def("normalizeLines", &normalizeLines, py::arg("lines"), py::arg("rules"),
+          "Applies a plugin's normalize rules to configuration lines.");
 
     py::class_<DeviceHandle, std::shared_ptr<DeviceHandle>>(m, "DeviceHandle")
         .def_readonly("ops", &DeviceHandle::ops);
 
     m.def("loadDeviceOps", &loadDeviceOps, "Load a device plugin from a .cld file");
+    m.def("devicePluginPath", &devicePluginPath, py::arg("directory"), py::arg("vendorName"), py::arg("deviceName"),
+          "Path of a device plugin inside a plugin directory laid out as the build installs it.");
 }
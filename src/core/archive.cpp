@@ -0,0 +1,507 @@
+#include "core/archive.hpp"
+#include "core/error_handler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+  constexpr uint32_t RECORD_MAGIC = 0x52524843;   // "CHRR"
+  constexpr char INDEX_MAGIC[8] = {'C', 'H', 'R', 'A', 'I', 'D', 'X', '1'};
+  constexpr uint8_t FLAG_DEFLATE = 1;
+  constexpr uint8_t FLAG_REFERENCE = 2;           // Payload is the segment and offset of an earlier record
+
+  struct recordHeader {
+    uint32_t magic;
+    uint32_t crc;             // Everything after this field up to the end of the payload
+    uint8_t flags;
+    uint8_t reserved;
+    uint16_t device_length;
+    uint16_t hash_length;
+    uint16_t reserved2;
+    int64_t taken_at;
+    uint32_t raw_size;
+    uint32_t stored_size;
+  };
+  static_assert(sizeof(recordHeader) == 32, "archive record header must stay 32 bytes");
+
+  constexpr size_t CRC_START = offsetof(recordHeader, flags);
+  constexpr size_t REFERENCE_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
+  struct indexHeader {
+    char magic[8];
+    uint64_t covered;
+    uint32_t count;
+    uint32_t device_count;
+  };
+
+  struct indexEntry {
+    uint32_t device;
+    uint32_t size;
+    int64_t taken_at;
+    uint64_t offset;
+  };
+
+  std::string segmentPath(const std::string& directory, uint32_t id, const char* extension) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06u.%s", id, extension);
+    return directory + "/" + name;
+  }
+
+  void throwIo(const std::string& what, const std::string& path) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_IO_FAILED, what + " " + path + ": " + std::strerror(errno));
+  }
+
+  // A record is usable when it fits in the valid part of its segment and its checksum holds
+  bool readRecord(const unsigned char* base, uint64_t limit, uint64_t offset, recordHeader& header) {
+    if (offset + sizeof(recordHeader) > limit) return false;
+    std::memcpy(&header, base + offset, sizeof(header));
+    if (header.magic != RECORD_MAGIC) return false;
+
+    const uint64_t length = sizeof(recordHeader) + header.device_length + header.hash_length + header.stored_size;
+    if (offset + length > limit) return false;
+
+    uLong crc = crc32(0L, base + offset + CRC_START, static_cast<uInt>(length - CRC_START));
+    return crc == header.crc;
+  }
+
+  uint64_t recordLength(const recordHeader& header) {
+    return sizeof(recordHeader) + header.device_length + header.hash_length + header.stored_size;
+  }
+}
+
+SnapshotArchive::SnapshotArchive(const std::string& directory, bool writable)
+  : directory_(directory), writable_(writable) {
+
+  struct stat st{};
+  if (stat(directory_.c_str(), &st) != 0) {
+    if (!writable_ || mkdir(directory_.c_str(), 0755) != 0) throwIo("Cannot open archive", directory_);
+  } else if (!S_ISDIR(st.st_mode)) {
+    errno = ENOTDIR;
+    throwIo("Cannot open archive", directory_);
+  }
+
+  try {
+    for (uint32_t id = 0; access(segmentPath(directory_, id, "chra").c_str(), F_OK) == 0; ++id) {
+      openSegment(id, writable_);
+    }
+
+    if (writable_) {
+      if (segments_.empty()) {
+        startSegment();
+      } else {
+        activeFd_ = ::open(segments_.back().path.c_str(), O_WRONLY | O_APPEND);
+        if (activeFd_ < 0) throwIo("Cannot open", segments_.back().path);
+      }
+    }
+  } catch (...) {
+    for (auto& segment : segments_) {
+      if (segment.map != nullptr) munmap(segment.map, segment.mapped);
+    }
+    if (activeFd_ >= 0) ::close(activeFd_);
+    throw;
+  }
+}
+
+SnapshotArchive::~SnapshotArchive() {
+  if (writable_) {
+    try {
+      flush();
+    } catch (const ChronicleException&) {
+      // Indexes are rebuilt from the segments on the next open
+    }
+  }
+
+  if (activeFd_ >= 0) ::close(activeFd_);
+  for (auto& segment : segments_) {
+    if (segment.map != nullptr) munmap(segment.map, segment.mapped);
+  }
+}
+
+void SnapshotArchive::mapSegment(segmentFile& segment, size_t length) {
+  int fd = ::open(segment.path.c_str(), O_RDONLY);
+  if (fd < 0) throwIo("Cannot open", segment.path);
+
+  // Mapping past the end of the file is fine, only the valid part of the segment is ever read
+  void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) throwIo("Cannot map", segment.path);
+
+  if (segment.map != nullptr) munmap(segment.map, segment.mapped);
+  segment.map = map;
+  segment.mapped = length;
+}
+
+void SnapshotArchive::openSegment(uint32_t id, bool recover) {
+  segmentFile segment;
+  segment.path = segmentPath(directory_, id, "chra");
+
+  struct stat st{};
+  if (stat(segment.path.c_str(), &st) != 0) throwIo("Cannot stat", segment.path);
+  const uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+
+  mapSegment(segment, std::max<uint64_t>(fileSize, CHRONICLE_ARCHIVE_SEGMENT_SIZE));
+  segments_.push_back(segment);
+  segmentFile& current = segments_.back();
+  const unsigned char* base = static_cast<const unsigned char*>(current.map);
+
+  // Index file first, it is only trusted when its checksum holds and the segment still has the bytes it covers
+  std::ifstream indexFile(segmentPath(directory_, id, "idx"), std::ios::binary);
+  std::string index((std::istreambuf_iterator<char>(indexFile)), std::istreambuf_iterator<char>());
+
+  indexHeader header{};
+  bool indexed = index.size() >= sizeof(header) + sizeof(uint32_t);
+  if (indexed) {
+    std::memcpy(&header, index.data(), sizeof(header));
+    uint32_t storedCrc;
+    std::memcpy(&storedCrc, index.data() + index.size() - sizeof(storedCrc), sizeof(storedCrc));
+    indexed = std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+              header.covered <= fileSize &&
+              crc32(0L, reinterpret_cast<const Bytef*>(index.data()), static_cast<uInt>(index.size() - sizeof(storedCrc))) == storedCrc;
+  }
+
+  if (indexed) {
+    size_t pos = sizeof(header);
+    const size_t end = index.size() - sizeof(uint32_t);
+    std::vector<std::vector<location>*> names;
+
+    for (uint32_t i = 0; i < header.device_count && indexed; ++i) {
+      uint16_t length;
+      if (pos + sizeof(length) > end) { indexed = false; break; }
+      std::memcpy(&length, index.data() + pos, sizeof(length));
+      pos += sizeof(length);
+      if (pos + length > end) { indexed = false; break; }
+      names.push_back(&devices_[index.substr(pos, length)]);
+      pos += length;
+    }
+
+    if (indexed && pos + uint64_t(header.count) * sizeof(indexEntry) == end) {
+      for (uint32_t i = 0; i < header.count; ++i) {
+        indexEntry entry;
+        std::memcpy(&entry, index.data() + pos + i * sizeof(indexEntry), sizeof(entry));
+        if (entry.device >= names.size()) {
+          THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, "Index of " + current.path + " names an unknown device");
+        }
+        names[entry.device]->push_back({id, entry.size, entry.taken_at, entry.offset});
+      }
+      count_ += header.count;
+      current.indexed = header.covered;
+    }
+  }
+
+  // Records past the index, left by a writer that did not shut down cleanly
+  uint64_t pos = current.indexed;
+  recordHeader record;
+  while (readRecord(base, fileSize, pos, record)) {
+    std::string device(reinterpret_cast<const char*>(base + pos + sizeof(recordHeader)), record.device_length);
+    devices_[device].push_back({id, record.raw_size, record.taken_at, pos});
+    count_++;
+    pos += recordLength(record);
+  }
+  current.size = pos;
+
+  if (pos < fileSize && recover && truncate(current.path.c_str(), static_cast<off_t>(pos)) != 0) {
+    throwIo("Cannot cut the torn tail of", current.path);
+  }
+}
+
+void SnapshotArchive::startSegment() {
+  if (activeFd_ >= 0) {
+    fsync(activeFd_);
+    ::close(activeFd_);
+    activeFd_ = -1;
+    writeIndex(static_cast<uint32_t>(segments_.size() - 1));
+  }
+
+  segmentFile segment;
+  segment.path = segmentPath(directory_, static_cast<uint32_t>(segments_.size()), "chra");
+
+  activeFd_ = ::open(segment.path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+  if (activeFd_ < 0) throwIo("Cannot create", segment.path);
+
+  mapSegment(segment, CHRONICLE_ARCHIVE_SEGMENT_SIZE);
+  segments_.push_back(segment);
+}
+
+void SnapshotArchive::writeIndex(uint32_t id) {
+  segmentFile& segment = segments_[id];
+
+  std::string names;
+  std::vector<indexEntry> entries;
+  uint32_t deviceCount = 0;
+
+  for (const auto& [device, history] : devices_) {
+    bool named = false;
+    for (const auto& at : history) {
+      if (at.segment != id) continue;
+      if (!named) {
+        uint16_t length = static_cast<uint16_t>(device.size());
+        names.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        names.append(device);
+        named = true;
+        deviceCount++;
+      }
+      entries.push_back({deviceCount - 1, at.size, at.taken_at, at.offset});
+    }
+  }
+
+  indexHeader header{};
+  std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.covered = segment.size;
+  header.count = static_cast<uint32_t>(entries.size());
+  header.device_count = deviceCount;
+
+  std::string buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(names);
+  buffer.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(indexEntry));
+  uint32_t crc = static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(buffer.data()), static_cast<uInt>(buffer.size())));
+  buffer.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+
+  const std::string path = segmentPath(directory_, id, "idx");
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+  out.write(buffer.data(), buffer.size());
+  out.close();
+  if (!out) throwIo("Cannot write", tmpPath);
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) throwIo("Cannot replace", path);
+
+  segment.indexed = segment.size;
+}
+
+bool SnapshotArchive::append(const std::string& device, const std::string& hash, int64_t takenAt, std::string_view blob) {
+  if (!writable_) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_READ_ONLY, directory_);
+  }
+  if (device.size() > UINT16_MAX || hash.size() > UINT16_MAX || blob.size() > UINT32_MAX) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_IO_FAILED, "Snapshot of " + device + " does not fit an archive record");
+  }
+
+  std::unique_lock lock(mutex_);
+
+  auto existing = devices_.find(device);
+  const location* previous = nullptr;
+  if (existing != devices_.end() && !existing->second.empty()) {
+    previous = &existing->second.back();
+    if (takenAt <= previous->taken_at) return false;
+  }
+
+  recordHeader header{};
+  header.magic = RECORD_MAGIC;
+  header.device_length = static_cast<uint16_t>(device.size());
+  header.hash_length = static_cast<uint16_t>(hash.size());
+  header.taken_at = takenAt;
+  header.raw_size = static_cast<uint32_t>(blob.size());
+
+  std::string payload;
+
+  // Unchanged since the previous record, point at the record that holds the bytes
+  if (previous != nullptr) {
+    const unsigned char* base = static_cast<const unsigned char*>(segments_[previous->segment].map);
+    recordHeader last;
+    std::memcpy(&last, base + previous->offset, sizeof(last));
+    std::string_view lastHash(reinterpret_cast<const char*>(base + previous->offset + sizeof(recordHeader) + last.device_length), last.hash_length);
+
+    if (lastHash == hash) {
+      uint32_t segment = previous->segment;
+      uint64_t offset = previous->offset;
+      if (last.flags & FLAG_REFERENCE) {
+        const unsigned char* target = base + previous->offset + sizeof(recordHeader) + last.device_length + last.hash_length;
+        std::memcpy(&segment, target, sizeof(segment));
+        std::memcpy(&offset, target + sizeof(segment), sizeof(offset));
+      }
+      payload.append(reinterpret_cast<const char*>(&segment), sizeof(segment));
+      payload.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+      header.flags = FLAG_REFERENCE;
+    }
+  }
+
+  if (header.flags == 0) {
+    uLongf compressedSize = compressBound(static_cast<uLong>(blob.size()));
+    payload.resize(compressedSize);
+    if (compress2(reinterpret_cast<Bytef*>(payload.data()), &compressedSize, reinterpret_cast<const Bytef*>(blob.data()),
+                  static_cast<uLong>(blob.size()), CHRONICLE_ARCHIVE_COMPRESSION_LEVEL) == Z_OK && compressedSize < blob.size()) {
+      payload.resize(compressedSize);
+      header.flags = FLAG_DEFLATE;
+    } else {
+      payload.assign(blob);
+    }
+  }
+
+  header.stored_size = static_cast<uint32_t>(payload.size());
+
+  std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+  record.append(device);
+  record.append(hash);
+  record.append(payload);
+
+  uint32_t crc = static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(record.data() + CRC_START), static_cast<uInt>(record.size() - CRC_START)));
+  std::memcpy(record.data() + offsetof(recordHeader, crc), &crc, sizeof(crc));
+
+  if (segments_.back().size > 0 && segments_.back().size + record.size() > CHRONICLE_ARCHIVE_SEGMENT_SIZE) {
+    startSegment();
+  }
+
+  segmentFile& segment = segments_.back();
+  size_t written = 0;
+  while (written < record.size()) {
+    ssize_t n = ::write(activeFd_, record.data() + written, record.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // Drop the partial record so the next append starts at a record boundary again
+      int error = errno;
+      if (ftruncate(activeFd_, static_cast<off_t>(segment.size)) != 0) {}
+      errno = error;
+      throwIo("Cannot append to", segment.path);
+    }
+    written += static_cast<size_t>(n);
+  }
+
+  const uint64_t offset = segment.size;
+  segment.size += record.size();
+  if (segment.size > segment.mapped) mapSegment(segment, segment.size);
+
+  devices_[device].push_back({static_cast<uint32_t>(segments_.size() - 1), header.raw_size, takenAt, offset});
+  count_++;
+  return true;
+}
+
+void SnapshotArchive::flush() {
+  if (!writable_) return;
+
+  std::unique_lock lock(mutex_);
+
+  if (activeFd_ >= 0 && fsync(activeFd_) != 0) throwIo("Cannot sync", segments_.back().path);
+  for (uint32_t id = 0; id < segments_.size(); ++id) {
+    if (segments_[id].indexed < segments_[id].size) writeIndex(id);
+  }
+}
+
+std::string_view SnapshotArchive::payload(uint32_t segment, uint64_t offset, std::string& scratch) const {
+  if (segment >= segments_.size()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, "Record points at missing segment " + std::to_string(segment));
+  }
+
+  const segmentFile& file = segments_[segment];
+  const unsigned char* base = static_cast<const unsigned char*>(file.map);
+
+  recordHeader header;
+  if (!readRecord(base, file.size, offset, header)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, file.path + " at offset " + std::to_string(offset));
+  }
+
+  const unsigned char* data = base + offset + sizeof(recordHeader) + header.device_length + header.hash_length;
+
+  if (header.flags & FLAG_REFERENCE) {
+    if (header.stored_size != REFERENCE_SIZE) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, file.path + " at offset " + std::to_string(offset));
+    }
+    uint32_t targetSegment;
+    uint64_t targetOffset;
+    std::memcpy(&targetSegment, data, sizeof(targetSegment));
+    std::memcpy(&targetOffset, data + sizeof(targetSegment), sizeof(targetOffset));
+
+    // References always point at a record holding the bytes, never at another reference
+    if (targetSegment > segment || (targetSegment == segment && targetOffset >= offset)) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, file.path + " has a forward reference at offset " + std::to_string(offset));
+    }
+    return payload(targetSegment, targetOffset, scratch);
+  }
+
+  if (!(header.flags & FLAG_DEFLATE)) {
+    return std::string_view(reinterpret_cast<const char*>(data), header.stored_size);
+  }
+
+  scratch.resize(header.raw_size);
+  uLongf rawSize = header.raw_size;
+  if (uncompress(reinterpret_cast<Bytef*>(scratch.data()), &rawSize, data, header.stored_size) != Z_OK || rawSize != header.raw_size) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_ARCHIVE_CORRUPT, file.path + " does not inflate at offset " + std::to_string(offset));
+  }
+  return scratch;
+}
+
+archiveEntry SnapshotArchive::describe(const std::string& device, const location& at) const {
+  const unsigned char* base = static_cast<const unsigned char*>(segments_[at.segment].map);
+  recordHeader header;
+  std::memcpy(&header, base + at.offset, sizeof(header));
+
+  archiveEntry entry;
+  entry.device = device;
+  entry.hash.assign(reinterpret_cast<const char*>(base + at.offset + sizeof(recordHeader) + header.device_length), header.hash_length);
+  entry.taken_at = at.taken_at;
+  entry.size = at.size;
+  entry.segment = at.segment;
+  entry.offset = at.offset;
+  return entry;
+}
+
+std::vector<std::string> SnapshotArchive::devices() const {
+  std::shared_lock lock(mutex_);
+
+  std::vector<std::string> names;
+  for (const auto& entry : devices_) {
+    if (!entry.second.empty()) names.push_back(entry.first);
+  }
+  return names;
+}
+
+int64_t SnapshotArchive::latest(const std::string& device) const {
+  std::shared_lock lock(mutex_);
+
+  auto history = devices_.find(device);
+  return history == devices_.end() || history->second.empty() ? 0 : history->second.back().taken_at;
+}
+
+size_t SnapshotArchive::size() const {
+  std::shared_lock lock(mutex_);
+  return count_;
+}
+
+std::vector<archiveEntry> SnapshotArchive::entries(const std::string& device, int64_t from, int64_t to) const {
+  std::shared_lock lock(mutex_);
+
+  std::vector<archiveEntry> result;
+  auto history = devices_.find(device);
+  if (history == devices_.end()) return result;
+
+  auto first = std::lower_bound(history->second.begin(), history->second.end(), from,
+                                [](const location& at, int64_t time) { return at.taken_at < time; });
+  for (auto it = first; it != history->second.end() && it->taken_at <= to; ++it) {
+    result.push_back(describe(device, *it));
+  }
+  return result;
+}
+
+std::string SnapshotArchive::read(const archiveEntry& entry) const {
+  std::shared_lock lock(mutex_);
+
+  std::string scratch;
+  std::string_view blob = payload(entry.segment, entry.offset, scratch);
+  return blob.data() == scratch.data() ? std::move(scratch) : std::string(blob);
+}
+
+void SnapshotArchive::scan(const std::string& device, int64_t from, int64_t to,
+                           const std::function<void(const archiveEntry&, std::string_view)>& visit) const {
+  std::shared_lock lock(mutex_);
+
+  std::string scratch;
+  for (const auto& [name, history] : devices_) {
+    if (!device.empty() && name != device) continue;
+
+    auto first = std::lower_bound(history.begin(), history.end(), from,
+                                  [](const location& at, int64_t time) { return at.taken_at < time; });
+    for (auto it = first; it != history.end() && it->taken_at <= to; ++it) {
+      visit(describe(name, *it), payload(it->segment, it->offset, scratch));
+    }
+  }
+}
@@ -0,0 +1,214 @@
+#include "core/async_writer.hpp"
+#include "core/error_handler.hpp"
+#include "core/mongodb.hpp"
+#include "core/trace.hpp"
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/oid.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+namespace {
+  constexpr int MONGO_DUPLICATE_KEY = 11000;
+
+  // An _id taken on a retry is this batch's own document, stored by an earlier attempt that
+  // failed after the server took it. On the first attempt, or on another unique index, it is a
+  // real conflict and reported as a failure
+  bool isStoredCopy(const bulkWriteError& refusal, int attempt) {
+    return refusal.code == MONGO_DUPLICATE_KEY && attempt > 1 && refusal.message.find("index: _id_ ") != std::string::npos;
+  }
+
+  // An id given here instead of by the server makes a retried insert of a stored document a duplicate
+  bsoncxx::document::value withId(bsoncxx::document::value document) {
+    if (document.view()["_id"]) return document;
+
+    bsoncxx::builder::basic::document out;
+    out.append(bsoncxx::builder::basic::kvp("_id", bsoncxx::oid()));
+    for (const auto& element : document.view()) {
+      out.append(bsoncxx::builder::basic::kvp(element.key(), element.get_value()));
+    }
+    return out.extract();
+  }
+}
+
+AsyncWriter::AsyncWriter(const writerOptions& options)
+  : options_(options), db_(std::make_unique<MongoDB>()) {
+
+  if (options_.queue_capacity == 0) options_.queue_capacity = 1;
+  if (options_.batch_size == 0) options_.batch_size = 1;
+
+  db_->connect(false);
+  thread_ = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+  close();
+}
+
+void AsyncWriter::enqueue(std::unique_lock<std::mutex>& lock, const std::string& collection, bsoncxx::document::value&& document) {
+  const size_t bytes = document.view().length();
+  queue_.push_back({collection, std::move(document)});
+  queuedBytes_ += bytes;
+  enqueued_++;
+
+  // The writer only needs waking when it is idle or a batch just filled up
+  const bool wake = queue_.size() == 1 || queue_.size() == options_.batch_size || queuedBytes_ >= options_.batch_bytes;
+  lock.unlock();
+  if (wake) work_.notify_one();
+}
+
+void AsyncWriter::insert(const std::string& collection, bsoncxx::document::value document) {
+  std::unique_lock lock(mutex_);
+
+  space_.wait(lock, [&]() { return stopping_ || queue_.size() < options_.queue_capacity; });
+  if (stopping_) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_WRITER_CLOSED, "Insert into " + collection);
+  }
+
+  enqueue(lock, collection, std::move(document));
+}
+
+bool AsyncWriter::tryInsert(const std::string& collection, bsoncxx::document::value document) {
+  std::unique_lock lock(mutex_);
+
+  if (stopping_) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_WRITER_CLOSED, "Insert into " + collection);
+  }
+  if (queue_.size() >= options_.queue_capacity) {
+    stats_.rejected++;
+    return false;
+  }
+
+  enqueue(lock, collection, std::move(document));
+  return true;
+}
+
+void AsyncWriter::flush() {
+  std::unique_lock lock(mutex_);
+
+  const uint64_t target = enqueued_;
+  flushTarget_ = std::max(flushTarget_, target);
+  work_.notify_one();
+  done_.wait(lock, [&]() { return completed_ >= target; });
+
+  if (unreportedFailures_ > 0) {
+    const uint64_t failures = unreportedFailures_;
+    unreportedFailures_ = 0;
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED,
+      std::to_string(failures) + " queued documents could not be written.\nLast error: " + stats_.last_error);
+  }
+}
+
+void AsyncWriter::close() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  work_.notify_all();
+  space_.notify_all();
+
+  if (thread_.joinable()) thread_.join();
+}
+
+writerStats AsyncWriter::stats() const {
+  std::lock_guard lock(mutex_);
+
+  writerStats current = stats_;
+  current.queued = queue_.size();
+  return current;
+}
+
+void AsyncWriter::run() {
+  std::unique_lock lock(mutex_);
+
+  while (true) {
+    work_.wait(lock, [&]() { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) break;   // Stopping and drained
+
+    // Give the batch time to fill, unless it is full already or someone waits for it
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.linger_ms);
+    work_.wait_until(lock, deadline, [&]() {
+      return stopping_ || flushTarget_ > completed_ ||
+             queue_.size() >= options_.batch_size || queuedBytes_ >= options_.batch_bytes;
+    });
+
+    std::map<std::string, std::vector<bsoncxx::document::value>> batch;
+    size_t count = 0, bytes = 0;
+    while (!queue_.empty() && count < options_.batch_size) {
+      const size_t size = queue_.front().document.view().length();
+      if (count > 0 && bytes + size > options_.batch_bytes) break;
+
+      batch[queue_.front().collection].push_back(std::move(queue_.front().document));
+      queue_.pop_front();
+      queuedBytes_ -= size;
+      bytes += size;
+      count++;
+    }
+
+    lock.unlock();
+    space_.notify_all();
+
+    uint64_t written = 0, failed = 0;
+    std::string error;
+
+    for (auto& [name, documents] : batch) {
+      mongocxx::collection collection = db_->collection(name);
+      TraceSpan span("AsyncWriter::insertBatch");
+
+      for (auto& document : documents) document = withId(std::move(document));
+
+      // Each attempt sends only what is not stored or given up on yet
+      std::vector<bsoncxx::document::value> remaining = std::move(documents);
+      for (int attempt = 1; attempt <= CHRONICLE_WRITER_MAX_ATTEMPTS && !remaining.empty(); ++attempt) {
+        try {
+          const std::vector<bulkWriteError> refused = db_->insertDocumentsReport(collection, remaining);
+
+          std::vector<char> isRefused(remaining.size(), 0);
+          std::vector<bsoncxx::document::value> retry;
+          for (const auto& refusal : refused) {
+            if (refusal.index >= remaining.size() || isRefused[refusal.index]) continue;
+            isRefused[refusal.index] = 1;
+
+            if (isStoredCopy(refusal, attempt)) {
+              written++;
+            } else if (refusal.code == MONGO_DUPLICATE_KEY) {
+              // A real conflict, sending it again cannot help
+              failed++;
+              error = refusal.message;
+              span.setError();
+            } else {
+              error = refusal.message;
+              retry.push_back(std::move(remaining[refusal.index]));
+            }
+          }
+
+          written += static_cast<uint64_t>(std::count(isRefused.begin(), isRefused.end(), 0));
+          remaining = std::move(retry);
+        } catch (const ChronicleException& e) {
+          // Nothing says which documents went in, all of them go again
+          error = e.getDetails();
+        }
+
+        if (remaining.empty()) break;
+        if (attempt == CHRONICLE_WRITER_MAX_ATTEMPTS) {
+          failed += remaining.size();
+          span.setError();
+        } else {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100 * attempt));
+        }
+      }
+    }
+
+    lock.lock();
+    stats_.written += written;
+    stats_.failed += failed;
+    stats_.batches++;
+    if (!error.empty()) stats_.last_error = error;
+    unreportedFailures_ += failed;
+    completed_ += count;
+    done_.notify_all();
+  }
+}
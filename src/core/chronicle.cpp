@@ -1,20 +1,636 @@
 #include "core/chronicle.hpp"
 #include "core/ssh.hpp"
+#include "core/error_handler.hpp"
+#include "core/hash.hpp"
+#include "core/host_keys.hpp"
+#include "core/circuit_breaker.hpp"
+#include "core/normalize.hpp"
+#include "core/output_cache.hpp"
+#include "core/snapshot.hpp"
+#include "core/trace.hpp"
+#include "core/transcript.hpp"
+#include "database_handler.hpp"
 
-std::vector<std::string> getConfig(connectionInfo ci, std::vector<OperationMap> getConfig) {
-    Ssh ssh;
-    ssh_session session = ssh.startSession(ci);
-    ssh_channel channel = ssh.startChannel(session);
-    std::vector<std::string> output;
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
-    ssh.flushBanner(session, channel);
-    for (auto cmdMap : getConfig) {
-        output.clear();
-        output = ssh.executeCommand(cmdMap, session, channel);
+namespace {
+    // A sweep result goes stale, a device that was down an hour ago is tried again. Setting
+    // reachable on the connectionInfo overrides the sweep
+    Result<void> checkReachable(const connectionInfo& ci) {
+        const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        const bool recent = ci.reachable_checked_at > 0 && now - ci.reachable_checked_at < CHRONICLE_CONFIG_DEFAULT_SWEEP_MAX_AGE;
+
+        if (!ci.reachable && recent) {
+            return CHRONICLE_ERROR_LAZY(CHRONICLE_ERROR_SSH_HOST_UNREACHABLE, ([nickname = ci.nickname, host = ci.host, port = ci.port]() {
+                return nickname + " (" + host + ":" + std::to_string(port) + ")";
+            }));
+        }
+        return {};
+    }
+
+    // Runs work(0..count-1) on up to workers threads, the calling thread is one of them
+    template <typename Work>
+    void parallelFor(size_t count, int workers, Work&& work) {
+        std::atomic<size_t> next{0};
+        auto drain = [&]() {
+            for (size_t i = next++; i < count; i = next++) work(i);
+        };
+
+        const size_t threads = std::min(count, static_cast<size_t>(std::max(workers, 1)));
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t) pool.emplace_back(drain);
+        drain();
+        for (auto& thread : pool) thread.join();
+    }
+
+    // Breaker key, devices loaded from the database are tracked by nickname
+    std::string deviceKey(const connectionInfo& ci) {
+        if (!ci.nickname.empty()) return ci.nickname;
+        return ci.host + ":" + std::to_string(ci.port);
     }
 
-    ssh.closeChannel(channel);
-    ssh.endSession(session);
+    // What a session needs besides the device, a batch resolves it once for every device
+    struct sessionContext {
+        chronicleSettings settings;
+        std::shared_ptr<TranscriptReplay> replay;   // Set when the session runs against a transcript
+        std::vector<std::string> pager_prompts;     // The plugin's, answered while reading shell output
+        bool cache_output = false;                  // A configuration is always read from the device, it becomes a snapshot
+        bool every_output = false;                  // Outputs of all commands in order, otherwise only the last one's
+    };
+
+    sessionContext liveContext() {
+        sessionContext context;
+        context.settings = getChronicleSettings();
+        return context;
+    }
+
+    // Shared by the workers of a batch, every session answers the same pager prompts
+    sessionContext batchContext(const std::vector<std::string>& pagerPrompts) {
+        sessionContext context = liveContext();
+        context.pager_prompts = pagerPrompts;
+        return context;
+    }
+
+    // Optional first stage of a session, decides whether the full command map still has to run
+    struct probeStage {
+        const std::vector<OperationMap>* commands = nullptr;
+        std::function<bool(const std::vector<std::string>&)> wantConfig;
+        std::vector<std::string> output;
+        bool skipped_config = false;
+    };
+
+    Result<std::vector<std::string>> runShellOperations(const connectionInfo& ci, const std::vector<OperationMap>& operations,
+                                                        const sessionContext& context, probeStage* probe = nullptr) {
+        TraceSpan span("shell session", ci.nickname, ci.vendorName);
+        Ssh ssh(context.settings);
+        ssh.tune(ci);
+        ssh.replay(context.replay);
+
+        Result<void> paged = catchResult([&]() { ssh.pagerPrompts(context.pager_prompts); });
+        if (!paged) return paged.error();
+
+        Result<ssh_session> session = ssh.tryStartSession(ci);
+        if (!session) return session.error();
+        SshSessionGuard sessionGuard(ssh, session.value());
+
+        Result<ssh_channel> channel = ssh.tryStartChannel(session.value());
+        if (!channel) return channel.error();
+        SshChannelGuard channelGuard(ssh, channel.value());
+
+        // A command failing is rare next to a device failing to connect, it still comes as an exception
+        Result<std::vector<std::string>> output = catchResult([&]() {
+            std::vector<std::string> output;
+
+            ssh.flushBanner(session.value(), channel.value());
+
+            if (probe != nullptr && probe->commands != nullptr) {
+                // Every probe command counts, a plugin may need more than one line of state
+                for (const auto& cmdMap : *probe->commands) {
+                    std::vector<std::string> probeOutput = ssh.executeCommand(cmdMap, session.value(), channel.value());
+                    probe->output.insert(probe->output.end(), std::make_move_iterator(probeOutput.begin()),
+                                         std::make_move_iterator(probeOutput.end()));
+                }
+                probe->skipped_config = !probe->wantConfig(probe->output);
+            }
+
+            if (probe == nullptr || !probe->skipped_config) {
+                for (const auto& cmdMap : operations) {
+                    std::vector<std::string> commandOutput = ssh.executeCommand(cmdMap, session.value(), channel.value());
+                    if (!context.every_output) output.clear();
+                    output.insert(output.end(), std::make_move_iterator(commandOutput.begin()),
+                                  std::make_move_iterator(commandOutput.end()));
+                }
+            }
+
+            return output;
+        });
+
+        return output;
+    }
+
+    Result<std::vector<std::string>> runExecOperations(const connectionInfo& ci, const std::vector<OperationMap>& operations,
+                                                       const sessionContext& context, probeStage* probe = nullptr) {
+        TraceSpan span("exec session", ci.nickname, ci.vendorName);
+        Ssh ssh(context.settings);
+        ssh.tune(ci);
+        ssh.replay(context.replay);
+
+        Result<ssh_session> session = ssh.tryStartSession(ci);
+        if (!session) return session.error();
+        SshSessionGuard sessionGuard(ssh, session.value());
+
+        Result<std::vector<std::string>> output = catchResult([&]() {
+            std::vector<std::vector<std::string>> outputs;
+
+            if (probe != nullptr && probe->commands != nullptr) {
+                for (auto& probeOutput : ssh.execCommands(*probe->commands, session.value())) {
+                    probe->output.insert(probe->output.end(), std::make_move_iterator(probeOutput.begin()),
+                                         std::make_move_iterator(probeOutput.end()));
+                }
+                probe->skipped_config = !probe->wantConfig(probe->output);
+            }
+
+            if (probe == nullptr || !probe->skipped_config) {
+                outputs = ssh.execCommands(operations, session.value());
+            }
+
+            if (!context.every_output) return outputs.empty() ? std::vector<std::string>{} : std::move(outputs.back());
+
+            std::vector<std::string> output;
+            for (auto& commandOutput : outputs) {
+                output.insert(output.end(), std::make_move_iterator(commandOutput.begin()), std::make_move_iterator(commandOutput.end()));
+            }
+            return output;
+        });
+
+        return output;
+    }
+
+    // Remember the output size so the next run can pre-size its buffers. Only a hint, a failed
+    // write never costs the output that was downloaded
+    void recordOutputSize(const connectionInfo& ci, const std::vector<std::string>& output) {
+        if (ci.nickname.empty()) return;
+
+        size_t size = 0;
+        for (const auto& line : output) size += line.size() + 1;
+
+        // Small drifts are not worth a write
+        size_t previous = static_cast<size_t>(std::max(ci.last_output_size, 0));
+        if (size > previous + previous / 8 || size + previous / 8 < previous) {
+            try {
+                ChronicleDB cdb;
+                cdb.recordOutputSize(ci.nickname, static_cast<int>(std::min<size_t>(size, INT32_MAX)));
+            } catch (const std::exception&) {
+                // The next download sizes its buffers from the older hint
+            }
+        }
+    }
+
+    // Network part of a download, touches neither the database nor the host key store on disk.
+    // With cache_output set it goes through the output cache, which calls the device only when it has nothing fresh.
+    Result<std::vector<std::string>> fetchOutput(const connectionInfo& ci, const std::vector<OperationMap>& operations, int channelMode,
+                                                 const sessionContext& context) {
+        const std::string device = deviceKey(ci);
+
+        auto fetch = [&]() -> Result<std::vector<std::string>> {
+            Result<void> reachable = checkReachable(ci);
+            if (!reachable) return reachable.error();
 
+            return withDeviceRetryResult(device, [&]() {
+                if (channelMode == CHRONICLE_CHANNEL_MODE_EXEC) {
+                    return runExecOperations(ci, operations, context);
+                }
+                return runShellOperations(ci, operations, context);
+            });
+        };
+
+        if (!context.cache_output) return fetch();
+        return OutputCache::instance().fetch(device, operations, channelMode, context.pager_prompts, fetch);
+    }
+
+    Result<std::vector<std::string>> fetchConfig(const connectionInfo& ci, const deviceOperations& ops, const sessionContext& context) {
+        if (ops.pager_prompts.empty()) return fetchOutput(ci, ops.getConfig, ops.channel_mode, context);
+
+        sessionContext paged = context;
+        paged.pager_prompts = ops.pager_prompts;
+        return fetchOutput(ci, ops.getConfig, ops.channel_mode, paged);
+    }
+
+    // Same as fetchOutput but nothing escapes, for worker threads
+    Result<std::vector<std::string>> fetchOutputCaught(const connectionInfo& ci, const std::vector<OperationMap>& operations, int channelMode,
+                                                       const sessionContext& context) {
+        try {
+            return fetchOutput(ci, operations, channelMode, context);
+        } catch (const ChronicleException& e) {
+            return ChronicleError::fromException(e);
+        } catch (const std::exception& e) {
+            return CHRONICLE_ERROR(CHRONICLE_ERROR_UNKNOWN_CORE_ERROR, e.what());
+        }
+    }
+
+    configResult describeFailure(const connectionInfo& ci, const ChronicleError& error) {
+        configResult result;
+        result.device = deviceKey(ci);
+        result.code = error.code();
+        result.message = error.message();
+        result.details = error.details();
+        return result;
+    }
+}
+
+Result<std::vector<std::string>> tryGetConfig(const connectionInfo& ci, const std::vector<OperationMap>& getConfig,
+                                              const std::vector<std::string>& pagerPrompts) {
+    Result<sessionContext> context = catchResult(liveContext);
+    if (!context) return context.error();
+    context.value().pager_prompts = pagerPrompts;
+
+    Result<std::vector<std::string>> output = fetchOutput(ci, getConfig, CHRONICLE_CHANNEL_MODE_SHELL, context.value());
+    if (!output) return output;
+
+    recordOutputSize(ci, output.value());
+
+    return output;
+}
+
+Result<std::vector<std::string>> tryGetConfig(const connectionInfo& ci, const deviceOperations& ops) {
+    Result<sessionContext> context = catchResult(liveContext);
+    if (!context) return context.error();
+
+    // Compiled before connecting so a broken plugin rule fails without touching the device
+    std::unique_ptr<Normalizer> normalizer;
+    Result<void> compiled = catchResult([&]() { normalizer = std::make_unique<Normalizer>(ops.normalize); });
+    if (!compiled) return compiled.error();
+
+    Result<std::vector<std::string>> output = fetchConfig(ci, ops, context.value());
+    if (!output) return output;
+
+    recordOutputSize(ci, output.value());
+
+    normalizer->apply(output.value());
     return output;
 }
+
+std::vector<std::string> getConfig(connectionInfo ci, std::vector<OperationMap> getConfig, const std::vector<std::string>& pagerPrompts) {
+    return tryGetConfig(ci, getConfig, pagerPrompts).valueOrThrow();
+}
+
+std::vector<std::string> getConfig(connectionInfo ci, const deviceOperations& ops) {
+    return tryGetConfig(ci, ops).valueOrThrow();
+}
+
+std::vector<configResult> getConfigBatch(const std::vector<connectionInfo>& devices, const deviceOperations& ops, int workers) {
+    // Settings, plugin rules and database writes stay on this thread, the workers only talk to devices
+    const sessionContext context = batchContext(ops.pager_prompts);
+    Normalizer normalizer(ops.normalize);
+    HostKeyStore::instance().ensureLoaded();
+
+    std::vector<Result<std::vector<std::string>>> outputs(devices.size(), Result<std::vector<std::string>>(std::vector<std::string>{}));
+    parallelFor(devices.size(), workers, [&](size_t i) {
+        outputs[i] = fetchOutputCaught(devices[i], ops.getConfig, ops.channel_mode, context);
+    });
+
+    HostKeyStore::instance().tryFlush();
+
+    std::vector<configResult> results;
+    results.reserve(devices.size());
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (!outputs[i].ok()) {
+            // The only place a failure gets formatted
+            results.push_back(describeFailure(devices[i], outputs[i].error()));
+            continue;
+        }
+
+        recordOutputSize(devices[i], outputs[i].value());
+
+        configResult result;
+        result.device = deviceKey(devices[i]);
+        result.ok = true;
+        result.config = std::move(outputs[i].value());
+        normalizer.apply(result.config);
+        results.push_back(std::move(result));
+    }
+
+    return results;
+}
+
+std::vector<configResult> backupRun(FleetRun& run, const std::vector<connectionInfo>& devices, const deviceOperations& ops, int workers) {
+    // As getConfigBatch, the run's writes and the snapshots stay on this thread while the workers fetch
+    ChronicleDB cdb;
+    const sessionContext context = batchContext(ops.pager_prompts);
+    Normalizer normalizer(ops.normalize);
+    HostKeyStore::instance().ensureLoaded();
+
+    const size_t count = devices.size();
+    std::vector<Result<std::vector<std::string>>> outputs(count, Result<std::vector<std::string>>(std::vector<std::string>{}));
+
+    // A worker starts a device once its lease is written, finished devices come back through finished
+    std::mutex mutex;
+    std::condition_variable leasedChanged;
+    std::condition_variable deviceFinished;
+    size_t leased = 0;
+    bool aborted = false;
+    std::vector<size_t> finished;
+    std::vector<char> skipped(count, 0);    // Done in the run already, claim() turned them down
+    size_t handled = 0;                     // Stored, failed or skipped
+
+    std::thread fetcher([&]() {
+        parallelFor(count, workers, [&](size_t i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                leasedChanged.wait(lock, [&]() { return i < leased || aborted; });
+                if (aborted || skipped[i]) return;
+            }
+
+            outputs[i] = fetchOutputCaught(devices[i], ops.getConfig, ops.channel_mode, context);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(i);
+            }
+            deviceFinished.notify_one();
+        });
+    });
+
+    // One write leases the next window, the workers never wait on the database per device
+    auto leaseUpTo = [&](size_t end) {
+        size_t declined = 0;
+        for (size_t i = leased; i < end; ++i) {
+            if (run.claim(deviceKey(devices[i]))) continue;
+            skipped[i] = 1;
+            declined++;
+        }
+        run.flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            leased = end;
+        }
+        handled += declined;
+        leasedChanged.notify_all();
+    };
+
+    std::vector<configResult> results;
+    results.reserve(count);
+
+    try {
+        leaseUpTo(std::min(count, CHRONICLE_RUN_FLUSH_BATCH));
+
+        while (handled < count) {
+            std::vector<size_t> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                deviceFinished.wait_for(lock, std::chrono::milliseconds(CHRONICLE_RUN_FLUSH_INTERVAL_MS), [&]() { return !finished.empty(); });
+                batch.swap(finished);
+            }
+
+            for (size_t i : batch) {
+                const std::string device = deviceKey(devices[i]);
+                handled++;
+
+                Result<std::string> stored = !outputs[i].ok() ? Result<std::string>(outputs[i].error()) : catchResult([&]() {
+                    recordOutputSize(devices[i], outputs[i].value());
+                    normalizer.apply(outputs[i].value());
+                    return cdb.storeSnapshot(device, outputs[i].value(), run.id());
+                });
+                outputs[i] = std::vector<std::string>{};    // Stored, no need to hold every config until the end
+
+                if (!stored) {
+                    configResult failure = describeFailure(devices[i], stored.error());
+                    run.fail(device, failure.code, failure.message);
+                    results.push_back(std::move(failure));
+                    continue;
+                }
+
+                configResult result;
+                result.device = device;
+                result.ok = true;
+                result.hash = std::move(stored.value());
+                run.complete(device, result.hash);
+                results.push_back(std::move(result));
+            }
+
+            // Keeps half a window of leased devices ahead of the workers
+            if (leased < count && leased - handled < CHRONICLE_RUN_FLUSH_BATCH / 2) {
+                leaseUpTo(std::min(count, leased + CHRONICLE_RUN_FLUSH_BATCH));
+            } else if (run.flushDue()) {
+                HostKeyStore::instance().tryFlush();
+                run.flush();
+            }
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+        }
+        leasedChanged.notify_all();
+        fetcher.join();
+        throw;
+    }
+
+    fetcher.join();
+    HostKeyStore::instance().tryFlush();
+    run.flush();
+
+    return results;
+}
+
+fanoutResult fanOut(const std::vector<connectionInfo>& devices, const std::vector<OperationMap>& operations,
+                    const std::vector<NormalizeRule>& normalize, int channelMode, int workers,
+                    const std::vector<std::string>& pagerPrompts) {
+    sessionContext context = batchContext(pagerPrompts);
+    context.cache_output = true;
+    context.every_output = true;
+    const Normalizer normalizer(normalize);
+    HostKeyStore::instance().ensureLoaded();
+
+    // Identical outputs share one group, a fleet with a handful of distinct answers stays small
+    std::mutex groupsMutex;
+    std::unordered_map<std::string, size_t> groupByHash;
+    std::vector<fanoutGroup> groups;
+    std::vector<std::optional<ChronicleError>> errors(devices.size());
+
+    parallelFor(devices.size(), workers, [&](size_t i) {
+        Result<std::vector<std::string>> output = fetchOutputCaught(devices[i], operations, channelMode, context);
+        if (!output) {
+            errors[i] = output.error();
+            return;
+        }
+
+        normalizer.apply(output.value());
+        const std::string hash = contentHash(joinSnapshotLines(output.value()));
+
+        std::lock_guard<std::mutex> lock(groupsMutex);
+        auto [it, inserted] = groupByHash.try_emplace(hash, groups.size());
+        if (inserted) {
+            fanoutGroup group;
+            group.hash = hash;
+            group.output = std::move(output.value());
+            groups.push_back(std::move(group));
+        }
+        groups[it->second].devices.push_back(deviceKey(devices[i]));
+    });
+
+    HostKeyStore::instance().tryFlush();
+
+    fanoutResult result;
+    result.devices = devices.size();
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (errors[i]) result.failures.push_back(describeFailure(devices[i], *errors[i]));
+    }
+
+    for (auto& group : groups) {
+        std::sort(group.devices.begin(), group.devices.end());
+        group.count = group.devices.size();
+        result.succeeded += group.count;
+    }
+
+    // Most common answer first, the outliers are usually what is being looked for
+    std::sort(groups.begin(), groups.end(), [](const fanoutGroup& a, const fanoutGroup& b) {
+        return a.count != b.count ? a.count > b.count : a.hash < b.hash;
+    });
+    result.groups = std::move(groups);
+
+    return result;
+}
+
+fanoutResult fanOutByName(const std::vector<std::string>& nicknames, const std::vector<OperationMap>& operations,
+                          const std::vector<NormalizeRule>& normalize, int channelMode, int workers,
+                          const std::vector<std::string>& pagerPrompts) {
+    // One query for the whole inventory instead of one per device
+    std::unordered_map<std::string, connectionInfo> inventory;
+    for (auto& ci : getAllConnectionInfo()) {
+        std::string nickname = ci.nickname;
+        inventory.emplace(std::move(nickname), std::move(ci));
+    }
+
+    std::vector<connectionInfo> devices;
+    std::vector<configResult> unknown;
+    for (const auto& nickname : nicknames) {
+        auto it = inventory.find(nickname);
+        if (it != inventory.end()) {
+            devices.push_back(it->second);
+            continue;
+        }
+
+        configResult missing;
+        missing.device = nickname;
+        missing.code = CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT;
+        missing.message = getErrorMsg(missing.code);
+        missing.details = nickname;
+        unknown.push_back(std::move(missing));
+    }
+
+    fanoutResult result = fanOut(devices, operations, normalize, channelMode, workers, pagerPrompts);
+    result.devices += unknown.size();
+    result.failures.insert(result.failures.end(), std::make_move_iterator(unknown.begin()), std::make_move_iterator(unknown.end()));
+
+    return result;
+}
+
+namespace {
+    std::vector<std::string> replayOperations(const std::string& transcriptPath, const std::vector<OperationMap>& operations,
+                                              const std::vector<std::string>& pagerPrompts, bool realtime) {
+        // A replay must not need the database, it runs with the default timeouts
+        sessionContext context;
+        context.pager_prompts = pagerPrompts;
+        context.replay = std::make_shared<TranscriptReplay>(Transcript(transcriptPath), realtime);
+        const Transcript& transcript = context.replay->transcript();
+
+        connectionInfo ci;
+        ci.nickname = transcript.nickname();
+        ci.vendorName = transcript.vendor();
+        ci.deviceName = transcript.device();
+
+        // The recording tells the session kind, an exec one replays through its own channels
+        if (transcript.exec()) return runExecOperations(ci, operations, context).valueOrThrow();
+        return runShellOperations(ci, operations, context).valueOrThrow();
+    }
+}
+
+std::vector<std::string> replayConfig(const std::string& transcriptPath, std::vector<OperationMap> getConfig, bool realtime,
+                                      const std::vector<std::string>& pagerPrompts) {
+    return replayOperations(transcriptPath, getConfig, pagerPrompts, realtime);
+}
+
+std::vector<std::string> replayConfig(const std::string& transcriptPath, const deviceOperations& ops, bool realtime) {
+    Normalizer normalizer(ops.normalize);
+
+    std::vector<std::string> output = replayOperations(transcriptPath, ops.getConfig, ops.pager_prompts, realtime);
+
+    normalizer.apply(output);
+    return output;
+}
+
+configCheck getConfigIfChanged(connectionInfo ci, const deviceOperations& ops) {
+    checkReachable(ci).valueOrThrow();
+
+    sessionContext context = liveContext();
+    context.pager_prompts = ops.pager_prompts;
+    Normalizer normalizer(ops.normalize);
+    configCheck check;
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    const bool expired = ci.change_probe_full_at <= 0 || now - ci.change_probe_full_at >= ops.probe_max_age;
+
+    probeStage probe;
+    if (!ops.changeProbe.empty()) {
+        probe.commands = &ops.changeProbe;
+        probe.wantConfig = [&](const std::vector<std::string>& output) {
+            check.probe = joinSnapshotLines(output);
+            return expired || ci.change_probe.empty() || check.probe != ci.change_probe;
+        };
+    }
+
+    std::vector<std::string> output = withDeviceRetryResult(deviceKey(ci), [&]() {
+        probe.output.clear();
+        probe.skipped_config = false;
+
+        if (ops.channel_mode == CHRONICLE_CHANNEL_MODE_EXEC) {
+            return runExecOperations(ci, ops.getConfig, context, &probe);
+        }
+        return runShellOperations(ci, ops.getConfig, context, &probe);
+    }).valueOrThrow();
+
+    check.probed = probe.commands != nullptr;
+    check.changed = !probe.skipped_config;
+
+    if (!check.changed) {
+        return check;
+    }
+
+    recordOutputSize(ci, output);
+    normalizer.apply(output);
+    check.config = std::move(output);
+
+    // The stored probe always describes the last config that was actually downloaded
+    if (check.probed && !ci.nickname.empty()) {
+        ChronicleDB cdb;
+        cdb.recordChangeProbe(ci.nickname, check.probe);
+    }
+
+    return check;
+}
+
+std::vector<reachabilityResult> sweepReachability(int timeoutMs, int maxInFlight) {
+    return sweepReachability(getAllConnectionInfo(), timeoutMs, maxInFlight);
+}
+
+std::vector<reachabilityResult> sweepReachability(const std::vector<connectionInfo>& devices, int timeoutMs, int maxInFlight) {
+    std::vector<reachabilityResult> results = probeReachability(devices, timeoutMs, maxInFlight);
+
+    ChronicleDB cdb;
+    cdb.updateReachability(results);
+
+    return results;
+}
@@ -0,0 +1,124 @@
+#include "core/circuit_breaker.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+  int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+}
+
+retryPolicy getRetryPolicy(int error_code) {
+  switch (error_code) {
+    // Transient transport errors, worth a few spaced out attempts
+    case CHRONICLE_ERROR_SSH_CONNECTION_FAILED: return {3, 1000, 8000};
+    case CHRONICLE_ERROR_SSH_CLOSED_REMOTE:     return {2, 2000, 8000};
+    case CHRONICLE_ERROR_SSH_UNKNOWN:           return {2, 2000, 8000};
+
+    // Handshake failures rarely fix themselves
+    case CHRONICLE_ERROR_SSH_SESSION_FAILED:    return {2, 5000, 5000};
+
+    // Never retried, every attempt counts against the account on the AAA server and a
+    // changed host key stays changed
+    case CHRONICLE_ERROR_SSH_AUTH_FAILED:       return {0, 0, 0};
+    case CHRONICLE_ERROR_SSH_HOST_KEY_MISMATCH: return {0, 0, 0};
+
+    default: return {1, 0, 0};
+  }
+}
+
+bool isDeviceFailure(int error_code) {
+  switch (error_code) {
+    case CHRONICLE_ERROR_SSH_UNKNOWN:
+    case CHRONICLE_ERROR_SSH_CLOSED_REMOTE:
+    case CHRONICLE_ERROR_SSH_SESSION_FAILED:
+    case CHRONICLE_ERROR_SSH_CONNECTION_FAILED:
+    case CHRONICLE_ERROR_SSH_AUTH_FAILED:
+    case CHRONICLE_ERROR_SSH_HOST_KEY_MISMATCH:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int getBackoffDelay(const retryPolicy& policy, int attempt) {
+  thread_local std::mt19937 rng{std::random_device{}()};
+
+  int64_t ceiling = policy.base_delay_ms;
+  for (int i = 1; i < attempt && ceiling < policy.max_delay_ms; ++i) {
+    ceiling *= 2;
+  }
+  ceiling = std::min<int64_t>(ceiling, policy.max_delay_ms);
+
+  // Full jitter, so workers retrying the same site spread out
+  std::uniform_int_distribution<int64_t> jitter(0, ceiling);
+  return static_cast<int>(jitter(rng));
+}
+
+CircuitBreaker& CircuitBreaker::instance() {
+  static CircuitBreaker breaker;
+  return breaker;
+}
+
+bool CircuitBreaker::allowRequest(const std::string& device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = devices_.find(device);
+  if (it == devices_.end()) return true;
+
+  deviceHealth& health = it->second;
+  switch (health.state) {
+    case CHRONICLE_CIRCUIT_CLOSED:
+      return true;
+    case CHRONICLE_CIRCUIT_OPEN:
+      if (nowMs() < health.open_until_ms) return false;
+      health.state = CHRONICLE_CIRCUIT_HALF_OPEN;
+      return true;
+    default:
+      // A probe is already in flight
+      return false;
+  }
+}
+
+void CircuitBreaker::recordSuccess(const std::string& device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = devices_.find(device);
+  if (it == devices_.end()) return;
+
+  it->second = deviceHealth{};
+}
+
+void CircuitBreaker::recordFailure(const std::string& device, int error_code) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  deviceHealth& health = devices_[device];
+  health.consecutive_failures++;
+  health.last_error = error_code;
+
+  if (health.state == CHRONICLE_CIRCUIT_HALF_OPEN) {
+    // Failed probe, stay away for longer
+    health.cooldown_ms = std::min(health.cooldown_ms * 2, CHRONICLE_CONFIG_DEFAULT_BREAKER_MAX_COOLDOWN);
+    health.state = CHRONICLE_CIRCUIT_OPEN;
+    health.open_until_ms = nowMs() + health.cooldown_ms;
+  } else if (health.consecutive_failures >= CHRONICLE_CONFIG_DEFAULT_BREAKER_THRESHOLD) {
+    health.state = CHRONICLE_CIRCUIT_OPEN;
+    health.open_until_ms = nowMs() + health.cooldown_ms;
+  }
+}
+
+deviceHealth CircuitBreaker::getHealth(const std::string& device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = devices_.find(device);
+  if (it == devices_.end()) return deviceHealth{};
+
+  return it->second;
+}
+
+void CircuitBreaker::reset(const std::string& device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  devices_.erase(device);
+}
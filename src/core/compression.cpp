@@ -0,0 +1,184 @@
+#include "core/compression.hpp"
+#include "core/error_handler.hpp"
+#include "core/synthetic.hpp"
+
+#include <chrono>
+#include <memory>
+
+#include <zdict.h>
+#include <zstd.h>
+
+namespace {
+  // Contexts are expensive to set up and not thread safe, every thread keeps its own
+  ZSTD_CCtx* compressionContext() {
+    thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    return context.get();
+  }
+}
+
+CompressionDictionary::CompressionDictionary(std::string id, std::string bytes, int level)
+  : id_(std::move(id)), bytes_(std::move(bytes)) {
+
+  cdict_ = ZSTD_createCDict(bytes_.data(), bytes_.size(), level);
+  ddict_ = ZSTD_createDDict(bytes_.data(), bytes_.size());
+
+  if (cdict_ == nullptr || ddict_ == nullptr) {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DICTIONARY_FAILED, "Dictionary " + id_ + " could not be loaded");
+  }
+}
+
+CompressionDictionary::~CompressionDictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+BlobDecompressor::BlobDecompressor(const CompressionDictionary* dictionary) {
+  dctx_ = ZSTD_createDCtx();
+  if (dctx_ == nullptr) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DECOMPRESSION_FAILED, "Out of memory for a decompression context");
+  }
+
+  if (dictionary != nullptr) {
+    size_t result = ZSTD_DCtx_refDDict(dctx_, dictionary->decompressor());
+    if (ZSTD_isError(result)) {
+      ZSTD_freeDCtx(dctx_);
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DECOMPRESSION_FAILED, ZSTD_getErrorName(result));
+    }
+  }
+}
+
+BlobDecompressor::~BlobDecompressor() {
+  ZSTD_freeDCtx(dctx_);
+}
+
+void BlobDecompressor::feed(std::string_view input, std::string& output) {
+  ZSTD_inBuffer in{input.data(), input.size(), 0};
+  const size_t step = ZSTD_DStreamOutSize();
+
+  while (in.pos < in.size) {
+    const size_t start = output.size();
+    output.resize(start + step);
+
+    ZSTD_outBuffer out{output.data() + start, step, 0};
+    size_t result = ZSTD_decompressStream(dctx_, &out, &in);
+    output.resize(start + out.pos);
+
+    if (ZSTD_isError(result)) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DECOMPRESSION_FAILED, ZSTD_getErrorName(result));
+    }
+    complete_ = result == 0;
+  }
+
+  // Output still buffered in the context after the last input byte
+  while (!complete_) {
+    const size_t start = output.size();
+    output.resize(start + step);
+
+    ZSTD_outBuffer out{output.data() + start, step, 0};
+    size_t result = ZSTD_decompressStream(dctx_, &out, &in);
+    output.resize(start + out.pos);
+
+    if (ZSTD_isError(result)) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DECOMPRESSION_FAILED, ZSTD_getErrorName(result));
+    }
+    complete_ = result == 0;
+    if (out.pos < step) break;   // Needs more input
+  }
+}
+
+void BlobDecompressor::finish() const {
+  if (!complete_) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DECOMPRESSION_FAILED, "Compressed blob ends in the middle of a frame");
+  }
+}
+
+std::string trainDictionary(const std::vector<std::string>& samples, size_t capacity) {
+  if (samples.size() < CHRONICLE_DICTIONARY_MIN_SAMPLES) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DICTIONARY_FAILED,
+      "Need at least " + std::to_string(CHRONICLE_DICTIONARY_MIN_SAMPLES) + " samples, got " + std::to_string(samples.size()));
+  }
+
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const auto& sample : samples) {
+    buffer.append(sample);
+    sizes.push_back(sample.size());
+  }
+
+  std::string dictionary(capacity, '\0');
+  size_t result = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), buffer.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(result)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_DICTIONARY_FAILED, ZDICT_getErrorName(result));
+  }
+
+  dictionary.resize(result);
+  return dictionary;
+}
+
+std::string compressBlob(std::string_view data, const CompressionDictionary* dictionary, int level) {
+  std::string compressed(ZSTD_compressBound(data.size()), '\0');
+
+  size_t result = dictionary != nullptr
+    ? ZSTD_compress_usingCDict(compressionContext(), compressed.data(), compressed.size(), data.data(), data.size(), dictionary->compressor())
+    : ZSTD_compressCCtx(compressionContext(), compressed.data(), compressed.size(), data.data(), data.size(), level);
+
+  if (ZSTD_isError(result)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_COMPRESSION_FAILED, ZSTD_getErrorName(result));
+  }
+
+  compressed.resize(result);
+  return compressed;
+}
+
+std::string decompressBlob(std::string_view data, const CompressionDictionary* dictionary) {
+  BlobDecompressor decompressor(dictionary);
+  std::string output;
+  decompressor.feed(data, output);
+  decompressor.finish();
+  return output;
+}
+
+std::vector<compressionBenchmark> benchmarkCompression(const std::vector<std::string>& samples, int level) {
+  // Every other sample trains the dictionary, the rest are measured so the dictionary has not seen them
+  std::vector<std::string> training, measured;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    (i % 2 == 0 ? training : measured).push_back(samples[i]);
+  }
+  if (measured.empty()) measured = training;
+
+  CompressionDictionary dictionary("benchmark", trainDictionary(training), level);
+
+  std::vector<compressionBenchmark> results;
+  for (const char* codec : {"none", "zstd", "zstd+dict"}) {
+    compressionBenchmark run;
+    run.codec = codec;
+    const std::string name = codec;
+    const CompressionDictionary* dict = name == "zstd+dict" ? &dictionary : nullptr;
+
+    std::vector<std::string> stored;
+    stored.reserve(measured.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& sample : measured) {
+      stored.push_back(name == "none" ? sample : compressBlob(sample, dict, level));
+      run.raw_bytes += sample.size();
+      run.stored_bytes += stored.back().size();
+    }
+    run.compress_mb_s = megabytesPerSecond(run.raw_bytes, std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    size_t restored = 0;
+    for (const auto& blob : stored) {
+      restored += name == "none" ? std::string(blob).size() : decompressBlob(blob, dict).size();
+    }
+    run.decompress_mb_s = megabytesPerSecond(restored, std::chrono::steady_clock::now() - start);
+
+    run.ratio = run.stored_bytes > 0 ? static_cast<double>(run.raw_bytes) / static_cast<double>(run.stored_bytes) : 1.0;
+    results.push_back(run);
+  }
+
+  return results;
+}
@@ -1,6 +1,8 @@
 #include "core/config.hpp"
 #include "database_handler.hpp"
 #include "core/error_handler.hpp"
+#include "core/trace.hpp"
+#include <chrono>
 #include <unordered_map>
 #include "core/device_factory.hpp"
 
@@ -45,35 +47,92 @@ int connectionInfo::getDeviceId(int vendor_id, const std::string& device_name) c
     return (deviceIt != deviceMap.end()) ? deviceIt->second : 0;
 }
 
+namespace {
+  connectionInfo connectionInfoFromBson(const bsoncxx::document::view& deviceSettings) {
+    connectionInfo ci;
+
+    const auto& ssh = deviceSettings["ssh"].get_document().view();
+    const auto& device = deviceSettings["device"].get_document().view();
+
+    /* Initialize */
+    std::string vendorName = std::string(device["vendorName"].get_string().value);
+    std::string deviceName = std::string(device["deviceName"].get_string().value);
+
+    ci.nickname           = std::string(device["name"].get_string().value);
+    ci.vendorName         = vendorName;
+    ci.deviceName         = deviceName;
+    ci.vendor             = ci.getVendorId(vendorName);
+    ci.device             = ci.getDeviceId(ci.vendor, deviceName);
+    ci.user               = std::string(ssh["user"].get_string().value);
+    ci.password           = std::string(ssh["password"].get_string().value);
+    ci.host               = std::string(ssh["host"].get_string().value);
+    ci.port               = ssh["port"].get_int32();
+    ci.verbosity          = ssh["verbosity"].get_int32();
+    ci.kex_methods        = std::string(ssh["kexMethods"].get_string().value);
+    ci.hostkey_algorithms = std::string(ssh["hostkeyAlgorithms"].get_string().value);
+
+    // Devices never swept are assumed reachable
+    const auto& reachability = deviceSettings["reachability"];
+    if (reachability) {
+      const auto& sweep = reachability.get_document().view();
+      ci.reachable = sweep["reachable"].get_bool();
+      if (sweep["checkedAt"]) {
+        ci.reachable_checked_at = std::chrono::duration_cast<std::chrono::seconds>(sweep["checkedAt"].get_date().value).count();
+      }
+    }
+
+    // Devices added before transport tuning existed keep the defaults
+    const auto& transport = deviceSettings["transport"];
+    if (transport) {
+      const auto& tuning = transport.get_document().view();
+      if (tuning["compression"])      ci.compression       = tuning["compression"].get_bool();
+      if (tuning["compressionLevel"]) ci.compression_level = tuning["compressionLevel"].get_int32();
+      if (tuning["readBufferSize"])   ci.read_buffer_size  = tuning["readBufferSize"].get_int32();
+      if (tuning["lastOutputSize"])   ci.last_output_size  = tuning["lastOutputSize"].get_int32();
+    }
+
+    const auto& changeProbe = deviceSettings["changeProbe"];
+    if (changeProbe) {
+      const auto& probe = changeProbe.get_document().view();
+      ci.change_probe = std::string(probe["value"].get_string().value);
+      ci.change_probe_full_at = std::chrono::duration_cast<std::chrono::seconds>(probe["fullAt"].get_date().value).count();
+    }
+
+    return ci;
+  }
+}
+
 connectionInfo getConnectionInfo(const std::string& deviceNickname) {
-  connectionInfo ci;
+  TraceSpan span("getConnectionInfo", deviceNickname);
 
   /* Fetch device settings */
   ChronicleDB cdb;
 
   const auto& deviceSettings = cdb.getDeviceBson(deviceNickname);
-  const auto& ssh = deviceSettings["ssh"].get_document().view();
-  const auto& device = deviceSettings["device"].get_document().view();
-
-  /* Initialize */
-  std::string vendorName = std::string(device["vendorName"].get_string().value);
-  std::string deviceName = std::string(device["deviceName"].get_string().value);
-
-  ci.vendorName         = vendorName;
-  ci.deviceName         = deviceName;
-  ci.vendor             = ci.getVendorId(vendorName);
-  ci.device             = ci.getDeviceId(ci.vendor, deviceName);
-  ci.user               = std::string(ssh["user"].get_string().value);
-  ci.password           = std::string(ssh["password"].get_string().value);
-  ci.host               = std::string(ssh["host"].get_string().value);
-  ci.port               = ssh["port"].get_int32();
-  ci.verbosity          = ssh["verbosity"].get_int32();
-  ci.kex_methods        = std::string(ssh["kexMethods"].get_string().value);
-  ci.hostkey_algorithms = std::string(ssh["hostkeyAlgorithms"].get_string().value);
 
+  connectionInfo ci = connectionInfoFromBson(deviceSettings.view());
+  span.setDevice(ci.nickname, ci.vendorName);
   return ci;
 }
 
+std::vector<connectionInfo> getAllConnectionInfo() {
+  TraceSpan span("getAllConnectionInfo");
+
+  /* Fetch every device in one query */
+  ChronicleDB cdb;
+
+  const auto& devices = cdb.getDevicesBson();
+
+  std::vector<connectionInfo> inventory;
+  inventory.reserve(devices.size());
+
+  for (const auto& deviceSettings : devices) {
+    inventory.push_back(connectionInfoFromBson(deviceSettings.view()));
+  }
+
+  return inventory;
+}
+
 chronicleSettings getChronicleSettings() {
   chronicleSettings cs;
 
@@ -86,5 +145,10 @@ chronicleSettings getChronicleSettings() {
   cs.ssh_idle_timeout   = ssh["sshIdleTimeout"].get_int32();
   cs.ssh_total_timeout  = ssh["sshTotalTimeout"].get_int32();
 
+  // Settings written before these existed fall back to the defaults
+  if (ssh["sshConnectTimeout"])   cs.ssh_connect_timeout   = ssh["sshConnectTimeout"].get_int32();
+  if (ssh["sshHandshakeTimeout"]) cs.ssh_handshake_timeout = ssh["sshHandshakeTimeout"].get_int32();
+  if (ssh["sshAuthTimeout"])      cs.ssh_auth_timeout      = ssh["sshAuthTimeout"].get_int32();
+
   return cs;
 }
@@ -0,0 +1,253 @@
+#include "core/config_tree.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+  std::string_view trim(std::string_view text) {
+    size_t start = 0;
+    while (start < text.size() && (text[start] == ' ' || text[start] == '\t')) start++;
+    size_t end = text.size();
+    while (end > start && (text[end - 1] == ' ' || text[end - 1] == '\t' || text[end - 1] == '\r')) end--;
+    return text.substr(start, end - start);
+  }
+
+  size_t indentOf(std::string_view line) {
+    size_t indent = 0;
+    while (indent < line.size() && (line[indent] == ' ' || line[indent] == '\t')) indent++;
+    return indent;
+  }
+
+  bool isJunosComment(std::string_view trimmed) {
+    return trimmed.compare(0, 1, "#") == 0 || trimmed.compare(0, 2, "/*") == 0;
+  }
+
+  // Matches the pattern against a run of whole words at the start of text. Only the last '*' is
+  // ever backtracked, an earlier one taking more text never helps, so a pattern full of stars
+  // costs at most pattern * text steps
+  bool globPrefix(std::string_view pattern, std::string_view text) {
+    size_t pi = 0;
+    size_t ti = 0;
+    size_t star = std::string_view::npos;
+    size_t starText = 0;
+
+    while (true) {
+      if (pi < pattern.size() && pattern[pi] == '*') {
+        while (pi < pattern.size() && pattern[pi] == '*') pi++;
+        star = pi;
+        starText = ti;
+        continue;
+      }
+
+      if (pi == pattern.size()) {
+        if (ti == text.size() || text[ti] == ' ') return true;
+      } else if (ti < text.size() && (pattern[pi] == '?' || pattern[pi] == text[ti])) {
+        pi++;
+        ti++;
+        continue;
+      }
+
+      if (star == std::string_view::npos || starText == text.size()) return false;
+      pi = star;
+      ti = ++starText;
+    }
+  }
+
+  void appendChild(configNode* parent, configNode* child) {
+    child->parent = parent;
+    child->depth = parent->depth + 1;
+
+    if (parent->last_child == nullptr) {
+      parent->first_child = child;
+    } else {
+      parent->last_child->next_sibling = child;
+    }
+    parent->last_child = child;
+  }
+}
+
+ConfigTree::ConfigTree(std::string_view text) {
+  length_ = text.size();
+  buffer_ = std::make_unique<char[]>(length_ + 1);
+  std::memcpy(buffer_.get(), text.data(), length_);
+  buffer_[length_] = '\0';
+  parse();
+}
+
+ConfigTree::ConfigTree(const std::vector<std::string>& lines) {
+  for (const auto& line : lines) length_ += line.size() + 1;
+  buffer_ = std::make_unique<char[]>(length_ + 1);
+
+  char* out = buffer_.get();
+  for (const auto& line : lines) {
+    std::memcpy(out, line.data(), line.size());
+    out += line.size();
+    *out++ = '\n';
+  }
+  buffer_[length_] = '\0';
+  parse();
+}
+
+void ConfigTree::parse() {
+  const std::string_view text(buffer_.get(), length_);
+
+  // One node per line at most, plus the root
+  size_t lines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+  nodes_ = std::make_unique<configNode[]>(lines + 1);
+  count_ = 1;
+
+  std::vector<std::string_view> source;
+  source.reserve(lines);
+  for (size_t start = 0; start <= text.size();) {
+    size_t eol = text.find('\n', start);
+    if (eol == std::string_view::npos) eol = text.size();
+    source.push_back(text.substr(start, eol - start));
+    start = eol + 1;
+  }
+
+  // Braces only when every block a line opens is closed by a "}" line, an IOS banner or script
+  // line that happens to end in "{" leaves the configuration indented
+  long depth = 0;
+  bool opened = false;
+  for (const auto& line : source) {
+    std::string_view trimmed = trim(line);
+    if (trimmed.empty() || isJunosComment(trimmed)) continue;
+
+    if (trimmed.back() == '{') {
+      depth++;
+      opened = true;
+    } else if ((trimmed == "}" || trimmed == "};") && --depth < 0) {
+      break;
+    }
+  }
+  braces_ = opened && depth == 0;
+
+  configNode* root = &nodes_[0];
+  std::vector<std::pair<size_t, configNode*>> stack;
+
+  for (size_t i = 0; i < source.size(); ++i) {
+    std::string_view trimmed = trim(source[i]);
+    if (trimmed.empty()) continue;
+
+    if (braces_) {
+      if (isJunosComment(trimmed)) continue;
+
+      if (trimmed == "}" || trimmed == "};") {
+        if (!stack.empty()) stack.pop_back();
+        continue;
+      }
+
+      // Trailing "## SECRET-DATA" style annotations are not part of the statement
+      size_t annotation = trimmed.find("; ##");
+      if (annotation != std::string_view::npos) trimmed = trimmed.substr(0, annotation + 1);
+
+      bool opens = trimmed.back() == '{';
+      if (opens || trimmed.back() == ';') trimmed = trim(trimmed.substr(0, trimmed.size() - 1));
+
+      configNode* node = &nodes_[count_++];
+      node->text = trimmed;
+      node->line = static_cast<uint32_t>(i);
+      appendChild(stack.empty() ? root : stack.back().second, node);
+
+      if (opens) stack.emplace_back(0, node);
+    } else {
+      // IOS "!" separators close nothing on their own, indentation decides
+      if (trimmed.front() == '!') continue;
+
+      size_t indent = indentOf(source[i]);
+      while (!stack.empty() && stack.back().first >= indent) stack.pop_back();
+
+      configNode* node = &nodes_[count_++];
+      node->text = trimmed;
+      node->line = static_cast<uint32_t>(i);
+      appendChild(stack.empty() ? root : stack.back().second, node);
+
+      stack.emplace_back(indent, node);
+    }
+  }
+}
+
+std::vector<const configNode*> ConfigTree::query(std::string_view path) const {
+  return query(root(), path);
+}
+
+std::vector<const configNode*> ConfigTree::query(const configNode* from, std::string_view path) {
+  std::vector<const configNode*> current{from};
+  bool anyDepth = false;
+  bool lastAnyDepth = false;
+
+  size_t start = 0;
+  while (start <= path.size()) {
+    size_t slash = path.find('/', start);
+    if (slash == std::string_view::npos) slash = path.size();
+    std::string_view segment = trim(path.substr(start, slash - start));
+    start = slash + 1;
+
+    if (segment.empty()) continue;
+
+    // "**/**" selects what a single "**" does
+    if (segment == "**" && lastAnyDepth) continue;
+    lastAnyDepth = segment == "**";
+
+    std::vector<const configNode*> next;
+
+    if (segment == "**") {
+      // Every node below the current ones, the current ones included. A node under two of them
+      // is walked once, the second walk would only find the same subtree again
+      std::unordered_set<const configNode*> visited;
+      for (const configNode* node : current) {
+        std::vector<const configNode*> pending{node};
+        while (!pending.empty()) {
+          const configNode* visit = pending.back();
+          pending.pop_back();
+          if (!visited.insert(visit).second) continue;
+          next.push_back(visit);
+          for (const configNode* child = visit->first_child; child != nullptr; child = child->next_sibling) {
+            pending.push_back(child);
+          }
+        }
+      }
+      anyDepth = true;
+    } else {
+      for (const configNode* node : current) {
+        for (const configNode* child = node->first_child; child != nullptr; child = child->next_sibling) {
+          if (globPrefix(segment, child->text)) next.push_back(child);
+        }
+      }
+    }
+
+    // Nodes sit in the block in source order, so sorting by address restores document order
+    if (anyDepth) {
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+    }
+
+    current = std::move(next);
+    if (current.empty()) break;
+  }
+
+  // The root is not a line of the configuration
+  current.erase(std::remove_if(current.begin(), current.end(), [](const configNode* node) { return node->depth == 0; }), current.end());
+  return current;
+}
+
+std::vector<const configNode*> childrenOf(const configNode* node) {
+  std::vector<const configNode*> children;
+  for (const configNode* child = node->first_child; child != nullptr; child = child->next_sibling) {
+    children.push_back(child);
+  }
+  return children;
+}
+
+std::string nodePath(const configNode* node) {
+  std::vector<std::string_view> parts;
+  for (; node != nullptr && node->depth > 0; node = node->parent) parts.push_back(node->text);
+
+  std::string path;
+  for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+    if (!path.empty()) path += " > ";
+    path.append(it->data(), it->size());
+  }
+  return path;
+}
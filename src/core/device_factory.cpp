@@ -9,3 +9,16 @@ void deviceOperations::pushCommand(std::vector<OperationMap>& operation, const s
 
     operation.push_back(opMap);
 }
+
+void deviceOperations::pushNormalizeRule(int kind, const std::string& pattern, const std::string& replacement) {
+    NormalizeRule rule;
+    rule.kind = kind;
+    rule.pattern = pattern;
+    rule.replacement = replacement;
+
+    normalize.push_back(rule);
+}
+
+void deviceOperations::pushPagerPrompt(const std::string& pattern) {
+    pager_prompts.push_back(pattern);
+}
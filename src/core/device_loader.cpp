@@ -0,0 +1,42 @@
+#include "core/device_loader.hpp"
+#include "core/error_handler.hpp"
+#include "core/trace.hpp"
+
+#include <dlfcn.h>
+
+DeviceHandle::~DeviceHandle() {
+    if (ops) delete ops;
+    if (handle) dlclose(handle);
+}
+
+std::shared_ptr<DeviceHandle> loadDeviceOps(const std::string& so_path, int device_id, int vendor_id) {
+    TraceSpan span("loadDeviceOps");
+
+    void* handle = dlopen(so_path.c_str(), RTLD_NOW);
+    if (!handle) THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_LOAD_DEVICE_MAP_FAILED, std::string("dlopen failed: ") + dlerror());
+
+    using CreateFunc = deviceOperations* (*)(int, int);
+    auto create_fn = (CreateFunc)dlsym(handle, "createDeviceOperations");
+    if (!create_fn) {
+        dlclose(handle);
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_LOAD_DEVICE_MAP_FAILED, "dlsym failed: " + so_path);
+    }
+
+    deviceOperations* ops = nullptr;
+    try {
+        ops = create_fn(device_id, vendor_id);
+    } catch (...) {
+        dlclose(handle);
+        throw;
+    }
+    if (!ops) {
+        dlclose(handle);
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_LOAD_DEVICE_MAP_FAILED, "Device did not return valid operations");
+    }
+
+    return std::make_shared<DeviceHandle>(handle, ops);
+}
+
+std::string devicePluginPath(const std::string& directory, const std::string& vendorName, const std::string& deviceName) {
+    return directory + "/" + vendorName + "/" + deviceName + CHRONICLE_DEVICE_PLUGIN_EXTENSION;
+}
@@ -0,0 +1,417 @@
+#include "core/diff.hpp"
+#include "core/hash.hpp"
+#include "core/synthetic.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+  struct lineHash {
+    size_t operator()(std::string_view line) const { return static_cast<size_t>(xxh64(line)); }
+  };
+
+  struct lineEdit {
+    int kind;
+    size_t old_index;
+    size_t new_index;
+  };
+
+  // Maps every distinct line to a small integer so the diff compares ints instead of strings
+  void internLines(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines,
+                   std::vector<int>& old_ids, std::vector<int>& new_ids) {
+    std::unordered_map<std::string_view, int, lineHash> ids;
+    ids.reserve(old_lines.size() + new_lines.size());
+
+    auto intern = [&](const std::string& line) {
+      auto inserted = ids.emplace(line, static_cast<int>(ids.size()));
+      return inserted.first->second;
+    };
+
+    old_ids.reserve(old_lines.size());
+    for (const auto& line : old_lines) old_ids.push_back(intern(line));
+
+    new_ids.reserve(new_lines.size());
+    for (const auto& line : new_lines) new_ids.push_back(intern(line));
+  }
+
+  /*
+    Myers' linear space refinement: find the middle snake of the optimal path, split there and recurse.
+    Only the deleted/inserted flags are kept, the edit script is rebuilt from them afterwards.
+  */
+  class Myers {
+    public:
+      Myers(const std::vector<int>& a, const std::vector<int>& b)
+        : a_(a), b_(b), deleted_(a.size(), 0), inserted_(b.size(), 0) {
+        size_t diagonals = a.size() + b.size() + 3;
+        forward_.resize(diagonals);
+        backward_.resize(diagonals);
+        offset_ = static_cast<long>(b.size()) + 1;
+      }
+
+      void run() {
+        compare(0, static_cast<long>(a_.size()), 0, static_cast<long>(b_.size()));
+      }
+
+      const std::vector<char>& deleted() const { return deleted_; }
+      const std::vector<char>& inserted() const { return inserted_; }
+
+    private:
+      long& fd(long diagonal) { return forward_[diagonal + offset_]; }
+      long& bd(long diagonal) { return backward_[diagonal + offset_]; }
+
+      void compare(long xoff, long xlim, long yoff, long ylim) {
+        while (xoff < xlim && yoff < ylim && a_[xoff] == b_[yoff]) { xoff++; yoff++; }
+        while (xlim > xoff && ylim > yoff && a_[xlim - 1] == b_[ylim - 1]) { xlim--; ylim--; }
+
+        if (xoff == xlim) {
+          for (long y = yoff; y < ylim; ++y) inserted_[y] = 1;
+        } else if (yoff == ylim) {
+          for (long x = xoff; x < xlim; ++x) deleted_[x] = 1;
+        } else {
+          long xmid, ymid;
+          middleSnake(xoff, xlim, yoff, ylim, xmid, ymid);
+          compare(xoff, xmid, yoff, ymid);
+          compare(xmid, xlim, ymid, ylim);
+        }
+      }
+
+      void middleSnake(long xoff, long xlim, long yoff, long ylim, long& xmid, long& ymid) {
+        const long dmin = xoff - ylim;
+        const long dmax = xlim - yoff;
+        const long fmid = xoff - yoff;
+        const long bmid = xlim - ylim;
+        const bool odd = ((fmid - bmid) & 1) != 0;
+        long fmin = fmid, fmax = fmid;
+        long bmin = bmid, bmax = bmid;
+
+        fd(fmid) = xoff;
+        bd(bmid) = xlim;
+
+        while (true) {
+          // Extend the forward search by one edit
+          if (fmin > dmin) fd(--fmin - 1) = -1; else ++fmin;
+          if (fmax < dmax) fd(++fmax + 1) = -1; else --fmax;
+
+          for (long d = fmax; d >= fmin; d -= 2) {
+            long tlo = fd(d - 1);
+            long thi = fd(d + 1);
+            long x = tlo >= thi ? tlo + 1 : thi;
+            long y = x - d;
+
+            while (x < xlim && y < ylim && a_[x] == b_[y]) { x++; y++; }
+            fd(d) = x;
+
+            if (odd && bmin <= d && d <= bmax && bd(d) <= x) {
+              xmid = x;
+              ymid = y;
+              return;
+            }
+          }
+
+          // Extend the backward search by one edit
+          if (bmin > dmin) bd(--bmin - 1) = LONG_MAX; else ++bmin;
+          if (bmax < dmax) bd(++bmax + 1) = LONG_MAX; else --bmax;
+
+          for (long d = bmax; d >= bmin; d -= 2) {
+            long tlo = bd(d - 1);
+            long thi = bd(d + 1);
+            long x = tlo < thi ? tlo : thi - 1;
+            long y = x - d;
+
+            while (x > xoff && y > yoff && a_[x - 1] == b_[y - 1]) { x--; y--; }
+            bd(d) = x;
+
+            if (!odd && fmin <= d && d <= fmax && x <= fd(d)) {
+              xmid = x;
+              ymid = y;
+              return;
+            }
+          }
+        }
+      }
+
+      const std::vector<int>& a_;
+      const std::vector<int>& b_;
+      std::vector<char> deleted_;
+      std::vector<char> inserted_;
+      std::vector<long> forward_;
+      std::vector<long> backward_;
+      long offset_;
+  };
+
+  std::vector<lineEdit> diffEdits(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines) {
+    std::vector<int> old_ids, new_ids;
+    internLines(old_lines, new_lines, old_ids, new_ids);
+
+    // A line that never appears on the other side can not be part of the common subsequence,
+    // drop those up front so a rewritten config does not cost a full O(ND) search
+    std::vector<int> old_counts(old_ids.size() + new_ids.size(), 0), new_counts(old_counts.size(), 0);
+    for (int id : old_ids) old_counts[id]++;
+    for (int id : new_ids) new_counts[id]++;
+
+    std::vector<char> deleted(old_ids.size(), 1), inserted(new_ids.size(), 1);
+    std::vector<int> old_kept, new_kept;
+    std::vector<size_t> old_map, new_map;
+
+    for (size_t i = 0; i < old_ids.size(); ++i) {
+      if (new_counts[old_ids[i]] == 0) continue;
+      old_kept.push_back(old_ids[i]);
+      old_map.push_back(i);
+    }
+    for (size_t j = 0; j < new_ids.size(); ++j) {
+      if (old_counts[new_ids[j]] == 0) continue;
+      new_kept.push_back(new_ids[j]);
+      new_map.push_back(j);
+    }
+
+    Myers myers(old_kept, new_kept);
+    myers.run();
+
+    for (size_t i = 0; i < old_map.size(); ++i) deleted[old_map[i]] = myers.deleted()[i];
+    for (size_t j = 0; j < new_map.size(); ++j) inserted[new_map[j]] = myers.inserted()[j];
+
+    std::vector<lineEdit> edits;
+    edits.reserve(std::max(old_lines.size(), new_lines.size()));
+
+    size_t i = 0, j = 0;
+    while (i < old_lines.size() || j < new_lines.size()) {
+      if (i < old_lines.size() && deleted[i]) {
+        edits.push_back({CHRONICLE_DIFF_DELETE, i++, j});
+      } else if (j < new_lines.size() && inserted[j]) {
+        edits.push_back({CHRONICLE_DIFF_INSERT, i, j++});
+      } else {
+        edits.push_back({CHRONICLE_DIFF_EQUAL, i++, j++});
+      }
+    }
+
+    return edits;
+  }
+
+  size_t indentOf(const std::string& line) {
+    size_t indent = 0;
+    while (indent < line.size() && (line[indent] == ' ' || line[indent] == '\t')) indent++;
+    return indent;
+  }
+
+  // Blank lines and IOS "!" separators never open a block
+  bool isStructural(const std::string& line) {
+    size_t indent = indentOf(line);
+    return indent < line.size() && line[indent] != '!';
+  }
+
+  // parent[i] is the closest previous line with a smaller indent, -1 for top level lines
+  std::vector<long> computeParents(const std::vector<std::string>& lines) {
+    std::vector<long> parents(lines.size(), -1);
+    std::vector<std::pair<size_t, long>> stack;
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+      if (!isStructural(lines[i])) continue;
+
+      size_t indent = indentOf(lines[i]);
+      while (!stack.empty() && stack.back().first >= indent) stack.pop_back();
+
+      parents[i] = stack.empty() ? -1 : stack.back().second;
+      stack.emplace_back(indent, static_cast<long>(i));
+    }
+
+    return parents;
+  }
+
+  std::string trimmed(const std::string& line) {
+    return line.substr(indentOf(line));
+  }
+
+  std::string blockPath(const std::vector<std::string>& lines, const std::vector<long>& parents, size_t index) {
+    std::vector<long> chain;
+    for (long p = parents[index]; p >= 0; p = parents[p]) chain.push_back(p);
+
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      if (!path.empty()) path += " > ";
+      path += trimmed(lines[*it]);
+    }
+
+    return path;
+  }
+
+  std::string topLevelBlock(const std::vector<std::string>& lines, const std::vector<long>& parents, size_t index) {
+    long root = static_cast<long>(index);
+    while (parents[root] >= 0) root = parents[root];
+    return trimmed(lines[root]);
+  }
+}
+
+std::vector<diffOp> diffLines(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines) {
+  std::vector<lineEdit> edits = diffEdits(old_lines, new_lines);
+  std::vector<diffOp> ops;
+
+  for (const auto& edit : edits) {
+    if (!ops.empty() && ops.back().kind == edit.kind) {
+      ops.back().length++;
+    } else {
+      ops.push_back({edit.kind, edit.old_index, edit.new_index, 1});
+    }
+  }
+
+  return ops;
+}
+
+std::string unifiedDiff(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines,
+                        const std::string& old_label, const std::string& new_label,
+                        int context, bool hierarchical) {
+  std::vector<lineEdit> edits = diffEdits(old_lines, new_lines);
+  const size_t total = edits.size();
+  const size_t ctx = static_cast<size_t>(std::max(context, 0));
+
+  std::vector<long> old_parents, new_parents;
+  if (hierarchical) {
+    old_parents = computeParents(old_lines);
+    new_parents = computeParents(new_lines);
+  }
+
+  std::string out;
+  size_t i = 0;
+  size_t previous_end = 0;
+
+  while (i < total) {
+    while (i < total && edits[i].kind == CHRONICLE_DIFF_EQUAL) i++;
+    if (i == total) break;
+
+    const size_t first_change = i;
+    size_t start = std::max(first_change >= ctx ? first_change - ctx : 0, previous_end);
+    size_t end = i;
+
+    // Merge changes separated by at most two contexts worth of equal lines
+    size_t j = i;
+    while (j < total) {
+      if (edits[j].kind != CHRONICLE_DIFF_EQUAL) {
+        end = ++j;
+        continue;
+      }
+
+      size_t k = j;
+      while (k < total && edits[k].kind == CHRONICLE_DIFF_EQUAL) k++;
+      if (k < total && k - j <= 2 * ctx) {
+        j = k;
+        continue;
+      }
+      break;
+    }
+
+    const size_t stop = std::min(total, end + ctx);
+
+    size_t old_count = 0, new_count = 0;
+    for (size_t e = start; e < stop; ++e) {
+      if (edits[e].kind != CHRONICLE_DIFF_INSERT) old_count++;
+      if (edits[e].kind != CHRONICLE_DIFF_DELETE) new_count++;
+    }
+
+    if (out.empty()) {
+      out += "--- " + old_label + "\n";
+      out += "+++ " + new_label + "\n";
+    }
+
+    // An empty side points at the line before the hunk, like diff -u
+    size_t old_start = edits[start].old_index + (old_count > 0 ? 1 : 0);
+    size_t new_start = edits[start].new_index + (new_count > 0 ? 1 : 0);
+
+    out += "@@ -" + std::to_string(old_start) + "," + std::to_string(old_count) +
+           " +" + std::to_string(new_start) + "," + std::to_string(new_count) + " @@";
+
+    if (hierarchical) {
+      const lineEdit& change = edits[first_change];
+      std::string path = change.kind == CHRONICLE_DIFF_DELETE
+        ? blockPath(old_lines, old_parents, change.old_index)
+        : blockPath(new_lines, new_parents, change.new_index);
+      if (!path.empty()) out += " " + path;
+    }
+    out += "\n";
+
+    for (size_t e = start; e < stop; ++e) {
+      switch (edits[e].kind) {
+        case CHRONICLE_DIFF_EQUAL:  out += " " + old_lines[edits[e].old_index] + "\n"; break;
+        case CHRONICLE_DIFF_DELETE: out += "-" + old_lines[edits[e].old_index] + "\n"; break;
+        case CHRONICLE_DIFF_INSERT: out += "+" + new_lines[edits[e].new_index] + "\n"; break;
+      }
+    }
+
+    previous_end = stop;
+    i = stop;
+  }
+
+  return out;
+}
+
+diffSummary summarizeDiff(const std::vector<std::string>& old_lines, const std::vector<std::string>& new_lines) {
+  std::vector<lineEdit> edits = diffEdits(old_lines, new_lines);
+  std::vector<long> old_parents = computeParents(old_lines);
+  std::vector<long> new_parents = computeParents(new_lines);
+  std::unordered_set<std::string> seen;
+  diffSummary summary;
+
+  bool in_change = false;
+  for (const auto& edit : edits) {
+    if (edit.kind == CHRONICLE_DIFF_EQUAL) {
+      in_change = false;
+      continue;
+    }
+
+    if (!in_change) summary.hunks++;
+    in_change = true;
+    summary.identical = false;
+
+    std::string section;
+    if (edit.kind == CHRONICLE_DIFF_DELETE) {
+      summary.removed++;
+      if (isStructural(old_lines[edit.old_index])) section = topLevelBlock(old_lines, old_parents, edit.old_index);
+    } else {
+      summary.added++;
+      if (isStructural(new_lines[edit.new_index])) section = topLevelBlock(new_lines, new_parents, edit.new_index);
+    }
+
+    if (!section.empty() && seen.insert(section).second) {
+      summary.sections.push_back(std::move(section));
+    }
+  }
+
+  return summary;
+}
+
+std::vector<diffBenchmark> benchmarkDiff(const std::vector<size_t>& sizes, const std::vector<double>& editRates, int rounds) {
+  rounds = std::max(rounds, 1);
+
+  std::vector<diffBenchmark> results;
+  for (const size_t size : sizes) {
+    const std::vector<std::string> old_lines = syntheticConfig(size);
+
+    for (const double rate : editRates) {
+      const std::vector<std::string> new_lines = syntheticEdit(old_lines, rate);
+
+      diffBenchmark run;
+      run.lines = old_lines.size();
+      run.edit_rate = rate;
+      run.diff_ms = run.unified_ms = std::numeric_limits<double>::max();
+
+      for (int round = 0; round < rounds; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        const std::vector<diffOp> ops = diffLines(old_lines, new_lines);
+        run.diff_ms = std::min(run.diff_ms, millisecondsOf(std::chrono::steady_clock::now() - start));
+        run.edits = static_cast<size_t>(std::count_if(ops.begin(), ops.end(), [](const diffOp& op) { return op.kind != CHRONICLE_DIFF_EQUAL; }));
+
+        start = std::chrono::steady_clock::now();
+        unifiedDiff(old_lines, new_lines, "old", "new", CHRONICLE_DIFF_DEFAULT_CONTEXT, true);
+        run.unified_ms = std::min(run.unified_ms, millisecondsOf(std::chrono::steady_clock::now() - start));
+      }
+
+      run.lines_per_s = run.diff_ms > 0 ? static_cast<double>(old_lines.size() + new_lines.size()) / (run.diff_ms / 1000.0) : 0;
+      results.push_back(run);
+    }
+  }
+
+  return results;
+}
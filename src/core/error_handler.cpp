@@ -7,6 +7,7 @@ std::string getErrorMsg(int internal_exit_code) {
         // Internal errors
         case CHRONICLE_ERROR_UNKNOWN_CORE_ERROR: return "Unknown core level error";
         case CHRONICLE_ERROR_ASSERTION_FAILED: return "Assertion failed, core level error";
+        case CHRONICLE_ERROR_TRACE_EXPORT_FAILED: return "Could not write the trace export file";
 
         // SSH errors
         case CHRONICLE_ERROR_SSH_UNKNOWN: return "Unknown ssh error";
@@ -14,12 +15,40 @@ std::string getErrorMsg(int internal_exit_code) {
         case CHRONICLE_ERROR_SSH_SESSION_FAILED: return "Failed creating an SSH session";
         case CHRONICLE_ERROR_SSH_CONNECTION_FAILED: return "Could not connect to host";
         case CHRONICLE_ERROR_SSH_COMMAND_FAILED: return "Command failed";
+        case CHRONICLE_ERROR_SSH_HOST_UNREACHABLE: return "Host was unreachable in the last reachability sweep";
+        case CHRONICLE_ERROR_SSH_CIRCUIT_OPEN: return "Device is failing repeatedly, skipped until its cooldown ends";
+        case CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED: return "Could not write or read an SSH transcript";
+        case CHRONICLE_ERROR_SSH_REPLAY_MISMATCH: return "Replayed session diverged from the recording";
+        case CHRONICLE_ERROR_SSH_AUTH_FAILED: return "Authentication was rejected by the device";
+        case CHRONICLE_ERROR_SSH_HOST_KEY_MISMATCH: return "Host key could not be verified";
 
         // Device factory
         case CHRONICLE_ERROR_DEVICE_FACTORY_FAILED: return "Error while getting device operations";
         case CHRONICLE_ERROR_INVALID_DEVICE_ID: return "Wrong device ID provided";
         case CHRONICLE_ERROR_INVALID_VENDOR_ID: return "Wrong vendor ID provided";
         case CHRONICLE_ERROR_LOAD_DEVICE_MAP_FAILED: return "Error while loading device map";
+        case CHRONICLE_ERROR_INVALID_NORMALIZE_RULE: return "Device map declares an invalid normalize rule";
+        case CHRONICLE_ERROR_INVALID_PAGER_PROMPT: return "Device map declares an invalid pager prompt";
+
+        // Fleet index
+        case CHRONICLE_ERROR_FLEET_INDEX_IO_FAILED: return "Could not read or write the fleet index file";
+        case CHRONICLE_ERROR_FLEET_INDEX_CORRUPT: return "Fleet index file is corrupt or from another version";
+        case CHRONICLE_ERROR_FLEET_INDEX_BAD_PATTERN: return "Invalid search pattern";
+
+        // Snapshot archive
+        case CHRONICLE_ERROR_ARCHIVE_IO_FAILED: return "Could not read or write the snapshot archive";
+        case CHRONICLE_ERROR_ARCHIVE_CORRUPT: return "Snapshot archive record failed its checksum";
+        case CHRONICLE_ERROR_ARCHIVE_READ_ONLY: return "Snapshot archive was opened read only";
+
+        // Storage backends
+        case CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED: return "Could not read or write the storage journal";
+        case CHRONICLE_ERROR_STORAGE_JOURNAL_CORRUPT: return "Storage journal is corrupt or from another version";
+        case CHRONICLE_ERROR_STORAGE_UNSUPPORTED: return "Operation is not supported by the selected storage backend";
+
+        // Compression
+        case CHRONICLE_ERROR_COMPRESSION_FAILED: return "Could not compress configuration blob";
+        case CHRONICLE_ERROR_DECOMPRESSION_FAILED: return "Could not decompress configuration blob";
+        case CHRONICLE_ERROR_DICTIONARY_FAILED: return "Could not train or load a compression dictionary";
 
         // MongoDB
         case CHRONICLE_ERROR_MONGO_UNKNOWN: return "Unknown error while using MongoDB";
@@ -29,12 +58,14 @@ std::string getErrorMsg(int internal_exit_code) {
         case CHRONICLE_ERROR_MONGO_DUPLICATE: return "Duplicate document";
         case CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND: return "Collection not found";
         case CHRONICLE_ERROR_MONGO_DELETE_DOCUMENT: return "Could not delete document";
+        case CHRONICLE_ERROR_MONGO_WRITER_CLOSED: return "Asynchronous writer is already closed";
 
         // ChronicleDB
         case CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED: return "Failed while trying to add";
         case CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED: return "Failed while trying to modify";
         case CHRONICLE_ERROR_CHRONICLE_DB_DELETE_FAILED: return "Failed while trying to delete";
         case CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT: return "Faild while trying to access a non-exitant document";
+        case CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB: return "Stored configuration blob is incomplete";
 
         default: return "Unknown error.";
     }
@@ -0,0 +1,565 @@
+#include "core/fleet_index.hpp"
+#include "core/error_handler.hpp"
+#include "core/snapshot.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <regex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  constexpr char FILE_MAGIC[8] = {'C', 'H', 'R', 'F', 'I', 'D', 'X', '1'};
+  constexpr uint32_t FILE_VERSION = 1;
+
+  // On disk layout: header | doc records | text and names | trigram table | postings
+  struct fileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t doc_count;
+    uint32_t trigram_count;
+    uint32_t reserved;
+    int64_t last_sync;
+    uint64_t docs_offset;
+    uint64_t trigrams_offset;
+    uint64_t postings_offset;
+    uint64_t file_size;
+  };
+
+  struct docRecord {
+    uint64_t text_offset;
+    uint64_t text_length;
+    uint64_t names_offset;      // Device name followed by the hash
+    uint32_t device_length;
+    uint32_t hash_length;
+  };
+
+  struct trigramRecord {
+    uint32_t trigram;
+    uint32_t count;
+    uint64_t offset;
+  };
+
+  /*
+    Distinct trigrams of text, sorted. Lines are searched one at a time, so trigrams never
+    span a newline. A per thread bitmap over the whole 24 bit key space dedups in one pass,
+    configurations repeat the same few thousand trigrams tens of thousands of times.
+  */
+  void collectTrigrams(std::string_view text, std::vector<uint32_t>& trigrams) {
+    trigrams.clear();
+    if (text.size() < 3) return;
+
+    thread_local std::vector<uint64_t> seen(size_t(1) << 18);
+
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+      unsigned char a = text[i], b = text[i + 1], c = text[i + 2];
+      if (a == '\n' || b == '\n' || c == '\n') continue;
+
+      uint32_t key = (uint32_t(a) << 16) | (uint32_t(b) << 8) | uint32_t(c);
+      uint64_t bit = uint64_t(1) << (key & 63);
+      if (seen[key >> 6] & bit) continue;
+      seen[key >> 6] |= bit;
+      trigrams.push_back(key);
+    }
+
+    for (uint32_t key : trigrams) seen[key >> 6] = 0;
+    std::sort(trigrams.begin(), trigrams.end());
+  }
+
+  /*
+    Literal runs every match of the pattern must contain. Groups and classes are skipped,
+    an optional atom ('*', '?', '{0,') drops the character before it, and a top level
+    alternation or an escape it does not model means nothing is required at all.
+  */
+  std::vector<std::string> requiredLiterals(const std::string& pattern) {
+    std::vector<std::string> literals;
+    std::string current;
+    int depth = 0;
+    bool inClass = false;
+
+    auto flush = [&]() {
+      if (!current.empty()) literals.push_back(current);
+      current.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      char c = pattern[i];
+
+      if (inClass) {
+        if (c == '\\') i++;
+        else if (c == ']') inClass = false;
+        continue;
+      }
+
+      if (c == '\\') {
+        if (++i >= pattern.size()) break;
+        const char escaped = pattern[i];
+
+        if (std::ispunct(static_cast<unsigned char>(escaped))) {
+          if (depth == 0) current.push_back(escaped);
+          continue;
+        }
+
+        // Single character classes and assertions, anything else (\x41, \u0041, \cA, back
+        // references) spans characters this does not parse, nothing is required then
+        if (std::strchr("dDwWsSbBtnrfv", escaped) == nullptr) return {};
+        flush();
+        continue;
+      }
+
+      if (c == '[') { flush(); inClass = true; continue; }
+      if (c == '(') { flush(); depth++; continue; }
+      if (c == ')') { depth--; continue; }
+      if (depth > 0) continue;
+
+      switch (c) {
+        case '|':
+          return {};
+        case '.': case '^': case '$': case '+':
+          flush();
+          break;
+        case '*': case '?':
+          if (!current.empty()) current.pop_back();
+          flush();
+          break;
+        case '{': {
+          size_t close = pattern.find('}', i);
+          if (close == std::string::npos) return {};
+          if (std::atoi(pattern.c_str() + i + 1) == 0 && !current.empty()) current.pop_back();
+          flush();
+          i = close;
+          break;
+        }
+        default:
+          current.push_back(c);
+      }
+    }
+
+    flush();
+    return literals;
+  }
+
+  // Appends a hit for every line of text the matcher accepts, up to limit hits in total
+  template <typename Matcher>
+  void scanDocument(std::string_view text, Matcher matches, const std::string& device, const std::string& hash,
+                    std::vector<fleetHit>& hits, size_t limit) {
+    size_t start = 0;
+    int line = 0;
+
+    while (start <= text.size() && hits.size() < limit) {
+      size_t end = text.find('\n', start);
+      if (end == std::string_view::npos) end = text.size();
+
+      std::string_view current = text.substr(start, end - start);
+      if (matches(current)) {
+        hits.push_back({device, hash, line, std::string(current)});
+      }
+
+      start = end + 1;
+      line++;
+    }
+  }
+
+  void throwIo(const std::string& what, const std::string& path) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_FLEET_INDEX_IO_FAILED, what + " " + path + ": " + std::strerror(errno));
+  }
+}
+
+FleetIndex::~FleetIndex() {
+  unmap();
+}
+
+void FleetIndex::unmap() {
+  if (map_ != nullptr) munmap(map_, mapSize_);
+  map_ = nullptr;
+  mapSize_ = 0;
+  mappedDocs_ = 0;
+  mappedTrigrams_ = 0;
+  trigramTable_ = nullptr;
+  postingArea_ = nullptr;
+}
+
+FleetIndex::mappedFile FleetIndex::mapFile(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throwIo("Cannot open", path);
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throwIo("Cannot stat", path);
+  }
+
+  const size_t size = static_cast<size_t>(st.st_size);
+  void* map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (map == MAP_FAILED) throwIo("Cannot map", path);
+
+  const unsigned char* base = static_cast<const unsigned char*>(map);
+  auto corrupt = [&](const std::string& details) {
+    munmap(map, size);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_FLEET_INDEX_CORRUPT, path + ": " + details);
+  };
+
+  fileHeader header;
+  if (size < sizeof(header)) corrupt("truncated header");
+  std::memcpy(&header, base, sizeof(header));
+
+  if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION) corrupt("unknown format");
+  if (header.file_size != size) corrupt("size mismatch");
+  if (header.docs_offset + uint64_t(header.doc_count) * sizeof(docRecord) > size ||
+      header.trigrams_offset + uint64_t(header.trigram_count) * sizeof(trigramRecord) > size ||
+      header.postings_offset > size) corrupt("tables out of range");
+
+  mappedFile file;
+  file.docs.resize(header.doc_count);
+
+  for (uint32_t i = 0; i < header.doc_count; ++i) {
+    docRecord record;
+    std::memcpy(&record, base + header.docs_offset + uint64_t(i) * sizeof(docRecord), sizeof(record));
+
+    if (record.text_offset + record.text_length > size ||
+        record.names_offset + record.device_length + record.hash_length > size) corrupt("document out of range");
+
+    const char* names = reinterpret_cast<const char*>(base + record.names_offset);
+    file.docs[i].device.assign(names, record.device_length);
+    file.docs[i].hash.assign(names + record.device_length, record.hash_length);
+    file.docs[i].text = std::string_view(reinterpret_cast<const char*>(base + record.text_offset), record.text_length);
+    file.byDevice[file.docs[i].device] = i;
+  }
+
+  // A posting past the documents would index out of docs_ on the first search that reads it
+  for (uint32_t i = 0; i < header.trigram_count; ++i) {
+    trigramRecord record;
+    std::memcpy(&record, base + header.trigrams_offset + uint64_t(i) * sizeof(trigramRecord), sizeof(record));
+    if (record.offset + uint64_t(record.count) * sizeof(uint32_t) > size) corrupt("postings out of range");
+
+    for (uint32_t j = 0; j < record.count; ++j) {
+      uint32_t id;
+      std::memcpy(&id, base + record.offset + uint64_t(j) * sizeof(uint32_t), sizeof(id));
+      if (id >= header.doc_count) corrupt("posting of a missing document");
+    }
+  }
+
+  file.map = map;
+  file.size = size;
+  file.lastSync = header.last_sync;
+  file.docCount = header.doc_count;
+  file.trigramCount = header.trigram_count;
+  file.trigramTable = base + header.trigrams_offset;
+  return file;
+}
+
+/* Callers hold the unique lock */
+void FleetIndex::install(mappedFile&& file) {
+  docs_ = std::move(file.docs);
+  byDevice_ = std::move(file.byDevice);
+  memoryPostings_.clear();
+  lastSync_ = file.lastSync;
+
+  unmap();
+  map_ = file.map;
+  mapSize_ = file.size;
+  mappedDocs_ = file.docCount;
+  mappedTrigrams_ = file.trigramCount;
+  trigramTable_ = file.trigramTable;
+  postingArea_ = static_cast<const unsigned char*>(file.map);
+  generation_++;
+}
+
+void FleetIndex::load(const std::string& path) {
+  mappedFile file = mapFile(path);
+
+  std::unique_lock lock(mutex_);
+  install(std::move(file));
+}
+
+void FleetIndex::save(const std::string& path) {
+  uint64_t generation;
+  {
+    std::shared_lock lock(mutex_);
+    generation = generation_;
+
+    std::vector<const document*> live;
+    for (const auto& doc : docs_) {
+      if (doc.live) live.push_back(&doc);
+    }
+
+    // Postings of the rewritten file, documents are renumbered in order
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    std::vector<uint32_t> trigrams;
+    for (uint32_t id = 0; id < live.size(); ++id) {
+      collectTrigrams(live[id]->text, trigrams);
+      for (uint32_t trigram : trigrams) postings[trigram].push_back(id);
+    }
+
+    std::vector<uint32_t> keys;
+    keys.reserve(postings.size());
+    for (const auto& entry : postings) keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+
+    fileHeader header{};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.doc_count = static_cast<uint32_t>(live.size());
+    header.trigram_count = static_cast<uint32_t>(keys.size());
+    header.last_sync = lastSync_;
+    header.docs_offset = sizeof(fileHeader);
+
+    uint64_t offset = header.docs_offset + uint64_t(live.size()) * sizeof(docRecord);
+    std::vector<docRecord> records(live.size());
+    for (size_t i = 0; i < live.size(); ++i) {
+      records[i].text_offset = offset;
+      records[i].text_length = live[i]->text.size();
+      offset += live[i]->text.size();
+      records[i].names_offset = offset;
+      records[i].device_length = static_cast<uint32_t>(live[i]->device.size());
+      records[i].hash_length = static_cast<uint32_t>(live[i]->hash.size());
+      offset += live[i]->device.size() + live[i]->hash.size();
+    }
+
+    offset = (offset + 7) & ~uint64_t(7);
+    header.trigrams_offset = offset;
+    header.postings_offset = offset + uint64_t(keys.size()) * sizeof(trigramRecord);
+
+    std::vector<trigramRecord> table(keys.size());
+    offset = header.postings_offset;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const auto& list = postings[keys[i]];
+      table[i] = {keys[i], static_cast<uint32_t>(list.size()), offset};
+      offset += list.size() * sizeof(uint32_t);
+    }
+    header.file_size = offset;
+
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out) throwIo("Cannot create", tmpPath);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(docRecord));
+    for (const document* doc : live) {
+      out.write(doc->text.data(), doc->text.size());
+      out.write(doc->device.data(), doc->device.size());
+      out.write(doc->hash.data(), doc->hash.size());
+    }
+
+    static const char padding[8] = {};
+    out.write(padding, header.trigrams_offset - static_cast<uint64_t>(out.tellp()));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(trigramRecord));
+    for (uint32_t key : keys) {
+      const auto& list = postings[key];
+      out.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(uint32_t));
+    }
+
+    out.close();
+    if (!out) throwIo("Cannot write", tmpPath);
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) throwIo("Cannot replace", path);
+  }
+
+  // The new file holds everything, the in memory documents give way to it unless they changed
+  // while it was written, those changes are only in memory and stay until the next save
+  mappedFile file = mapFile(path);
+
+  std::unique_lock lock(mutex_);
+  if (generation_ != generation) {
+    munmap(file.map, file.size);
+    return;
+  }
+  install(std::move(file));
+}
+
+void FleetIndex::update(const std::string& device, const std::string& hash, const std::vector<std::string>& lines) {
+  auto owned = std::make_unique<std::string>(joinSnapshotLines(lines));
+
+  std::vector<uint32_t> trigrams;
+  collectTrigrams(*owned, trigrams);
+
+  std::unique_lock lock(mutex_);
+
+  auto existing = byDevice_.find(device);
+  if (existing != byDevice_.end()) {
+    if (docs_[existing->second].hash == hash) return;
+    docs_[existing->second].live = false;
+  }
+
+  const uint32_t id = static_cast<uint32_t>(docs_.size());
+  document doc;
+  doc.device = device;
+  doc.hash = hash;
+  doc.text = *owned;
+  doc.owned = std::move(owned);
+  docs_.push_back(std::move(doc));
+  byDevice_[device] = id;
+
+  for (uint32_t trigram : trigrams) memoryPostings_[trigram].push_back(id);
+  generation_++;
+}
+
+void FleetIndex::remove(const std::string& device) {
+  std::unique_lock lock(mutex_);
+
+  auto existing = byDevice_.find(device);
+  if (existing == byDevice_.end()) return;
+
+  docs_[existing->second].live = false;
+  byDevice_.erase(existing);
+  generation_++;
+}
+
+std::string FleetIndex::indexedHash(const std::string& device) const {
+  std::shared_lock lock(mutex_);
+
+  auto existing = byDevice_.find(device);
+  return existing == byDevice_.end() ? "" : docs_[existing->second].hash;
+}
+
+std::vector<std::string> FleetIndex::devices() const {
+  std::shared_lock lock(mutex_);
+
+  std::vector<std::string> names;
+  names.reserve(byDevice_.size());
+  for (const auto& entry : byDevice_) names.push_back(entry.first);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+size_t FleetIndex::size() const {
+  std::shared_lock lock(mutex_);
+  return byDevice_.size();
+}
+
+int64_t FleetIndex::lastSync() const {
+  std::shared_lock lock(mutex_);
+  return lastSync_;
+}
+
+void FleetIndex::setLastSync(int64_t lastSync) {
+  std::unique_lock lock(mutex_);
+  lastSync_ = lastSync;
+  generation_++;
+}
+
+// Mapped documents come first, so appending the in memory list keeps ids sorted
+std::vector<uint32_t> FleetIndex::postings(uint32_t trigram) const {
+  std::vector<uint32_t> ids;
+
+  size_t low = 0, high = mappedTrigrams_;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    trigramRecord record;
+    std::memcpy(&record, trigramTable_ + mid * sizeof(trigramRecord), sizeof(record));
+
+    if (record.trigram < trigram) {
+      low = mid + 1;
+    } else if (record.trigram > trigram) {
+      high = mid;
+    } else {
+      ids.resize(record.count);
+      std::memcpy(ids.data(), postingArea_ + record.offset, record.count * sizeof(uint32_t));
+      break;
+    }
+  }
+
+  auto memory = memoryPostings_.find(trigram);
+  if (memory != memoryPostings_.end()) {
+    ids.insert(ids.end(), memory->second.begin(), memory->second.end());
+  }
+
+  return ids;
+}
+
+std::vector<uint32_t> FleetIndex::candidates(const std::vector<std::string>& literals) const {
+  std::vector<uint32_t> trigrams, wanted;
+  for (const auto& literal : literals) {
+    collectTrigrams(literal, trigrams);
+    wanted.insert(wanted.end(), trigrams.begin(), trigrams.end());
+  }
+  std::sort(wanted.begin(), wanted.end());
+  wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+  std::vector<uint32_t> result;
+
+  if (wanted.empty()) {
+    // Nothing to narrow down with, every live document is a candidate
+    for (uint32_t id = 0; id < docs_.size(); ++id) {
+      if (docs_[id].live) result.push_back(id);
+    }
+    return result;
+  }
+
+  std::vector<std::vector<uint32_t>> lists;
+  lists.reserve(wanted.size());
+  for (uint32_t trigram : wanted) {
+    lists.push_back(postings(trigram));
+    if (lists.back().empty()) return {};
+  }
+
+  // Shortest list first keeps every intersection small
+  std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+
+  result = std::move(lists[0]);
+  std::vector<uint32_t> next;
+  for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+    next.clear();
+    std::set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(), std::back_inserter(next));
+    result.swap(next);
+  }
+
+  result.erase(std::remove_if(result.begin(), result.end(), [&](uint32_t id) { return !docs_[id].live; }), result.end());
+  return result;
+}
+
+std::vector<fleetHit> FleetIndex::search(const std::string& needle, size_t limit) const {
+  if (needle.empty() || needle.find('\n') != std::string::npos) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_FLEET_INDEX_BAD_PATTERN, "Search text must be a non empty single line");
+  }
+
+  std::shared_lock lock(mutex_);
+  std::vector<fleetHit> hits;
+
+  for (uint32_t id : candidates({needle})) {
+    const document& doc = docs_[id];
+    scanDocument(doc.text, [&](std::string_view line) { return line.find(needle) != std::string_view::npos; },
+                 doc.device, doc.hash, hits, limit);
+    if (hits.size() >= limit) break;
+  }
+
+  return hits;
+}
+
+std::vector<fleetHit> FleetIndex::searchRegex(const std::string& pattern, size_t limit) const {
+  std::regex regex;
+  try {
+    regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+  } catch (const std::regex_error& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_FLEET_INDEX_BAD_PATTERN, "Pattern \"" + pattern + "\": " + e.what());
+  }
+
+  const std::vector<std::string> literals = requiredLiterals(pattern);
+
+  std::shared_lock lock(mutex_);
+  std::vector<fleetHit> hits;
+
+  // The literals are cheap to look for and rule out most lines before the regex runs
+  auto matches = [&](std::string_view line) {
+    for (const auto& literal : literals) {
+      if (line.find(literal) == std::string_view::npos) return false;
+    }
+    return std::regex_search(line.data(), line.data() + line.size(), regex);
+  };
+
+  for (uint32_t id : candidates(literals)) {
+    const document& doc = docs_[id];
+    scanDocument(doc.text, matches, doc.device, doc.hash, hits, limit);
+    if (hits.size() >= limit) break;
+  }
+
+  return hits;
+}
@@ -0,0 +1,317 @@
+#include "core/fleet_run.hpp"
+#include "core/error_handler.hpp"
+#include "database_handler.hpp"
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/types.hpp>
+
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+
+namespace {
+  std::string stringField(const bsoncxx::document::element& element) {
+    if (!element || element.type() != bsoncxx::type::k_string) return "";
+    return std::string(element.get_string().value);
+  }
+
+  int intField(const bsoncxx::document::element& element) {
+    if (!element || element.type() != bsoncxx::type::k_int32) return 0;
+    return element.get_int32().value;
+  }
+
+  std::string hostName() {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0) return "";
+    return name;
+  }
+
+  // Last heartbeat of a process holding leases in the run
+  struct ownerState {
+    std::string host;
+    int pid = 0;
+    int lease = 0;
+    std::chrono::system_clock::time_point heartbeat;
+  };
+
+  std::unordered_map<std::string, ownerState> ownersOf(const bsoncxx::document::view& run) {
+    std::unordered_map<std::string, ownerState> owners;
+    const auto element = run["owners"];
+    if (!element || element.type() != bsoncxx::type::k_document) return owners;
+
+    for (const auto& entry : element.get_document().view()) {
+      if (entry.type() != bsoncxx::type::k_document) continue;
+      const auto view = entry.get_document().view();
+
+      ownerState owner;
+      owner.host = stringField(view["host"]);
+      owner.pid = intField(view["pid"]);
+      owner.lease = intField(view["lease"]);
+      if (view["heartbeatAt"] && view["heartbeatAt"].type() == bsoncxx::type::k_date) {
+        owner.heartbeat = std::chrono::system_clock::time_point(view["heartbeatAt"].get_date().value);
+      }
+      owners.emplace(std::string(entry.key()), std::move(owner));
+    }
+    return owners;
+  }
+
+  bool ownerGone(const std::unordered_map<std::string, ownerState>& owners, const std::string& owner,
+                 const std::string& host, std::chrono::system_clock::time_point now) {
+    // Written before owners were recorded, only the lease tells
+    if (owner.empty()) return false;
+
+    // The heartbeat is written ahead of the leases, an owner without one never got further
+    auto found = owners.find(owner);
+    if (found == owners.end()) return true;
+
+    const ownerState& state = found->second;
+    if (!host.empty() && state.host == host && state.pid > 0 && kill(state.pid, 0) != 0 && errno == ESRCH) return true;
+
+    // A live owner writes a heartbeat every quarter of its lease
+    return state.heartbeat + std::chrono::seconds(state.lease) / 2 < now;
+  }
+
+  bsoncxx::document::value countsOf(const runProgress& progress) {
+    return bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp(CHRONICLE_RUN_PENDING, static_cast<int64_t>(progress.pending)),
+      bsoncxx::builder::basic::kvp(CHRONICLE_RUN_INFLIGHT, static_cast<int64_t>(progress.inflight)),
+      bsoncxx::builder::basic::kvp(CHRONICLE_RUN_DONE, static_cast<int64_t>(progress.done)),
+      bsoncxx::builder::basic::kvp(CHRONICLE_RUN_FAILED, static_cast<int64_t>(progress.failed))
+    );
+  }
+}
+
+FleetRun::FleetRun(std::string id, std::string kind, int leaseSeconds)
+  : id_(std::move(id)), kind_(std::move(kind)), owner_(bsoncxx::oid().to_string()), lease_(leaseSeconds),
+    last_flush_(std::chrono::steady_clock::now()) {}
+
+std::shared_ptr<FleetRun> FleetRun::start(const std::vector<std::string>& devices, const std::string& kind, int leaseSeconds) {
+  std::shared_ptr<FleetRun> run(new FleetRun(bsoncxx::oid().to_string(), kind, leaseSeconds));
+
+  for (const auto& device : devices) {
+    if (!run->devices_.emplace(device, deviceState{}).second) continue;
+    run->unfinished_.push_back(device);
+    run->markDirty(device);
+  }
+
+  const runProgress progress = run->tally();
+  const auto now = bsoncxx::types::b_date{std::chrono::system_clock::now()};
+
+  ChronicleDB cdb;
+  cdb.addRun(bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("id", run->id_),
+    bsoncxx::builder::basic::kvp("kind", run->kind_),
+    bsoncxx::builder::basic::kvp("status", progress.pending == 0 ? CHRONICLE_RUN_STATUS_FINISHED : CHRONICLE_RUN_STATUS_RUNNING),
+    bsoncxx::builder::basic::kvp("devices", static_cast<int64_t>(progress.devices)),
+    bsoncxx::builder::basic::kvp("counts", countsOf(progress)),
+    bsoncxx::builder::basic::kvp("startedAt", now),
+    bsoncxx::builder::basic::kvp("updatedAt", now)
+  ));
+
+  // Every device pending in one write
+  run->flush();
+  return run;
+}
+
+std::shared_ptr<FleetRun> FleetRun::resume(const std::string& runId, int leaseSeconds, bool retryFailed) {
+  ChronicleDB cdb;
+  const auto document = cdb.getRunBson(runId);
+  std::shared_ptr<FleetRun> run(new FleetRun(runId, stringField(document.view()["kind"]), leaseSeconds));
+
+  // A stored snapshot is the proof of work, the state write after it may not have made it
+  std::unordered_map<std::string, std::string> stored;
+  for (const auto& entry : cdb.getRunSnapshotsBson(runId)) {
+    stored[stringField(entry.view()["device"])] = stringField(entry.view()["hash"]);
+  }
+
+  const auto owners = ownersOf(document.view());
+  const std::string host = hostName();
+
+  const auto now = std::chrono::system_clock::now();
+  for (const auto& entry : cdb.getRunDevicesBson(runId)) {
+    const auto view = entry.view();
+    const std::string device = stringField(view["device"]);
+
+    deviceState state;
+    state.state = stringField(view["state"]);
+    if (state.state.empty()) state.state = CHRONICLE_RUN_PENDING;
+    state.attempts = intField(view["attempts"]);
+    state.owner = stringField(view["owner"]);
+    state.hash = stringField(view["hash"]);
+    state.code = intField(view["code"]);
+    state.message = stringField(view["message"]);
+    if (view["leaseUntil"] && view["leaseUntil"].type() == bsoncxx::type::k_date) {
+      state.lease_until = std::chrono::system_clock::time_point(view["leaseUntil"].get_date().value);
+    }
+
+    auto snapshot = stored.find(device);
+    const bool recovered = state.state != CHRONICLE_RUN_DONE && snapshot != stored.end();
+    if (recovered) {
+      state.state = CHRONICLE_RUN_DONE;
+      state.hash = snapshot->second;
+      state.code = 0;
+      state.message.clear();
+    }
+
+    // An unexpired lease of a live owner belongs to a process still working on the device
+    const bool left = state.state == CHRONICLE_RUN_PENDING
+      || (state.state == CHRONICLE_RUN_INFLIGHT && (state.lease_until <= now || ownerGone(owners, state.owner, host, now)))
+      || (state.state == CHRONICLE_RUN_FAILED && retryFailed);
+
+    if (!run->devices_.emplace(device, std::move(state)).second) continue;
+    if (left) run->unfinished_.push_back(device);
+    if (recovered) run->markDirty(device);
+  }
+
+  // Writes the recovered devices and the counts as they are now
+  run->flush();
+  return run;
+}
+
+std::vector<std::string> FleetRun::unfinished() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return unfinished_;
+}
+
+bool FleetRun::claim(const std::string& device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  deviceState& state = stateOf(device);
+  if (state.state == CHRONICLE_RUN_DONE) return false;
+
+  state.state = CHRONICLE_RUN_INFLIGHT;
+  state.attempts++;
+  state.owner = owner_;
+  state.lease_until = std::chrono::system_clock::now() + lease_;
+  leased_.insert(device);
+  markDirty(device);
+  return true;
+}
+
+void FleetRun::complete(const std::string& device, const std::string& hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  deviceState& state = stateOf(device);
+  state.state = CHRONICLE_RUN_DONE;
+  state.hash = hash;
+  state.code = 0;
+  state.message.clear();
+  leased_.erase(device);
+  markDirty(device);
+}
+
+void FleetRun::fail(const std::string& device, int code, const std::string& message) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  deviceState& state = stateOf(device);
+  state.state = CHRONICLE_RUN_FAILED;
+  state.code = code;
+  state.message = message;
+  leased_.erase(device);
+  markDirty(device);
+}
+
+bool FleetRun::flushDue() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dirty_.size() >= CHRONICLE_RUN_FLUSH_BATCH) return true;
+
+  const auto elapsed = std::chrono::steady_clock::now() - last_flush_;
+  if (elapsed < std::chrono::milliseconds(CHRONICLE_RUN_FLUSH_INTERVAL_MS)) return false;
+  return !dirty_.empty() || (!leased_.empty() && elapsed >= lease_ / 4);
+}
+
+void FleetRun::flush() {
+  const auto now = std::chrono::system_clock::now();
+
+  std::vector<std::string> written;
+  std::vector<std::pair<std::string, bsoncxx::document::value>> updates;
+  runProgress progress;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Renewed with half of the lease still to go, a slow device does not lose its claim
+    for (const auto& device : leased_) {
+      deviceState& state = devices_.at(device);
+      if (state.lease_until - now < lease_ / 2) {
+        state.lease_until = now + lease_;
+        markDirty(device);
+      }
+    }
+
+    written.swap(dirty_);
+    dirty_set_.clear();
+
+    updates.reserve(written.size());
+    for (const auto& device : written) {
+      const deviceState& state = devices_.at(device);
+      updates.emplace_back(device, bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("state", state.state),
+        bsoncxx::builder::basic::kvp("attempts", state.attempts),
+        bsoncxx::builder::basic::kvp("owner", state.owner),
+        bsoncxx::builder::basic::kvp("leaseUntil", bsoncxx::types::b_date{state.lease_until}),
+        bsoncxx::builder::basic::kvp("hash", state.hash),
+        bsoncxx::builder::basic::kvp("code", state.code),
+        bsoncxx::builder::basic::kvp("message", state.message),
+        bsoncxx::builder::basic::kvp("updatedAt", bsoncxx::types::b_date{now})
+      ));
+    }
+
+    progress = tally();
+    last_flush_ = std::chrono::steady_clock::now();
+  }
+
+  try {
+    // The heartbeat goes first, resume() finds the owner of every lease it reads
+    ChronicleDB cdb;
+    cdb.updateRun(id_, bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("status", progress.status),
+      bsoncxx::builder::basic::kvp("counts", countsOf(progress)),
+      bsoncxx::builder::basic::kvp("owners." + owner_, bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("host", hostName()),
+        bsoncxx::builder::basic::kvp("pid", static_cast<int>(getpid())),
+        bsoncxx::builder::basic::kvp("lease", static_cast<int>(lease_.count())),
+        bsoncxx::builder::basic::kvp("heartbeatAt", bsoncxx::types::b_date{now})
+      )),
+      bsoncxx::builder::basic::kvp("updatedAt", bsoncxx::types::b_date{now})
+    ));
+    cdb.updateRunDevices(id_, updates);
+  } catch (...) {
+    // Nothing is lost, the next flush writes these devices again
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& device : written) markDirty(device);
+    throw;
+  }
+}
+
+runProgress FleetRun::progress() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tally();
+}
+
+/* Callers hold the lock */
+FleetRun::deviceState& FleetRun::stateOf(const std::string& device) {
+  auto found = devices_.find(device);
+  if (found == devices_.end()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "Device " + device + " is not part of run " + id_);
+  }
+  return found->second;
+}
+
+void FleetRun::markDirty(const std::string& device) {
+  if (dirty_set_.insert(device).second) dirty_.push_back(device);
+}
+
+runProgress FleetRun::tally() const {
+  runProgress progress;
+  progress.id = id_;
+  progress.kind = kind_;
+  progress.devices = devices_.size();
+
+  for (const auto& [device, state] : devices_) {
+    if (state.state == CHRONICLE_RUN_DONE) progress.done++;
+    else if (state.state == CHRONICLE_RUN_FAILED) progress.failed++;
+    else if (state.state == CHRONICLE_RUN_INFLIGHT) progress.inflight++;
+    else progress.pending++;
+  }
+
+  progress.status = progress.pending + progress.inflight == 0 ? CHRONICLE_RUN_STATUS_FINISHED : CHRONICLE_RUN_STATUS_RUNNING;
+  return progress;
+}
@@ -0,0 +1,115 @@
+#include "core/hash.hpp"
+
+#include <cstring>
+
+namespace {
+  constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+  constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+  constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+  constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+  constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+  // Second seed of contentHash, any constant unrelated to the first works
+  constexpr uint64_t CONTENT_HASH_SEED = 0x6368726F6E69636CULL;
+
+  inline uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl(acc, 31);
+    return acc * PRIME64_1;
+  }
+
+  inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+  }
+
+  void appendHex(std::string& out, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      out.push_back(digits[(value >> shift) & 0xF]);
+    }
+  }
+}
+
+uint64_t xxh64(std::string_view data, uint64_t seed) {
+  const size_t length = data.size();
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+  const unsigned char* end = p + length;
+  uint64_t h;
+
+  if (length >= 32) {
+    const unsigned char* limit = end - 32;
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+
+    do {
+      v1 = round(v1, read64(p));      p += 8;
+      v2 = round(v2, read64(p));      p += 8;
+      v3 = round(v3, read64(p));      p += 8;
+      v4 = round(v4, read64(p));      p += 8;
+    } while (p <= limit);
+
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+
+  h += static_cast<uint64_t>(length);
+
+  while (p + 8 <= end) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+    p += 8;
+  }
+
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+    h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+
+  while (p < end) {
+    h ^= (*p) * PRIME64_5;
+    h = rotl(h, 11) * PRIME64_1;
+    p++;
+  }
+
+  // Avalanche
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+std::string contentHash(std::string_view data) {
+  std::string hex;
+  hex.reserve(32);
+  appendHex(hex, xxh64(data, 0));
+  appendHex(hex, xxh64(data, CONTENT_HASH_SEED));
+  return hex;
+}
@@ -0,0 +1,101 @@
+#include "core/host_keys.hpp"
+#include "database_handler.hpp"
+
+#include <algorithm>
+
+HostKeyStore& HostKeyStore::instance() {
+  static HostKeyStore store;
+  return store;
+}
+
+std::string HostKeyStore::key(const std::string& host, int port) {
+  return host + ":" + std::to_string(port);
+}
+
+void HostKeyStore::ensureLoaded() {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (loaded_) return;
+  }
+
+  // Loaded under the lock, concurrent first lookups wait instead of querying the database each
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (loaded_) return;
+
+  ChronicleDB cdb;
+  std::vector<hostKeyEntry> entries = cdb.getHostKeys();
+
+  fingerprints_.reserve(entries.size());
+  for (auto& entry : entries) {
+    fingerprints_[key(entry.host, entry.port)] = std::move(entry.fingerprint);
+  }
+  loaded_ = true;
+}
+
+std::optional<std::string> HostKeyStore::lookup(const std::string& host, int port) {
+  ensureLoaded();
+
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = fingerprints_.find(key(host, port));
+  if (it == fingerprints_.end()) {
+    return std::nullopt;
+  }
+
+  return it->second;
+}
+
+void HostKeyStore::remember(const std::string& host, int port, const std::string& fingerprint) {
+  ensureLoaded();
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto inserted = fingerprints_.emplace(key(host, port), fingerprint);
+  if (inserted.second) {
+    pending_.push_back({host, port, fingerprint});
+  }
+}
+
+void HostKeyStore::forget(const std::string& host, int port) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  fingerprints_.erase(key(host, port));
+  pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [&](const hostKeyEntry& entry) {
+    return entry.host == host && entry.port == port;
+  }), pending_.end());
+}
+
+void HostKeyStore::flush() {
+  std::vector<hostKeyEntry> batch;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    batch.swap(pending_);
+  }
+
+  if (batch.empty()) return;
+
+  try {
+    ChronicleDB cdb;
+    cdb.addHostKeys(batch);
+  } catch (const std::exception& e) {
+    // Keep the keys queued for the next flush
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    pending_.insert(pending_.end(), batch.begin(), batch.end());
+    throw;
+  }
+}
+
+bool HostKeyStore::tryFlush() {
+  try {
+    flush();
+    return true;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+void HostKeyStore::reload() {
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    fingerprints_.clear();
+    loaded_ = false;
+  }
+  ensureLoaded();
+}
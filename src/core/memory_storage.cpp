@@ -0,0 +1,678 @@
+#include "core/memory_storage.hpp"
+#include "core/error_handler.hpp"
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/types/bson_value/view.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unistd.h>
+
+namespace {
+  constexpr char FILE_MAGIC[8] = {'C', 'H', 'R', 'J', 'R', 'N', 'L', '1'};
+  constexpr uint32_t FILE_VERSION = 1;
+  constexpr uint8_t COLLECTION_COUNT = 8;
+  constexpr uint8_t OPERATION_COUNT = 2;
+
+  void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+      out += static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    out += static_cast<char>(value);
+  }
+
+  bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= in.size()) return false;
+      const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return true;
+    }
+    return false;
+  }
+
+  bool getBytes(const std::string& in, size_t& pos, std::string_view& value) {
+    uint64_t size;
+    if (!getVarint(in, pos, size) || size > in.size() - pos) return false;
+    value = std::string_view(in.data() + pos, size);
+    pos += size;
+    return true;
+  }
+
+  std::string encodeRecord(uint8_t op, uint8_t name, const std::string& key, std::string_view payload) {
+    std::string record;
+    record.reserve(2 + 10 + key.size() + 10 + payload.size());
+    record += static_cast<char>(op);
+    record += static_cast<char>(name);
+    putVarint(record, key.size());
+    record += key;
+    putVarint(record, payload.size());
+    record.append(payload.data(), payload.size());
+    return record;
+  }
+
+  bool writeAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+      const ssize_t written = ::write(fd, data.data(), data.size());
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+  }
+
+  std::string fileHeader() {
+    std::string header(FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.append(reinterpret_cast<const char*>(&FILE_VERSION), sizeof(FILE_VERSION));
+    return header;
+  }
+
+  std::string_view bytesOf(const bsoncxx::document::view& document) {
+    return std::string_view(reinterpret_cast<const char*>(document.data()), document.length());
+  }
+
+  bsoncxx::document::value documentOf(std::string_view bytes) {
+    return bsoncxx::document::value(bsoncxx::document::view(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size()));
+  }
+
+  std::string hostKey(const std::string& host, int port) {
+    return host + ":" + std::to_string(port);
+  }
+
+  std::string stringField(const bsoncxx::document::element& element) {
+    if (!element || element.type() != bsoncxx::type::k_string) return "";
+    return std::string(element.get_string().value);
+  }
+
+  // Run device states are keyed by both, run ids are hex and never hold the separator
+  std::string runDeviceKey(const std::string& runId, const std::string& device) {
+    return runId + "/" + device;
+  }
+
+  std::chrono::system_clock::time_point takenAt(const bsoncxx::document::view& entry) {
+    return std::chrono::system_clock::time_point(entry["takenAt"].get_date().value);
+  }
+
+  // A field of a $set, its dotted path split up
+  struct setField {
+    std::vector<std::string> path;
+    bsoncxx::types::bson_value::view value;
+  };
+
+  // Copy of document with the fields set below depth of their paths, what a Mongo $set does
+  bsoncxx::document::value applySet(const bsoncxx::document::view& document, const std::vector<const setField*>& fields, size_t depth) {
+    std::vector<std::string> order;
+    std::unordered_map<std::string, std::vector<const setField*>> byKey;
+    for (const setField* field : fields) {
+      auto& matching = byKey[field->path[depth]];
+      if (matching.empty()) order.push_back(field->path[depth]);
+      matching.push_back(field);
+    }
+
+    bsoncxx::builder::basic::document out;
+
+    auto append = [&](const std::string& key, const bsoncxx::document::view& current) {
+      const auto& matching = byKey[key];
+
+      // A field that replaces the key outright wins over deeper ones, the last one given if several do
+      const setField* replacement = nullptr;
+      for (const setField* field : matching) {
+        if (field->path.size() == depth + 1) replacement = field;
+      }
+
+      if (replacement != nullptr) {
+        out.append(bsoncxx::builder::basic::kvp(key, replacement->value));
+      } else {
+        out.append(bsoncxx::builder::basic::kvp(key, applySet(current, matching, depth + 1)));
+      }
+    };
+
+    for (const auto& element : document) {
+      const std::string key(element.key());
+      if (byKey.find(key) == byKey.end()) {
+        out.append(bsoncxx::builder::basic::kvp(key, element.get_value()));
+        continue;
+      }
+
+      const bsoncxx::document::view current = element.type() == bsoncxx::type::k_document
+        ? element.get_document().view()
+        : bsoncxx::document::view();
+      append(key, current);
+      byKey.erase(key);
+    }
+
+    // Keys the document did not have yet go at the end, in the order they were given
+    for (const auto& key : order) {
+      if (byKey.find(key) != byKey.end()) append(key, bsoncxx::document::view());
+    }
+
+    return out.extract();
+  }
+
+  bsoncxx::document::value applySet(const bsoncxx::document::view& document, const bsoncxx::document::view& fields) {
+    std::vector<setField> parsed;
+    for (const auto& element : fields) {
+      setField field;
+      const std::string_view key = element.key();
+      size_t start = 0;
+      while (true) {
+        const size_t dot = key.find('.', start);
+        field.path.emplace_back(key.substr(start, dot == std::string_view::npos ? std::string_view::npos : dot - start));
+        if (dot == std::string_view::npos) break;
+        start = dot + 1;
+      }
+      field.value = element.get_value();
+      parsed.push_back(std::move(field));
+    }
+
+    std::vector<const setField*> pointers;
+    pointers.reserve(parsed.size());
+    for (const auto& field : parsed) pointers.push_back(&field);
+
+    return applySet(document, pointers, 0);
+  }
+}
+
+MemoryStorage::MemoryStorage(const std::string& journalPath) : journal_path_(journalPath) {
+  if (!journal_path_.empty()) replay();
+}
+
+MemoryStorage::~MemoryStorage() {
+  if (journal_fd_ >= 0) ::close(journal_fd_);
+}
+
+/* Devices */
+void MemoryStorage::insertDevice(const bsoncxx::document::view& device) {
+  const std::string nickname = stringField(device["device"]["name"]);
+
+  std::unique_lock lock(mutex_);
+  if (contains(collection::devices, nickname)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, "Device " + nickname + " exists already.");
+  }
+  put(collection::devices, nickname, device);
+}
+
+void MemoryStorage::updateDevice(const std::string& nickname, const bsoncxx::document::view& fields) {
+  std::unique_lock lock(mutex_);
+  update(collection::devices, nickname, fields);
+}
+
+void MemoryStorage::updateDevices(const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) {
+  std::unique_lock lock(mutex_);
+  for (const auto& [nickname, fields] : updates) {
+    if (contains(collection::devices, nickname)) update(collection::devices, nickname, fields.view());
+  }
+}
+
+void MemoryStorage::deleteDevice(const std::string& nickname) {
+  std::unique_lock lock(mutex_);
+  if (!erase(collection::devices, nickname)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND, "No device " + nickname);
+  }
+}
+
+std::optional<bsoncxx::document::value> MemoryStorage::findDevice(const std::string& nickname) {
+  std::shared_lock lock(mutex_);
+  return find(collection::devices, nickname);
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findDevices() {
+  std::shared_lock lock(mutex_);
+  return all(collection::devices);
+}
+
+/* Users */
+void MemoryStorage::insertUser(const bsoncxx::document::view& user) {
+  const std::string username = stringField(user["username"]);
+
+  std::unique_lock lock(mutex_);
+  if (contains(collection::users, username)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, "User " + username + " exists already.");
+  }
+  put(collection::users, username, user);
+}
+
+void MemoryStorage::updateUser(const std::string& username, const bsoncxx::document::view& fields) {
+  std::unique_lock lock(mutex_);
+  update(collection::users, username, fields);
+}
+
+void MemoryStorage::deleteUser(const std::string& username) {
+  std::unique_lock lock(mutex_);
+  if (!erase(collection::users, username)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND, "No user " + username);
+  }
+}
+
+std::optional<bsoncxx::document::value> MemoryStorage::findUser(const std::string& username) {
+  std::shared_lock lock(mutex_);
+  return find(collection::users, username);
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findUsers() {
+  std::shared_lock lock(mutex_);
+  return all(collection::users);
+}
+
+/* Settings */
+void MemoryStorage::insertSettings(const bsoncxx::document::view& settings) {
+  std::unique_lock lock(mutex_);
+  put(collection::settings, "", settings);
+}
+
+void MemoryStorage::updateSettings(const bsoncxx::document::view& fields) {
+  std::unique_lock lock(mutex_);
+  update(collection::settings, "", fields);
+}
+
+std::optional<bsoncxx::document::value> MemoryStorage::findSettings() {
+  std::shared_lock lock(mutex_);
+  return find(collection::settings, "");
+}
+
+/* Host keys */
+void MemoryStorage::insertHostKeys(const std::vector<bsoncxx::document::value>& entries) {
+  std::unique_lock lock(mutex_);
+
+  bool duplicate = false;
+  for (const auto& entry : entries) {
+    const auto view = entry.view();
+    const std::string key = hostKey(stringField(view["host"]), view["port"].get_int32().value);
+    if (contains(collection::hostKeys, key)) {
+      duplicate = true;
+      continue;
+    }
+    put(collection::hostKeys, key, view);
+  }
+
+  if (duplicate) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, "Host key pinned already.");
+  }
+}
+
+void MemoryStorage::deleteHostKey(const std::string& host, int port) {
+  std::unique_lock lock(mutex_);
+  if (!erase(collection::hostKeys, hostKey(host, port))) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND, "No host key for " + hostKey(host, port));
+  }
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findHostKeys() {
+  std::shared_lock lock(mutex_);
+  return all(collection::hostKeys);
+}
+
+/* Snapshots */
+void MemoryStorage::insertSnapshot(const bsoncxx::document::view& entry) {
+  std::unique_lock lock(mutex_);
+  const std::string nickname = stringField(entry["device"]);
+  journal(operation::put, collection::snapshots, nickname, bytesOf(entry));
+  apply(operation::put, collection::snapshots, nickname, bytesOf(entry));
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findSnapshots(
+  const std::string& nickname,
+  std::optional<std::chrono::system_clock::time_point> at,
+  std::optional<int> limit
+) {
+  std::shared_lock lock(mutex_);
+
+  std::vector<bsoncxx::document::value> results;
+  auto entries = snapshots_.find(nickname);
+  if (entries == snapshots_.end()) return results;
+
+  for (auto entry = entries->second.rbegin(); entry != entries->second.rend(); ++entry) {
+    if (limit && static_cast<int>(results.size()) >= *limit) break;
+    if (at && takenAt(entry->view()) > *at) continue;
+    results.push_back(*entry);
+  }
+  return results;
+}
+
+void MemoryStorage::storeBlob(const std::string& hash, std::string_view blob, const std::string&, const std::string&) {
+  std::unique_lock lock(mutex_);
+  if (blobs_.find(hash) != blobs_.end()) return;
+
+  journal(operation::put, collection::blobs, hash, blob);
+  apply(operation::put, collection::blobs, hash, blob);
+}
+
+std::string MemoryStorage::getBlob(const std::string& hash) {
+  std::shared_lock lock(mutex_);
+  auto blob = blobs_.find(hash);
+  if (blob == blobs_.end()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No configuration blob " + hash);
+  }
+  return blob->second;
+}
+
+/* Fleet runs */
+void MemoryStorage::insertRun(const bsoncxx::document::view& run) {
+  const std::string runId = stringField(run["id"]);
+
+  std::unique_lock lock(mutex_);
+  if (contains(collection::runs, runId)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, "Run " + runId + " exists already.");
+  }
+  put(collection::runs, runId, run);
+}
+
+void MemoryStorage::updateRun(const std::string& runId, const bsoncxx::document::view& fields) {
+  std::unique_lock lock(mutex_);
+  update(collection::runs, runId, fields);
+}
+
+std::optional<bsoncxx::document::value> MemoryStorage::findRun(const std::string& runId) {
+  std::shared_lock lock(mutex_);
+  return find(collection::runs, runId);
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findRuns(std::optional<int> limit) {
+  std::shared_lock lock(mutex_);
+
+  std::vector<bsoncxx::document::value> results;
+  for (auto run = runs_.documents.rbegin(); run != runs_.documents.rend(); ++run) {
+    if (limit && static_cast<int>(results.size()) >= *limit) break;
+    if (*run) results.push_back(**run);
+  }
+  return results;
+}
+
+void MemoryStorage::updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  std::unique_lock lock(mutex_);
+  for (const auto& [device, fields] : updates) {
+    const std::string key = runDeviceKey(runId, device);
+
+    // An upsert, the first update of a device starts from its filter fields
+    auto current = find(collection::runDevices, key);
+    const auto base = current ? std::move(*current) : make_document(kvp("run", runId), kvp("device", device));
+    const auto updated = applySet(base.view(), fields.view());
+    put(collection::runDevices, key, updated.view());
+  }
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findRunDevices(const std::string& runId) {
+  std::shared_lock lock(mutex_);
+
+  std::vector<bsoncxx::document::value> results;
+  for (const auto& document : run_devices_.documents) {
+    if (document && stringField(document->view()["run"]) == runId) results.push_back(*document);
+  }
+  return results;
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::findRunSnapshots(const std::string& runId) {
+  std::shared_lock lock(mutex_);
+
+  std::vector<bsoncxx::document::value> results;
+  for (const auto& [nickname, entries] : snapshots_) {
+    for (const auto& entry : entries) {
+      if (stringField(entry.view()["run"]) == runId) results.push_back(entry);
+    }
+  }
+  return results;
+}
+
+/* Tables, callers hold the lock */
+MemoryStorage::table& MemoryStorage::tableOf(collection name) {
+  return const_cast<table&>(static_cast<const MemoryStorage*>(this)->tableOf(name));
+}
+
+const MemoryStorage::table& MemoryStorage::tableOf(collection name) const {
+  switch (name) {
+    case collection::devices: return devices_;
+    case collection::users: return users_;
+    case collection::settings: return settings_;
+    case collection::runs: return runs_;
+    case collection::runDevices: return run_devices_;
+    default: return host_keys_;
+  }
+}
+
+void MemoryStorage::put(collection name, const std::string& key, const bsoncxx::document::view& document) {
+  journal(operation::put, name, key, bytesOf(document));
+  apply(operation::put, name, key, bytesOf(document));
+}
+
+bool MemoryStorage::erase(collection name, const std::string& key) {
+  if (!contains(name, key)) return false;
+
+  journal(operation::erase, name, key, {});
+  apply(operation::erase, name, key, {});
+  return true;
+}
+
+void MemoryStorage::update(collection name, const std::string& key, const bsoncxx::document::view& fields) {
+  auto current = find(name, key);
+  if (!current) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND, "No matching document found to update.");
+  }
+
+  // The journal gets the whole updated document, replaying it needs no earlier state
+  const auto updated = applySet(current->view(), fields);
+  put(name, key, updated.view());
+}
+
+bool MemoryStorage::contains(collection name, const std::string& key) const {
+  const table& documents = tableOf(name);
+  return documents.index.find(key) != documents.index.end();
+}
+
+std::optional<bsoncxx::document::value> MemoryStorage::find(collection name, const std::string& key) const {
+  const table& documents = tableOf(name);
+  auto found = documents.index.find(key);
+  if (found == documents.index.end()) return std::nullopt;
+  return documents.documents[found->second];
+}
+
+std::vector<bsoncxx::document::value> MemoryStorage::all(collection name) const {
+  const table& documents = tableOf(name);
+
+  std::vector<bsoncxx::document::value> results;
+  results.reserve(documents.index.size());
+  for (const auto& document : documents.documents) {
+    if (document) results.push_back(*document);
+  }
+  return results;
+}
+
+void MemoryStorage::apply(operation op, collection name, const std::string& key, std::string_view payload) {
+  if (name == collection::blobs) {
+    if (op == operation::put) blobs_.emplace(key, std::string(payload));
+    else blobs_.erase(key);
+    return;
+  }
+
+  if (name == collection::snapshots) {
+    if (op == operation::erase) {
+      snapshots_.erase(key);
+      return;
+    }
+
+    // Entries come in time order, the search only matters for a clock that stepped back
+    auto entry = documentOf(payload);
+    auto& entries = snapshots_[key];
+    const auto at = takenAt(entry.view());
+    auto position = std::upper_bound(entries.begin(), entries.end(), at, [](const auto& time, const auto& other) {
+      return time < takenAt(other.view());
+    });
+    entries.insert(position, std::move(entry));
+    return;
+  }
+
+  table& documents = tableOf(name);
+  auto found = documents.index.find(key);
+
+  if (op == operation::erase) {
+    if (found == documents.index.end()) return;
+    documents.documents[found->second].reset();
+    documents.index.erase(found);
+    return;
+  }
+
+  if (found != documents.index.end()) {
+    documents.documents[found->second] = documentOf(payload);
+    return;
+  }
+
+  documents.index.emplace(key, documents.documents.size());
+  documents.documents.emplace_back(documentOf(payload));
+}
+
+/* Journal */
+void MemoryStorage::journal(operation op, collection name, const std::string& key, std::string_view payload) {
+  if (journal_fd_ < 0) return;
+  if (journal_failed_) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, journal_path_ + ": a torn record could not be removed, the store is read only");
+  }
+
+  const std::string record = encodeRecord(static_cast<uint8_t>(op), static_cast<uint8_t>(name), key, payload);
+
+  // Written before the change is applied, what a reader saw is in the file
+  if (!writeAll(journal_fd_, record)) {
+    const int error = errno;
+
+    // Whatever part of the record made it is cut off again, the next record follows the last complete one
+    if (ftruncate(journal_fd_, journal_size_) != 0) journal_failed_ = true;
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, journal_path_ + ": " + std::strerror(error));
+  }
+  journal_size_ += static_cast<off_t>(record.size());
+}
+
+void MemoryStorage::replay() {
+  std::string content;
+  {
+    std::ifstream in(journal_path_, std::ios::binary);
+    if (in) content.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  }
+
+  const size_t fixed = sizeof(FILE_MAGIC) + sizeof(uint32_t);
+  size_t complete = 0;
+  size_t records = 0;
+
+  if (!content.empty()) {
+    if (content.size() < fixed || std::memcmp(content.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_CORRUPT, journal_path_ + ": not a storage journal");
+    }
+
+    uint32_t version;
+    std::memcpy(&version, content.data() + sizeof(FILE_MAGIC), sizeof(version));
+    if (version != FILE_VERSION) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_CORRUPT, journal_path_ + ": unsupported version " + std::to_string(version));
+    }
+
+    // A write cut short by a crash leaves a partial record at the end, everything before it stands
+    size_t pos = complete = fixed;
+    while (pos + 2 <= content.size()) {
+      const uint8_t op = static_cast<uint8_t>(content[pos]);
+      const uint8_t name = static_cast<uint8_t>(content[pos + 1]);
+      if (op >= OPERATION_COUNT || name >= COLLECTION_COUNT) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_CORRUPT, journal_path_ + ": bad record at offset " + std::to_string(pos));
+      }
+      pos += 2;
+
+      std::string_view key, payload;
+      if (!getBytes(content, pos, key) || !getBytes(content, pos, payload)) break;
+
+      apply(static_cast<operation>(op), static_cast<collection>(name), std::string(key), payload);
+      complete = pos;
+      records++;
+    }
+  }
+
+  size_t live = devices_.index.size() + users_.index.size() + settings_.index.size() + host_keys_.index.size() + runs_.index.size()
+    + run_devices_.index.size() + blobs_.size();
+  for (const auto& [nickname, entries] : snapshots_) live += entries.size();
+
+  if (records > live) {
+    compact();
+  } else if (complete != content.size()) {
+    if (truncate(journal_path_.c_str(), static_cast<off_t>(complete)) != 0) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, journal_path_ + ": " + std::strerror(errno));
+    }
+  }
+
+  journal_fd_ = ::open(journal_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (journal_fd_ < 0) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, journal_path_ + ": " + std::strerror(errno));
+  }
+
+  journal_size_ = ::lseek(journal_fd_, 0, SEEK_END);
+  bool opened = journal_size_ >= 0;
+  if (opened && journal_size_ == 0) {
+    const std::string header = fileHeader();
+    opened = writeAll(journal_fd_, header);
+    journal_size_ = static_cast<off_t>(header.size());
+  }
+
+  if (!opened) {
+    const int error = errno;
+    ::close(journal_fd_);
+    journal_fd_ = -1;
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, journal_path_ + ": " + std::strerror(error));
+  }
+}
+
+// Writes the live documents to a new file and puts it in place of the journal in one rename
+void MemoryStorage::compact() {
+  const std::string path = journal_path_ + ".tmp";
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  std::FILE* file = fd < 0 ? nullptr : ::fdopen(fd, "wb");
+  if (file == nullptr) {
+    const int error = errno;
+    if (fd >= 0) ::close(fd);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, path + ": " + std::strerror(error));
+  }
+
+  bool written = true;
+  auto write = [&](std::string_view data) {
+    written = written && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  };
+
+  write(fileHeader());
+
+  for (collection name : {collection::devices, collection::users, collection::settings, collection::hostKeys, collection::runs, collection::runDevices}) {
+    const table& documents = tableOf(name);
+
+    std::vector<std::pair<size_t, const std::string*>> keys;
+    keys.reserve(documents.index.size());
+    for (const auto& [key, position] : documents.index) keys.emplace_back(position, &key);
+    std::sort(keys.begin(), keys.end());
+
+    for (const auto& [position, key] : keys) {
+      write(encodeRecord(static_cast<uint8_t>(operation::put), static_cast<uint8_t>(name), *key, bytesOf(documents.documents[position]->view())));
+    }
+  }
+
+  for (const auto& [nickname, entries] : snapshots_) {
+    for (const auto& entry : entries) {
+      write(encodeRecord(static_cast<uint8_t>(operation::put), static_cast<uint8_t>(collection::snapshots), nickname, bytesOf(entry.view())));
+    }
+  }
+
+  for (const auto& [hash, blob] : blobs_) {
+    write(encodeRecord(static_cast<uint8_t>(operation::put), static_cast<uint8_t>(collection::blobs), hash, blob));
+  }
+
+  written = std::fflush(file) == 0 && written;
+  std::fclose(file);
+
+  if (!written || std::rename(path.c_str(), journal_path_.c_str()) != 0) {
+    std::remove(path.c_str());
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_JOURNAL_FAILED, path + ": could not rewrite the journal");
+  }
+}
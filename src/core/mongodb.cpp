@@ -1,10 +1,16 @@
 #include "core/mongodb.hpp"
+#include <chrono>
 #include <mongocxx/client.hpp>
 #include <mongocxx/database.hpp>
 #include <mongocxx/instance.hpp>
 #include <mongocxx/uri.hpp>
 #include <mongocxx/exception/exception.hpp>
+#include <mongocxx/exception/bulk_write_exception.hpp>
 #include <mongocxx/options/find.hpp>
+#include <mongocxx/options/insert.hpp>
+#include <mongocxx/options/bulk_write.hpp>
+#include <mongocxx/model/update_one.hpp>
+#include <mongocxx/bulk_write.hpp>
 #include <bsoncxx/json.hpp>
 #include "core/error_handler.hpp"
 
@@ -30,30 +36,91 @@ void MongoDB::initDatabase() {
   db_["devices"].create_index(index_keys.view(), index_options);
 
   db_.create_collection("settings");
+
+  db_.create_collection("hostkeys");
+  auto hostkey_index_keys = bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("host", 1),
+    bsoncxx::builder::basic::kvp("port", 1)
+  );
+  db_["hostkeys"].create_index(hostkey_index_keys.view(), index_options);
+
+  db_.create_collection("configs");
+  auto config_index_keys = bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("hash", 1),
+    bsoncxx::builder::basic::kvp("n", 1)
+  );
+  db_["configs"].create_index(config_index_keys.view(), index_options);
+
+  db_.create_collection("snapshots");
+  auto snapshot_index_keys = bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("device", 1),
+    bsoncxx::builder::basic::kvp("takenAt", -1)
+  );
+  db_["snapshots"].create_index(snapshot_index_keys.view());
+  db_["snapshots"].create_index(bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", 1)).view());
+  mongocxx::options::index sparse_index_options{};
+  sparse_index_options.sparse(true);
+  db_["snapshots"].create_index(bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("run", 1)).view(), sparse_index_options);
+
+  db_.create_collection("dictionaries");
+  auto dictionary_index_keys = bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("vendor", 1),
+    bsoncxx::builder::basic::kvp("version", -1)
+  );
+  db_["dictionaries"].create_index(dictionary_index_keys.view(), index_options);
+
+  db_.create_collection("outputcache");
+  auto cache_index_keys = bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("expiresAt", 1));
+  mongocxx::options::index cache_index_options{};
+  cache_index_options.expire_after(std::chrono::seconds(0));
+  db_["outputcache"].create_index(cache_index_keys.view(), cache_index_options);
+
+  db_.create_collection("runs");
+  db_["runs"].create_index(bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("id", 1)).view(), index_options);
+
+  db_.create_collection("rundevices");
+  auto run_device_index_keys = bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("run", 1),
+    bsoncxx::builder::basic::kvp("device", 1)
+  );
+  db_["rundevices"].create_index(run_device_index_keys.view(), index_options);
 }
 
 MongoDB::MongoDB() {ensureInstance();}
 
-void MongoDB::connect() {
-  client_ = mongocxx::client{mongocxx::uri{
-    "mongodb://" +
+std::string MongoDB::connectionUri() {
+  return "mongodb://" +
     databaseUser_ + ":" + databaseUserPassword_ +
-    "@localhost:27017/" + databaseName_ + "?authSource=admin"
-  }};
+    "@localhost:27017/" + databaseName_ + "?authSource=admin";
+}
+
+// A client is not thread safe, threads that write on their own connect a MongoDB of their own without initializing
+void MongoDB::connect(bool initialize) {
+  client_ = mongocxx::client{mongocxx::uri{connectionUri()}};
 
   db_ = client_[databaseName_];
   users_c = db_["users"];
   devices_c = db_["devices"];
   settings_c = db_["settings"];
+  hostkeys_c = db_["hostkeys"];
+  configs_c = db_["configs"];
+  snapshots_c = db_["snapshots"];
+  dictionaries_c = db_["dictionaries"];
+  runs_c = db_["runs"];
+  rundevices_c = db_["rundevices"];
 
   try {
-    initDatabase();
+    if (initialize) initDatabase();
     connected = true;
   } catch (const mongocxx::exception& e) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, e.what());
   }
 }
 
+mongocxx::collection MongoDB::collection(const std::string& name) {
+  return db_[name];
+}
+
 void MongoDB::insertDocument(mongocxx::collection& collection, const bsoncxx::document::view_or_value& doc) {
 	try {
 		auto result = collection.insert_one(doc.view());
@@ -82,6 +149,76 @@ void MongoDB::insertDocument(mongocxx::collection& collection, const bsoncxx::do
   }
 }
 
+void MongoDB::insertDocuments(mongocxx::collection& collection, const std::vector<bsoncxx::document::value>& docs) {
+  if (docs.empty()) return;
+
+  // Unordered so one duplicate does not stop the rest of the batch
+  mongocxx::options::insert opts;
+  opts.ordered(false);
+
+  try {
+    auto result = collection.insert_many(docs, opts);
+    if (!result) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED, "Bulk insert failed with no result.");
+    }
+  } catch (const ChronicleException& e) {
+    throw;
+  } catch (const mongocxx::exception& e) {
+    if (e.code().value() == 11000) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, e.what());
+    }
+
+    std::string fullMessage =
+      "Bulk insert failure.\n"
+      "Collection: " + std::string(collection.name()) + "\n"
+      "Documents: " + std::to_string(docs.size()) + "\n"
+      "Error: " + e.what();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED, fullMessage);
+  }
+}
+
+// Same unordered insert, but the documents the server refused come back instead of one exception for
+// the batch. Only a failure that names no document (network, auth) still throws
+std::vector<bulkWriteError> MongoDB::insertDocumentsReport(mongocxx::collection& collection, const std::vector<bsoncxx::document::value>& docs) {
+  if (docs.empty()) return {};
+
+  mongocxx::options::insert opts;
+  opts.ordered(false);
+
+  try {
+    auto result = collection.insert_many(docs, opts);
+    if (!result) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED, "Bulk insert failed with no result.");
+    }
+    return {};
+  } catch (const ChronicleException& e) {
+    throw;
+  } catch (const mongocxx::bulk_write_exception& e) {
+    std::vector<bulkWriteError> errors;
+    if (e.raw_server_error()) {
+      const auto writeErrors = e.raw_server_error()->view()["writeErrors"];
+      if (writeErrors && writeErrors.type() == bsoncxx::type::k_array) {
+        for (const auto& element : writeErrors.get_array().value) {
+          const auto error = element.get_document().view();
+          const auto index = error["index"];
+          errors.push_back({
+            static_cast<size_t>(index.type() == bsoncxx::type::k_int64 ? index.get_int64().value : index.get_int32().value),
+            error["code"].get_int32().value,
+            std::string(error["errmsg"].get_string().value)
+          });
+        }
+      }
+    }
+    if (!errors.empty()) return errors;
+
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED,
+      "Bulk insert failure.\nCollection: " + std::string(collection.name()) + "\nError: " + e.what());
+  } catch (const mongocxx::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_INSERT_FAILED,
+      "Bulk insert failure.\nCollection: " + std::string(collection.name()) + "\nError: " + e.what());
+  }
+}
+
 void MongoDB::updateDocument(mongocxx::collection& collection, bsoncxx::builder::basic::document& queryFilter, const bsoncxx::document::view_or_value& doc) {
   bsoncxx::builder::basic::document updateDoc;
   updateDoc.append(bsoncxx::builder::basic::kvp("$set", doc));
@@ -116,6 +253,53 @@ void MongoDB::updateDocument(mongocxx::collection& collection, bsoncxx::builder:
 	}
 }
 
+void MongoDB::updateDocuments(mongocxx::collection& collection, const std::vector<std::pair<bsoncxx::document::value, bsoncxx::document::value>>& updates, bool upsert, bool ordered) {
+  if (updates.empty()) return;
+
+  // One round trip for the whole batch, each pair is (query filter, fields to $set). Ordered
+  // stops at the first failed update, the ones after it are not tried
+  mongocxx::options::bulk_write opts;
+  opts.ordered(ordered);
+  auto bulk = collection.create_bulk_write(opts);
+
+  for (const auto& update : updates) {
+    mongocxx::model::update_one model{
+      update.first.view(),
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("$set", update.second.view()))
+    };
+    model.upsert(upsert);
+    bulk.append(model);
+  }
+
+  try {
+    auto result = bulk.execute();
+    if (!result) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_UPDATE_FAILED, "Bulk update failed with no result.");
+    }
+  } catch (const ChronicleException& e) {
+    throw;
+  } catch (const mongocxx::exception& e) {
+    // An upsert whose filter missed a document the unique index already holds
+    if (e.code().value() == 11000) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DUPLICATE, e.what());
+    }
+
+    std::string fullMessage =
+      "MongoDB bulk update failed.\n"
+      "Collection: " + std::string(collection.name()) + "\n"
+      "Updates: " + std::to_string(updates.size()) + "\n"
+      "Error: " + e.what();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_UPDATE_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    std::string fullMessage =
+      "MongoDB bulk update failed.\n"
+      "Collection: " + std::string(collection.name()) + "\n"
+      "Updates: " + std::to_string(updates.size()) + "\n"
+      "Error: " + e.what();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_UPDATE_FAILED, fullMessage);
+  }
+}
+
 void MongoDB::deleteDocument(mongocxx::collection& collection,  bsoncxx::builder::basic::document& queryFilter) {
   try {
     auto result = collection.delete_one(queryFilter.view());
@@ -148,11 +332,37 @@ void MongoDB::deleteDocument(mongocxx::collection& collection,  bsoncxx::builder
   }
 }
 
+int64_t MongoDB::deleteDocuments(mongocxx::collection& collection, const bsoncxx::document::view_or_value& filter) {
+  try {
+    auto result = collection.delete_many(filter.view());
+
+    if (!result) {
+      std::string fullMessage =
+        "No result returned from delete_many.\n"
+        "Collection: " + std::string(collection.name()) + "\n"
+        "Query filter: " + bsoncxx::to_json(filter);
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DELETE_DOCUMENT, fullMessage);
+    }
+
+    return result->deleted_count();
+
+  } catch (const ChronicleException& e) {
+    throw;
+  } catch (const std::exception& e) {
+    std::string fullMessage =
+      "MongoDB bulk delete failed.\n"
+      "Collection: " + std::string(collection.name()) + "\n"
+      "Error: " + e.what();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_DELETE_DOCUMENT, fullMessage);
+  }
+}
+
 std::vector<bsoncxx::document::value> MongoDB::findDocuments(
   mongocxx::collection& collection,
   const bsoncxx::document::view_or_value& filter,
   const bsoncxx::document::view_or_value& projection,
-  std::optional<int> limit
+  std::optional<int> limit,
+  std::optional<bsoncxx::document::view_or_value> sort
 ) {
   mongocxx::options::find opts;
 
@@ -160,6 +370,10 @@ std::vector<bsoncxx::document::value> MongoDB::findDocuments(
       opts.limit(*limit);
   }
 
+  if (sort.has_value()) {
+      opts.sort(*sort);
+  }
+
   opts.projection(projection);
 
   std::vector<bsoncxx::document::value> results;
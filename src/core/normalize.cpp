@@ -0,0 +1,64 @@
+#include "core/normalize.hpp"
+#include "core/error_handler.hpp"
+
+Normalizer::Normalizer(const std::vector<NormalizeRule>& rules) {
+  rules_.reserve(rules.size());
+
+  for (const auto& rule : rules) {
+    compiledRule compiled{rule.kind, rule.pattern, std::regex(), rule.replacement};
+
+    switch (rule.kind) {
+      case CHRONICLE_NORMALIZE_DROP_PREFIX:
+        break;
+      case CHRONICLE_NORMALIZE_DROP_MATCH:
+      case CHRONICLE_NORMALIZE_REPLACE:
+        try {
+          compiled.regex = std::regex(rule.pattern, std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+          THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_INVALID_NORMALIZE_RULE, "Pattern \"" + rule.pattern + "\": " + e.what());
+        }
+        break;
+      default:
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_INVALID_NORMALIZE_RULE, "Unknown rule kind " + std::to_string(rule.kind));
+    }
+
+    rules_.push_back(std::move(compiled));
+  }
+}
+
+void Normalizer::apply(std::vector<std::string>& lines) const {
+  if (rules_.empty()) return;
+
+  size_t kept = 0;
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::string& line = lines[i];
+    bool drop = false;
+
+    for (const auto& rule : rules_) {
+      if (rule.kind == CHRONICLE_NORMALIZE_DROP_PREFIX) {
+        size_t indent = line.find_first_not_of(" \t");
+        if (indent != std::string::npos && line.compare(indent, rule.pattern.size(), rule.pattern) == 0) {
+          drop = true;
+        }
+      } else if (rule.kind == CHRONICLE_NORMALIZE_DROP_MATCH) {
+        drop = std::regex_search(line, rule.regex);
+      } else if (std::regex_search(line, rule.regex)) {
+        line = std::regex_replace(line, rule.regex, rule.replacement);
+      }
+
+      if (drop) break;
+    }
+
+    if (drop) continue;
+    if (kept != i) lines[kept] = std::move(line);
+    kept++;
+  }
+
+  lines.resize(kept);
+}
+
+std::vector<std::string> normalizeLines(std::vector<std::string> lines, const std::vector<NormalizeRule>& rules) {
+  Normalizer(rules).apply(lines);
+  return lines;
+}
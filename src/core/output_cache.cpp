@@ -0,0 +1,270 @@
+#include "core/output_cache.hpp"
+#include "core/error_handler.hpp"
+#include "core/hash.hpp"
+#include "core/mongodb.hpp"
+#include "core/snapshot.hpp"
+#include "core/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/exception/exception.hpp>
+#include <mongocxx/options/update.hpp>
+
+namespace {
+  int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  std::string cacheKey(const std::string& device, const std::vector<OperationMap>& operations, int channelMode,
+                       const std::vector<std::string>& pagerPrompts) {
+    std::string key = device;
+    key += '\0';
+    key += std::to_string(channelMode);
+    for (const auto& prompt : pagerPrompts) {
+      key += '\0';
+      key += "pager:" + prompt;
+    }
+    for (const auto& op : operations) {
+      key += '\0';
+      key += op.command;
+      key += ":" + std::to_string(op.skip_head) + ":" + std::to_string(op.skip_tail);
+    }
+    return contentHash(key);
+  }
+
+  bool contains(const std::vector<std::string>& commands, const std::string& command) {
+    return std::find(commands.begin(), commands.end(), command) != commands.end();
+  }
+}
+
+OutputCache& OutputCache::instance() {
+  static OutputCache cache;
+  return cache;
+}
+
+void OutputCache::enable(bool useDatabase) {
+  std::unique_ptr<MongoDB> db;
+  if (useDatabase) {
+    db = std::make_unique<MongoDB>();
+    db->connect(false);
+  }
+
+  std::lock_guard<std::mutex> dbLock(dbMutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  db_ = std::move(db);
+  useDatabase_ = useDatabase;
+  enabled_ = true;
+}
+
+void OutputCache::disable() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  enabled_ = false;
+  entries_.clear();
+}
+
+bool OutputCache::enabled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return enabled_;
+}
+
+Result<std::vector<std::string>> OutputCache::fetch(const std::string& device, const std::vector<OperationMap>& operations,
+                                                    int channelMode, const std::vector<std::string>& pagerPrompts,
+                                                    const fetcher& fetch) {
+  const int ttl = operations.empty() ? 0 : operations.back().cache_ttl;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!enabled_ || ttl <= 0) {
+    lock.unlock();
+    return fetch();
+  }
+
+  const std::string key = cacheKey(device, operations, channelMode, pagerPrompts);
+  const int64_t now = nowMs();
+
+  auto cached = entries_.find(key);
+  if (cached != entries_.end() && cached->second.expires_at > now) {
+    stats_.hits++;
+    return cached->second.output;
+  }
+
+  auto running = inflight_.find(key);
+  if (running != inflight_.end()) {
+    stats_.coalesced++;
+    std::shared_future<Result<std::vector<std::string>>> pending = running->second;
+    lock.unlock();
+    return pending.get();
+  }
+
+  std::promise<Result<std::vector<std::string>>> promise;
+  inflight_.emplace(key, promise.get_future().share());
+  const uint64_t generation = generation_;
+  const bool useDatabase = useDatabase_;
+  lock.unlock();
+
+  entry found;
+  found.device = device;
+  for (const auto& op : operations) found.commands.push_back(op.command);
+
+  bool fromDatabase = false;
+  std::optional<Result<std::vector<std::string>>> result;
+
+  try {
+    if (useDatabase && loadStored(key, found) && found.expires_at > now) {
+      fromDatabase = true;
+      result.emplace(found.output);
+    } else {
+      TraceSpan span("OutputCache::miss", device);
+      result.emplace(fetch());
+      if (result->ok()) {
+        found.expires_at = nowMs() + static_cast<int64_t>(ttl) * 1000;
+        found.output = result->value();
+      }
+    }
+  } catch (...) {
+    lock.lock();
+    inflight_.erase(key);
+    lock.unlock();
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  lock.lock();
+  inflight_.erase(key);
+  fromDatabase ? stats_.database_hits++ : stats_.misses++;
+
+  // Nothing is kept from a fetch that raced an invalidation of its device
+  const bool keep = result->ok() && enabled_ && generation == generation_;
+  if (keep) {
+    evict(now);
+    entries_[key] = found;
+  }
+  lock.unlock();
+
+  if (keep && useDatabase && !fromDatabase) store(key, found);
+
+  promise.set_value(*result);
+  return std::move(*result);
+}
+
+void OutputCache::evict(int64_t now) {
+  if (entries_.size() < CHRONICLE_CACHE_MAX_ENTRIES) return;
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    it = it->second.expires_at <= now ? entries_.erase(it) : std::next(it);
+  }
+
+  // Still full of live entries, the one closest to expiring goes
+  if (entries_.size() >= CHRONICLE_CACHE_MAX_ENTRIES) {
+    auto soonest = std::min_element(entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+      return a.second.expires_at < b.second.expires_at;
+    });
+    entries_.erase(soonest);
+  }
+}
+
+// The database is a second level, when it is unavailable the cache behaves as a miss
+bool OutputCache::loadStored(const std::string& key, entry& found) {
+  std::lock_guard<std::mutex> lock(dbMutex_);
+  if (!db_) return false;
+
+  try {
+    auto collection = db_->collection(CHRONICLE_CACHE_COLLECTION);
+    auto doc = collection.find_one(bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("_id", key)));
+    if (!doc) return false;
+
+    const auto view = doc->view();
+    found.expires_at = view["expiresAt"].get_date().value.count();
+    found.output = splitSnapshotLines(std::string_view(view["output"].get_string().value));
+    return true;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+void OutputCache::store(const std::string& key, const entry& stored) {
+  std::lock_guard<std::mutex> lock(dbMutex_);
+  if (!db_) return;
+
+  bsoncxx::builder::basic::array commands;
+  for (const auto& command : stored.commands) commands.append(command);
+
+  bsoncxx::builder::basic::document fields;
+  fields.append(
+    bsoncxx::builder::basic::kvp("device", stored.device),
+    bsoncxx::builder::basic::kvp("commands", commands.extract()),
+    bsoncxx::builder::basic::kvp("expiresAt", bsoncxx::types::b_date{std::chrono::milliseconds(stored.expires_at)}),
+    bsoncxx::builder::basic::kvp("output", joinSnapshotLines(stored.output))
+  );
+
+  mongocxx::options::update opts;
+  opts.upsert(true);
+
+  try {
+    auto collection = db_->collection(CHRONICLE_CACHE_COLLECTION);
+    collection.update_one(
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("_id", key)),
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("$set", fields.extract())),
+      opts
+    );
+  } catch (const std::exception&) {
+    // Still cached in memory, the next process just misses
+  }
+}
+
+size_t OutputCache::invalidate(const std::string& device, const std::string& command) {
+  size_t removed = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      const bool match = it->second.device == device && (command.empty() || contains(it->second.commands, command));
+      if (match) removed++;
+      it = match ? entries_.erase(it) : std::next(it);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(dbMutex_);
+  if (!db_) return removed;
+
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("device", device));
+  if (!command.empty()) filter.append(bsoncxx::builder::basic::kvp("commands", command));
+
+  // The generation bump above already keeps this process from serving them, others wait out the TTL
+  try {
+    auto collection = db_->collection(CHRONICLE_CACHE_COLLECTION);
+    removed = std::max<size_t>(removed, static_cast<size_t>(db_->deleteDocuments(collection, filter.extract())));
+  } catch (const std::exception&) {
+  }
+  return removed;
+}
+
+void OutputCache::clear() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    entries_.clear();
+  }
+
+  std::lock_guard<std::mutex> lock(dbMutex_);
+  if (!db_) return;
+
+  try {
+    auto collection = db_->collection(CHRONICLE_CACHE_COLLECTION);
+    db_->deleteDocuments(collection, bsoncxx::builder::basic::make_document());
+  } catch (const std::exception&) {
+    // Same as invalidate(), memory is cleared and the stored entries expire on their own
+  }
+}
+
+cacheStats OutputCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cacheStats stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
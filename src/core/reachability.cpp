@@ -0,0 +1,235 @@
+#include "core/reachability.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+  using steadyClock = std::chrono::steady_clock;
+
+  inline constexpr size_t SSH_BANNER_MAX = 1024;
+
+  struct probeState {
+    size_t index;
+    int fd;
+    bool connected;
+    steadyClock::time_point started;
+    steadyClock::time_point deadline;
+    std::string banner;
+  };
+
+  // Starts a non-blocking connect to the first address that accepts one, -1 on failure
+  int startConnect(const std::string& host, int port, std::string& error) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    std::string service = std::to_string(port);
+    int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &res);
+    if (rc != 0) {
+      error = gai_strerror(rc);
+      return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd < 0) continue;
+
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || errno == EINPROGRESS) break;
+
+      error = strerror(errno);
+      close(fd);
+      fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return fd;
+  }
+
+  int finishConnect(int fd, std::string& error) {
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0) {
+      error = strerror(errno);
+      return -1;
+    }
+    if (so_error != 0) {
+      error = strerror(so_error);
+      return -1;
+    }
+
+    return 0;
+  }
+
+  int remainingMs(steadyClock::time_point deadline, steadyClock::time_point now) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+  }
+}
+
+int openTcpConnection(const std::string& host, int port, int timeout_ms, std::string& error) {
+  int fd = startConnect(host, port, error);
+  if (fd < 0) return -1;
+
+  auto deadline = steadyClock::now() + std::chrono::milliseconds(timeout_ms);
+  struct pollfd pfd = {fd, POLLOUT, 0};
+
+  while (true) {
+    int rc = poll(&pfd, 1, remainingMs(deadline, steadyClock::now()));
+    if (rc > 0) break;
+
+    if (rc == 0) {
+      error = "Connect timed out after " + std::to_string(timeout_ms) + "ms";
+      close(fd);
+      return -1;
+    }
+    if (errno != EINTR) {
+      error = strerror(errno);
+      close(fd);
+      return -1;
+    }
+  }
+
+  if (finishConnect(fd, error) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  // Hand libssh a regular blocking socket
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+
+  return fd;
+}
+
+std::vector<reachabilityResult> probeReachability(const std::vector<connectionInfo>& targets, int timeout_ms, int max_in_flight) {
+  std::vector<reachabilityResult> results(targets.size());
+  std::vector<probeState> active;
+  std::vector<struct pollfd> pfds;
+  size_t next = 0;
+
+  if (max_in_flight < 1) max_in_flight = 1;
+  active.reserve(max_in_flight);
+  pfds.reserve(max_in_flight);
+
+  for (size_t i = 0; i < targets.size(); ++i) {
+    results[i].nickname = targets[i].nickname;
+    results[i].host = targets[i].host;
+    results[i].port = targets[i].port;
+  }
+
+  while (next < targets.size() || !active.empty()) {
+    // Keep the window full
+    while (next < targets.size() && active.size() < static_cast<size_t>(max_in_flight)) {
+      std::string error;
+      int fd = startConnect(targets[next].host, targets[next].port, error);
+      auto now = steadyClock::now();
+
+      if (fd < 0) {
+        results[next].error = error;
+      } else {
+        active.push_back({next, fd, false, now, now + std::chrono::milliseconds(timeout_ms), ""});
+      }
+      ++next;
+    }
+
+    if (active.empty()) continue;
+
+    auto now = steadyClock::now();
+    int wait_ms = timeout_ms;
+    pfds.clear();
+    for (const auto& probe : active) {
+      pfds.push_back({probe.fd, static_cast<short>(probe.connected ? POLLIN : POLLOUT), 0});
+      wait_ms = std::min(wait_ms, remainingMs(probe.deadline, now));
+    }
+
+    int rc = poll(pfds.data(), pfds.size(), wait_ms);
+    if (rc < 0 && errno != EINTR) {
+      std::string error = strerror(errno);
+      for (auto& probe : active) {
+        results[probe.index].error = error;
+        close(probe.fd);
+      }
+      active.clear();
+      continue;
+    }
+
+    now = steadyClock::now();
+
+    for (size_t i = 0; i < active.size(); ++i) {
+      auto& probe = active[i];
+      auto& result = results[probe.index];
+      bool finished = false;
+
+      if (rc > 0 && pfds[i].revents != 0) {
+        if (!probe.connected) {
+          if (finishConnect(probe.fd, result.error) < 0) {
+            finished = true;
+          } else {
+            probe.connected = true;
+          }
+        } else {
+          char buffer[256];
+          ssize_t nbytes = recv(probe.fd, buffer, sizeof(buffer), 0);
+
+          if (nbytes > 0) {
+            probe.banner.append(buffer, nbytes);
+
+            // Servers may send other lines before the identification string
+            size_t eol;
+            while (!finished && (eol = probe.banner.find('\n')) != std::string::npos) {
+              std::string line = probe.banner.substr(0, eol);
+              probe.banner.erase(0, eol + 1);
+              if (!line.empty() && line.back() == '\r') line.pop_back();
+
+              if (line.rfind("SSH-", 0) == 0) {
+                result.reachable = true;
+                result.banner = line;
+                result.latency_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now - probe.started).count());
+                finished = true;
+              }
+            }
+
+            if (!finished && probe.banner.size() > SSH_BANNER_MAX) {
+              result.error = "No SSH identification string received";
+              finished = true;
+            }
+          } else if (nbytes == 0) {
+            result.error = "Connection closed before SSH banner";
+            finished = true;
+          } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            result.error = strerror(errno);
+            finished = true;
+          }
+        }
+      }
+
+      if (!finished && now >= probe.deadline) {
+        result.error = probe.connected ? "Timed out waiting for SSH banner" : "Connect timed out";
+        finished = true;
+      }
+
+      if (finished) {
+        close(probe.fd);
+        probe.fd = -1;
+      }
+    }
+
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [](const probeState& probe) { return probe.fd < 0; }),
+                 active.end());
+  }
+
+  return results;
+}
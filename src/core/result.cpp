@@ -0,0 +1,24 @@
+#include "core/result.hpp"
+
+ChronicleError ChronicleError::fromException(const ChronicleException& e) {
+  ChronicleError error;
+  error.code_ = e.getCode();
+  error.origin_ = std::make_shared<const ChronicleException>(e);
+  return error;
+}
+
+std::string ChronicleError::details() const {
+  if (origin_) return origin_->getDetails();
+  if (describe_) return describe_();
+  return details_;
+}
+
+std::string ChronicleError::what() const {
+  if (origin_) return origin_->what();
+  return ChronicleException(code_, message(), function_, details(), file_, line_).what();
+}
+
+void ChronicleError::raise() const {
+  if (origin_) throw *origin_;
+  throw ChronicleException(code_, message(), function_, details(), file_, line_);
+}
@@ -0,0 +1,129 @@
+#include "core/snapshot.hpp"
+#include "core/diff.hpp"
+#include "core/error_handler.hpp"
+
+#include <cstdlib>
+
+namespace {
+  inline bool isTrailingSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+}
+
+std::string joinSnapshotLines(const std::vector<std::string>& lines) {
+  size_t total = 0;
+  for (const auto& line : lines) total += line.size() + 1;
+
+  std::string blob;
+  blob.reserve(total);
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const std::string& line = lines[i];
+    size_t end = line.size();
+    while (end > 0 && isTrailingSpace(line[end - 1])) end--;
+
+    if (i > 0) blob.push_back('\n');
+    blob.append(line, 0, end);
+  }
+
+  return blob;
+}
+
+std::vector<std::string> splitSnapshotLines(std::string_view blob) {
+  std::vector<std::string> lines;
+  if (blob.empty()) return lines;
+
+  size_t start = 0;
+  while (true) {
+    size_t eol = blob.find('\n', start);
+    if (eol == std::string_view::npos) {
+      lines.emplace_back(blob.substr(start));
+      break;
+    }
+    lines.emplace_back(blob.substr(start, eol - start));
+    start = eol + 1;
+  }
+
+  return lines;
+}
+
+/*
+  Delta format, one instruction per line:
+    =<start>,<length>   copy lines [start, start + length) of the base
+    +<count>            the next <count> lines are new
+*/
+std::string encodeSnapshotDelta(const std::vector<std::string>& base_lines, const std::vector<std::string>& target_lines) {
+  std::string delta;
+
+  for (const auto& op : diffLines(base_lines, target_lines)) {
+    if (op.kind == CHRONICLE_DIFF_EQUAL) {
+      delta += "=" + std::to_string(op.old_start) + "," + std::to_string(op.length) + "\n";
+    } else if (op.kind == CHRONICLE_DIFF_INSERT) {
+      delta += "+" + std::to_string(op.length) + "\n";
+      for (size_t i = 0; i < op.length; ++i) {
+        delta += target_lines[op.new_start + i];
+        delta.push_back('\n');
+      }
+    }
+  }
+
+  return delta;
+}
+
+std::string applySnapshotDelta(std::string_view base_blob, std::string_view delta) {
+  std::vector<std::string_view> base;
+  if (!base_blob.empty()) {
+    size_t start = 0;
+    while (true) {
+      size_t eol = base_blob.find('\n', start);
+      base.push_back(base_blob.substr(start, eol == std::string_view::npos ? std::string_view::npos : eol - start));
+      if (eol == std::string_view::npos) break;
+      start = eol + 1;
+    }
+  }
+
+  std::string blob;
+  blob.reserve(base_blob.size() + delta.size());
+  bool first = true;
+
+  auto emit = [&](std::string_view line) {
+    if (!first) blob.push_back('\n');
+    blob.append(line.data(), line.size());
+    first = false;
+  };
+
+  auto nextLine = [&](size_t& pos) {
+    size_t eol = delta.find('\n', pos);
+    if (eol == std::string_view::npos) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, "Truncated snapshot delta");
+    }
+    std::string_view line = delta.substr(pos, eol - pos);
+    pos = eol + 1;
+    return line;
+  };
+
+  size_t pos = 0;
+  while (pos < delta.size()) {
+    std::string instruction(nextLine(pos));
+    char* end = nullptr;
+
+    if (instruction.size() > 1 && instruction[0] == '=') {
+      size_t start = std::strtoull(instruction.c_str() + 1, &end, 10);
+      size_t length = (*end == ',') ? std::strtoull(end + 1, &end, 10) : 0;
+      if (*end != '\0' || start + length > base.size()) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, "Snapshot delta copies outside of its base: " + instruction);
+      }
+      for (size_t i = start; i < start + length; ++i) emit(base[i]);
+    } else if (instruction.size() > 1 && instruction[0] == '+') {
+      size_t count = std::strtoull(instruction.c_str() + 1, &end, 10);
+      if (*end != '\0') {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, "Bad snapshot delta instruction: " + instruction);
+      }
+      for (size_t i = 0; i < count; ++i) emit(nextLine(pos));
+    } else {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, "Bad snapshot delta instruction: " + instruction);
+    }
+  }
+
+  return blob;
+}
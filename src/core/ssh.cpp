@@ -1,104 +1,308 @@
 #include "core/ssh.hpp"
 
 #include "core/error_handler.hpp"
+#include "core/host_keys.hpp"
+#include "core/reachability.hpp"
+#include "core/synthetic.hpp"
+#include "core/terminal.hpp"
+#include "core/trace.hpp"
 
 #include <sstream>
 #include <cstring>
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <algorithm>
+#include <string_view>
+#include <limits>
+
+// Longest line still checked for a pager prompt
+inline constexpr size_t CHRONICLE_SSH_PAGER_LINE_MAX = 256;
+
+// What one non blocking read finds waiting in the benchmark, about a channel window's worth
+inline constexpr size_t CHRONICLE_SSH_BENCHMARK_CHUNK = 128 * 1024;
+
+Ssh::Ssh() : settings_(getChronicleSettings()) {}
+
+Ssh::Ssh(const chronicleSettings& settings) : settings_(settings) {}
+
+void Ssh::tune(const connectionInfo& ci) {
+  read_buffer_size_ = std::clamp(ci.read_buffer_size, CHRONICLE_CONFIG_MIN_READ_BUFFER, CHRONICLE_CONFIG_MAX_READ_BUFFER);
+  expected_output_size_ = ci.last_output_size > 0 ? static_cast<size_t>(ci.last_output_size) : 0;
+  nickname_ = ci.nickname;
+  vendor_name_ = ci.vendorName;
+  device_name_ = ci.deviceName;
+}
+
+void Ssh::pagerPrompts(const std::vector<std::string>& patterns) {
+  pager_prompts_.clear();
+  for (const auto& pattern : patterns) {
+    try {
+      // The prompt has to be the whole last line, a "--More--" inside the config is left alone
+      pager_prompts_.emplace_back("^[ \\t]*(?:" + pattern + ")[ \\t]*$", std::regex::ECMAScript | std::regex::optimize);
+    } catch (const std::regex_error& e) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_INVALID_PAGER_PROMPT, "Pattern \"" + pattern + "\": " + e.what());
+    }
+  }
+}
+
+// One recording per session, shell and exec channels alike
+void Ssh::startRecording() const {
+  exec_channels_ = 0;
+
+  const std::string directory = transcriptDirectory();
+  if (directory.empty()) return;
+
+  const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  const std::string name = nickname_.empty() ? "session" : nickname_;
+  recorder_ = std::make_unique<TranscriptWriter>(directory + "/" + name + "-" + std::to_string(now) + CHRONICLE_TRANSCRIPT_EXTENSION,
+                                                 nickname_, vendor_name_, device_name_);
+}
+
+size_t Ssh::execChannel(const std::string& command) const {
+  if (replay_) return replay_->exec(command);
+
+  const uint32_t channel = exec_channels_++;
+  if (recorder_) recorder_->record(CHRONICLE_TRANSCRIPT_EXEC, command.data(), command.size(), channel);
+  return channel;
+}
+
+int Ssh::readChannel(ssh_channel channel, char* buffer, uint32_t size, int is_stderr, int exec_channel) const {
+  if (replay_) {
+    if (exec_channel >= 0) return replay_->readExec(static_cast<size_t>(exec_channel), buffer, size, is_stderr);
+    return replay_->read(buffer, size, is_stderr);
+  }
+
+  int rc = ssh_channel_read_nonblocking(channel, buffer, size, is_stderr);
+  if (rc > 0 && recorder_) {
+    if (exec_channel >= 0) {
+      recorder_->record(is_stderr ? CHRONICLE_TRANSCRIPT_EXEC_STDERR : CHRONICLE_TRANSCRIPT_EXEC_STDOUT, buffer, rc,
+                        static_cast<uint32_t>(exec_channel));
+    } else {
+      recorder_->record(is_stderr ? CHRONICLE_TRANSCRIPT_STDERR : CHRONICLE_TRANSCRIPT_STDOUT, buffer, rc);
+    }
+  }
+  return rc;
+}
+
+int Ssh::writeChannel(ssh_channel channel, const std::string& data) const {
+  if (replay_) {
+    replay_->write(data);
+    return static_cast<int>(data.size());
+  }
+
+  int rc = ssh_channel_write(channel, data.c_str(), data.size());
+  if (rc != SSH_ERROR && recorder_) {
+    recorder_->record(CHRONICLE_TRANSCRIPT_SENT, data.data(), data.size());
+  }
+  return rc;
+}
+
+// A read that fills the whole buffer means more is waiting, double up to the cap
+void Ssh::growReadBuffer(std::vector<char>& buffer, int last_read) {
+  if (static_cast<size_t>(last_read) == buffer.size() && buffer.size() < static_cast<size_t>(CHRONICLE_CONFIG_MAX_READ_BUFFER)) {
+    buffer.resize(std::min(buffer.size() * 2, static_cast<size_t>(CHRONICLE_CONFIG_MAX_READ_BUFFER)));
+  }
+}
+
+// Start of the pager prompt the output ends with, npos when it does not end with one
+size_t Ssh::pagerPromptAt(const std::string& output) const {
+  const size_t newline = output.rfind('\n');
+  const size_t line = newline == std::string::npos ? 0 : newline + 1;
+  if (line == output.size() || output.size() - line > CHRONICLE_SSH_PAGER_LINE_MAX) return std::string::npos;
+
+  for (const auto& prompt : pager_prompts_) {
+    if (std::regex_search(output.cbegin() + line, output.cend(), prompt)) return line;
+  }
+  return std::string::npos;
+}
+
+void Ssh::setSessionTimeout(ssh_session session, int timeout_ms) {
+  long timeout_sec = timeout_ms / 1000;
+  long timeout_usec = (timeout_ms % 1000) * 1000L;
+
+  ssh_options_set(session, SSH_OPTIONS_TIMEOUT, &timeout_sec);
+  ssh_options_set(session, SSH_OPTIONS_TIMEOUT_USEC, &timeout_usec);
+}
+
+/*
+  Each connection phase gets its own deadline so an unreachable device fails fast:
+    - TCP connect:  non-blocking connect bounded by ssh_connect_timeout, the socket is handed to libssh
+    - Handshake:    banner and key exchange bounded by ssh_handshake_timeout
+    - Auth:         password authentication bounded by ssh_auth_timeout
+*/
+Result<ssh_session> Ssh::tryStartSession(const connectionInfo& ci) const {
+  TraceSpan span("Ssh::startSession", ci.nickname, ci.vendorName);
+  if (replay_) return ssh_session(NULL);
+
+  // libssh takes the options by non-const pointer
+  int verbosity = ci.verbosity;
+  int port = ci.port;
+  int compression_level = ci.compression_level;
 
-ssh_session Ssh::startSession(connectionInfo ci) const {
   ssh_session session;
 
   session = ssh_new();
   if (session == NULL) {
-      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED,ssh_get_error(session));
+      return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_SESSION_FAILED, "Could not allocate an SSH session.");
   }
 
   ssh_options_set(session, SSH_OPTIONS_HOST, ci.host.c_str());
-  ssh_options_set(session, SSH_OPTIONS_LOG_VERBOSITY, &ci.verbosity);
-  ssh_options_set(session, SSH_OPTIONS_PORT, &ci.port);
+  ssh_options_set(session, SSH_OPTIONS_LOG_VERBOSITY, &verbosity);
+  ssh_options_set(session, SSH_OPTIONS_PORT, &port);
   ssh_options_set(session, SSH_OPTIONS_KEY_EXCHANGE, ci.kex_methods.c_str());
   ssh_options_set(session, SSH_OPTIONS_HOSTKEYS, ci.hostkey_algorithms.c_str());
 
+  ssh_options_set(session, SSH_OPTIONS_COMPRESSION, ci.compression ? "yes" : "no");
+  if (ci.compression) {
+    ssh_options_set(session, SSH_OPTIONS_COMPRESSION_LEVEL, &compression_level);
+  }
+
+  std::string connect_error;
+  socket_t fd = openTcpConnection(ci.host, ci.port, settings_.ssh_connect_timeout, connect_error);
+  if (fd < 0) {
+    ssh_free(session);
+    return CHRONICLE_ERROR_LAZY(CHRONICLE_ERROR_SSH_CONNECTION_FAILED, ([host = ci.host, port = ci.port, connect_error]() {
+      return host + ":" + std::to_string(port) + " (" + connect_error + ")";
+    }));
+  }
+
+  // libssh owns the socket from here on and closes it on disconnect
+  ssh_options_set(session, SSH_OPTIONS_FD, &fd);
+  setSessionTimeout(session, settings_.ssh_handshake_timeout);
+
   int rc = ssh_connect(session);
   if (rc != SSH_OK)
   {
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_CONNECTION_FAILED,ssh_get_error(session));
+    std::string error = ssh_get_error(session);
+    endSession(session);
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_CONNECTION_FAILED, std::move(error));
   }
 
-  std::string known_host_msg = verifyKnownHost(session);
+  std::string known_host_msg = verifyKnownHost(session, ci);
   if (known_host_msg.size() > 0) {
       endSession(session);
-      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED,known_host_msg);
+      return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_HOST_KEY_MISMATCH, std::move(known_host_msg));
   }
 
+  setSessionTimeout(session, settings_.ssh_auth_timeout);
+
   rc = ssh_userauth_password(session, ci.user.c_str(), ci.password.c_str());
   if (rc != SSH_AUTH_SUCCESS) {
       endSession(session);
-      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, "Password for user \"" + ci.user + "\" is wrong");
+      return CHRONICLE_ERROR_LAZY(CHRONICLE_ERROR_SSH_AUTH_FAILED, ([user = ci.user]() {
+        return "Password for user \"" + user + "\" is wrong";
+      }));
+  }
+
+  Result<void> recording = catchResult([&]() { startRecording(); });
+  if (!recording) {
+    endSession(session);
+    return recording.error();
   }
 
   return session;
 }
 
-ssh_channel Ssh::startChannel(ssh_session session) const {
+ssh_session Ssh::startSession(connectionInfo ci) const {
+  return tryStartSession(ci).valueOrThrow();
+}
+
+Result<ssh_channel> Ssh::tryStartChannel(ssh_session session) const {
+  TraceSpan span("Ssh::startChannel");
   ssh_channel channel;
 
+  if (replay_) return ssh_channel(NULL);
+
+  // The caller owns the session and ends it
   if (!ssh_is_connected(session)) {
-    endSession(session);
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_UNKNOWN, "SSH session died, could not create channel.");
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_UNKNOWN, "SSH session died, could not create channel.");
   }
   
   channel = ssh_channel_new(session);
   if (channel == NULL)
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
 
   if (ssh_channel_open_session(channel) != SSH_OK) {
     ssh_channel_close(channel);
     ssh_channel_free(channel);
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
   }
 
   if (ssh_channel_request_pty(channel) != SSH_OK) {
     ssh_channel_close(channel);
     ssh_channel_free(channel);
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
   }
 
   if (ssh_channel_request_shell(channel) != SSH_OK) {
     ssh_channel_close(channel);
     ssh_channel_free(channel);
-    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED,ssh_get_error(session));
+    return CHRONICLE_ERROR(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+  }
+
+  return channel;
+}
+
+ssh_channel Ssh::startChannel(ssh_session session) const {
+  return tryStartChannel(session).valueOrThrow();
+}
+
+ssh_channel Ssh::startExecChannel(ssh_session session, const std::string& command) const {
+  ssh_channel channel;
+
+  if (replay_) return ssh_channel(NULL);
+
+  if (!ssh_is_connected(session)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_UNKNOWN, "SSH session died, could not create exec channel.");
+  }
+
+  channel = ssh_channel_new(session);
+  if (channel == NULL)
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+
+  if (ssh_channel_open_session(channel) != SSH_OK) {
+    ssh_channel_close(channel);
+    ssh_channel_free(channel);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+  }
+
+  if (ssh_channel_request_exec(channel, command.c_str()) != SSH_OK) {
+    ssh_channel_close(channel);
+    ssh_channel_free(channel);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
   }
 
   return channel;
 }
 
 void Ssh::endSession(ssh_session session) const {
+  recorder_.reset();
+  if (session == NULL) return;
   ssh_disconnect(session);
   ssh_free(session);
 }
 
 void Ssh::closeChannel(ssh_channel channel) const {
+  if (channel == NULL) return;
   ssh_channel_send_eof(channel);
   ssh_channel_close(channel);
   ssh_channel_free(channel);
 }
 
 std::vector<std::string> Ssh::executeCommand(OperationMap operation_map, ssh_session session, ssh_channel channel) const {
+  TraceSpan span("Ssh::executeCommand");
   int rc;
-  char buffer[4096];
-  int nbytes;
+  std::vector<char> buffer(read_buffer_size_);
   std::string output, error_output;
-  std::vector<std::string> output_lines;
+  TerminalFilter terminal(output);
 
-  chronicleSettings cs = getChronicleSettings();
+  if (expected_output_size_ > 0) {
+    output.reserve(expected_output_size_ + expected_output_size_ / 8);
+  }
 
   std::string full_command = std::string(operation_map.command) + "\n";
-  if (ssh_channel_write(channel, full_command.c_str(), full_command.size()) == SSH_ERROR) {
-    closeChannel(channel);
+  if (writeChannel(channel, full_command) == SSH_ERROR) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED,ssh_get_error(session));
   }
 
@@ -106,24 +310,45 @@ std::vector<std::string> Ssh::executeCommand(OperationMap operation_map, ssh_ses
   auto last_data = start;
 
   while (true) {
+    bool progress = false;
+
     // Read stdout (stream 0)
-    rc = ssh_channel_read_nonblocking(channel, buffer, sizeof(buffer), 0);
+    rc = readChannel(channel, buffer.data(), buffer.size(), 0);
     if (rc == SSH_ERROR) {
       THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, "SSH non-blocking read failed");
     }
     if (rc > 0) {
-      output.append(buffer, rc);
+      // The pty adds escapes and redraws, only what a terminal would show is kept
+      terminal.feed(buffer.data(), rc);
       last_data = std::chrono::steady_clock::now();
+      progress = true;
+      growReadBuffer(buffer, rc);
+
+      // The pager waits for a key, answer it now instead of idling until the timeout.
+      // The wipe of the prompt that follows is undone by the backspaces or \r it is made of.
+      const size_t prompt = pager_prompts_.empty() ? std::string::npos : pagerPromptAt(output);
+      if (prompt != std::string::npos) {
+        terminal.truncate(prompt);
+        if (writeChannel(channel, " ") == SSH_ERROR) {
+          THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, ssh_get_error(session));
+        }
+      }
     }
 
     // Read stderr (stream 1)
-    rc = ssh_channel_read_nonblocking(channel, buffer, sizeof(buffer), 1);
+    rc = readChannel(channel, buffer.data(), buffer.size(), 1);
     if (rc == SSH_ERROR) {
       THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, "SSH non-blocking read failed (stderr)");
     }
     if (rc > 0) {
-      error_output.append(buffer, rc);
+      error_output.append(buffer.data(), rc);
       last_data = std::chrono::steady_clock::now();
+      progress = true;
+    }
+
+    // A replay has no more output for this command, no need to wait for the idle timeout
+    if (replay_ && replay_->drained()) {
+      break;
     }
 
     // Check idle and total timeout
@@ -131,22 +356,167 @@ std::vector<std::string> Ssh::executeCommand(OperationMap operation_map, ssh_ses
     auto idle_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_data);
     auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
 
-    if (idle_time.count() >= cs.ssh_idle_timeout || total_time.count() > cs.ssh_total_timeout) {
+    if (idle_time.count() >= settings_.ssh_idle_timeout || total_time.count() > settings_.ssh_total_timeout) {
       break;
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // Only back off while the channel is quiet, a large transfer is read back to back
+    if (!progress) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
   }
 
   if (!error_output.empty()) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_COMMAND_FAILED, operation_map.err_msg + " (stderr: " + error_output + ")");
   }
 
-  std::istringstream iss(output);
-  std::string line;
+  return parseOutput(output, operation_map);
+}
+
+/*
+  Exec mode: every command gets its own channel, all channels are opened up front
+  and drained together, so the commands run concurrently on the one session.
+  A command is complete once its channel reports EOF, no banner or idle framing is needed.
+*/
+std::vector<std::vector<std::string>> Ssh::execCommands(const std::vector<OperationMap>& operation_maps, ssh_session session) const {
+  TraceSpan span("Ssh::execCommands");
+  struct execState {
+    ssh_channel channel = NULL;
+    int id = 0;             // Its number in the transcript
+    std::string output;
+    std::string error_output;
+    bool done = false;
+  };
+
+  std::vector<char> buffer(read_buffer_size_);
+  std::vector<execState> states(operation_maps.size());
+
+  // Every opened channel is closed on the way out, whatever ends the read
+  struct channelCloser {
+    const Ssh& ssh;
+    std::vector<execState>& states;
+    ~channelCloser() {
+      for (auto& state : states) ssh.closeChannel(state.channel);
+    }
+  } closer{*this, states};
+
+  for (size_t i = 0; i < operation_maps.size(); ++i) {
+    states[i].channel = startExecChannel(session, operation_maps[i].command);
+    states[i].id = static_cast<int>(execChannel(operation_maps[i].command));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  size_t remaining = states.size();
+
+  while (remaining > 0) {
+    bool progress = false;
+
+    for (auto& state : states) {
+      if (state.done) continue;
+
+      // Read stdout (stream 0)
+      int out_rc = readChannel(state.channel, buffer.data(), buffer.size(), 0, state.id);
+      if (out_rc == SSH_ERROR) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, "SSH non-blocking read failed");
+      }
+      if (out_rc > 0) {
+        state.output.append(buffer.data(), out_rc);
+        progress = true;
+        growReadBuffer(buffer, out_rc);
+      }
+
+      // Read stderr (stream 1)
+      int err_rc = readChannel(state.channel, buffer.data(), buffer.size(), 1, state.id);
+      if (err_rc == SSH_ERROR) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_SESSION_FAILED, "SSH non-blocking read failed (stderr)");
+      }
+      if (err_rc > 0) {
+        state.error_output.append(buffer.data(), err_rc);
+        progress = true;
+      }
+
+      // Complete once the remote sent EOF and both streams are drained
+      const bool eof = replay_ ? replay_->execDone(state.id) : ssh_channel_is_eof(state.channel);
+      if (out_rc <= 0 && err_rc <= 0 && eof) {
+        state.done = true;
+        --remaining;
+        progress = true;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+    if (remaining > 0 && total_time.count() > settings_.ssh_total_timeout) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_COMMAND_FAILED, "Exec channel timed out after " + std::to_string(total_time.count()) + "ms");
+    }
+
+    if (!progress) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  std::vector<std::vector<std::string>> outputs;
+  outputs.reserve(states.size());
+
+  for (size_t i = 0; i < states.size(); ++i) {
+    // Devices that never report an exit status return -1, only a real failure counts. Many report
+    // 0 for a rejected command, which then shows as stderr alone or an error line on stderr
+    int exit_status = replay_ ? replay_->execExitStatus(states[i].id) : ssh_channel_get_exit_status(states[i].channel);
+    if (recorder_) {
+      const std::string status = std::to_string(exit_status);
+      recorder_->record(CHRONICLE_TRANSCRIPT_EXEC_EXIT, status.data(), status.size(), static_cast<uint32_t>(states[i].id));
+    }
+    const std::string& error_output = states[i].error_output;
+
+    bool failed = exit_status > 0 || (states[i].output.empty() && !error_output.empty());
+    std::istringstream errors(error_output);
+    for (std::string line; !failed && std::getline(errors, line);) {
+      failed = hasError(line);
+    }
+
+    if (failed) {
+      std::string details = operation_maps[i].err_msg + " (exit status: " + std::to_string(exit_status);
+      if (!error_output.empty())
+        details += ", stderr: " + error_output;
+      details += ")";
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_COMMAND_FAILED, details);
+    }
+  }
+
+  for (size_t i = 0; i < states.size(); ++i) {
+    outputs.push_back(parseOutput(states[i].output, operation_maps[i]));
+  }
+
+  return outputs;
+}
+
+// True for any line one of the hasError patterns could match: one starting with % or "error",
+// or one holding "command" or "invalid input", case insensitively
+bool Ssh::mayBeError(const std::string& line) {
+  if (line.empty()) return false;
+  if (line[0] == '%' || line[0] == 'e' || line[0] == 'E') return true;
+
+  // ASCII case folding, the words are lower case letters and spaces
+  auto contains = [&line](std::string_view word) {
+    return std::search(line.begin(), line.end(), word.begin(), word.end(), [](char a, char b) {
+      return b == ' ' ? a == ' ' : (a | 0x20) == b;
+    }) != line.end();
+  };
+  return contains("command") || contains("invalid input");
+}
+
+std::vector<std::string> Ssh::parseOutput(const std::string& output, const OperationMap& operation_map) {
+  std::vector<std::string> output_lines;
   int line_index = 0;
-  
-  while (std::getline(iss, line)) {
+
+  // Split in place, as getline did: a last line without \n counts, an empty tail does not
+  for (size_t pos = 0; pos < output.size(); ) {
+      size_t end = output.find('\n', pos);
+      if (end == std::string::npos) end = output.size();
+
+      std::string line(output, pos, end - pos);
+      pos = end + 1;
+
       if (!line.empty() && line.back() == '\r') {
           line.pop_back();
       }
@@ -157,7 +527,8 @@ std::vector<std::string> Ssh::executeCommand(OperationMap operation_map, ssh_ses
       if (hasError(line))
           THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_COMMAND_FAILED, operation_map.err_msg + " (" + line + ")");
   
-      if (std::regex_match(line, std::regex(R"(^%)", std::regex::icase)))
+      // A bare % line, as regex_match of ^% took it
+      if (line == "%")
           continue;
   
       output_lines.push_back(std::move(line));
@@ -170,13 +541,16 @@ std::vector<std::string> Ssh::executeCommand(OperationMap operation_map, ssh_ses
   return output_lines;
 }
 
-std::string Ssh::verifyKnownHost(ssh_session session) {
-  enum ssh_known_hosts_e state;
+/*
+  Host keys are pinned by SHA-256 fingerprint in the HostKeyStore.
+  known_hosts is only consulted once for a host the store has never seen, so existing
+  entries carry over, after that it is never read or written again.
+*/
+std::string Ssh::verifyKnownHost(ssh_session session, const connectionInfo& ci) {
   unsigned char *hash = NULL;
   ssh_key srv_pubkey = NULL;
   size_t hlen;
-  char *p;
-  int cmp;
+  char *fingerprint_hex;
   int rc;
 
   rc = ssh_get_server_publickey(session, &srv_pubkey);
@@ -185,7 +559,7 @@ std::string Ssh::verifyKnownHost(ssh_session session) {
   }
 
   rc = ssh_get_publickey_hash(srv_pubkey,
-                              SSH_PUBLICKEY_HASH_SHA1,
+                              SSH_PUBLICKEY_HASH_SHA256,
                               &hash,
                               &hlen);
   ssh_key_free(srv_pubkey);
@@ -193,56 +567,114 @@ std::string Ssh::verifyKnownHost(ssh_session session) {
     return "Could not get server public key hash.";
   }
 
-  state = ssh_session_is_known_server(session);
-  switch (state) {
-    case SSH_KNOWN_HOSTS_OK:
-      /* OK */
+  fingerprint_hex = ssh_get_fingerprint_hash(SSH_PUBLICKEY_HASH_SHA256, hash, hlen);
+  ssh_clean_pubkey_hash(&hash);
+  if (fingerprint_hex == NULL) {
+    return "Could not format server public key fingerprint.";
+  }
 
-      break;
-    case SSH_KNOWN_HOSTS_CHANGED: ssh_clean_pubkey_hash(&hash);
+  std::string fingerprint(fingerprint_hex);
+  ssh_string_free_char(fingerprint_hex);
+
+  HostKeyStore& store = HostKeyStore::instance();
+  std::optional<std::string> known = store.lookup(ci.host, ci.port);
+
+  if (known.has_value()) {
+    if (*known != fingerprint) {
+      return "Host key for server changed. (expected " + *known + ", got " + fingerprint + ")";
+    }
+    return "";
+  }
+
+  switch (ssh_session_is_known_server(session)) {
+    case SSH_KNOWN_HOSTS_CHANGED:
       return "Host key for server changed.";
-    case SSH_KNOWN_HOSTS_OTHER|SSH_KNOWN_HOSTS_NOT_FOUND:
-      ssh_clean_pubkey_hash(&hash);
-      return "The host key for this server was not found.";
-    case SSH_KNOWN_HOSTS_UNKNOWN:
-      ssh_clean_pubkey_hash(&hash);
-      rc = ssh_session_update_known_hosts(session);
-      if (rc < 0) {
-          return strerror(errno);
-      }
-      break;
+    case SSH_KNOWN_HOSTS_OTHER:
+      return "The host key for this server was not found but another type of key exists.";
     case SSH_KNOWN_HOSTS_ERROR:
-      ssh_clean_pubkey_hash(&hash);
       return ssh_get_error(session);
+    default:
+      break;
   }
 
-  ssh_clean_pubkey_hash(&hash);
+  store.remember(ci.host, ci.port, fingerprint);
   return "";
 }
 
 void Ssh::flushBanner(ssh_session session, ssh_channel channel) const {
+  TraceSpan span("Ssh::flushBanner");
   char buffer[256];
   int rc;
   auto start = std::chrono::steady_clock::now();
   auto last_data = start;
-  chronicleSettings cs = getChronicleSettings();
- 
+
   while (true) {
-    rc = ssh_channel_read_nonblocking(channel, buffer, sizeof(buffer), 0);
+    rc = readChannel(channel, buffer, sizeof(buffer), 0);
     if (rc == SSH_ERROR) {
       THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_UNKNOWN, "SSH non-blocking read failed during flushBanner");
     }
     if (rc > 0) {
       last_data = std::chrono::steady_clock::now();
       // Just discard the data
+    } else if (replay_ && replay_->drained()) {
+      break;
     } else {
       auto now = std::chrono::steady_clock::now();
       auto idle_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_data);
       auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
-      if (idle_time.count() > cs.ssh_idle_timeout || total_time.count() > cs.ssh_total_timeout) {
+      if (idle_time.count() > settings_.ssh_idle_timeout || total_time.count() > settings_.ssh_total_timeout) {
         break;
       }
       std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
   }
 }
+
+std::vector<sshReadBenchmark> benchmarkSshRead(size_t bytes, const std::vector<int>& readBufferSizes, int rounds) {
+  rounds = std::max(rounds, 1);
+  const std::string command = "show running-config";
+  const std::string output = syntheticTerminalOutput(bytes);
+
+  std::vector<transcriptEvent> events;
+  events.push_back({CHRONICLE_TRANSCRIPT_SENT, 0, 0, command + "\n"});
+  for (size_t offset = 0; offset < output.size(); offset += CHRONICLE_SSH_BENCHMARK_CHUNK) {
+    events.push_back({CHRONICLE_TRANSCRIPT_STDOUT, 0, 0, output.substr(offset, CHRONICLE_SSH_BENCHMARK_CHUNK)});
+  }
+  const Transcript transcript("benchmark", std::move(events));
+
+  // Nothing here waits on a device, the timeouts only have to outlast the run
+  chronicleSettings settings;
+  settings.ssh_idle_timeout = settings.ssh_total_timeout = std::numeric_limits<int>::max();
+
+  std::vector<sshReadBenchmark> results;
+  for (const int readBufferSize : readBufferSizes) {
+    for (const bool reserved : {false, true}) {
+      connectionInfo ci;
+      ci.nickname = transcript.nickname();
+      ci.read_buffer_size = readBufferSize;
+      ci.last_output_size = reserved ? static_cast<int>(std::min<size_t>(output.size(), std::numeric_limits<int>::max())) : 0;
+
+      sshReadBenchmark run;
+      run.read_buffer_size = std::clamp(readBufferSize, CHRONICLE_CONFIG_MIN_READ_BUFFER, CHRONICLE_CONFIG_MAX_READ_BUFFER);
+      run.reserved = reserved;
+      run.bytes = output.size();
+
+      auto best = std::chrono::steady_clock::duration::max();
+      for (int round = 0; round < rounds; ++round) {
+        Ssh ssh(settings);
+        ssh.tune(ci);
+        ssh.replay(std::make_shared<TranscriptReplay>(transcript));
+
+        const auto start = std::chrono::steady_clock::now();
+        run.lines = ssh.executeCommand({command, 0, 0, "Benchmark read failed"}, NULL, NULL).size();
+        best = std::min(best, std::chrono::steady_clock::now() - start);
+      }
+
+      run.ms = millisecondsOf(best);
+      run.mb_s = megabytesPerSecond(run.bytes, best);
+      results.push_back(run);
+    }
+  }
+
+  return results;
+}
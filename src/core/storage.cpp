@@ -0,0 +1,40 @@
+#include "core/storage.hpp"
+#include "core/memory_storage.hpp"
+
+#include <mutex>
+
+namespace {
+  std::mutex backendMutex;
+  std::shared_ptr<StorageBackend> backend;
+}
+
+std::shared_ptr<StorageBackend> storage() {
+  std::lock_guard<std::mutex> lock(backendMutex);
+  if (!backend) backend = makeMongoStorage();
+  return backend;
+}
+
+std::string storageKind() {
+  return storage()->kind();
+}
+
+void useMongoStorage() {
+  auto mongo = makeMongoStorage();
+
+  std::lock_guard<std::mutex> lock(backendMutex);
+  backend = std::move(mongo);
+}
+
+void useMemoryStorage(const std::string& journalPath) {
+  // The journal is replayed before the switch, a bad one leaves the current backend selected
+  auto memory = std::make_shared<MemoryStorage>(journalPath);
+
+  std::lock_guard<std::mutex> lock(backendMutex);
+  backend = std::move(memory);
+}
+
+std::shared_ptr<StorageBackend> swapStorage(std::shared_ptr<StorageBackend> next) {
+  std::lock_guard<std::mutex> lock(backendMutex);
+  std::swap(backend, next);
+  return next;
+}
@@ -0,0 +1,111 @@
+#include "core/synthetic.hpp"
+
+#include <random>
+
+std::vector<std::string> syntheticConfig(size_t lines, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> config;
+  config.reserve(lines);
+
+  auto push = [&](std::string line) {
+    if (config.size() < lines) config.push_back(std::move(line));
+  };
+
+  push("version 17.9");
+  push("service timestamps debug datetime msec");
+  push("hostname synthetic-" + std::to_string(seed));
+  push("!");
+
+  // Interfaces take the first four fifths, access lists the rest
+  const size_t interfaceLines = lines - lines / 5;
+  for (size_t port = 1; config.size() < interfaceLines; ++port) {
+    const std::string id = std::to_string(port / 48 + 1) + "/0/" + std::to_string(port % 48 + 1);
+    push("interface GigabitEthernet" + id);
+    push(" description access port " + std::to_string(rng() % 10000) + " room " + std::to_string(rng() % 500));
+    push(" switchport access vlan " + std::to_string(rng() % 4000 + 1));
+    push(" switchport mode access");
+    if (rng() % 3 == 0) push(" ip access-group ACL-" + std::to_string(rng() % 50) + " in");
+    push(" spanning-tree portfast");
+    push("!");
+  }
+
+  for (size_t acl = 0; config.size() < lines; ++acl) {
+    push("ip access-list extended ACL-" + std::to_string(acl));
+    for (int rule = 10; rule <= 100 && config.size() < lines; rule += 10) {
+      push(" " + std::to_string(rule) + " permit tcp 10." + std::to_string(rng() % 256) + "." + std::to_string(rng() % 256) +
+           ".0 0.0.0.255 any eq " + std::to_string(rng() % 65535 + 1));
+    }
+    push("!");
+  }
+
+  return config;
+}
+
+std::vector<std::string> syntheticEdit(const std::vector<std::string>& config, double editRate, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+  std::vector<std::string> edited;
+  edited.reserve(config.size() + config.size() / 10 + 1);
+
+  for (const auto& line : config) {
+    if (chance(rng) >= editRate) {
+      edited.push_back(line);
+      continue;
+    }
+
+    switch (rng() % 3) {
+      case 0:     // Changed
+        edited.push_back(line + " ! edited " + std::to_string(rng() % 100000));
+        break;
+      case 1:     // Removed
+        break;
+      default:    // Kept, a new line after it
+        edited.push_back(line);
+        edited.push_back(" description added " + std::to_string(rng() % 100000));
+        break;
+    }
+  }
+
+  return edited;
+}
+
+std::string syntheticTerminalOutput(size_t bytes, uint32_t seed) {
+  constexpr int screenLines = 24;
+  std::mt19937 rng(seed);
+
+  std::string output;
+  output.reserve(bytes + 256);
+
+  // Long enough that the output never wraps around to the start of the config
+  const std::vector<std::string> config = syntheticConfig(bytes / 32 + 64, seed);
+  for (size_t line = 0; output.size() < bytes; ++line) {
+    const std::string& text = config[line % config.size()];
+
+    if (line % screenLines == screenLines - 1) {
+      output += "\x1b[7m --More-- \x1b[m";
+      output.append(10, '\b');
+      output += "\x1b[K";
+    }
+
+    if (text.rfind("interface", 0) == 0) {
+      output += "\x1b[1;34minterface\x1b[0m" + text.substr(9);
+    } else if (rng() % 16 == 0) {
+      output += text + " (pending)\r" + text + "\x1b[K";
+    } else {
+      output += text;
+    }
+    output += "\r\n";
+  }
+
+  return output;
+}
+
+double megabytesPerSecond(size_t bytes, std::chrono::steady_clock::duration elapsed) {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  return seconds > 0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0;
+}
+
+double millisecondsOf(std::chrono::steady_clock::duration elapsed) {
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
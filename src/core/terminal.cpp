@@ -0,0 +1,243 @@
+#include "core/terminal.hpp"
+#include "core/synthetic.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+  constexpr char ESC = '\x1b';
+  constexpr char BEL = '\x07';
+  constexpr uint32_t PARAM_MAX = 9999;
+
+  // Written as is: printable ASCII, UTF-8 bytes and tabs
+  inline bool plain(char c) {
+    const unsigned char byte = static_cast<unsigned char>(c);
+    return (byte >= 0x20 && byte != 0x7f) || c == '\t';
+  }
+}
+
+TerminalFilter::TerminalFilter(std::string& output) : out_(output), cursor_(output.size()) {
+  const size_t newline = out_.rfind('\n');
+  line_start_ = newline == std::string::npos ? 0 : newline + 1;
+}
+
+void TerminalFilter::feed(const char* data, size_t size) {
+  const char* p = data;
+  const char* const end = data + size;
+
+  while (p < end) {
+    switch (state_) {
+      case state::text: {
+        // Plain text at the end of the output, the bulk of any config, goes in as a run
+        if (!pending_cr_ && cursor_ == out_.size()) {
+          const char* run = p;
+          while (run < end && plain(*run)) ++run;
+          if (run != p) {
+            out_.append(p, run - p);
+            cursor_ = out_.size();
+            p = run;
+            continue;
+          }
+        }
+
+        const char c = *p++;
+        if (plain(c)) put(c);
+        else if (c == ESC) state_ = state::escape;
+        else control(c);
+        break;
+      }
+
+      case state::escape: {
+        const char c = *p++;
+        if (c == '[') {
+          state_ = state::csi;
+          param_ = 0;
+          param_done_ = false;
+        } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+          state_ = state::string;
+        } else if (c >= 0x20 && c <= 0x2f) {
+          state_ = state::escapeIntermediate;
+        } else if (c != ESC) {
+          state_ = state::text;
+        }
+        break;
+      }
+
+      case state::escapeIntermediate: {
+        const char c = *p++;
+        if (c < 0x20 || c > 0x2f) state_ = c == ESC ? state::escape : state::text;
+        break;
+      }
+
+      case state::csi: {
+        const char c = *p++;
+        if (c >= '0' && c <= '9') {
+          if (!param_done_) param_ = std::min<uint32_t>(param_ * 10 + (c - '0'), PARAM_MAX);
+        } else if (c == ';' || c == ':') {
+          param_done_ = true;
+        } else if (c >= 0x40 && c <= 0x7e) {
+          csi(c);
+          state_ = state::text;
+        } else if (c == ESC) {
+          state_ = state::escape;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          control(c);     // Controls inside a sequence still take effect
+        }
+        break;
+      }
+
+      case state::string: {
+        while (p < end && *p != BEL && *p != ESC) ++p;
+        if (p == end) break;
+        state_ = *p++ == BEL ? state::text : state::stringEscape;
+        break;
+      }
+
+      case state::stringEscape: {
+        // ESC \ ends the string, an ESC followed by anything else starts a new sequence
+        if (*p == '\\') {
+          ++p;
+          state_ = state::text;
+        } else {
+          state_ = state::escape;
+        }
+        break;
+      }
+    }
+  }
+}
+
+void TerminalFilter::truncate(size_t size) {
+  out_.resize(std::min(size, out_.size()));
+  cursor_ = out_.size();
+
+  const size_t newline = out_.rfind('\n');
+  line_start_ = newline == std::string::npos ? 0 : newline + 1;
+  pending_cr_ = false;
+  rewound_ = false;
+}
+
+void TerminalFilter::put(char c) {
+  if (pending_cr_) carriageReturn();
+
+  if (cursor_ == out_.size()) {
+    out_.push_back(c);
+  } else {
+    out_[cursor_] = c;
+  }
+  cursor_++;
+}
+
+void TerminalFilter::control(char c) {
+  switch (c) {
+    case '\n':
+      endLine();
+      break;
+    case '\r':
+      pending_cr_ = true;
+      break;
+    case '\b':
+      if (pending_cr_) carriageReturn();
+      if (cursor_ > line_start_) {
+        cursor_--;
+        rewound_ = true;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void TerminalFilter::csi(char final) {
+  if (final != 'K' && final != 'C' && final != 'D') return;
+  if (pending_cr_) carriageReturn();
+
+  const size_t count = param_ == 0 ? 1 : param_;
+
+  switch (final) {
+    case 'D': {
+      const size_t back = std::min(count, cursor_ - line_start_);
+      cursor_ -= back;
+      if (back > 0) rewound_ = true;
+      break;
+    }
+    case 'C':
+      cursor_ += count;
+      if (cursor_ > out_.size()) {
+        out_.resize(cursor_, ' ');
+        rewound_ = true;
+      }
+      break;
+    case 'K':
+      // 0 erases to the end of the line, 1 to its start, 2 all of it
+      if (param_ != 1) out_.resize(cursor_);
+      if (param_ != 0) {
+        std::fill(out_.begin() + line_start_, out_.begin() + cursor_, ' ');
+        rewound_ = true;
+      }
+      break;
+  }
+}
+
+void TerminalFilter::carriageReturn() {
+  pending_cr_ = false;
+  if (out_.size() > line_start_) rewound_ = true;
+  cursor_ = line_start_;
+}
+
+void TerminalFilter::endLine() {
+  pending_cr_ = false;
+
+  if (rewound_) {
+    size_t last = out_.size();
+    while (last > line_start_ && (out_[last - 1] == ' ' || out_[last - 1] == '\t')) last--;
+    out_.resize(last);
+  }
+
+  out_.push_back('\n');
+  line_start_ = cursor_ = out_.size();
+  rewound_ = false;
+}
+
+std::string stripTerminalControl(std::string_view data) {
+  std::string output;
+  output.reserve(data.size());
+
+  TerminalFilter filter(output);
+  filter.feed(data);
+  return output;
+}
+
+std::vector<terminalBenchmark> benchmarkTerminalFilter(size_t bytes, const std::vector<size_t>& chunkSizes, int rounds) {
+  rounds = std::max(rounds, 1);
+  const std::string input = syntheticTerminalOutput(bytes);
+
+  std::vector<terminalBenchmark> results;
+  std::string output;
+  output.reserve(input.size());
+
+  for (const size_t chunkSize : chunkSizes) {
+    terminalBenchmark run;
+    run.chunk_size = std::max<size_t>(chunkSize, 1);
+    run.input_bytes = input.size();
+
+    auto best = std::chrono::steady_clock::duration::max();
+    for (int round = 0; round < rounds; ++round) {
+      output.clear();
+      TerminalFilter filter(output);
+
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t offset = 0; offset < input.size(); offset += run.chunk_size) {
+        filter.feed(input.data() + offset, std::min(run.chunk_size, input.size() - offset));
+      }
+      best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+
+    const double seconds = std::chrono::duration<double>(best).count();
+    run.output_bytes = output.size();
+    run.bytes_per_s = seconds > 0 ? static_cast<double>(input.size()) / seconds : 0;
+    results.push_back(run);
+  }
+
+  return results;
+}
@@ -0,0 +1,354 @@
+#include "core/trace.hpp"
+#include "core/error_handler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+  struct spanRecord {
+    uint64_t index;         // Position in the ring, tells a slot apart from the one a lap later
+    const char* name;
+    uint64_t start;         // Steady clock nanoseconds
+    uint64_t end;
+    uint64_t span_id;
+    uint64_t parent_id;
+    bool error;
+    char device[CHRONICLE_TRACE_DEVICE_LENGTH];
+    char vendor[CHRONICLE_TRACE_VENDOR_LENGTH];
+  };
+
+  constexpr size_t recordWords = (sizeof(spanRecord) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // The record is kept as atomic words, a reader racing the owner then sees torn data it
+  // throws away on the sequence check rather than a data race
+  struct ringSlot {
+    std::atomic<uint32_t> seq{0};   // Odd while the owner thread writes the slot
+    std::atomic<uint64_t> words[recordWords];
+  };
+
+  void storeRecord(ringSlot& slot, const spanRecord& record) {
+    uint64_t words[recordWords] = {};
+    std::memcpy(words, &record, sizeof(record));
+    for (size_t i = 0; i < recordWords; ++i) slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  spanRecord loadRecord(const ringSlot& slot) {
+    uint64_t words[recordWords];
+    for (size_t i = 0; i < recordWords; ++i) words[i] = slot.words[i].load(std::memory_order_relaxed);
+
+    spanRecord record;
+    std::memcpy(&record, words, sizeof(record));
+    return record;
+  }
+
+  // Written by its owner thread only, read by the exporters
+  struct traceRing {
+    traceRing(size_t capacity, uint32_t tid, uint64_t generation)
+      : slots(new ringSlot[capacity]), capacity(capacity), tid(tid), generation(generation) {}
+
+    std::unique_ptr<ringSlot[]> slots;
+    size_t capacity;
+    uint32_t tid;
+    uint64_t generation;
+    uint64_t next_span = 0;
+    std::atomic<uint64_t> head{0};
+  };
+
+  struct exportedSpan {
+    spanRecord record;
+    uint32_t tid;
+  };
+
+  std::atomic<bool> enabled{false};
+  std::atomic<uint64_t> generation{0};
+  std::atomic<uint32_t> nextThread{0};
+
+  std::mutex registryMutex;
+  std::vector<std::shared_ptr<traceRing>> rings;
+  size_t ringCapacity = CHRONICLE_TRACE_DEFAULT_CAPACITY;
+  uint64_t enabledAt = 0;         // Steady clock nanoseconds
+  int64_t unixOffset = 0;         // Add to a steady timestamp to get unix nanoseconds
+  uint64_t traceId[2] = {0, 0};
+
+  thread_local std::shared_ptr<traceRing> localRing;
+  thread_local TraceSpan* currentSpan = nullptr;
+  thread_local uint32_t threadId = 0;
+
+  uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  traceRing* ringFor(uint64_t gen) {
+    if (!localRing || localRing->generation != gen) {
+      if (threadId == 0) threadId = ++nextThread;
+
+      std::lock_guard<std::mutex> lock(registryMutex);
+      localRing = std::make_shared<traceRing>(ringCapacity, threadId, gen);
+      rings.push_back(localRing);
+    }
+    return localRing.get();
+  }
+
+  void copyName(char* dest, size_t capacity, std::string_view src) {
+    const size_t n = std::min(src.size(), capacity - 1);
+    std::memcpy(dest, src.data(), n);
+    dest[n] = '\0';
+  }
+
+  // Seqlock read of every slot still holding a span of the current generation
+  std::vector<exportedSpan> collect(uint64_t& start, int64_t& offset, uint64_t (&id)[2]) {
+    std::vector<std::shared_ptr<traceRing>> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      snapshot = rings;
+      start = enabledAt;
+      offset = unixOffset;
+      id[0] = traceId[0];
+      id[1] = traceId[1];
+    }
+
+    std::vector<exportedSpan> spans;
+    for (const auto& ring : snapshot) {
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      const uint64_t first = head > ring->capacity ? head - ring->capacity : 0;
+
+      for (uint64_t i = first; i < head; ++i) {
+        const ringSlot& slot = ring->slots[i % ring->capacity];
+
+        const uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        const spanRecord record = loadRecord(slot);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before || record.index != i) continue;
+
+        spans.push_back({record, ring->tid});
+      }
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const exportedSpan& a, const exportedSpan& b) {
+      return a.record.start < b.record.start;
+    });
+    return spans;
+  }
+
+  std::string escape(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    for (const char c : text) {
+      switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+          } else {
+            out += c;
+          }
+      }
+    }
+    return out;
+  }
+
+  std::string hex(uint64_t value) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+    return buf;
+  }
+
+  void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_TRACE_EXPORT_FAILED, path);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    out.close();
+    if (!out) THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_TRACE_EXPORT_FAILED, path);
+  }
+}
+
+void enableTracing(size_t capacity) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+
+  rings.clear();
+  ringCapacity = std::max<size_t>(capacity, 1);
+
+  enabledAt = now();
+  const int64_t unixNow = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  unixOffset = unixNow - static_cast<int64_t>(enabledAt);
+
+  std::random_device rd;
+  std::mt19937_64 rng((static_cast<uint64_t>(rd()) << 32) ^ rd() ^ enabledAt);
+  traceId[0] = rng();
+  traceId[1] = rng();
+
+  // Threads pick up a fresh ring on their next span
+  generation.fetch_add(1, std::memory_order_release);
+  enabled.store(true, std::memory_order_release);
+}
+
+void disableTracing() {
+  enabled.store(false, std::memory_order_release);
+}
+
+bool tracingEnabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* name, std::string_view device, std::string_view vendor) : name_(name) {
+  if (!enabled.load(std::memory_order_relaxed)) return;
+
+  active_ = true;
+  generation_ = generation.load(std::memory_order_acquire);
+  exceptions_ = std::uncaught_exceptions();
+
+  device_[0] = '\0';
+  vendor_[0] = '\0';
+
+  traceRing* ring = ringFor(generation_);
+  spanId_ = (static_cast<uint64_t>(ring->tid) << 40) | ++ring->next_span;
+
+  parent_ = currentSpan;
+  if (parent_ != nullptr && parent_->generation_ == generation_) {
+    parentId_ = parent_->spanId_;
+    if (device.empty()) std::memcpy(device_, parent_->device_, sizeof(device_));
+    if (vendor.empty()) std::memcpy(vendor_, parent_->vendor_, sizeof(vendor_));
+  }
+  if (!device.empty()) copyName(device_, sizeof(device_), device);
+  if (!vendor.empty()) copyName(vendor_, sizeof(vendor_), vendor);
+
+  currentSpan = this;
+  start_ = now();
+}
+
+void TraceSpan::setDevice(std::string_view device, std::string_view vendor) {
+  if (!active_) return;
+  copyName(device_, sizeof(device_), device);
+  if (!vendor.empty()) copyName(vendor_, sizeof(vendor_), vendor);
+}
+
+TraceSpan::~TraceSpan() {
+  if (!active_) return;
+
+  const uint64_t end = now();
+  currentSpan = parent_;
+
+  // Started before tracing was re-enabled, its ring is gone
+  if (generation_ != generation.load(std::memory_order_acquire) || localRing == nullptr || localRing->generation != generation_) return;
+
+  traceRing* ring = localRing.get();
+  const uint64_t index = ring->head.load(std::memory_order_relaxed);
+  ringSlot& slot = ring->slots[index % ring->capacity];
+
+  spanRecord record{};
+  record.index = index;
+  record.name = name_;
+  record.start = start_;
+  record.end = end;
+  record.span_id = spanId_;
+  record.parent_id = parentId_;
+  record.error = error_ || std::uncaught_exceptions() > exceptions_;
+  std::memcpy(record.device, device_, sizeof(device_));
+  std::memcpy(record.vendor, vendor_, sizeof(vendor_));
+
+  const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  storeRecord(slot, record);
+  slot.seq.store(seq + 2, std::memory_order_release);
+  ring->head.store(index + 1, std::memory_order_release);
+}
+
+size_t exportChromeTrace(const std::string& path) {
+  uint64_t start;
+  int64_t offset;
+  uint64_t id[2];
+  const std::vector<exportedSpan> spans = collect(start, offset, id);
+
+  const std::string pid = std::to_string(getpid());
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"traceId\":\"" + hex(id[0]) + hex(id[1]) + "\"},\"traceEvents\":[";
+
+  std::vector<uint32_t> threads;
+  char buf[64];
+  bool first = true;
+  for (const auto& span : spans) {
+    const spanRecord& r = span.record;
+    if (!first) out += ',';
+    first = false;
+
+    // Microseconds since tracing was enabled keeps the sub microsecond part in a double
+    out += "\n{\"name\":\"" + escape(r.name) + "\",\"cat\":\"chronicle\",\"ph\":\"X\"";
+    std::snprintf(buf, sizeof(buf), ",\"ts\":%.3f", (r.start - start) / 1000.0);
+    out += buf;
+    std::snprintf(buf, sizeof(buf), ",\"dur\":%.3f", (r.end - r.start) / 1000.0);
+    out += buf;
+    out += ",\"pid\":" + pid + ",\"tid\":" + std::to_string(span.tid) + ",\"args\":{";
+    out += "\"device\":\"" + escape(r.device) + "\",\"vendor\":\"" + escape(r.vendor) + "\"";
+    if (r.error) out += ",\"error\":true";
+    out += "}}";
+
+    if (std::find(threads.begin(), threads.end(), span.tid) == threads.end()) threads.push_back(span.tid);
+  }
+
+  for (const uint32_t tid : threads) {
+    if (!first) out += ',';
+    first = false;
+    out += "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid) +
+           ",\"args\":{\"name\":\"chronicle-" + std::to_string(tid) + "\"}}";
+  }
+  out += "\n]}\n";
+
+  writeFile(path, out);
+  return spans.size();
+}
+
+size_t exportOtlpJson(const std::string& path) {
+  uint64_t start;
+  int64_t offset;
+  uint64_t id[2];
+  const std::vector<exportedSpan> spans = collect(start, offset, id);
+  (void)start;
+
+  const std::string traceHex = hex(id[0]) + hex(id[1]);
+  std::string out =
+    "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+    "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"chronicle\"}},"
+    "{\"key\":\"process.pid\",\"value\":{\"intValue\":\"" + std::to_string(getpid()) + "\"}}"
+    "]},\"scopeSpans\":[{\"scope\":{\"name\":\"chronicle_core\"},\"spans\":[";
+
+  bool first = true;
+  for (const auto& span : spans) {
+    const spanRecord& r = span.record;
+    if (!first) out += ',';
+    first = false;
+
+    out += "\n{\"traceId\":\"" + traceHex + "\",\"spanId\":\"" + hex(r.span_id) + "\"";
+    if (r.parent_id != 0) out += ",\"parentSpanId\":\"" + hex(r.parent_id) + "\"";
+    out += ",\"name\":\"" + escape(r.name) + "\",\"kind\":1";
+    out += ",\"startTimeUnixNano\":\"" + std::to_string(static_cast<int64_t>(r.start) + offset) + "\"";
+    out += ",\"endTimeUnixNano\":\"" + std::to_string(static_cast<int64_t>(r.end) + offset) + "\"";
+    out += ",\"attributes\":[";
+    out += "{\"key\":\"thread.id\",\"value\":{\"intValue\":\"" + std::to_string(span.tid) + "\"}}";
+    if (r.device[0] != '\0') out += ",{\"key\":\"device.name\",\"value\":{\"stringValue\":\"" + escape(r.device) + "\"}}";
+    if (r.vendor[0] != '\0') out += ",{\"key\":\"device.vendor\",\"value\":{\"stringValue\":\"" + escape(r.vendor) + "\"}}";
+    out += "]";
+    out += r.error ? ",\"status\":{\"code\":2}" : ",\"status\":{\"code\":1}";
+    out += "}";
+  }
+  out += "\n]}]}]}\n";
+
+  writeFile(path, out);
+  return spans.size();
+}
@@ -0,0 +1,279 @@
+#include "core/transcript.hpp"
+#include "core/error_handler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unistd.h>
+
+namespace {
+  constexpr char FILE_MAGIC[8] = {'C', 'H', 'R', 'T', 'R', 'A', 'N', '1'};
+  constexpr uint32_t FILE_VERSION = 2;       // 2 added the exec events, 1 is still read
+  constexpr size_t WRITE_BUFFER = 64 * 1024;
+
+  std::mutex directoryMutex;
+  std::string directory;
+
+  void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+      out += static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    out += static_cast<char>(value);
+  }
+
+  bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= in.size()) return false;
+      const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return true;
+    }
+    return false;
+  }
+
+  bool getString(const std::string& in, size_t& pos, std::string& value) {
+    uint64_t size;
+    if (!getVarint(in, pos, size) || size > in.size() - pos) return false;
+    value.assign(in, pos, size);
+    pos += size;
+    return true;
+  }
+}
+
+void setTranscriptDirectory(const std::string& path) {
+  std::lock_guard<std::mutex> lock(directoryMutex);
+  directory = path;
+}
+
+std::string transcriptDirectory() {
+  std::lock_guard<std::mutex> lock(directoryMutex);
+  return directory;
+}
+
+TranscriptWriter::TranscriptWriter(const std::string& path, const std::string& nickname,
+                                   const std::string& vendor, const std::string& device)
+  : path_(path), last_(std::chrono::steady_clock::now()) {
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  file_ = fd < 0 ? nullptr : ::fdopen(fd, "wb");
+  if (file_ == nullptr) {
+    const int error = errno;
+    if (fd >= 0) ::close(fd);
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": " + std::strerror(error));
+  }
+  std::setvbuf(file_, nullptr, _IOFBF, WRITE_BUFFER);
+
+  const int64_t startedAt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  std::string header(FILE_MAGIC, sizeof(FILE_MAGIC));
+  header.append(reinterpret_cast<const char*>(&FILE_VERSION), sizeof(FILE_VERSION));
+  header.append(reinterpret_cast<const char*>(&startedAt), sizeof(startedAt));
+  for (const std::string* field : {&nickname, &vendor, &device}) {
+    putVarint(header, field->size());
+    header += *field;
+  }
+
+  if (std::fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+    std::fclose(file_);
+    file_ = nullptr;
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path);
+  }
+}
+
+TranscriptWriter::~TranscriptWriter() {
+  if (file_ != nullptr) std::fclose(file_);
+}
+
+void TranscriptWriter::record(uint8_t kind, const char* data, size_t size, uint32_t channel) {
+  if (file_ == nullptr) return;
+
+  const auto now = std::chrono::steady_clock::now();
+  const uint64_t delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_).count();
+  last_ = now;
+
+  std::string prefix(1, static_cast<char>(kind));
+  putVarint(prefix, delta);
+  if (kind >= CHRONICLE_TRANSCRIPT_EXEC) putVarint(prefix, channel);
+  putVarint(prefix, size);
+
+  // The recording is a side channel, losing it must not fail the session it records
+  if (std::fwrite(prefix.data(), 1, prefix.size(), file_) != prefix.size() ||
+      std::fwrite(data, 1, size, file_) != size) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+Transcript::Transcript(const std::string& nickname, std::vector<transcriptEvent> events)
+  : nickname_(nickname),
+    started_at_(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()),
+    events_(std::move(events)) {}
+
+Transcript::Transcript(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": could not open");
+  const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  const size_t fixed = sizeof(FILE_MAGIC) + sizeof(uint32_t) + sizeof(int64_t);
+  if (content.size() < fixed || std::memcmp(content.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": not a transcript");
+  }
+
+  uint32_t version;
+  std::memcpy(&version, content.data() + sizeof(FILE_MAGIC), sizeof(version));
+  if (version < 1 || version > FILE_VERSION) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": unsupported version " + std::to_string(version));
+  }
+  std::memcpy(&started_at_, content.data() + sizeof(FILE_MAGIC) + sizeof(version), sizeof(started_at_));
+
+  size_t pos = fixed;
+  if (!getString(content, pos, nickname_) || !getString(content, pos, vendor_) || !getString(content, pos, device_)) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": truncated header");
+  }
+
+  // A recording cut short keeps every complete event
+  uint64_t at = 0;
+  while (pos < content.size()) {
+    transcriptEvent event;
+    event.kind = static_cast<uint8_t>(content[pos++]);
+    if (event.kind > CHRONICLE_TRANSCRIPT_EXEC_EXIT) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_TRANSCRIPT_FAILED, path + ": bad event at offset " + std::to_string(pos - 1));
+    }
+
+    uint64_t delta;
+    if (!getVarint(content, pos, delta)) break;
+    if (event.kind >= CHRONICLE_TRANSCRIPT_EXEC) {
+      uint64_t channel;
+      if (!getVarint(content, pos, channel)) break;
+      event.channel = static_cast<uint32_t>(channel);
+    }
+    if (!getString(content, pos, event.data)) break;
+
+    at += delta;
+    event.at_us = at;
+    events_.push_back(std::move(event));
+  }
+}
+
+bool Transcript::exec() const {
+  return std::any_of(events_.begin(), events_.end(), [](const transcriptEvent& event) {
+    return event.kind == CHRONICLE_TRANSCRIPT_EXEC;
+  });
+}
+
+TranscriptReplay::TranscriptReplay(Transcript transcript, bool realtime)
+  : transcript_(std::move(transcript)), realtime_(realtime), segment_start_(std::chrono::steady_clock::now()) {}
+
+int TranscriptReplay::read(char* buffer, size_t size, int is_stderr) {
+  const auto& events = transcript_.events();
+  if (next_ >= events.size()) return 0;
+
+  const transcriptEvent& event = events[next_];
+  if (event.kind != (is_stderr ? CHRONICLE_TRANSCRIPT_STDERR : CHRONICLE_TRANSCRIPT_STDOUT)) return 0;
+
+  if (realtime_) {
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - segment_start_).count();
+    if (elapsed < event.at_us - segment_at_) return 0;
+  }
+
+  const size_t n = std::min(size, event.data.size() - consumed_);
+  std::memcpy(buffer, event.data.data() + consumed_, n);
+  consumed_ += n;
+  if (consumed_ == event.data.size()) {
+    next_++;
+    consumed_ = 0;
+  }
+
+  return static_cast<int>(n);
+}
+
+void TranscriptReplay::write(const std::string& data) {
+  const auto& events = transcript_.events();
+
+  // Output left unread before the next write is skipped
+  while (next_ < events.size() && events[next_].kind != CHRONICLE_TRANSCRIPT_SENT) next_++;
+  consumed_ = 0;
+
+  if (next_ >= events.size()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_REPLAY_MISMATCH, "Nothing more was sent in the recording, replay sent: " + data);
+  }
+  if (events[next_].data != data) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_REPLAY_MISMATCH, "Recording sent: " + events[next_].data + ", replay sent: " + data);
+  }
+
+  segment_at_ = events[next_].at_us;
+  segment_start_ = std::chrono::steady_clock::now();
+  next_++;
+}
+
+bool TranscriptReplay::drained() const {
+  const auto& events = transcript_.events();
+  return next_ >= events.size() || events[next_].kind == CHRONICLE_TRANSCRIPT_SENT;
+}
+
+size_t TranscriptReplay::exec(const std::string& command) {
+  const auto& events = transcript_.events();
+
+  while (next_exec_ < events.size() && events[next_exec_].kind != CHRONICLE_TRANSCRIPT_EXEC) next_exec_++;
+  if (next_exec_ >= events.size()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_REPLAY_MISMATCH, "Nothing more was run in the recording, replay ran: " + command);
+  }
+
+  const transcriptEvent& opened = events[next_exec_++];
+  if (opened.data != command) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_SSH_REPLAY_MISMATCH, "Recording ran: " + opened.data + ", replay ran: " + command);
+  }
+
+  execCursor cursor;
+  for (size_t i = next_exec_; i < events.size(); ++i) {
+    if (events[i].kind <= CHRONICLE_TRANSCRIPT_EXEC || events[i].channel != opened.channel) continue;
+    cursor.events.push_back(i);
+    if (events[i].kind == CHRONICLE_TRANSCRIPT_EXEC_EXIT) break;
+  }
+
+  exec_channels_.push_back(std::move(cursor));
+  return exec_channels_.size() - 1;
+}
+
+int TranscriptReplay::readExec(size_t channel, char* buffer, size_t size, int is_stderr) {
+  execCursor& cursor = exec_channels_.at(channel);
+  if (cursor.next >= cursor.events.size()) return 0;
+
+  const transcriptEvent& event = transcript_.events()[cursor.events[cursor.next]];
+  if (event.kind != (is_stderr ? CHRONICLE_TRANSCRIPT_EXEC_STDERR : CHRONICLE_TRANSCRIPT_EXEC_STDOUT)) return 0;
+
+  const size_t n = std::min(size, event.data.size() - cursor.consumed);
+  std::memcpy(buffer, event.data.data() + cursor.consumed, n);
+  cursor.consumed += n;
+  if (cursor.consumed == event.data.size()) {
+    cursor.next++;
+    cursor.consumed = 0;
+  }
+
+  return static_cast<int>(n);
+}
+
+bool TranscriptReplay::execDone(size_t channel) const {
+  const execCursor& cursor = exec_channels_.at(channel);
+  return cursor.next >= cursor.events.size() ||
+         transcript_.events()[cursor.events[cursor.next]].kind == CHRONICLE_TRANSCRIPT_EXEC_EXIT;
+}
+
+// -1 like libssh when the recording holds no status, a session cut short say
+int TranscriptReplay::execExitStatus(size_t channel) const {
+  const execCursor& cursor = exec_channels_.at(channel);
+  if (cursor.events.empty()) return -1;
+
+  const transcriptEvent& last = transcript_.events()[cursor.events.back()];
+  if (last.kind != CHRONICLE_TRANSCRIPT_EXEC_EXIT) return -1;
+  try {
+    return std::stoi(last.data);
+  } catch (const std::exception&) {
+    return -1;
+  }
+}
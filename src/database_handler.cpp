@@ -1,31 +1,769 @@
 #include "database_handler.hpp"
 #include "core/mongodb.hpp"
+#include "core/compression.hpp"
 #include "core/error_handler.hpp"
+#include "core/hash.hpp"
+#include "core/memory_storage.hpp"
+#include "core/snapshot.hpp"
+#include "core/storage.hpp"
+#include "core/synthetic.hpp"
+#include "core/trace.hpp"
 #include <bsoncxx/json.hpp>
+#include <bsoncxx/types.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 MongoDB mdb;
 
+namespace {
+  inline constexpr size_t CHRONICLE_SNAPSHOT_QUERY_BATCH = 1000;   // Hashes per $in query
+  inline constexpr auto CHRONICLE_DICTIONARY_REFRESH = std::chrono::minutes(5);
+
+  struct storedBlob {
+    bool delta = false;
+    std::string base;
+    std::vector<std::string> chain;     // Keyframe first, base last
+    int depth = 0;
+    size_t chunks = 0;
+    size_t found = 0;
+    size_t size = 0;
+    bool has_stored_at = false;
+    std::chrono::system_clock::time_point stored_at{};
+    std::string codec;                  // Empty when the payload is stored as is
+    std::string dictionary;
+    std::shared_ptr<BlobDecompressor> decoder;
+    std::string data;
+  };
+
+  /*
+    Dictionaries, a version never changes once written so it is loaded once per process.
+    The newest version of a vendor is looked up again every CHRONICLE_DICTIONARY_REFRESH
+    so a freshly trained one is picked up by running collectors.
+  */
+  struct vendorDictionary {
+    std::shared_ptr<const CompressionDictionary> dictionary;
+    std::chrono::steady_clock::time_point checked;
+  };
+
+  std::mutex dictionaryMutex;
+  std::unordered_map<std::string, std::shared_ptr<const CompressionDictionary>> dictionariesById;
+  std::unordered_map<std::string, vendorDictionary> latestDictionaries;
+
+  std::string dictionaryId(const std::string& vendor, int version) {
+    return vendor + "/" + std::to_string(version);
+  }
+
+  std::shared_ptr<const CompressionDictionary> cacheDictionary(const bsoncxx::document::view& view) {
+    const std::string id(view["id"].get_string().value);
+
+    auto cached = dictionariesById.find(id);
+    if (cached != dictionariesById.end()) return cached->second;
+
+    const auto data = view["data"].get_binary();
+    auto dictionary = std::make_shared<const CompressionDictionary>(id, std::string(reinterpret_cast<const char*>(data.bytes), data.size));
+    dictionariesById[id] = dictionary;
+    return dictionary;
+  }
+
+  std::shared_ptr<const CompressionDictionary> loadDictionary(const std::string& id) {
+    std::lock_guard lock(dictionaryMutex);
+
+    auto cached = dictionariesById.find(id);
+    if (cached != dictionariesById.end()) return cached->second;
+
+    auto results = mdb.findDocuments(
+      mdb.dictionaries_c,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("id", id)),
+      bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("_id", 0),
+        bsoncxx::builder::basic::kvp("id", 1),
+        bsoncxx::builder::basic::kvp("data", 1)
+      ),
+      1
+    );
+    if (results.empty()) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No compression dictionary " + id);
+    }
+
+    return cacheDictionary(results[0].view());
+  }
+
+  std::shared_ptr<const CompressionDictionary> latestDictionary(const std::string& vendor) {
+    if (vendor.empty()) return nullptr;
+
+    std::lock_guard lock(dictionaryMutex);
+
+    const auto now = std::chrono::steady_clock::now();
+    auto cached = latestDictionaries.find(vendor);
+    if (cached != latestDictionaries.end() && now - cached->second.checked < CHRONICLE_DICTIONARY_REFRESH) {
+      return cached->second.dictionary;
+    }
+
+    auto results = mdb.findDocuments(
+      mdb.dictionaries_c,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("vendor", vendor)),
+      bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("_id", 0),
+        bsoncxx::builder::basic::kvp("id", 1),
+        bsoncxx::builder::basic::kvp("data", 1)
+      ),
+      1,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("version", -1))
+    );
+
+    vendorDictionary& entry = latestDictionaries[vendor];
+    entry.dictionary = results.empty() ? nullptr : cacheDictionary(results[0].view());
+    entry.checked = now;
+    return entry.dictionary;
+  }
+
+  // Compressed payload and the fields describing it, the payload is kept as is when compression does not pay off
+  struct encodedPayload {
+    std::string codec;
+    std::string dictionary;
+    std::string data;
+  };
+
+  bool encodePayload(std::string_view payload, const CompressionDictionary* dictionary, encodedPayload& encoded) {
+    try {
+      encoded.data = compressBlob(payload, dictionary);
+    } catch (const ChronicleException&) {
+      return false;
+    }
+    if (encoded.data.size() >= payload.size()) return false;
+
+    encoded.codec = CHRONICLE_CODEC_ZSTD;
+    encoded.dictionary = dictionary != nullptr ? dictionary->id() : "";
+    return true;
+  }
+
+  bsoncxx::document::value blobProjection(bool withData) {
+    bsoncxx::builder::basic::document projection;
+    projection.append(
+      bsoncxx::builder::basic::kvp("_id", 0),
+      bsoncxx::builder::basic::kvp("hash", 1),
+      bsoncxx::builder::basic::kvp("n", 1),
+      bsoncxx::builder::basic::kvp("chunks", 1),
+      bsoncxx::builder::basic::kvp("size", 1),
+      bsoncxx::builder::basic::kvp("kind", 1),
+      bsoncxx::builder::basic::kvp("base", 1),
+      bsoncxx::builder::basic::kvp("chain", 1),
+      bsoncxx::builder::basic::kvp("depth", 1),
+      bsoncxx::builder::basic::kvp("storedAt", 1),
+      bsoncxx::builder::basic::kvp("codec", 1),
+      bsoncxx::builder::basic::kvp("dictionary", 1)
+    );
+    if (withData) projection.append(bsoncxx::builder::basic::kvp("data", 1));
+    return projection.extract();
+  }
+
+  bsoncxx::array::value hashArray(const std::vector<std::string>& hashes, size_t first, size_t last) {
+    bsoncxx::builder::basic::array array;
+    for (size_t i = first; i < last; ++i) array.append(hashes[i]);
+    return array.extract();
+  }
+
+  // Blobs written before delta chains existed have no kind and are full
+  void readBlobMeta(const bsoncxx::document::view& view, storedBlob& blob) {
+    blob.chunks = static_cast<size_t>(view["chunks"].get_int32().value);
+    blob.size = static_cast<size_t>(view["size"].get_int64().value);
+
+    auto kind = view["kind"];
+    blob.delta = kind && kind.get_string().value == "delta";
+
+    if (blob.delta) {
+      blob.base = std::string(view["base"].get_string().value);
+      blob.depth = view["depth"].get_int32().value;
+      blob.chain.clear();
+      for (const auto& element : view["chain"].get_array().value) {
+        blob.chain.emplace_back(element.get_string().value);
+      }
+    }
+
+    auto storedAt = view["storedAt"];
+    if (storedAt) {
+      blob.has_stored_at = true;
+      blob.stored_at = std::chrono::system_clock::time_point(storedAt.get_date().value);
+    }
+
+    // Blobs written before compression have neither field
+    auto codec = view["codec"];
+    blob.codec = codec ? std::string(codec.get_string().value) : "";
+    auto dictionary = view["dictionary"];
+    blob.dictionary = dictionary ? std::string(dictionary.get_string().value) : "";
+  }
+
+  // The chain a delta against hash gets
+  std::vector<std::string> chainThrough(const storedBlob& blob, const std::string& hash) {
+    std::vector<std::string> chain = blob.delta ? blob.chain : std::vector<std::string>();
+    chain.push_back(hash);
+    return chain;
+  }
+
+  // Loads every chunk of the given blobs in as few round trips as possible
+  void loadBlobs(const std::vector<std::string>& hashes, std::unordered_map<std::string, storedBlob>& blobs, bool withData) {
+    for (size_t first = 0; first < hashes.size(); first += CHRONICLE_SNAPSHOT_QUERY_BATCH) {
+      size_t last = std::min(hashes.size(), first + CHRONICLE_SNAPSHOT_QUERY_BATCH);
+      bsoncxx::builder::basic::document filter;
+      filter.append(bsoncxx::builder::basic::kvp("hash", bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("$in", hashArray(hashes, first, last))
+      )));
+      if (!withData) filter.append(bsoncxx::builder::basic::kvp("n", 0));
+
+      auto results = mdb.findDocuments(
+        mdb.configs_c,
+        filter.view(),
+        blobProjection(withData),
+        std::nullopt,
+        bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("hash", 1),
+          bsoncxx::builder::basic::kvp("n", 1)
+        )
+      );
+
+      for (const auto& r : results) {
+        const auto& view = r.view();
+        storedBlob& blob = blobs[std::string(view["hash"].get_string().value)];
+
+        if (view["n"].get_int32().value == 0) readBlobMeta(view, blob);
+        blob.found++;
+
+        if (withData) {
+          const auto data = view["data"].get_binary();
+          std::string_view chunk(reinterpret_cast<const char*>(data.bytes), data.size);
+
+          // Chunks arrive in order, compressed ones are inflated as they come in
+          if (blob.codec.empty()) {
+            blob.data.append(chunk);
+          } else {
+            if (!blob.decoder) {
+              auto dictionary = blob.dictionary.empty() ? nullptr : loadDictionary(blob.dictionary);
+              blob.decoder = std::make_shared<BlobDecompressor>(dictionary.get());
+            }
+            blob.decoder->feed(chunk, blob.data);
+          }
+        }
+      }
+    }
+  }
+
+  // Follows the delta chain down to its keyframe, normally the whole chain arrives with the second query
+  std::string resolveBlob(const std::string& hash, std::unordered_map<std::string, storedBlob>& blobs, int depth) {
+    if (depth > 2 * CHRONICLE_SNAPSHOT_KEYFRAME_INTERVAL) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, hash + " does not lead back to a keyframe");
+    }
+
+    if (blobs.find(hash) == blobs.end()) {
+      loadBlobs({hash}, blobs, true);
+      if (blobs.find(hash) == blobs.end()) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No configuration blob " + hash);
+      }
+
+      std::vector<std::string> missing;
+      for (const auto& link : blobs[hash].chain) {
+        if (blobs.find(link) == blobs.end()) missing.push_back(link);
+      }
+      loadBlobs(missing, blobs, true);
+    }
+
+    const storedBlob& blob = blobs[hash];
+    if (blob.found != blob.chunks) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_CORRUPT_BLOB, hash + " has " + std::to_string(blob.found) + " of " + std::to_string(blob.chunks) + " chunks");
+    }
+
+    if (blob.decoder) blob.decoder->finish();
+
+    if (!blob.delta) return blob.data;
+    return applySnapshotDelta(resolveBlob(blob.base, blobs, depth + 1), blob.data);
+  }
+
+  // Only single chunk blobs are ever rewritten, so replacing chunk 0 is one atomic update
+  void rewriteBlob(const std::string& hash, const storedBlob& layout, std::string_view payload, const std::string& dictionaryId) {
+    std::shared_ptr<const CompressionDictionary> dictionary;
+    if (!dictionaryId.empty()) {
+      try {
+        dictionary = loadDictionary(dictionaryId);
+      } catch (const ChronicleException&) {
+        // Plain zstd then, the blob is rewritten either way
+      }
+    }
+
+    encodedPayload encoded;
+    if (encodePayload(payload, dictionary.get(), encoded)) payload = encoded.data;
+
+    bsoncxx::builder::basic::document queryFilter;
+    queryFilter.append(
+      bsoncxx::builder::basic::kvp("hash", hash),
+      bsoncxx::builder::basic::kvp("n", 0)
+    );
+
+    bsoncxx::builder::basic::document updateDoc;
+    updateDoc.append(
+      bsoncxx::builder::basic::kvp("kind", layout.delta ? "delta" : "full"),
+      bsoncxx::builder::basic::kvp("base", layout.base),
+      bsoncxx::builder::basic::kvp("chain", hashArray(layout.chain, 0, layout.chain.size())),
+      bsoncxx::builder::basic::kvp("depth", static_cast<int32_t>(layout.depth)),
+      bsoncxx::builder::basic::kvp("chunks", 1),
+      bsoncxx::builder::basic::kvp("codec", encoded.codec),
+      bsoncxx::builder::basic::kvp("dictionary", encoded.dictionary),
+      bsoncxx::builder::basic::kvp("data", bsoncxx::types::b_binary{
+        bsoncxx::binary_sub_type::k_binary,
+        static_cast<uint32_t>(payload.size()),
+        reinterpret_cast<const uint8_t*>(payload.data())
+      })
+    );
+
+    mdb.updateDocument(mdb.configs_c, queryFilter, updateDoc.view());
+  }
+
+  // The selected backend, once it holds a connection
+  std::shared_ptr<StorageBackend> connectedStorage() {
+    auto backend = storage();
+    if (!backend->connected()) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+    return backend;
+  }
+
+  // Retention, dictionaries, the fleet index sync and archives query the collections themselves
+  void requireMongoStorage(const std::string& operation) {
+    const std::string kind = storageKind();
+    if (kind != CHRONICLE_STORAGE_MONGO) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_STORAGE_UNSUPPORTED, operation + " needs the mongo storage backend, " + kind + " is selected.");
+    }
+  }
+
+  // The chronicle_db collections through the process wide connection
+  class MongoStorage : public StorageBackend {
+    public:
+      std::string kind() const override { return CHRONICLE_STORAGE_MONGO; }
+      void connect() override { mdb.connect(); }
+      bool connected() const override { return mdb.connected; }
+
+      void insertDevice(const bsoncxx::document::view& device) override;
+      void updateDevice(const std::string& nickname, const bsoncxx::document::view& fields) override;
+      void updateDevices(const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) override;
+      void deleteDevice(const std::string& nickname) override;
+      std::optional<bsoncxx::document::value> findDevice(const std::string& nickname) override;
+      std::vector<bsoncxx::document::value> findDevices() override;
+
+      void insertUser(const bsoncxx::document::view& user) override;
+      void updateUser(const std::string& username, const bsoncxx::document::view& fields) override;
+      void deleteUser(const std::string& username) override;
+      std::optional<bsoncxx::document::value> findUser(const std::string& username) override;
+      std::vector<bsoncxx::document::value> findUsers() override;
+
+      void insertSettings(const bsoncxx::document::view& settings) override;
+      void updateSettings(const bsoncxx::document::view& fields) override;
+      std::optional<bsoncxx::document::value> findSettings() override;
+
+      void insertHostKeys(const std::vector<bsoncxx::document::value>& entries) override;
+      void deleteHostKey(const std::string& host, int port) override;
+      std::vector<bsoncxx::document::value> findHostKeys() override;
+
+      void insertSnapshot(const bsoncxx::document::view& entry) override;
+      std::vector<bsoncxx::document::value> findSnapshots(
+        const std::string& nickname,
+        std::optional<std::chrono::system_clock::time_point> at = std::nullopt,
+        std::optional<int> limit = std::nullopt
+      ) override;
+
+      void storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash, const std::string& vendor) override;
+      std::string getBlob(const std::string& hash) override;
+
+      void insertRun(const bsoncxx::document::view& run) override;
+      void updateRun(const std::string& runId, const bsoncxx::document::view& fields) override;
+      std::optional<bsoncxx::document::value> findRun(const std::string& runId) override;
+      std::vector<bsoncxx::document::value> findRuns(std::optional<int> limit = std::nullopt) override;
+      void updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) override;
+      std::vector<bsoncxx::document::value> findRunDevices(const std::string& runId) override;
+      std::vector<bsoncxx::document::value> findRunSnapshots(const std::string& runId) override;
+  };
+
+  std::optional<bsoncxx::document::value> first(std::vector<bsoncxx::document::value>&& results) {
+    if (results.empty()) return std::nullopt;
+    return std::move(results[0]);
+  }
+}
+
+std::shared_ptr<StorageBackend> makeMongoStorage() {
+  return std::make_shared<MongoStorage>();
+}
+
+/* Mongo storage backend */
+void MongoStorage::insertDevice(const bsoncxx::document::view& device) {
+  mdb.insertDocument(mdb.devices_c, device);
+}
+
+void MongoStorage::updateDevice(const std::string& nickname, const bsoncxx::document::view& fields) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(bsoncxx::builder::basic::kvp("device.name", nickname));
+  mdb.updateDocument(mdb.devices_c, queryFilter, fields);
+}
+
+void MongoStorage::updateDevices(const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) {
+  std::vector<std::pair<bsoncxx::document::value, bsoncxx::document::value>> filtered;
+  filtered.reserve(updates.size());
+  for (const auto& [nickname, fields] : updates) {
+    filtered.emplace_back(bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("device.name", nickname)), fields);
+  }
+  mdb.updateDocuments(mdb.devices_c, filtered);
+}
+
+void MongoStorage::deleteDevice(const std::string& nickname) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(bsoncxx::builder::basic::kvp("device.name", nickname));
+  mdb.deleteDocument(mdb.devices_c, queryFilter);
+}
+
+std::optional<bsoncxx::document::value> MongoStorage::findDevice(const std::string& nickname) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("device.name", nickname));
+  return first(mdb.findDocuments(mdb.devices_c, filter.view(), ChronicleDB::MongoProjections::device(), 1));
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findDevices() {
+  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
+  return mdb.findDocuments(mdb.devices_c, filter, ChronicleDB::MongoProjections::device());
+}
+
+void MongoStorage::insertUser(const bsoncxx::document::view& user) {
+  mdb.insertDocument(mdb.users_c, user);
+}
+
+void MongoStorage::updateUser(const std::string& username, const bsoncxx::document::view& fields) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(bsoncxx::builder::basic::kvp("username", username));
+  mdb.updateDocument(mdb.users_c, queryFilter, fields);
+}
+
+void MongoStorage::deleteUser(const std::string& username) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(bsoncxx::builder::basic::kvp("username", username));
+  mdb.deleteDocument(mdb.users_c, queryFilter);
+}
+
+std::optional<bsoncxx::document::value> MongoStorage::findUser(const std::string& username) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("username", username));
+  return first(mdb.findDocuments(mdb.users_c, filter.view(), ChronicleDB::MongoProjections::users(), 1));
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findUsers() {
+  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
+  return mdb.findDocuments(mdb.users_c, filter, ChronicleDB::MongoProjections::users());
+}
+
+void MongoStorage::insertSettings(const bsoncxx::document::view& settings) {
+  mdb.insertDocument(mdb.settings_c, settings);
+}
+
+void MongoStorage::updateSettings(const bsoncxx::document::view& fields) {
+  bsoncxx::builder::basic::document filter{};
+  mdb.updateDocument(mdb.settings_c, filter, fields);
+}
+
+std::optional<bsoncxx::document::value> MongoStorage::findSettings() {
+  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
+  return first(mdb.findDocuments(mdb.settings_c, filter, ChronicleDB::MongoProjections::settings(), 1));
+}
+
+void MongoStorage::insertHostKeys(const std::vector<bsoncxx::document::value>& entries) {
+  mdb.insertDocuments(mdb.hostkeys_c, entries);
+}
+
+void MongoStorage::deleteHostKey(const std::string& host, int port) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(
+    bsoncxx::builder::basic::kvp("host", host),
+    bsoncxx::builder::basic::kvp("port", port)
+  );
+  mdb.deleteDocument(mdb.hostkeys_c, queryFilter);
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findHostKeys() {
+  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
+  return mdb.findDocuments(mdb.hostkeys_c, filter, ChronicleDB::MongoProjections::hostKeys());
+}
+
+void MongoStorage::insertSnapshot(const bsoncxx::document::view& entry) {
+  mdb.insertDocument(mdb.snapshots_c, entry);
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findSnapshots(
+  const std::string& nickname,
+  std::optional<std::chrono::system_clock::time_point> at,
+  std::optional<int> limit
+) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("device", nickname));
+  if (at) {
+    filter.append(bsoncxx::builder::basic::kvp("takenAt", bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("$lte", bsoncxx::types::b_date{*at})
+    )));
+  }
+
+  // Served by the device + takenAt index, no history scan
+  return mdb.findDocuments(
+    mdb.snapshots_c,
+    filter.view(),
+    ChronicleDB::MongoProjections::snapshots(),
+    limit,
+    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", -1))
+  );
+}
+
+void MongoStorage::storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash, const std::string& vendor) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("hash", hash));
+
+  auto findChunks = [&]() {
+    return mdb.findDocuments(
+      mdb.configs_c,
+      filter.view(),
+      bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("_id", 0),
+        bsoncxx::builder::basic::kvp("n", 1),
+        bsoncxx::builder::basic::kvp("chunks", 1),
+        bsoncxx::builder::basic::kvp("complete", 1),
+        bsoncxx::builder::basic::kvp("codec", 1),
+        bsoncxx::builder::basic::kvp("dictionary", 1)
+      ),
+      std::nullopt,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("n", 1))
+    );
+  };
+
+  // The first chunk carries the marker once every chunk is in, blobs from before it have all their chunks
+  auto isComplete = [](const std::vector<bsoncxx::document::value>& chunks) {
+    if (chunks.empty()) return false;
+    const auto first = chunks[0].view();
+    if (first["n"].get_int32().value == 0 && first["complete"]) return true;
+    return chunks.size() == static_cast<size_t>(first["chunks"].get_int32().value);
+  };
+
+  // Every chunk already there means the blob is stored, this is the common unchanged case
+  auto existing = findChunks();
+  if (isComplete(existing)) return;
+
+  // Store a delta against the previous version while the chain is short and the delta actually saves space
+  storedBlob layout;
+  std::string delta;
+  std::string_view plain = blob;
+
+  if (existing.empty() && !baseHash.empty() && blob.size() <= CHRONICLE_SNAPSHOT_CHUNK_SIZE) {
+    try {
+      auto baseMeta = mdb.findDocuments(
+        mdb.configs_c,
+        bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("hash", baseHash),
+          bsoncxx::builder::basic::kvp("n", 0)
+        ),
+        blobProjection(false),
+        1
+      );
+
+      if (!baseMeta.empty()) {
+        storedBlob base;
+        readBlobMeta(baseMeta[0].view(), base);
+
+        if (base.depth + 1 < CHRONICLE_SNAPSHOT_KEYFRAME_INTERVAL) {
+          delta = encodeSnapshotDelta(splitSnapshotLines(getBlob(baseHash)), splitSnapshotLines(blob));
+
+          if (delta.size() < blob.size() / 2) {
+            layout.delta = true;
+            layout.base = baseHash;
+            layout.chain = chainThrough(base, baseHash);
+            layout.depth = static_cast<int>(layout.chain.size());
+            plain = delta;
+          }
+        }
+      }
+    } catch (const ChronicleException& e) {
+      // A base that can not be read is no reason to lose this version, store it as a keyframe
+      layout = storedBlob();
+      plain = blob;
+    }
+  }
+
+  const auto storedAt = bsoncxx::types::b_date{std::chrono::system_clock::now()};
+
+  /*
+    Chunks are upserted on (hash, n) in order, nothing is ever deleted. Only full blobs span
+    several chunks and their encoding is the dictionary alone, which is part of the filter: a
+    chunk written with another dictionary makes the upsert hit the unique index and stop,
+    chunk 0 first. The write then starts over with the encoding found, so the chunks of a blob
+    are never mixed from writers that compressed differently.
+  */
+  for (int attempt = 0; ; ++attempt) {
+    // Compressed with the vendor's newest dictionary, or the one of chunks already stored
+    std::shared_ptr<const CompressionDictionary> dictionary;
+    bool compress = true;
+    try {
+      if (existing.empty()) {
+        dictionary = latestDictionary(vendor);
+      } else {
+        const auto found = existing[0].view();
+        const std::string codec = found["codec"] ? std::string(found["codec"].get_string().value) : "";
+        const std::string dictionaryId = found["dictionary"] ? std::string(found["dictionary"].get_string().value) : "";
+        compress = !codec.empty();
+        if (!dictionaryId.empty()) dictionary = loadDictionary(dictionaryId);
+      }
+    } catch (const ChronicleException& e) {
+      if (!existing.empty()) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, hash + ": chunks stored already use a dictionary that can not be loaded");
+      }
+      dictionary = nullptr;
+    }
+
+    encodedPayload encoded;
+    std::string_view payload = plain;
+    if (compress && encodePayload(payload, dictionary.get(), encoded)) payload = encoded.data;
+
+    const size_t chunks = payload.empty() ? 1 : (payload.size() + CHRONICLE_SNAPSHOT_CHUNK_SIZE - 1) / CHRONICLE_SNAPSHOT_CHUNK_SIZE;
+
+    std::vector<std::pair<bsoncxx::document::value, bsoncxx::document::value>> updates;
+    updates.reserve(chunks);
+
+    for (size_t n = 0; n < chunks; ++n) {
+      std::string_view part = payload.substr(std::min(payload.size(), n * CHRONICLE_SNAPSHOT_CHUNK_SIZE), CHRONICLE_SNAPSHOT_CHUNK_SIZE);
+
+      bsoncxx::builder::basic::document doc;
+      doc.append(
+        bsoncxx::builder::basic::kvp("chunks", static_cast<int32_t>(chunks)),
+        bsoncxx::builder::basic::kvp("size", static_cast<int64_t>(blob.size())),
+        bsoncxx::builder::basic::kvp("kind", layout.delta ? "delta" : "full"),
+        bsoncxx::builder::basic::kvp("depth", static_cast<int32_t>(layout.depth)),
+        bsoncxx::builder::basic::kvp("storedAt", storedAt),
+        bsoncxx::builder::basic::kvp("data", bsoncxx::types::b_binary{
+          bsoncxx::binary_sub_type::k_binary,
+          static_cast<uint32_t>(part.size()),
+          reinterpret_cast<const uint8_t*>(part.data())
+        })
+      );
+
+      if (layout.delta) {
+        doc.append(
+          bsoncxx::builder::basic::kvp("base", layout.base),
+          bsoncxx::builder::basic::kvp("chain", hashArray(layout.chain, 0, layout.chain.size()))
+        );
+      }
+
+      updates.emplace_back(bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("hash", hash),
+        bsoncxx::builder::basic::kvp("n", static_cast<int32_t>(n)),
+        bsoncxx::builder::basic::kvp("codec", encoded.codec),
+        bsoncxx::builder::basic::kvp("dictionary", encoded.dictionary)
+      ), doc.extract());
+    }
+
+    try {
+      mdb.updateDocuments(mdb.configs_c, updates, true, true);
+
+      bsoncxx::builder::basic::document first;
+      first.append(
+        bsoncxx::builder::basic::kvp("hash", hash),
+        bsoncxx::builder::basic::kvp("n", 0)
+      );
+      mdb.updateDocument(mdb.configs_c, first, bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("complete", true)));
+      return;
+    } catch (const ChronicleException& e) {
+
+      // Another writer got there first with a different encoding, done or to be followed
+      if (e.getCode() == CHRONICLE_ERROR_MONGO_DUPLICATE && attempt == 0) {
+        existing = findChunks();
+        if (isComplete(existing)) return;
+        if (!existing.empty()) continue;
+      }
+
+      std::string fullMessage =
+        "Chronicle exception:\n"
+        "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+        "Details: " + e.getDetails();
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+    } catch (const std::exception& e) {
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+    }
+  }
+}
+
+std::string MongoStorage::getBlob(const std::string& hash) {
+  std::unordered_map<std::string, storedBlob> blobs;
+  return resolveBlob(hash, blobs, 0);
+}
+
+void MongoStorage::insertRun(const bsoncxx::document::view& run) {
+  mdb.insertDocument(mdb.runs_c, run);
+}
+
+void MongoStorage::updateRun(const std::string& runId, const bsoncxx::document::view& fields) {
+  bsoncxx::builder::basic::document queryFilter;
+  queryFilter.append(bsoncxx::builder::basic::kvp("id", runId));
+  mdb.updateDocument(mdb.runs_c, queryFilter, fields);
+}
+
+std::optional<bsoncxx::document::value> MongoStorage::findRun(const std::string& runId) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("id", runId));
+  return first(mdb.findDocuments(mdb.runs_c, filter.view(), ChronicleDB::MongoProjections::runs(), 1));
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findRuns(std::optional<int> limit) {
+  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
+  return mdb.findDocuments(
+    mdb.runs_c,
+    filter,
+    ChronicleDB::MongoProjections::runs(),
+    limit,
+    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("startedAt", -1))
+  );
+}
+
+void MongoStorage::updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) {
+  std::vector<std::pair<bsoncxx::document::value, bsoncxx::document::value>> filtered;
+  filtered.reserve(updates.size());
+  for (const auto& [device, fields] : updates) {
+    filtered.emplace_back(bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("run", runId),
+      bsoncxx::builder::basic::kvp("device", device)
+    ), fields);
+  }
+
+  // One unordered bulk write, a device seen for the first time gets its document from the filter
+  mdb.updateDocuments(mdb.rundevices_c, filtered, true);
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findRunDevices(const std::string& runId) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("run", runId));
+  return mdb.findDocuments(mdb.rundevices_c, filter.view(), ChronicleDB::MongoProjections::runDevices());
+}
+
+std::vector<bsoncxx::document::value> MongoStorage::findRunSnapshots(const std::string& runId) {
+  bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("run", runId));
+
+  // Served by the sparse run index, entries stored outside a run are not in it
+  return mdb.findDocuments(mdb.snapshots_c, filter.view(), ChronicleDB::MongoProjections::snapshots());
+}
+
+
 void ChronicleDB::connect() {
-  mdb.connect();
-  if (!mdb.connected) {
+  auto backend = storage();
+  backend->connect();
+  if (!backend->connected()) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Failed connecting to DB.");
   }
 }
 
 void ChronicleDB::initDB() const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot initialise DB since connection to database was not established."); }
-
-  bsoncxx::builder::basic::document matchAllFilter{};
+  auto backend = storage();
+  if (!backend->connected()) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot initialise DB since connection to database was not established."); }
 
   // Settings
-  auto settingsExisting = mdb.findDocuments(
-    mdb.settings_c,
-    matchAllFilter.view(),
-    ChronicleDB::MongoProjections::settings(),
-    1
-  );
-  
-  if (settingsExisting.empty()) {
+  if (!backend->findSettings()) {
     bsoncxx::builder::basic::document settingsDoc;
 
     settingsDoc.append(
@@ -33,13 +771,16 @@ void ChronicleDB::initDB() const {
         "ssh",
         bsoncxx::builder::basic::make_document(
           bsoncxx::builder::basic::kvp("sshIdleTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_IDLE_TIMEOUT),
-          bsoncxx::builder::basic::kvp("sshTotalTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT)
+          bsoncxx::builder::basic::kvp("sshTotalTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_TOTAL_TIMEOUT),
+          bsoncxx::builder::basic::kvp("sshConnectTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_CONNECT_TIMEOUT),
+          bsoncxx::builder::basic::kvp("sshHandshakeTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_HANDSHAKE_TIMEOUT),
+          bsoncxx::builder::basic::kvp("sshAuthTimeout", CHRONICLE_CONFIG_DEFAULT_SSH_AUTH_TIMEOUT)
         )
       )
     );
 
     try {
-      mdb.insertDocument(mdb.settings_c, settingsDoc.view());
+      backend->insertSettings(settingsDoc.view());
     } catch (const ChronicleException& e) {
 
       std::string fullMessage;
@@ -73,7 +814,10 @@ const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::device() {
       bsoncxx::builder::basic::kvp("name", 1),
       bsoncxx::builder::basic::kvp("deviceName", 1),
       bsoncxx::builder::basic::kvp("vendorName", 1)
-    ))
+    )),
+    bsoncxx::builder::basic::kvp("reachability", 1),
+    bsoncxx::builder::basic::kvp("transport", 1),
+    bsoncxx::builder::basic::kvp("changeProbe", 1)
   );
 }
 
@@ -84,7 +828,10 @@ const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::settings()
     bsoncxx::builder::basic::kvp("_id", 0),
     bsoncxx::builder::basic::kvp("ssh", bsoncxx::builder::basic::make_document(
       bsoncxx::builder::basic::kvp("sshIdleTimeout", 1),
-      bsoncxx::builder::basic::kvp("sshTotalTimeout", 1)
+      bsoncxx::builder::basic::kvp("sshTotalTimeout", 1),
+      bsoncxx::builder::basic::kvp("sshConnectTimeout", 1),
+      bsoncxx::builder::basic::kvp("sshHandshakeTimeout", 1),
+      bsoncxx::builder::basic::kvp("sshAuthTimeout", 1)
     ))
   );
 }
@@ -100,20 +847,88 @@ const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::users() {
   );
 }
 
+const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::hostKeys() {
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot create mongo projection since connection to database was not established."); }
+
+  return bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("_id", 0),
+    bsoncxx::builder::basic::kvp("host", 1),
+    bsoncxx::builder::basic::kvp("port", 1),
+    bsoncxx::builder::basic::kvp("fingerprint", 1)
+  );
+}
+
+const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::snapshots() {
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot create mongo projection since connection to database was not established."); }
+
+  return bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("_id", 0),
+    bsoncxx::builder::basic::kvp("device", 1),
+    bsoncxx::builder::basic::kvp("hash", 1),
+    bsoncxx::builder::basic::kvp("size", 1),
+    bsoncxx::builder::basic::kvp("lines", 1),
+    bsoncxx::builder::basic::kvp("changed", 1),
+    bsoncxx::builder::basic::kvp("takenAt", 1),
+    bsoncxx::builder::basic::kvp("run", 1)
+  );
+}
+
+const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::runs() {
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot create mongo projection since connection to database was not established."); }
+
+  return bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("_id", 0),
+    bsoncxx::builder::basic::kvp("id", 1),
+    bsoncxx::builder::basic::kvp("kind", 1),
+    bsoncxx::builder::basic::kvp("status", 1),
+    bsoncxx::builder::basic::kvp("devices", 1),
+    bsoncxx::builder::basic::kvp("counts", 1),
+    bsoncxx::builder::basic::kvp("owners", 1),
+    bsoncxx::builder::basic::kvp("startedAt", 1),
+    bsoncxx::builder::basic::kvp("updatedAt", 1)
+  );
+}
+
+const bsoncxx::document::view_or_value ChronicleDB::MongoProjections::runDevices() {
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Cannot create mongo projection since connection to database was not established."); }
+
+  return bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("_id", 0),
+    bsoncxx::builder::basic::kvp("run", 1),
+    bsoncxx::builder::basic::kvp("device", 1),
+    bsoncxx::builder::basic::kvp("state", 1),
+    bsoncxx::builder::basic::kvp("attempts", 1),
+    bsoncxx::builder::basic::kvp("owner", 1),
+    bsoncxx::builder::basic::kvp("leaseUntil", 1),
+    bsoncxx::builder::basic::kvp("hash", 1),
+    bsoncxx::builder::basic::kvp("code", 1),
+    bsoncxx::builder::basic::kvp("message", 1),
+    bsoncxx::builder::basic::kvp("updatedAt", 1)
+  );
+}
+
 
 /* Settings */
-void ChronicleDB::updateSettings(std::optional<int> sshIdleTimeout, std::optional<int> sshTotalTimeout) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+void ChronicleDB::updateSettings(
+  std::optional<int> sshIdleTimeout,
+  std::optional<int> sshTotalTimeout,
+  std::optional<int> sshConnectTimeout,
+  std::optional<int> sshHandshakeTimeout,
+  std::optional<int> sshAuthTimeout
+) const {
+  auto backend = connectedStorage();
 
-  bsoncxx::builder::basic::document filter{};
   bsoncxx::builder::basic::document updateDoc;
   
   // SSH fields
   if (sshIdleTimeout)           updateDoc.append(bsoncxx::builder::basic::kvp("ssh.sshIdleTimeout", *sshIdleTimeout));
   if (sshTotalTimeout)          updateDoc.append(bsoncxx::builder::basic::kvp("ssh.sshTotalTimeout", *sshTotalTimeout));
+  if (sshConnectTimeout)        updateDoc.append(bsoncxx::builder::basic::kvp("ssh.sshConnectTimeout", *sshConnectTimeout));
+  if (sshHandshakeTimeout)      updateDoc.append(bsoncxx::builder::basic::kvp("ssh.sshHandshakeTimeout", *sshHandshakeTimeout));
+  if (sshAuthTimeout)           updateDoc.append(bsoncxx::builder::basic::kvp("ssh.sshAuthTimeout", *sshAuthTimeout));
 
   try {
-    mdb.updateDocument(mdb.settings_c, filter, updateDoc.view());
+    backend->updateSettings(updateDoc.view());
   } catch (const ChronicleException& e) {
 
     std::string fullMessage;
@@ -134,16 +949,14 @@ void ChronicleDB::updateSettings(std::optional<int> sshIdleTimeout, std::optiona
 }
 
 std::string ChronicleDB::getSettings() const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
 
-  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
-  auto results = mdb.findDocuments(mdb.settings_c, filter, ChronicleDB::MongoProjections::settings());
-
-  if (results.empty()) {
+  auto settings = backend->findSettings();
+  if (!settings) {
       THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No Chronicle settings found in database.");
   }
 
-  return bsoncxx::to_json(results[0].view());
+  return bsoncxx::to_json(settings->view());
 }
 
 /* Devices */
@@ -160,9 +973,14 @@ void ChronicleDB::addDevice(
   const int& port,
   const int& sshVerbosity,
   const std::string& kexMethods,
-  const std::string& hostkeyAlgorithms
+  const std::string& hostkeyAlgorithms,
+
+  // Transport
+  const bool& compression,
+  const int& compressionLevel,
+  const int& readBufferSize
 ) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
 
   bsoncxx::builder::basic::document deviceData;
 
@@ -187,8 +1005,17 @@ void ChronicleDB::addDevice(
     ))
   );
 
+  deviceData.append(
+    bsoncxx::builder::basic::kvp("transport", bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("compression", compression),
+      bsoncxx::builder::basic::kvp("compressionLevel", compressionLevel),
+      bsoncxx::builder::basic::kvp("readBufferSize", readBufferSize),
+      bsoncxx::builder::basic::kvp("lastOutputSize", 0)
+    ))
+  );
+
   try {
-    mdb.insertDocument(mdb.devices_c, deviceData.view());
+    backend->insertDevice(deviceData.view());
   } catch (const ChronicleException& e) {
 
     std::string fullMessage;
@@ -222,9 +1049,14 @@ void ChronicleDB::modifyDevice(
   std::optional<int> port,
   std::optional<int> sshVerbosity,
   std::optional<std::string> kexMethods,
-  std::optional<std::string> hostkeyAlgorithms
+  std::optional<std::string> hostkeyAlgorithms,
+
+  // Transport fields
+  std::optional<bool> compression,
+  std::optional<int> compressionLevel,
+  std::optional<int> readBufferSize
 ) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
   
   bsoncxx::builder::basic::document updateDoc;
   
@@ -241,15 +1073,17 @@ void ChronicleDB::modifyDevice(
   if (kexMethods)         updateDoc.append(bsoncxx::builder::basic::kvp("ssh.kexMethods", *kexMethods));
   if (hostkeyAlgorithms)  updateDoc.append(bsoncxx::builder::basic::kvp("ssh.hostkeyAlgorithms", *hostkeyAlgorithms));
 
+  // Transport fields
+  if (compression)        updateDoc.append(bsoncxx::builder::basic::kvp("transport.compression", *compression));
+  if (compressionLevel)   updateDoc.append(bsoncxx::builder::basic::kvp("transport.compressionLevel", *compressionLevel));
+  if (readBufferSize)     updateDoc.append(bsoncxx::builder::basic::kvp("transport.readBufferSize", *readBufferSize));
+
   if (updateDoc.view().empty()) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, "No fields provided to modify.");
   }
 
-  bsoncxx::builder::basic::document queryFilter;
-  queryFilter.append(bsoncxx::builder::basic::kvp("device.name", deviceNickname));
-
   try {
-    mdb.updateDocument(mdb.devices_c, queryFilter, updateDoc.view());
+    backend->updateDevice(deviceNickname, updateDoc.view());
   } catch (const ChronicleException& e) {
 
     std::string fullMessage;
@@ -271,13 +1105,10 @@ void ChronicleDB::modifyDevice(
 
 void ChronicleDB::deleteDevice(const std::string& deviceNickname) const {
 
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
-
-  bsoncxx::builder::basic::document queryFilter;
-  queryFilter.append(bsoncxx::builder::basic::kvp("device.name", deviceNickname));
+  auto backend = connectedStorage();
 
   try {
-    mdb.deleteDocument(mdb.devices_c, queryFilter);
+    backend->deleteDevice(deviceNickname);
   } catch (const ChronicleException& e) {
     std::string fullMessage;
 
@@ -297,14 +1128,11 @@ void ChronicleDB::deleteDevice(const std::string& deviceNickname) const {
 }
 
 std::vector<std::string> ChronicleDB::listDevices() const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
-
-  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
-  auto results = mdb.findDocuments(mdb.devices_c, filter, ChronicleDB::MongoProjections::device());
+  auto backend = connectedStorage();
 
   std::vector<std::string> listOfDevices;
 
-  for (const auto r : results) {
+  for (const auto& r : backend->findDevices()) {
     listOfDevices.push_back( bsoncxx::to_json(r));
   }
 
@@ -313,18 +1141,14 @@ std::vector<std::string> ChronicleDB::listDevices() const {
 
 std::string ChronicleDB::getDevice(const std::string& deviceNickname) const {
 
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
-
-  bsoncxx::builder::basic::document filter;
-
-  filter.append(bsoncxx::builder::basic::kvp("device.name", deviceNickname));
+  auto backend = connectedStorage();
 
-  auto results = mdb.findDocuments(mdb.devices_c, filter.view(), ChronicleDB::MongoProjections::device());
+  auto device = backend->findDevice(deviceNickname);
 
   std::string deviceData;
 
-  if (!results.empty()) {
-      deviceData = bsoncxx::to_json(results[0].view());
+  if (device) {
+      deviceData = bsoncxx::to_json(device->view());
   }
 
   return deviceData;
@@ -332,7 +1156,7 @@ std::string ChronicleDB::getDevice(const std::string& deviceNickname) const {
 
 /* Users */
 void ChronicleDB::addUser(const std::string& username, const std::string& password, bool connected) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
 
   bsoncxx::builder::basic::document userData;
 
@@ -343,7 +1167,7 @@ void ChronicleDB::addUser(const std::string& username, const std::string& passwo
   );
 
   try {
-    mdb.insertDocument(mdb.users_c, userData.view());
+    backend->insertUser(userData.view());
   } catch (const ChronicleException& e) {
 
     std::string fullMessage;
@@ -368,7 +1192,7 @@ void ChronicleDB::modifyUser(
   std::optional<std::string> password,
   std::optional<bool> connected
 ) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
 
   bsoncxx::builder::basic::document updateDoc;
 
@@ -379,11 +1203,8 @@ void ChronicleDB::modifyUser(
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, "No fields provided to modify.");
   }
 
-  bsoncxx::builder::basic::document queryFilter;
-  queryFilter.append(bsoncxx::builder::basic::kvp("username", username));
-
   try {
-    mdb.updateDocument(mdb.users_c, queryFilter, updateDoc.view());
+    backend->updateUser(username, updateDoc.view());
   } catch (const ChronicleException& e) {
 
     std::string fullMessage;
@@ -404,13 +1225,10 @@ void ChronicleDB::modifyUser(
 }
 
 void ChronicleDB::deleteUser(const std::string& username) const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
-
-  bsoncxx::builder::basic::document queryFilter;
-  queryFilter.append(bsoncxx::builder::basic::kvp("username", username));
+  auto backend = connectedStorage();
 
   try {
-    mdb.deleteDocument(mdb.users_c, queryFilter);
+    backend->deleteUser(username);
   } catch (const ChronicleException& e) {
     std::string fullMessage;
 
@@ -430,14 +1248,11 @@ void ChronicleDB::deleteUser(const std::string& username) const {
 }
 
 std::vector<std::string> ChronicleDB::listUsers() const {
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
-
-  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
-  auto results = mdb.findDocuments(mdb.users_c, filter, ChronicleDB::MongoProjections::users());
+  auto backend = connectedStorage();
 
   std::vector<std::string> listOfUsers;
 
-  for (const auto r : results) {
+  for (const auto& r : backend->findUsers()) {
     listOfUsers.push_back( bsoncxx::to_json(r));
   }
 
@@ -445,53 +1260,973 @@ std::vector<std::string> ChronicleDB::listUsers() const {
 }
 
 std::string ChronicleDB::getUser(const std::string& username) const {
+  auto backend = connectedStorage();
+
+  auto user = backend->findUser(username);
+
+  std::string userData;
+
+  if (user) {
+      userData = bsoncxx::to_json(user->view());
+  }
+
+  return userData;
+}
+
+
+/* Snapshots */
+std::string ChronicleDB::storeSnapshot(const std::string& deviceNickname, const std::vector<std::string>& lines, const std::string& runId) const {
+  TraceSpan span("ChronicleDB::storeSnapshot", deviceNickname);
+
+  auto backend = connectedStorage();
+
+  const std::string blob = joinSnapshotLines(lines);
+  const std::string hash = contentHash(blob);
+
+  auto previous = backend->findSnapshots(deviceNickname, std::nullopt, 1);
+  const std::string previousHash = previous.empty() ? "" : std::string(previous[0].view()["hash"].get_string().value);
+  const bool changed = previousHash != hash;
+
+  storeBlob(hash, blob, changed ? previousHash : "", changed ? getDeviceVendor(deviceNickname) : "");
+
+  bsoncxx::builder::basic::document snapshotData;
+  snapshotData.append(
+    bsoncxx::builder::basic::kvp("device", deviceNickname),
+    bsoncxx::builder::basic::kvp("hash", hash),
+    bsoncxx::builder::basic::kvp("size", static_cast<int64_t>(blob.size())),
+    bsoncxx::builder::basic::kvp("lines", static_cast<int32_t>(lines.size())),
+    bsoncxx::builder::basic::kvp("changed", changed),
+    bsoncxx::builder::basic::kvp("takenAt", bsoncxx::types::b_date{std::chrono::system_clock::now()})
+  );
+
+  // Tags the entry with the fleet run that took it, a resumed run reads its finished devices from these
+  if (!runId.empty()) snapshotData.append(bsoncxx::builder::basic::kvp("run", runId));
+
+  try {
+    backend->insertSnapshot(snapshotData.view());
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+  }
+
+  return hash;
+}
+
+std::vector<std::string> ChronicleDB::getSnapshot(const std::string& hash) const {
+  return splitSnapshotLines(getBlob(hash));
+}
+
+std::vector<std::string> ChronicleDB::getLatestSnapshot(const std::string& deviceNickname) const {
+  auto backend = connectedStorage();
+
+  auto results = backend->findSnapshots(deviceNickname, std::nullopt, 1);
+
+  if (results.empty()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No snapshot found for device " + deviceNickname);
+  }
+
+  return getSnapshot(std::string(results[0].view()["hash"].get_string().value));
+}
+
+std::vector<std::string> ChronicleDB::getSnapshotAt(const std::string& deviceNickname, std::chrono::system_clock::time_point at) const {
+  auto backend = connectedStorage();
+
+  auto results = backend->findSnapshots(deviceNickname, at, 1);
+
+  if (results.empty()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No snapshot of device " + deviceNickname + " at or before the given time");
+  }
+
+  return getSnapshot(std::string(results[0].view()["hash"].get_string().value));
+}
+
+std::vector<snapshotBenchmark> benchmarkSnapshots(const std::vector<size_t>& sizes, int versions, double editRate) {
+  versions = std::max(versions, 2);
+
+  // Calls started before the swap finish on the backend they began with
+  struct storageSwap {
+    std::shared_ptr<StorageBackend> previous = swapStorage(std::make_shared<MemoryStorage>());
+    ~storageSwap() { swapStorage(std::move(previous)); }
+  } swap;
+
+  ChronicleDB cdb;
+  std::vector<snapshotBenchmark> results;
+
+  for (const size_t size : sizes) {
+    const std::string device = "benchmark-" + std::to_string(size);
+    storage()->insertDevice(bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("device", bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("name", device),
+        bsoncxx::builder::basic::kvp("vendorName", "synthetic")
+      ))
+    ).view());
+
+    std::vector<std::vector<std::string>> history{syntheticConfig(size)};
+    for (int version = 1; version < versions; ++version) {
+      history.push_back(syntheticEdit(history.back(), editRate, static_cast<uint32_t>(version)));
+    }
+
+    snapshotBenchmark run;
+    run.lines = history.front().size();
+    run.versions = versions;
+
+    std::chrono::steady_clock::duration storing{};
+    std::chrono::system_clock::time_point halfway;
+    for (int version = 0; version < versions; ++version) {
+      run.bytes += joinSnapshotLines(history[version]).size();
+
+      const auto start = std::chrono::steady_clock::now();
+      cdb.storeSnapshot(device, history[version]);
+      storing += std::chrono::steady_clock::now() - start;
+
+      if (version == versions / 2) halfway = std::chrono::system_clock::now();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < versions; ++round) cdb.getLatestSnapshot(device);
+    const auto latest = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < versions; ++round) cdb.getSnapshotAt(device, halfway);
+    const auto at = std::chrono::steady_clock::now() - start;
+
+    run.store_ms = millisecondsOf(storing) / versions;
+    run.latest_ms = millisecondsOf(latest) / versions;
+    run.at_ms = millisecondsOf(at) / versions;
+    run.store_mb_s = megabytesPerSecond(run.bytes, storing);
+    results.push_back(run);
+  }
+
+  return results;
+}
+
+compactionResult ChronicleDB::compactHistory(const retentionPolicy& policy) const {
+  requireMongoStorage("compactHistory");
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+
+  const auto startedAt = std::chrono::system_clock::now();
+  const auto ageCutoff = startedAt - std::chrono::hours(24) * policy.max_age_days;
+  const auto unchangedCutoff = startedAt - std::chrono::hours(24) * policy.keep_unchanged_days;
+
+  compactionResult result;
+  std::vector<std::vector<std::string>> histories;
+  std::unordered_map<std::string, int> references;
+
+  try {
+    // Retention, the newest snapshot of a device is always kept
+    for (const auto& device : getDevicesBson()) {
+      const std::string nickname(device.view()["device"]["name"].get_string().value);
+
+      auto newest = mdb.findDocuments(
+        mdb.snapshots_c,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("device", nickname)),
+        ChronicleDB::MongoProjections::snapshots(),
+        1,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", -1))
+      );
+      if (newest.empty()) continue;
+
+      const std::chrono::system_clock::time_point newestAt(newest[0].view()["takenAt"].get_date().value);
+
+      if (policy.max_age_days > 0) {
+        result.snapshots_removed += static_cast<int>(mdb.deleteDocuments(mdb.snapshots_c, bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("device", nickname),
+          bsoncxx::builder::basic::kvp("takenAt", bsoncxx::builder::basic::make_document(
+            bsoncxx::builder::basic::kvp("$lt", bsoncxx::types::b_date{std::min(ageCutoff, newestAt)})
+          ))
+        )));
+      }
+
+      if (policy.keep_unchanged_days > 0) {
+        result.snapshots_removed += static_cast<int>(mdb.deleteDocuments(mdb.snapshots_c, bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("device", nickname),
+          bsoncxx::builder::basic::kvp("changed", false),
+          bsoncxx::builder::basic::kvp("takenAt", bsoncxx::builder::basic::make_document(
+            bsoncxx::builder::basic::kvp("$lt", bsoncxx::types::b_date{std::min(unchangedCutoff, newestAt)})
+          ))
+        )));
+      }
+
+      // Distinct versions of the device in the order they first appeared
+      auto entries = mdb.findDocuments(
+        mdb.snapshots_c,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("device", nickname)),
+        ChronicleDB::MongoProjections::snapshots(),
+        std::nullopt,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", 1))
+      );
+
+      std::vector<std::string> history;
+      std::unordered_set<std::string> seen;
+      for (const auto& entry : entries) {
+        std::string hash(entry.view()["hash"].get_string().value);
+        if (seen.insert(hash).second) {
+          references[hash]++;
+          history.push_back(std::move(hash));
+        }
+      }
+      histories.push_back(std::move(history));
+    }
+
+    std::vector<std::string> allHashes;
+    {
+      auto metas = mdb.findDocuments(
+        mdb.configs_c,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("n", 0)),
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("_id", 0), bsoncxx::builder::basic::kvp("hash", 1))
+      );
+      for (const auto& meta : metas) allHashes.emplace_back(meta.view()["hash"].get_string().value);
+    }
+
+    std::unordered_map<std::string, storedBlob> blobs;
+    loadBlobs(allHashes, blobs, false);
+
+    // Lay every history out as a keyframe followed by deltas against the previous version.
+    // Blobs shared by several devices stay keyframes so no chain crosses two histories.
+    for (const auto& history : histories) {
+      std::string previous;
+      std::vector<std::string> previousChain;
+      std::string previousContent;
+      bool previousLoaded = false;
+
+      for (const auto& hash : history) {
+        auto it = blobs.find(hash);
+        if (it == blobs.end()) {
+          previous.clear();
+          previousLoaded = false;
+          continue;
+        }
+        storedBlob& meta = it->second;
+
+        const bool wantDelta = !previous.empty() && references[hash] == 1 && meta.chunks == 1 &&
+                               meta.size <= CHRONICLE_SNAPSHOT_CHUNK_SIZE &&
+                               static_cast<int>(previousChain.size()) < CHRONICLE_SNAPSHOT_KEYFRAME_INTERVAL;
+        const bool laidOut = wantDelta
+          ? (meta.delta && meta.base == previous && meta.chain == previousChain)
+          : !meta.delta;
+
+        std::string content;
+        bool contentLoaded = false;
+
+        if (!laidOut) {
+          content = getBlob(hash);
+          contentLoaded = true;
+
+          storedBlob layout;
+          std::string payload = content;
+
+          if (wantDelta) {
+            if (!previousLoaded) previousContent = getBlob(previous);
+            std::string delta = encodeSnapshotDelta(splitSnapshotLines(previousContent), splitSnapshotLines(content));
+
+            if (delta.size() < content.size() / 2) {
+              layout.delta = true;
+              layout.base = previous;
+              layout.chain = previousChain;
+              layout.depth = static_cast<int>(previousChain.size());
+              payload = std::move(delta);
+            }
+          }
+
+          // A keyframe whose delta would not pay off is already in its final form
+          if (layout.delta || meta.delta) {
+            rewriteBlob(hash, layout, payload, meta.dictionary);
+            meta.delta = layout.delta;
+            meta.base = layout.base;
+            meta.chain = layout.chain;
+            meta.depth = layout.depth;
+            result.blobs_rewritten++;
+          }
+        }
+
+        previous = hash;
+        previousChain = chainThrough(meta, hash);
+        previousContent = std::move(content);
+        previousLoaded = contentLoaded;
+      }
+    }
+
+    // Everything a remaining snapshot needs, directly or as part of a chain
+    std::unordered_set<std::string> keep;
+    for (const auto& reference : references) keep.insert(reference.first);
+
+    std::vector<std::string> candidates;
+    for (const auto& entry : blobs) {
+      // Blobs written while the job runs may belong to a snapshot that is not inserted yet
+      bool settled = !entry.second.has_stored_at || entry.second.stored_at < startedAt;
+      if (settled && !keep.count(entry.first)) candidates.push_back(entry.first);
+    }
+
+    // Snapshots of devices that were removed still own their blobs
+    for (size_t first = 0; first < candidates.size(); first += CHRONICLE_SNAPSHOT_QUERY_BATCH) {
+      size_t last = std::min(candidates.size(), first + CHRONICLE_SNAPSHOT_QUERY_BATCH);
+      auto owned = mdb.findDocuments(
+        mdb.snapshots_c,
+        bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("hash", bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("$in", hashArray(candidates, first, last))
+        ))),
+        ChronicleDB::MongoProjections::snapshots()
+      );
+      for (const auto& r : owned) keep.emplace(r.view()["hash"].get_string().value);
+    }
+
+    std::vector<std::string> roots(keep.begin(), keep.end());
+    for (const auto& hash : roots) {
+      auto it = blobs.find(hash);
+      if (it == blobs.end() || !it->second.delta) continue;
+      for (const auto& link : it->second.chain) keep.insert(link);
+    }
+
+    std::vector<std::string> garbage;
+    for (const auto& hash : candidates) {
+      if (!keep.count(hash)) garbage.push_back(hash);
+    }
+
+    for (size_t first = 0; first < garbage.size(); first += CHRONICLE_SNAPSHOT_QUERY_BATCH) {
+      size_t last = std::min(garbage.size(), first + CHRONICLE_SNAPSHOT_QUERY_BATCH);
+      mdb.deleteDocuments(mdb.configs_c, bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("hash", bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("$in", hashArray(garbage, first, last))
+        ))
+      ));
+    }
+    result.blobs_removed = static_cast<int>(garbage.size());
+
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+
+  return result;
+}
+
+int ChronicleDB::syncFleetIndex(FleetIndex& index) const {
+  requireMongoStorage("syncFleetIndex");
   if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
 
+  const std::chrono::system_clock::time_point since{std::chrono::milliseconds(index.lastSync())};
+  int64_t newest = index.lastSync();
+  int updated = 0;
+  std::unordered_set<std::string> nicknames;
+
+  for (const auto& device : getDevicesBson()) {
+    nicknames.emplace(device.view()["device"]["name"].get_string().value);
+  }
+
+  // Every snapshot since the last sync in one query, oldest first so a device ends on its newest
   bsoncxx::builder::basic::document filter;
+  filter.append(bsoncxx::builder::basic::kvp("takenAt", bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("$gt", bsoncxx::types::b_date{since})
+  )));
+
+  std::unordered_map<std::string, std::string> latest;
+  for (const auto& snapshot : mdb.findDocuments(
+         mdb.snapshots_c,
+         filter.view(),
+         ChronicleDB::MongoProjections::snapshots(),
+         std::nullopt,
+         bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", 1))
+       )) {
+    const auto view = snapshot.view();
+    newest = std::max<int64_t>(newest, view["takenAt"].get_date().value.count());
+    latest[std::string(view["device"].get_string().value)] = std::string(view["hash"].get_string().value);
+  }
 
-  filter.append(bsoncxx::builder::basic::kvp("username", username));
+  for (const auto& [nickname, hash] : latest) {
+    if (nicknames.count(nickname) == 0 || index.indexedHash(nickname) == hash) continue;
 
-  auto results = mdb.findDocuments(mdb.users_c, filter.view(), ChronicleDB::MongoProjections::users());
+    index.update(nickname, hash, getSnapshot(hash));
+    updated++;
+  }
 
-  std::string userData;
+  for (const auto& nickname : index.devices()) {
+    if (nicknames.count(nickname) == 0) index.remove(nickname);
+  }
+
+  index.setLastSync(newest);
+  return updated;
+}
+
+int ChronicleDB::exportArchive(SnapshotArchive& archive) const {
+  requireMongoStorage("exportArchive");
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+
+  int appended = 0;
+
+  for (const auto& device : getDevicesBson()) {
+    const std::string nickname(device.view()["device"]["name"].get_string().value);
+
+    // Records are append only, everything up to the newest archived snapshot is already there
+    bsoncxx::builder::basic::document filter;
+    filter.append(
+      bsoncxx::builder::basic::kvp("device", nickname),
+      bsoncxx::builder::basic::kvp("takenAt", bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("$gt", bsoncxx::types::b_date{std::chrono::milliseconds(archive.latest(nickname))})
+      ))
+    );
+
+    auto history = mdb.findDocuments(
+      mdb.snapshots_c,
+      filter.view(),
+      ChronicleDB::MongoProjections::snapshots(),
+      std::nullopt,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", 1))
+    );
 
-  if (!results.empty()) {
-      userData = bsoncxx::to_json(results[0].view());
+    std::string lastHash, blob;
+    for (const auto& snapshot : history) {
+      const std::string hash(snapshot.view()["hash"].get_string().value);
+      if (hash != lastHash) {
+        blob = getBlob(hash);
+        lastHash = hash;
+      }
+
+      if (archive.append(nickname, hash, snapshot.view()["takenAt"].get_date().value.count(), blob)) appended++;
+    }
   }
 
-  return userData;
+  archive.flush();
+  return appended;
 }
 
+int ChronicleDB::importArchive(const SnapshotArchive& archive) const {
+  requireMongoStorage("importArchive");
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
 
+  int imported = 0;
 
-// Internal C++ methods
-bsoncxx::document::value ChronicleDB::getDeviceBson(const std::string& deviceNickname) const {
+  for (const auto& nickname : archive.devices()) {
+    auto newest = mdb.findDocuments(
+      mdb.snapshots_c,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("device", nickname)),
+      ChronicleDB::MongoProjections::snapshots(),
+      1,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", -1))
+    );
+
+    // Only history newer than what the database already has is imported
+    int64_t since = CHRONICLE_ARCHIVE_MIN_TIME;
+    std::string previousHash;
+    int32_t previousLines = 0;
+    if (!newest.empty()) {
+      since = newest[0].view()["takenAt"].get_date().value.count() + 1;
+      previousHash = std::string(newest[0].view()["hash"].get_string().value);
+      previousLines = newest[0].view()["lines"].get_int32().value;
+    }
+
+    std::vector<bsoncxx::document::value> batch;
+    auto insertBatch = [&]() {
+      if (batch.empty()) return;
+      try {
+        mdb.insertDocuments(mdb.snapshots_c, batch);
+      } catch (const ChronicleException& e) {
+        std::string fullMessage =
+          "Chronicle exception:\n"
+          "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+          "Details: " + e.getDetails();
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+      } catch (const std::exception& e) {
+        THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+      }
+      imported += static_cast<int>(batch.size());
+      batch.clear();
+    };
+
+    const std::string vendor = getDeviceVendor(nickname);
+
+    for (const auto& entry : archive.entries(nickname, since)) {
+      const bool changed = entry.hash != previousHash;
+      if (changed) {
+        const std::string blob = archive.read(entry);
+        storeBlob(entry.hash, blob, previousHash, vendor);
+        previousLines = static_cast<int32_t>(splitSnapshotLines(blob).size());
+      }
+
+      batch.push_back(bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("device", nickname),
+        bsoncxx::builder::basic::kvp("hash", entry.hash),
+        bsoncxx::builder::basic::kvp("size", static_cast<int64_t>(entry.size)),
+        bsoncxx::builder::basic::kvp("lines", previousLines),
+        bsoncxx::builder::basic::kvp("changed", changed),
+        bsoncxx::builder::basic::kvp("takenAt", bsoncxx::types::b_date{std::chrono::milliseconds(entry.taken_at)})
+      ));
+      previousHash = entry.hash;
+
+      if (batch.size() >= CHRONICLE_SNAPSHOT_QUERY_BATCH) insertBatch();
+    }
+    insertBatch();
+  }
+
+  return imported;
+}
 
+int ChronicleDB::trainDictionary(const std::string& vendor, int maxSamples) const {
+  requireMongoStorage("trainDictionary");
   if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
 
-  bsoncxx::builder::basic::document filter;
+  auto devices = mdb.findDocuments(
+    mdb.devices_c,
+    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("device.vendorName", vendor)),
+    ChronicleDB::MongoProjections::device()
+  );
+  if (devices.empty()) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No devices of vendor " + vendor);
+  }
 
-  filter.append(bsoncxx::builder::basic::kvp("device.name", deviceNickname));
+  // Recent distinct versions spread over every device, so no single device dominates the dictionary
+  const int perDevice = std::max(1, maxSamples / static_cast<int>(devices.size()));
+  std::vector<std::string> samples;
+  std::unordered_set<std::string> seen;
+
+  for (const auto& device : devices) {
+    auto history = mdb.findDocuments(
+      mdb.snapshots_c,
+      bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("device", device.view()["device"]["name"].get_string().value),
+        bsoncxx::builder::basic::kvp("changed", true)
+      ),
+      ChronicleDB::MongoProjections::snapshots(),
+      perDevice,
+      bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("takenAt", -1))
+    );
 
-  auto results = mdb.findDocuments(mdb.devices_c, filter.view(), ChronicleDB::MongoProjections::device());
+    for (const auto& snapshot : history) {
+      std::string hash(snapshot.view()["hash"].get_string().value);
+      if (!seen.insert(hash).second) continue;
+      samples.push_back(getBlob(hash));
+      if (static_cast<int>(samples.size()) >= maxSamples) break;
+    }
+    if (static_cast<int>(samples.size()) >= maxSamples) break;
+  }
 
-  if (results.empty()) {
+  const std::string dictionary = ::trainDictionary(samples);
+
+  auto newest = mdb.findDocuments(
+    mdb.dictionaries_c,
+    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("vendor", vendor)),
+    bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("_id", 0),
+      bsoncxx::builder::basic::kvp("version", 1)
+    ),
+    1,
+    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("version", -1))
+  );
+  const int version = newest.empty() ? 1 : newest[0].view()["version"].get_int32().value + 1;
+
+  bsoncxx::builder::basic::document dictionaryData;
+  dictionaryData.append(
+    bsoncxx::builder::basic::kvp("vendor", vendor),
+    bsoncxx::builder::basic::kvp("version", static_cast<int32_t>(version)),
+    bsoncxx::builder::basic::kvp("id", dictionaryId(vendor, version)),
+    bsoncxx::builder::basic::kvp("samples", static_cast<int32_t>(samples.size())),
+    bsoncxx::builder::basic::kvp("size", static_cast<int32_t>(dictionary.size())),
+    bsoncxx::builder::basic::kvp("trainedAt", bsoncxx::types::b_date{std::chrono::system_clock::now()}),
+    bsoncxx::builder::basic::kvp("data", bsoncxx::types::b_binary{
+      bsoncxx::binary_sub_type::k_binary,
+      static_cast<uint32_t>(dictionary.size()),
+      reinterpret_cast<const uint8_t*>(dictionary.data())
+    })
+  );
+
+  try {
+    mdb.insertDocument(mdb.dictionaries_c, dictionaryData.view());
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+  }
+
+  // This process writes with the new version right away, others within CHRONICLE_DICTIONARY_REFRESH
+  {
+    std::lock_guard lock(dictionaryMutex);
+    latestDictionaries.erase(vendor);
+  }
+
+  return version;
+}
+
+std::vector<std::string> ChronicleDB::listDictionaries() const {
+  requireMongoStorage("listDictionaries");
+  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+
+  auto results = mdb.findDocuments(
+    mdb.dictionaries_c,
+    bsoncxx::builder::basic::make_document(),
+    bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("_id", 0),
+      bsoncxx::builder::basic::kvp("data", 0)
+    ),
+    std::nullopt,
+    bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("vendor", 1),
+      bsoncxx::builder::basic::kvp("version", -1)
+    )
+  );
+
+  std::vector<std::string> listOfDictionaries;
+
+  for (const auto& r : results) {
+    listOfDictionaries.push_back(bsoncxx::to_json(r));
+  }
+
+  return listOfDictionaries;
+}
+
+std::vector<std::string> ChronicleDB::listSnapshots(const std::string& deviceNickname, std::optional<int> limit) const {
+  auto backend = connectedStorage();
+
+  std::vector<std::string> listOfSnapshots;
+
+  for (const auto& r : backend->findSnapshots(deviceNickname, std::nullopt, limit)) {
+    listOfSnapshots.push_back( bsoncxx::to_json(r));
+  }
+
+  return listOfSnapshots;
+}
+
+/* Fleet runs */
+std::vector<std::string> ChronicleDB::listRuns(std::optional<int> limit) const {
+  auto backend = connectedStorage();
+
+  std::vector<std::string> listOfRuns;
+
+  for (const auto& r : backend->findRuns(limit)) {
+    listOfRuns.push_back(bsoncxx::to_json(r));
+  }
+
+  return listOfRuns;
+}
+
+std::vector<std::string> ChronicleDB::listRunDevices(const std::string& runId) const {
+  auto backend = connectedStorage();
+
+  std::vector<std::string> listOfDevices;
+
+  for (const auto& r : backend->findRunDevices(runId)) {
+    listOfDevices.push_back(bsoncxx::to_json(r));
+  }
+
+  return listOfDevices;
+}
+
+void ChronicleDB::recordOutputSize(const std::string& deviceNickname, int outputSize) const {
+  auto backend = connectedStorage();
+
+  bsoncxx::builder::basic::document updateDoc;
+  updateDoc.append(bsoncxx::builder::basic::kvp("transport.lastOutputSize", outputSize));
+
+  try {
+    backend->updateDevice(deviceNickname, updateDoc.view());
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+}
+
+void ChronicleDB::recordChangeProbe(const std::string& deviceNickname, const std::string& probe) const {
+  auto backend = connectedStorage();
+
+  bsoncxx::builder::basic::document updateDoc;
+  updateDoc.append(bsoncxx::builder::basic::kvp("changeProbe", bsoncxx::builder::basic::make_document(
+    bsoncxx::builder::basic::kvp("value", probe),
+    bsoncxx::builder::basic::kvp("fullAt", bsoncxx::types::b_date{std::chrono::system_clock::now()})
+  )));
+
+  try {
+    backend->updateDevice(deviceNickname, updateDoc.view());
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+}
+
+/* Reachability */
+void ChronicleDB::updateReachability(const std::vector<reachabilityResult>& results) const {
+  auto backend = connectedStorage();
+
+  const auto checkedAt = bsoncxx::types::b_date{std::chrono::system_clock::now()};
+  std::vector<std::pair<std::string, bsoncxx::document::value>> updates;
+  updates.reserve(results.size());
+
+  for (const auto& result : results) {
+    updates.emplace_back(
+      result.nickname,
+      bsoncxx::builder::basic::make_document(
+        bsoncxx::builder::basic::kvp("reachability", bsoncxx::builder::basic::make_document(
+          bsoncxx::builder::basic::kvp("reachable", result.reachable),
+          bsoncxx::builder::basic::kvp("banner", result.banner),
+          bsoncxx::builder::basic::kvp("latencyMs", result.latency_ms),
+          bsoncxx::builder::basic::kvp("error", result.error),
+          bsoncxx::builder::basic::kvp("checkedAt", checkedAt)
+        ))
+      )
+    );
+  }
+
+  try {
+    backend->updateDevices(updates);
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+}
+
+/* Host keys */
+std::vector<std::string> ChronicleDB::listHostKeys() const {
+  auto backend = connectedStorage();
+
+  std::vector<std::string> listOfHostKeys;
+
+  for (const auto& r : backend->findHostKeys()) {
+    listOfHostKeys.push_back( bsoncxx::to_json(r));
+  }
+
+  return listOfHostKeys;
+}
+
+void ChronicleDB::deleteHostKey(const std::string& host, int port) const {
+  auto backend = connectedStorage();
+
+  try {
+    backend->deleteHostKey(host, port);
+  } catch (const ChronicleException& e) {
+    std::string fullMessage;
+
+    if (e.getCode() == CHRONICLE_ERROR_MONGO_DOCUMENT_NOT_FOUND) {
+      fullMessage = "Host key for " + host + ":" + std::to_string(port) + " not found";
+      THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_DELETE_FAILED, fullMessage);
+    }
+
+    fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_DELETE_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_DELETE_FAILED, e.what());
+  }
+
+  HostKeyStore::instance().forget(host, port);
+}
+
+
+// Internal C++ methods
+bsoncxx::document::value ChronicleDB::getDeviceBson(const std::string& deviceNickname) const {
+
+  auto backend = connectedStorage();
+
+  auto device = backend->findDevice(deviceNickname);
+
+  if (!device) {
     THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "Device not found.");
   }
 
-  return bsoncxx::document::value(results[0]);
+  return std::move(*device);
  }
 
+// Empty when the device is unknown, blobs are then compressed without a dictionary
+std::string ChronicleDB::getDeviceVendor(const std::string& deviceNickname) const {
+  try {
+    auto device = getDeviceBson(deviceNickname);
+    return std::string(device.view()["device"]["vendorName"].get_string().value);
+  } catch (const ChronicleException&) {
+    return "";
+  }
+}
+
+std::vector<bsoncxx::document::value> ChronicleDB::getDevicesBson() const {
+
+  auto backend = connectedStorage();
+
+  return backend->findDevices();
+}
+
 bsoncxx::document::value ChronicleDB::getSettingsBson() const {
 
-  if (!mdb.connected) { THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_MONGO_CONNECT_TO_DB, "Connection to database was not established."); }
+  auto backend = connectedStorage();
 
-  bsoncxx::document::view_or_value filter = bsoncxx::builder::basic::make_document(); // List all
-  auto results = mdb.findDocuments(mdb.settings_c, filter, ChronicleDB::MongoProjections::settings());
+  auto settings = backend->findSettings();
 
-  if (results.empty()) {
+  if (!settings) {
       THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "No Chronicle settings found in database.");
   }
 
-  return bsoncxx::document::value(results[0]);
+  return std::move(*settings);
+}
+
+std::vector<hostKeyEntry> ChronicleDB::getHostKeys() const {
+
+  auto backend = connectedStorage();
+
+  auto results = backend->findHostKeys();
+
+  std::vector<hostKeyEntry> entries;
+  entries.reserve(results.size());
+
+  for (const auto& r : results) {
+    const auto& view = r.view();
+    entries.push_back({
+      std::string(view["host"].get_string().value),
+      view["port"].get_int32(),
+      std::string(view["fingerprint"].get_string().value)
+    });
+  }
+
+  return entries;
+}
+
+void ChronicleDB::addHostKeys(const std::vector<hostKeyEntry>& entries) const {
+
+  auto backend = connectedStorage();
+
+  std::vector<bsoncxx::document::value> docs;
+  docs.reserve(entries.size());
+
+  for (const auto& entry : entries) {
+    docs.push_back(bsoncxx::builder::basic::make_document(
+      bsoncxx::builder::basic::kvp("host", entry.host),
+      bsoncxx::builder::basic::kvp("port", entry.port),
+      bsoncxx::builder::basic::kvp("fingerprint", entry.fingerprint)
+    ));
+  }
+
+  try {
+    backend->insertHostKeys(docs);
+  } catch (const ChronicleException& e) {
+
+    // Another worker pinned the same host first, the rest of the batch is still written
+    if (e.getCode() == CHRONICLE_ERROR_MONGO_DUPLICATE) {
+      return;
+    }
+
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+  }
+}
+
+void ChronicleDB::storeBlob(const std::string& hash, std::string_view blob, const std::string& baseHash, const std::string& vendor) const {
+  TraceSpan span("ChronicleDB::storeBlob", {}, vendor);
+
+  auto backend = connectedStorage();
+  backend->storeBlob(hash, blob, baseHash, vendor);
+}
+
+std::string ChronicleDB::getBlob(const std::string& hash) const {
+
+  auto backend = connectedStorage();
+  return backend->getBlob(hash);
+}
+
+void ChronicleDB::addRun(const bsoncxx::document::view& run) const {
+
+  auto backend = connectedStorage();
+
+  try {
+    backend->insertRun(run);
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_ADD_FAILED, e.what());
+  }
+}
+
+void ChronicleDB::updateRun(const std::string& runId, const bsoncxx::document::view& fields) const {
+
+  auto backend = connectedStorage();
+
+  try {
+    backend->updateRun(runId, fields);
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+}
+
+bsoncxx::document::value ChronicleDB::getRunBson(const std::string& runId) const {
+
+  auto backend = connectedStorage();
+
+  auto run = backend->findRun(runId);
+
+  if (!run) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_NX_DOCUMENT, "Run " + runId + " not found.");
+  }
+
+  return std::move(*run);
+}
+
+void ChronicleDB::updateRunDevices(const std::string& runId, const std::vector<std::pair<std::string, bsoncxx::document::value>>& updates) const {
+
+  if (updates.empty()) return;
+
+  auto backend = connectedStorage();
+
+  try {
+    backend->updateRunDevices(runId, updates);
+  } catch (const ChronicleException& e) {
+    std::string fullMessage =
+      "Chronicle exception:\n"
+      "ChronicleCode: " + std::to_string(e.getCode()) + "\n"
+      "Details: " + e.getDetails();
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, fullMessage);
+  } catch (const std::exception& e) {
+    THROW_CHRONICLE_EXCEPTION(CHRONICLE_ERROR_CHRONICLE_DB_MODIFY_FAILED, e.what());
+  }
+}
+
+std::vector<bsoncxx::document::value> ChronicleDB::getRunDevicesBson(const std::string& runId) const {
+
+  auto backend = connectedStorage();
+
+  return backend->findRunDevices(runId);
+}
+
+std::vector<bsoncxx::document::value> ChronicleDB::getRunSnapshotsBson(const std::string& runId) const {
+
+  auto backend = connectedStorage();
+
+  return backend->findRunSnapshots(runId);
 }
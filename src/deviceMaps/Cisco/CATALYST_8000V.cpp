@@ -19,9 +19,23 @@ extern "C" deviceOperations* createDeviceOperations(int device_id, int vendor_id
     };
 
     // getConfig
-    devOps->pushCommand(devOps->getConfig, "terminal length 0", 1, 1, "Failed to set terminal length to 0");
     devOps->pushCommand(devOps->getConfig, "show running all", 4, 1, "Failed to get configuration");
 
+    // Output is paged, --More-- is answered in-stream instead of running terminal length 0 first
+    devOps->pushPagerPrompt(R"(--More--)");
+
+    // changeProbe, the configuration id counts commits and restarts from 1 on a reload, the restart time tells those apart
+    devOps->pushCommand(devOps->changeProbe, "show version | include restarted at", 1, 1, "Failed to read the restart time");
+    devOps->pushCommand(devOps->changeProbe, "show configuration id", 1, 1, "Failed to read the configuration id");
+
+    // Lines that change on every run
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "Building configuration");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "Current configuration :");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "! Last configuration change at");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "! NVRAM config last updated at");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "! No configuration change since last restart");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "ntp clock-period");
+
     return devOps;
 }
 
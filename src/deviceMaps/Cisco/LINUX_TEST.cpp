@@ -18,8 +18,11 @@ extern "C" deviceOperations* createDeviceOperations(int device_id, int vendor_id
         return nullptr;
     };
 
+    // Plain sshd accepts exec requests, no prompt or echo to skip
+    devOps->channel_mode = CHRONICLE_CHANNEL_MODE_EXEC;
+
     // getConfig
-    devOps->pushCommand(devOps->getConfig, "cat ~/.bashrc", 0, 1, "Failed to open .bashrc");
+    devOps->pushCommand(devOps->getConfig, "cat ~/.bashrc", 0, 0, "Failed to open .bashrc");
 
     return devOps;
 }
@@ -21,6 +21,16 @@ extern "C" deviceOperations* createDeviceOperations(int device_id, int vendor_id
     // getConfig
     devOps->pushCommand(devOps->getConfig, "show configuration | display set | no-more", 1, 2, "Failed to get configuration");
 
+    // In case a command is run without | no-more
+    devOps->pushPagerPrompt(R"(---\(more( \d+%)?\)---)");
+
+    // changeProbe
+    devOps->pushCommand(devOps->changeProbe, "show system commit | no-more", 1, 2, "Failed to read the commit history");
+
+    // Lines that change on every commit
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "## Last commit:");
+    devOps->pushNormalizeRule(CHRONICLE_NORMALIZE_DROP_PREFIX, "## Last changed:");
+
     return devOps;
 }
 
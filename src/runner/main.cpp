@@ -0,0 +1,355 @@
+/*
+    chronicle-runner
+    Native entry point for cron driven runs, the same engine as the Python module without
+    an interpreter to start.
+
+    Exit status: 0 every device succeeded, 1 some device failed, 2 bad usage, 3 fatal error.
+*/
+#include "core/chronicle.hpp"
+#include "core/config.hpp"
+#include "core/device_loader.hpp"
+#include "core/error_handler.hpp"
+#include "core/fleet_run.hpp"
+#include "core/storage.hpp"
+#include "core/trace.hpp"
+#include "database_handler.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+  constexpr int EXIT_OK = 0;
+  constexpr int EXIT_DEVICE_FAILED = 1;
+  constexpr int EXIT_USAGE = 2;
+  constexpr int EXIT_FATAL = 3;
+
+  constexpr auto DEFAULT_PLUGIN_DIRECTORY = "bin/devices";
+
+  const char* USAGE =
+    "usage: chronicle-runner <command> [options]\n"
+    "\n"
+    "commands:\n"
+    "  backup      Download and store the configuration of the devices\n"
+    "  fanout      Run commands on the devices and group identical outputs\n"
+    "  inventory   List the devices, --sweep probes their reachability first\n"
+    "\n"
+    "options:\n"
+    "  --device NAME      Only this device, repeatable (default: every device)\n"
+    "  --workers N        Devices worked on at once\n"
+    "  --plugins DIR      Device plugin directory (default: $CHRONICLE_PLUGIN_DIR or bin/devices)\n"
+    "  --command CMD      fanout: command to run, repeatable, devices are grouped by all outputs\n"
+    "  --skip-head N      fanout: lines dropped from the start of the output (default 1, the echo)\n"
+    "  --skip-tail N      fanout: lines dropped from the end of the output (default 1, the prompt)\n"
+    "  --exec             fanout: run the commands on exec channels instead of a shell\n"
+    "  --pager REGEX      fanout: pager prompt answered with a space, repeatable (e.g. --More--)\n"
+    "  --resume RUN_ID    backup: continue a run that stopped, only its unfinished devices are worked on\n"
+    "  --retry-failed     backup: with --resume, also retry the devices that failed in the run\n"
+    "  --lease SECONDS    backup: how long a device stays claimed by a run that stopped renewing it\n"
+    "  --sweep            inventory: probe reachability and store the results\n"
+    "  --timeout MS       inventory: probe timeout\n"
+    "  --journal PATH     Keep devices and snapshots in memory, loaded from and saved to PATH, instead of MongoDB\n"
+    "  --trace PATH       Write a Chrome trace of the run to PATH\n";
+
+  struct runnerOptions {
+    std::string command;
+    std::vector<std::string> devices;
+    std::vector<std::string> commands;
+    std::vector<std::string> pager_prompts;
+    std::string plugins;
+    std::string trace;
+    std::string journal;
+    std::string resume;
+    int workers = 0;                // 0 keeps the default of the subcommand
+    int skip_head = 1;
+    int skip_tail = 1;
+    bool exec = false;
+    bool sweep = false;
+    bool retry_failed = false;
+    int timeout = CHRONICLE_CONFIG_DEFAULT_SWEEP_TIMEOUT;
+    int lease = CHRONICLE_RUN_DEFAULT_LEASE;
+  };
+
+  bool parseInt(const std::string& value, int& out) {
+    try {
+      size_t used = 0;
+      out = std::stoi(value, &used);
+      return used == value.size() && out >= 0;
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+
+  // Returns false with a message on stderr when the arguments do not make sense
+  bool parseArguments(int argc, char** argv, runnerOptions& options) {
+    if (argc < 2) return false;
+    options.command = argv[1];
+    if (options.command != "backup" && options.command != "fanout" && options.command != "inventory") {
+      std::cerr << "chronicle-runner: unknown command " << options.command << "\n";
+      return false;
+    }
+
+    const char* plugins = std::getenv("CHRONICLE_PLUGIN_DIR");
+    options.plugins = plugins != nullptr ? plugins : DEFAULT_PLUGIN_DIRECTORY;
+
+    for (int i = 2; i < argc; ++i) {
+      const std::string arg = argv[i];
+
+      if (arg == "--exec") { options.exec = true; continue; }
+      if (arg == "--sweep") { options.sweep = true; continue; }
+      if (arg == "--retry-failed") { options.retry_failed = true; continue; }
+
+      if (i + 1 >= argc) {
+        std::cerr << "chronicle-runner: " << arg << " needs a value or is unknown\n";
+        return false;
+      }
+      const std::string value = argv[++i];
+
+      bool valid = true;
+      if (arg == "--device") options.devices.push_back(value);
+      else if (arg == "--command") options.commands.push_back(value);
+      else if (arg == "--pager") options.pager_prompts.push_back(value);
+      else if (arg == "--plugins") options.plugins = value;
+      else if (arg == "--trace") options.trace = value;
+      else if (arg == "--journal") options.journal = value;
+      else if (arg == "--resume") options.resume = value;
+      else if (arg == "--workers") valid = parseInt(value, options.workers) && options.workers > 0;
+      else if (arg == "--skip-head") valid = parseInt(value, options.skip_head);
+      else if (arg == "--skip-tail") valid = parseInt(value, options.skip_tail);
+      else if (arg == "--timeout") valid = parseInt(value, options.timeout) && options.timeout > 0;
+      else if (arg == "--lease") valid = parseInt(value, options.lease) && options.lease > 0;
+      else {
+        std::cerr << "chronicle-runner: unknown option " << arg << "\n";
+        return false;
+      }
+
+      if (!valid) {
+        std::cerr << "chronicle-runner: bad value for " << arg << ": " << value << "\n";
+        return false;
+      }
+    }
+
+    if (options.command == "fanout" && options.commands.empty()) {
+      std::cerr << "chronicle-runner: fanout needs at least one --command\n";
+      return false;
+    }
+    if (!options.resume.empty() && !options.devices.empty()) {
+      std::cerr << "chronicle-runner: --resume works on the devices of the run, --device does not apply\n";
+      return false;
+    }
+    if (options.retry_failed && options.resume.empty()) {
+      std::cerr << "chronicle-runner: --retry-failed needs --resume\n";
+      return false;
+    }
+    return true;
+  }
+
+  void printFailure(const configResult& failure) {
+    std::cout << "FAIL " << failure.device << " [" << failure.code << "] " << failure.message;
+    if (!failure.details.empty()) std::cout << ": " << failure.details;
+    std::cout << "\n";
+  }
+
+  configResult failureOf(const std::string& device, const ChronicleException& e) {
+    configResult failure;
+    failure.device = device;
+    failure.code = e.getCode();
+    failure.message = getErrorMsg(e.getCode());
+    failure.details = e.getDetails();
+    return failure;
+  }
+
+  // The selected devices, names that cannot be resolved are reported as failures
+  std::vector<connectionInfo> selectDevices(const runnerOptions& options, std::vector<configResult>& failures) {
+    if (options.devices.empty()) return getAllConnectionInfo();
+
+    std::vector<connectionInfo> devices;
+    for (const auto& name : options.devices) {
+      try {
+        devices.push_back(getConnectionInfo(name));
+      } catch (const ChronicleException& e) {
+        failures.push_back(failureOf(name, e));
+      }
+    }
+    return devices;
+  }
+
+  int runBackup(const runnerOptions& options) {
+    std::vector<configResult> failures;
+    std::vector<connectionInfo> devices;
+    std::shared_ptr<FleetRun> run;
+
+    if (options.resume.empty()) {
+      devices = selectDevices(options, failures);
+
+      std::vector<std::string> names;
+      names.reserve(devices.size());
+      for (const auto& device : devices) names.push_back(device.nickname);
+      run = FleetRun::start(names, "backup", options.lease);
+    } else {
+      // The run decides the devices, what it finished stays finished
+      run = FleetRun::resume(options.resume, options.lease, options.retry_failed);
+      for (const auto& name : run->unfinished()) {
+        try {
+          devices.push_back(getConnectionInfo(name));
+        } catch (const ChronicleException& e) {
+          run->fail(name, e.getCode(), getErrorMsg(e.getCode()));
+          failures.push_back(failureOf(name, e));
+        }
+      }
+    }
+    std::cout << "run " << run->id() << "\n";
+
+    // One batch per plugin, every device of a batch shares the loaded deviceOperations
+    std::map<std::pair<std::string, std::string>, std::vector<connectionInfo>> byPlugin;
+    for (auto& device : devices) byPlugin[{device.vendorName, device.deviceName}].push_back(std::move(device));
+
+    size_t stored = 0;
+    for (const auto& [plugin, group] : byPlugin) {
+      std::shared_ptr<DeviceHandle> handle;
+      try {
+        const connectionInfo& first = group.front();
+        handle = loadDeviceOps(devicePluginPath(options.plugins, plugin.first, plugin.second), first.device, first.vendor);
+      } catch (const ChronicleException& e) {
+        for (const auto& device : group) {
+          run->fail(device.nickname, e.getCode(), getErrorMsg(e.getCode()));
+          failures.push_back(failureOf(device.nickname, e));
+        }
+        continue;
+      }
+
+      const int workers = options.workers > 0 ? options.workers : CHRONICLE_CONFIG_DEFAULT_BATCH_WORKERS;
+      for (auto& result : backupRun(*run, group, *handle->ops, workers)) {
+        if (!result.ok) {
+          failures.push_back(std::move(result));
+          continue;
+        }
+
+        std::cout << "OK   " << result.device << " " << result.hash << "\n";
+        stored++;
+      }
+    }
+    run->flush();
+
+    const runProgress progress = run->progress();
+    for (const auto& failure : failures) printFailure(failure);
+    std::cout << stored << " stored, " << failures.size() << " failed, run " << progress.id << " " << progress.status
+              << " (" << progress.done << "/" << progress.devices << " done)\n";
+
+    // Devices still leased by another process, or one that stopped without its lease running out yet
+    const size_t unfinished = progress.pending + progress.inflight;
+    if (unfinished > 0) {
+      std::cerr << "chronicle-runner: " << unfinished << " device(s) of run " << progress.id << " are not finished, resume it again later\n";
+    }
+
+    return failures.empty() && unfinished == 0 ? EXIT_OK : EXIT_DEVICE_FAILED;
+  }
+
+  int runFanOut(const runnerOptions& options) {
+    std::vector<OperationMap> operations;
+    for (const auto& command : options.commands) {
+      OperationMap op;
+      op.command = command;
+      op.skip_head = options.skip_head;
+      op.skip_tail = options.skip_tail;
+      op.err_msg = "Failed to run " + command;
+      operations.push_back(op);
+    }
+
+    const int channelMode = options.exec ? CHRONICLE_CHANNEL_MODE_EXEC : CHRONICLE_CHANNEL_MODE_SHELL;
+    const int workers = options.workers > 0 ? options.workers : CHRONICLE_CONFIG_DEFAULT_FANOUT_WORKERS;
+
+    const fanoutResult result = options.devices.empty()
+      ? fanOut(getAllConnectionInfo(), operations, {}, channelMode, workers, options.pager_prompts)
+      : fanOutByName(options.devices, operations, {}, channelMode, workers, options.pager_prompts);
+
+    for (const auto& group : result.groups) {
+      std::cout << "== " << group.count << " device(s), " << group.hash << "\n";
+      for (const auto& device : group.devices) std::cout << "   " << device << "\n";
+      std::cout << "--\n";
+      for (const auto& line : group.output) std::cout << line << "\n";
+      std::cout << "\n";
+    }
+
+    for (const auto& failure : result.failures) printFailure(failure);
+    std::cout << result.succeeded << "/" << result.devices << " answered, " << result.groups.size() << " distinct output(s)\n";
+
+    return result.failures.empty() ? EXIT_OK : EXIT_DEVICE_FAILED;
+  }
+
+  int runInventory(const runnerOptions& options) {
+    if (options.sweep) {
+      const int inFlight = options.workers > 0 ? options.workers : CHRONICLE_CONFIG_DEFAULT_SWEEP_IN_FLIGHT;
+      std::vector<configResult> failures;
+      const std::vector<connectionInfo> devices = selectDevices(options, failures);
+      size_t unreachable = 0;
+
+      for (const auto& result : sweepReachability(devices, options.timeout, inFlight)) {
+        std::cout << (result.reachable ? "UP   " : "DOWN ") << result.nickname << " " << result.host << ":" << result.port;
+        if (result.reachable) std::cout << " " << result.latency_ms << "ms " << result.banner;
+        else std::cout << " " << result.error;
+        std::cout << "\n";
+        if (!result.reachable) unreachable++;
+      }
+      for (const auto& failure : failures) printFailure(failure);
+
+      return unreachable == 0 && failures.empty() ? EXIT_OK : EXIT_DEVICE_FAILED;
+    }
+
+    std::vector<configResult> failures;
+    for (const auto& device : selectDevices(options, failures)) {
+      std::cout << device.nickname << " " << device.vendorName << "/" << device.deviceName << " "
+                << device.user << "@" << device.host << ":" << device.port
+                << (device.reachable ? "" : " (unreachable at the last sweep)") << "\n";
+    }
+    for (const auto& failure : failures) printFailure(failure);
+
+    return failures.empty() ? EXIT_OK : EXIT_DEVICE_FAILED;
+  }
+}
+
+int main(int argc, char** argv) {
+  runnerOptions options;
+  if (!parseArguments(argc, argv, options)) {
+    std::cerr << USAGE;
+    return EXIT_USAGE;
+  }
+
+  int status = EXIT_OK;
+  try {
+    if (!options.trace.empty()) enableTracing();
+
+    if (!options.journal.empty()) useMemoryStorage(options.journal);
+
+    ChronicleDB cdb;
+    cdb.connect();
+    if (!options.journal.empty()) cdb.initDB();     // A new journal starts without settings
+
+    if (options.command == "backup") status = runBackup(options);
+    else if (options.command == "fanout") status = runFanOut(options);
+    else status = runInventory(options);
+
+  } catch (const ChronicleException& e) {
+    std::cerr << e.what() << "\n";
+    status = EXIT_FATAL;
+  } catch (const std::exception& e) {
+    std::cerr << "chronicle-runner: " << e.what() << "\n";
+    status = EXIT_FATAL;
+  }
+
+  // A run that died is the one most worth looking at, its spans are written too
+  if (!options.trace.empty() && tracingEnabled()) {
+    try {
+      exportChromeTrace(options.trace);
+    } catch (const ChronicleException& e) {
+      std::cerr << e.what() << "\n";
+      if (status == EXIT_OK) status = EXIT_FATAL;
+    }
+  }
+
+  return status;
+}